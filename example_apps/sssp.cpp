@@ -13,6 +13,7 @@ bool        scheduler = true;
 vid_t		single_source = 0;
 bool		reset_edge_value = false;
 bool		num_tasks_print = false;
+bool		bucketed = false;	// delta-stepping, tasks are scheduled by tentative distance
 
 /**
  * Type definitions. Remember to create suitable graph shards using the
@@ -77,17 +78,19 @@ struct SSSPProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
 			
 				converged = false;
 				for(int j=0;j<vertex.num_outedges();j++){
-            		if (scheduler)
+					EdgeDataType edata = vertex.outedge(j)->get_data();
+            		if (scheduler && bucketed)
+						gcontext.scheduler->add_task_priority(vertex.outedge(j)->vertexid, (double) edata.value);
+            		else if (scheduler)
 						gcontext.scheduler->add_task(vertex.outedge(j)->vertexid, false);
 					
-					EdgeDataType edata = vertex.outedge(j)->get_data();
 					edata.srcValue = 0.0;
 					vertex.outedge(j)->set_data(edata);
 				}
 			}else{
 				vertex.set_data(infinity);
 				for(int j=0;j<vertex.num_outedges();j++){
-					if (scheduler)
+					if (scheduler && !bucketed)
 						gcontext.scheduler->add_task(vertex.outedge(j)->vertexid, false);
 					EdgeDataType edata = vertex.outedge(j)->get_data();
 					edata.srcValue = infinity;
@@ -124,7 +127,10 @@ struct SSSPProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
 				vertex.set_data(min);
 				for(int j=0; j<vertex.num_outedges(); j++){
 					vid_t out_edge_vid = vertex.outedge(j)->vertexid;
-					if (scheduler){
+					EdgeDataType edata = vertex.outedge(j)->get_data();
+					if (scheduler && bucketed){
+						gcontext.scheduler->add_task_priority(out_edge_vid, (double) (min + edata.value));
+					}else if (scheduler){
 						if(out_edge_vid >= gcontext.interval_st){	
 							//vertex is updated in this iteration
 							gcontext.scheduler->add_task(vertex.outedge(j)->vertexid, true);
@@ -133,7 +139,6 @@ struct SSSPProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
 							gcontext.scheduler->add_task(vertex.outedge(j)->vertexid, false);
 						}
 					}
-					EdgeDataType edata = vertex.outedge(j)->get_data();
 					edata.srcValue = min;
 					vertex.outedge(j)->set_data(edata);
 				}  
@@ -161,7 +166,9 @@ struct SSSPProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
      * Called after an iteration has finished.
      */
     void after_iteration(int iteration, graphchi_context &ginfo) {
-        if (converged) {
+        // With buckets, an iteration runs only one bucket, so a quiet one does not
+        // mean convergence; the run ends when the scheduler has no tasks left.
+        if (converged && !bucketed) {
             std::cout << "Converged!" << std::endl;
             ginfo.set_last_iteration(iteration);
         }
@@ -217,6 +224,7 @@ int main(int argc, const char ** argv) {
 	single_source		 = get_option_int("root", 0);
 	reset_edge_value	 = get_option_int("reset_edge_value", false);
 	num_tasks_print		 = get_option_int("print", false);
+	bucketed			 = scheduler && get_option_float("bucket_width", 0.0f) > 0;
 	//int ntop 			 = get_option_int("top",30);
 //    
 //	std::cout << "------------------------\tExecution Mode\t----------------" << std::endl;
@@ -39,6 +39,7 @@
 
 #include "graphchi_basic_includes.hpp"
 #include "util/labelanalysis.hpp"
+#include "output/parallel_output_writer.hpp"
 #include "util/maxdeg.cpp"
 
 using namespace graphchi;
@@ -350,8 +351,8 @@ struct SCCBackward : public GraphChiProgram<VertexDataType, EdgeDataType> {
 };
 
 graphchi_engine<VertexDataType, EdgeDataType> * gengine = NULL;
-FILE* fpout = NULL;
-FILE* fpout1 = NULL;
+parallel_output_writer* fpout = NULL;
+parallel_output_writer* fpout1 = NULL;
 /* Simple contraction step that just outputs the non-deleted edges. Would be better
  done automatically, but the dynamic engine is a bit flaky. */
 struct ContractionStep : public GraphChiProgram<VertexDataType, EdgeDataType> {
@@ -364,29 +365,25 @@ struct ContractionStep : public GraphChiProgram<VertexDataType, EdgeDataType> {
 			bidirectional_label edgedata = vertex.outedge(i)->get_data();
 			if(edgedata.is_equal()){		
 				if(root == edgedata.my_label(vertex.id(), vertex.outedge(i)->vertexid)){
-					lock.lock();
-						fprintf(fpout, "%u\t%u\n", vertex.id(), vertex.outedge(i)->vertexid);
-					lock.unlock();
+					fpout->write_edge(vertex.id(), vertex.outedge(i)->vertexid);
 					continue;
 				}
 			}
-			lock.lock();
-			fprintf(fpout1, "%u\t%u\n", vertex.id(), vertex.outedge(i)->vertexid);
-			lock.unlock();
+			fpout1->write_edge(vertex.id(), vertex.outedge(i)->vertexid);
 		}
 	}
 	void before_iteration(int iteration, graphchi_context &gcontext) {
 		//converged = iteration > 0;
 		assert(fpout != NULL);
 		assert(fpout1 != NULL);
-		fflush(fpout);
-		fflush(fpout1);
+		fpout->flush();
+		fpout1->flush();
 	}
 	 void after_iteration(int iteration, graphchi_context &gcontext) {
 	//	if(converged){
 	//		logstream(LOG_INFO)<<"scc_backward has finished!"<<std::endl;
-			fflush(fpout);
-			fflush(fpout1);
+			fpout->flush();
+			fpout1->flush();
 			gcontext.set_last_iteration(iteration);
 	//	}
 	}
@@ -422,8 +419,8 @@ int main(int argc, const char ** argv) {
 	scheduler = get_option_int("scheduler", false); 
 	int niters = get_option_int("niters", 1000);
     /* Run */
-    fpout = fopen((filename+".bigscc").c_str(), "w+"); 
-    fpout1 = fopen((filename+".smallscc").c_str(), "w+"); 
+    fpout = new parallel_output_writer(filename+".bigscc"); 
+    fpout1 = new parallel_output_writer(filename+".smallscc"); 
 	assert(fpout != NULL);
 	assert(fpout1 != NULL);
 	//use max outdegree*indegree as the pivot to find the largest SCC
@@ -442,8 +439,8 @@ int main(int argc, const char ** argv) {
     analyze_labels<VertexDataType>(filename);
     
     //delete_shards<EdgeDataType>(filename, nshards);
-   	fclose(fpout); 
-   	fclose(fpout1); 
+   	delete fpout; 
+   	delete fpout1; 
     
     /* Report execution metrics */
     metrics_report(m);
@@ -38,6 +38,8 @@
 
 #include "graphchi_basic_includes.hpp"
 #include "util/active_analysis.hpp"
+#include "util/partition_assignment.hpp"
+#include "output/parallel_output_writer.hpp"
 //#include "DAG.cpp"
 //#include "util/labelanalysis.hpp"
 
@@ -161,8 +163,8 @@ struct label_count{
 	}
 };
 
-FILE* vfout = NULL;
-FILE* efout = NULL;
+parallel_output_writer* vfout = NULL;
+parallel_output_writer* efout = NULL;
 FILE* fp_interval = NULL;
 std::vector<vid_t> start_vid;
 //storing the mapping between block id with array index 
@@ -187,6 +189,9 @@ int get_new_id(int lb){
   * class. The main logic is usually in the update function.
   */
 
+//number of active vertices after the last iteration, reduced by the engine
+active_count_aggregator active_vertices;
+
 struct initBFS : public GraphChiProgram<VertexDataType, EdgeDataType> {
     /**
      *  Vertex update function.
@@ -215,6 +220,7 @@ struct initBFS : public GraphChiProgram<VertexDataType, EdgeDataType> {
 				//std::cout<<"vid"<<vertex.edge(id)->vertexid
 			}
 			//assert(vertex.num_edges() ==4 );	
+			active_vertices.add();
 
 		} /*else {
 
@@ -413,6 +419,8 @@ struct msBFS : public GraphChiProgram<VertexDataType, EdgeDataType> {
 					assert(vdata.inbfs == true);
 			}	
 		}
+		if((vertex.get_data()).is_active())
+			active_vertices.add();
     }
     
     /**
@@ -789,9 +797,7 @@ struct ReMap : public GraphChiProgram<VertexDataType, EdgeDataType> {
 				//std::cout<<"vid"<<vertex.edge(id)->vertexid
 			}
 			//assert(vertex.num_edges() ==4 );	
-			lock.lock();
-			fprintf(vfout, "%d\t%d\n", (int)vertex.id(), new_id);	
-			lock.unlock();
+			vfout->print("%d\t%d\n", (int)vertex.id(), new_id);
 
 		}else{
 			//VertexDataType vdata = vertex.get_data();
@@ -804,13 +810,9 @@ struct ReMap : public GraphChiProgram<VertexDataType, EdgeDataType> {
 				vid_t nb_id = edata.neighbor_label(vertex.id(), e->vertex_id());	
 				assert(my_id != nb_id);
 				if(!weight_flag){
-					lock.lock();
-					fprintf(efout, "%u\t%u\n", my_id, nb_id);
-					lock.unlock();
+					efout->write_edge(my_id, nb_id);
 				}else{
-					lock.lock();
-					fprintf(efout, "%u\t%u\t%.3f\n", my_id, nb_id, edata.weight);
-					lock.unlock();
+					efout->write_edge(my_id, nb_id, edata.weight);
 				}	
 				/*	
 				if(edata.can_propagate()){
@@ -894,6 +896,7 @@ int main(int argc, const char ** argv) {
     graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, scheduler, m); 
 	//save edges attributes after execution in in-memory mode
 	engine.set_save_edgesfiles_after_inmemmode(true);
+	engine.add_aggregator(&active_vertices);
     engine.run(init_program, niters);
 	/*
 	graphchi_engine<VertexDataType, EdgeDataType> enginexx(filename, nshards, scheduler, m); 
@@ -902,7 +905,7 @@ int main(int argc, const char ** argv) {
 	std::cout<<"check initBFS is finished!"<<std::endl;	
 	*/
 	int active_curr = 0;	
-	int active_prev = active_vertices_count<VertexDataType>(filename);		
+	int active_prev = (int)active_vertices.value();		
 
 	msBFS msbfs_program;	
 	int round = 0;
@@ -913,7 +916,11 @@ int main(int argc, const char ** argv) {
 		std::cout<<"running msBFS round "<<round++<<"------------"<<std::endl;
     	//engine2.run(msbfs_program, niters);
     	engine.run(msbfs_program, niters);
-		active_curr = active_vertices_count<VertexDataType>(filename);		
+		//the aggregate covers all vertices only if every vertex is updated
+		if(scheduler)
+			active_curr = active_vertices_count<VertexDataType>(filename);		
+		else
+			active_curr = (int)active_vertices.value();		
 		ratio = (double)active_curr/active_prev;
 		active_prev = active_curr;
 		block_size_sum += sum_block();
@@ -974,16 +981,20 @@ int main(int argc, const char ** argv) {
 	
 	std::cout<<"assigning blocks to partitions"<<std::endl;
 	
+	std::vector<long> block_sizes(collect_result.size());
 	for(int i=0; i<(int)collect_result.size(); i++){
-		int min_idx = 0;		
-		for(int j=1; j<(int)partitions.size(); j++){
-			if(partitions[j] < partitions[min_idx])
-				min_idx = j;
-		}	
-		partitions[min_idx] += collect_result[i].count;				
-		block_to_par[i] = min_idx;	
+		block_sizes[i] = collect_result[i].count;
+	}
+	//each block goes to the least loaded partition
+	partition_assignment assignment(num_par, block_sizes);
+	assignment.assign_least_loaded();
+	for(int i=0; i<(int)collect_result.size(); i++){
+		block_to_par[i] = assignment.partition_of(i);	
 		block_to_idx.insert(std::pair<int,int>(collect_result[i].label, i));
 	}						
+	for(int i=0; i<num_par; i++){
+		partitions[i] = (int)assignment.load(i);
+	}
 
 	fp_interval = fopen((filename+".blogel.interval").c_str(), "w+");
 	assert(fp_interval != NULL);
@@ -1006,20 +1017,20 @@ int main(int argc, const char ** argv) {
 	}
 	//std::cout<<"assigning blocks to partitions finished!2"<<std::endl;
 	//vfout = fopen((filename+".bv").c_str(), "w+");
-	vfout = fopen((filename+".blogel.vmap").c_str(), "w+");
+	vfout = new parallel_output_writer(filename+".blogel.vmap");
 	//efout = fopen((filename+".be").c_str(), "w+");
-	efout = fopen((filename+".blogel").c_str(), "w+");
+	efout = new parallel_output_writer(filename+".blogel");
 	assert(vfout != NULL && efout != NULL);
-	fprintf(vfout, "# old_vid  new_vid\n");
-	fprintf(efout, "# new_src  new_dst\n");
-	fflush(vfout);
-	fflush(efout);
+	vfout->print("# old_vid  new_vid\n");
+	efout->print("# new_src  new_dst\n");
+	vfout->flush();
+	efout->flush();
 	std::cout<<"ReMap is started"<<std::endl;
 	//graphchi_engine<Vertexinfo, EdgeDataType> engine5(filename, nshards, scheduler, m);	
 	ReMap remap;
 	engine.run(remap, 2);
-	fclose(vfout);
-	fclose(efout);
+	delete vfout;
+	delete efout;
 	//std::cout<<"block number is "<<block_num<<std::endl;
     /* Report execution metrics */
 	std::cout<<"total blocks: "<<total_blocks<<"\t visited vertices "<<block_size_sum<<"\t active: "
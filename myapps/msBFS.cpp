@@ -9,6 +9,11 @@
 #include "graphchi_basic_includes.hpp"
 #include "util/active_analysis.hpp"
 #include "util/toplist.hpp"
+#include "util/block_graph.hpp"
+#include "util/partition_assignment.hpp"
+#include "util/degree_index.hpp"
+#include "util/bitparallel_bfs.hpp"
+#include "output/parallel_output_writer.hpp"
 #include "DAG.cpp"
 //#include "util/labelanalysis.hpp"
 
@@ -127,6 +132,11 @@ mutex lock;
 int NumRoots = 0;
 //int NumLevels = 0;
 std::set<vid_t> roots;
+//active vertices by degree, roots of each round are picked from it
+degree_index* degindex = NULL;
+//source masks of the bit-parallel mode, source i is rootlist[i]
+bitparallel_bfs* bpbfs = NULL;
+std::vector<vid_t> rootlist;
 std::map<vid_t, int> sizecount;
 
 //int numPartitions = 0;
@@ -151,7 +161,7 @@ struct label_count{
 	}
 };
 
-FILE* vfout = NULL;
+parallel_output_writer* vfout = NULL;
 FILE* efout = NULL;
 std::vector<vid_t> start_vid;
 //storing the mapping between block id with array index 
@@ -197,6 +207,8 @@ struct initBFS : public GraphChiProgram<VertexDataType, EdgeDataType> {
 			if(vertex.num_edges() == 0) vdata.inbfs = true;
 			else vdata.inbfs = false;
 			vdata.indeg = vertex.num_inedges();
+			if(vdata.is_active())
+				degindex->add(vertex.id(), vdata.indeg);
 			//vdata.level = MAX_LEVEL;
 			vertex.set_data(vdata);
 			for(int id = 0; id < vertex.num_edges(); id++)
@@ -364,6 +376,7 @@ struct msBFS : public GraphChiProgram<VertexDataType, EdgeDataType> {
 				vdata.label = (int)vertex.id();
 				vdata.inbfs = true;
 				vertex.set_data(vdata);
+				degindex->deactivate(vertex.id());
 				
 				for(int id = 0; id < vertex.num_edges(); id++)
 				{
@@ -455,6 +468,7 @@ struct msBFS : public GraphChiProgram<VertexDataType, EdgeDataType> {
 				vdata.label = minlabel;
 				vdata.inbfs = true;
 				vertex.set_data(vdata);
+				degindex->deactivate(vertex.id());
 				assert(isSources((vid_t)minlabel));
 				for(int i=0; i < vertex.num_edges(); i++) {
 					graphchi_edge<EdgeDataType> * e = vertex.edge(i);	
@@ -526,6 +540,79 @@ struct msBFS : public GraphChiProgram<VertexDataType, EdgeDataType> {
     
 };
 
+/**
+  * Bit-parallel variant of msBFS: all roots advance together, one level
+  * per iteration, and a vertex takes the label of the first root (in
+  * root order) among those at the smallest distance.
+  */
+struct msBFSBitParallel : public GraphChiProgram<VertexDataType, EdgeDataType> {
+
+	//label the vertex and its edges with the root, write the level to outedges
+	void join_tree(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, vid_t root, int level){
+		VertexDataType vdata = vertex.get_data();
+		vdata.label = (int)root;
+		vdata.inbfs = true;
+		vertex.set_data(vdata);
+		degindex->deactivate(vertex.id());
+		for(int i=0; i < vertex.num_edges(); i++) {
+			graphchi_edge<EdgeDataType> * e = vertex.edge(i);	
+			EdgeDataType edata = e->get_data();
+			edata.my_label(vertex.id(), e->vertex_id()) = (int)root;
+			if(i >= (int)vertex.num_inedges()){
+				edata.level = level;
+			}
+			e->set_data(edata);
+		}	
+		increaseSize(root);	
+	}
+
+    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+		if(vertex.num_edges() == 0)
+			return;
+		if (gcontext.iteration == 0) {
+			if(isSources(vertex.id()))
+				join_tree(vertex, vertex.id(), 0);
+			return;
+		}
+		//vertices labeled in earlier rounds are not traversed
+		if((vertex.get_data()).label >= 0 && !bpbfs->reached(vertex.id()))
+			return;
+		for(int i=0; i < (int)vertex.num_inedges(); i++){
+			bpbfs->gather(vertex.id(), vertex.inedge(i)->vertex_id());
+		}
+		int src = bpbfs->settle(vertex.id());
+		if(src >= 0){
+			converged = false;
+			join_tree(vertex, rootlist[src], gcontext.iteration);
+		}
+    }
+    
+    void before_iteration(int iteration, graphchi_context &gcontext) {
+		if(iteration == 0){
+			rootlist.assign(roots.begin(), roots.end());
+			bpbfs->reset(rootlist);
+		}else{
+			bpbfs->advance();
+		}
+		converged = iteration > 0;	
+    }
+    
+	void after_iteration(int iteration, graphchi_context &gcontext) {
+		//no vertex was reached first on this level, so none will be on later ones
+		if(gcontext.iteration >= max_iterations || converged){
+			logstream(LOG_INFO)<<"max number of iterations is reached, terminate now!"<<std::endl;
+			gcontext.set_last_iteration(iteration);
+		}	
+	}
+    
+    void before_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {        
+    }
+    
+    void after_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {        
+    }
+    
+};
+
 struct checkBFS : public GraphChiProgram<VertexDataType, EdgeDataType> {
     
  
@@ -730,14 +817,20 @@ struct checkWCC : public GraphChiProgram<VertexDataType, EdgeDataType> {
     
 };
 
+//size of each block after the last WCC iteration, reduced by the engine
+label_count_aggregator block_labels;
+
 struct WCC : public GraphChiProgram<VertexDataType, EdgeDataType> {
     /**
      *  Vertex update function.
      */
     void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
 		//don't consider verties in BFS
-		if((vertex.get_data()).inbfs)
+		if((vertex.get_data()).inbfs){
+			if((vertex.get_data()).label >= 0)
+				block_labels.add((vertex.get_data()).label);
 			return;
+		}
 
 		if (gcontext.iteration == 0) {
 			int vertex_id = (int)vertex.id();
@@ -794,6 +887,7 @@ struct WCC : public GraphChiProgram<VertexDataType, EdgeDataType> {
 				converged = false;
 			}
 		}
+		block_labels.add((vertex.get_data()).label);
 	}
     
     /**
@@ -833,20 +927,15 @@ struct WCC : public GraphChiProgram<VertexDataType, EdgeDataType> {
 //number of total blocks
 int Size = 0;
 std::map<int, int> label2idx;
-//std::vector< std::vector<int> > adjmatrix;
-int** adjmatrix;
+//edges between blocks, collected by initAdjMatrix 
+block_graph_builder* blockbuilder = NULL;
+block_graph blockgraph;
 
 int totalvertices = 0;//total number of non-isolated vertices
-std::vector< bool > merged;
 
 std::vector<label_count> collect_result;
 std::vector<std::vector<int> > partitions;	
 std::vector<int> partition_size;
-//std::vector< std::set<int> > nbblocks; 
-//number of cut-edges of each bfs tree
-std::vector<int> cutedges;
-//use nbblocks to record the neighboring blocks of a partition 
-std::vector< std::set<int> > nbblocks; 
 std::vector<vid_t> newid;
 vid_t startvid = 0;
 
@@ -859,9 +948,7 @@ int label_index(int label_id){
 
 void increaseMatrixCell(int i, int j){
 	assert(i < Size && j < Size);
-	lock.lock();
-	adjmatrix[i][j]++;
-	lock.unlock();
+	blockbuilder->add_edge(i, j);
 }
 
 struct initAdjMatrix : public GraphChiProgram<VertexDataType, EdgeDataType> {
@@ -965,9 +1052,7 @@ struct ReMap : public GraphChiProgram<VertexDataType, EdgeDataType> {
 				//std::cout<<"vid"<<vertex.edge(id)->vertexid
 			}
 			//assert(vertex.num_edges() ==4 );	
-			lock.lock();
-			fprintf(vfout, "%u\t%u\n", vertex.id(), new_id);	
-			lock.unlock();
+			vfout->write_edge(vertex.id(), new_id);
 		}/*else{
 			//VertexDataType vdata = vertex.get_data();
 			//int min_label = vdata.label;
@@ -1030,99 +1115,12 @@ struct ReMap : public GraphChiProgram<VertexDataType, EdgeDataType> {
     
 };
 
-//add a block to a partition, we need to insert the block's 
-//unmerged neighbors to the corresponding set 
-void add_neighbors(int partitionid, int blockid){
-	assert(partitionid < (int)nbblocks.size());		
-	if(blockid >= Size)
-		std::cout<<"block id: "<<blockid<<"\t Size: "<<Size<<std::endl;
-	assert(blockid < Size);
-	for(int i=0; i<Size; i++){
-		if(!merged[i] && adjmatrix[blockid][i] > 0){
-			nbblocks[partitionid].insert(i);
-		}else if(!merged[i] && adjmatrix[i][blockid] > 0){
-			nbblocks[partitionid].insert(i);	
-		}	
-	}
-}
-
-float compute_block_score(int partitionid, int blockid){
-	float score = (float)0;
-	for(int i=0; i<(int)partitions[partitionid].size(); i++){
-		int blkid = partitions[partitionid][i];		
-		score += (adjmatrix[blkid][blockid]+adjmatrix[blockid][blkid])/(float)cutedges[blockid];	
-	}						
-	return score;
-}
-//compute the score between the partition and the block
-int highest_block(int partitionid){
-	std::set<int> nbsets = nbblocks[partitionid];			
-	float high_score = (float)0;
-	int bid = -1;//the corresponding block id of the block the highest score 
-	std::set<int>::iterator sit;			
-	for(sit = nbsets.begin(); sit != nbsets.end(); sit++){
-		//int blockid = *sit;
-		if(!merged[*sit]){
-			float tmp_score = compute_block_score(partitionid, *sit); 	
-			if(high_score < tmp_score){
-				high_score = tmp_score;	
-				bid = *sit;
-			}
-			//high_score = high_score < tmp_score ? tmp_score : high_score;
-		}	
-	}
-	return bid;	
-	//return high_score;
-}
-
-int largest_block(){
-	int blksize = 0;	
-	int blkid = -1;
-	for(int i=0; i<(int)collect_result.size(); i++){
-		if(!merged[i] && collect_result[i].count > blksize){
-			blksize = collect_result[i].count;		
-			//blkid = collect_result[i].label;
-			blkid = i;
-		}	
-	}
-	return blkid;
-}
-//choose the neighbor block with highest neighboring score
-int best_nbblock(int partitionid){
-	assert(partitionid < (int)nbblocks.size());	
-	int blkid = highest_block(partitionid);	
-	if(blkid != -1){
-		return blkid;									
-	}else{
-		//this partition currently has no unmerged neighbors, choose the largest block from the rest
-		blkid = largest_block();	 					
-		assert(blkid != -1);
-		return blkid;
-	}	
-	return blkid;
-} 
-
-int least_loaded_partition(){
-	int blksize = totalvertices + 1;
-	int blkid = 0;
-	//choose the least loaded partition								
-	for(int i=0; i<(int)partition_size.size(); i++){
-		if(blksize > partition_size[i]){
-			blksize = partition_size[i];
-			blkid = i;
-		}		
-	}
-	return blkid;	
-}
-
 void free_matrix(){
-	if(adjmatrix == NULL)
-		return;
-	for(int i=0; i<Size; i++){
-		free(adjmatrix[i]);
+	if(blockbuilder != NULL){
+		delete blockbuilder;
+		blockbuilder = NULL;
 	}
-	free(adjmatrix);
-	adjmatrix = NULL;
+	blockgraph.clear();
 }
 
 //the vertex id range of each partition [start, end]
@@ -1155,6 +1153,8 @@ int main(int argc, const char ** argv) {
 	NumRoots			 = get_option_int("roots", 1000);	
 	MAX_LEVEL		     = get_option_int("levels", 10);
 	stop_ratio			 = (double)get_option_float("stopratio", 0.1);	
+	//advance all roots of a round together with per-vertex source bitmasks
+	bool bitparallel	 = get_option_int("bitparallel", 0) != 0;
 	//numPartitions	     = get_option_int("");
 	
 	//exclude left and right part of the DAG	
@@ -1174,8 +1174,10 @@ int main(int argc, const char ** argv) {
     //bfs program;
 	
     graphchi_engine<VertexDataType, EdgeDataType> engine1(filename, nshards, scheduler, m); 
+	degindex = new degree_index(engine1.num_vertices());
 	std::cout<<"---------------------------start init program----------------------------------"<<std::endl;
     engine1.run(init_program, niters);
+	degindex->build();
 	/*
 	graphchi_engine<VertexDataType, EdgeDataType> enginexx(filename, nshards, scheduler, m); 
 	checkBFS check_program1;	
@@ -1183,11 +1185,15 @@ int main(int argc, const char ** argv) {
 	std::cout<<"check initBFS is finished!"<<std::endl;	
 	*/
 	int active_curr = 0;	
-	int active_prev = active_vertices_count<VertexDataType>(filename);		
+	int active_prev = (int)degindex->num_active();		
 
 	scheduler = false;
     graphchi_engine<VertexDataType, EdgeDataType> engine2(filename, nshards, scheduler, m); 
 	msBFS msbfs_program;	
+	msBFSBitParallel bp_program;
+	//the masks are held in memory, so they are limited by membudget_mb
+	if(bitparallel)
+		bpbfs = new bitparallel_bfs(engine2.num_vertices(), NumRoots, get_option_int("membudget_mb", 1024));
 	int round = 0;
 	int block_size_sum = 0;	
 	int total_blocks = 0;
@@ -1198,13 +1204,30 @@ int main(int argc, const char ** argv) {
 	while(true){
 		std::cout<<"------------------------------running msBFS round "<<round++<<"------------"<<std::endl;
 		//roots.clear();
-		roots = get_top_degree_vertices<VertexDataType>(filename, NumRoots); 	
+		roots = degindex->top(NumRoots); 	
 		sizecount.clear();
 		for(std::set<vid_t>::iterator it = roots.begin(); it != roots.end(); it++){
 			sizecount.insert(std::make_pair(*it, 0));
 		}
-    	engine2.run(msbfs_program, niters);
-		active_curr = active_vertices_count<VertexDataType>(filename);		
+		if(bitparallel){
+			//roots that do not fit in one sweep run in later sweeps, skipping
+			//those already reached by an earlier sweep of the round
+			std::vector<vid_t> pending(roots.begin(), roots.end());
+			size_t width = bpbfs->max_sources();
+			for(size_t st = 0; st < pending.size(); st += width){
+				roots.clear();
+				for(size_t i = st; i < std::min(pending.size(), st + width); i++){
+					if(degindex->is_active(pending[i]))
+						roots.insert(pending[i]);
+				}
+				if(!roots.empty())
+					engine2.run(bp_program, niters);
+			}
+			roots.clear();
+			roots.insert(pending.begin(), pending.end());
+		}else
+    		engine2.run(msbfs_program, niters);
+		active_curr = (int)degindex->num_active();		
 		//ratio = (double)active_curr/active_prev;
 		ratio = (double)active_curr/totalvertices;
 		for(std::map<vid_t, int>::iterator it=sizecount.begin(); it != sizecount.end(); it++){
@@ -1236,6 +1259,12 @@ int main(int argc, const char ** argv) {
 		*/
 		//sources.clear();
 	}
+	delete degindex;
+	degindex = NULL;
+	if(bpbfs != NULL){
+		delete bpbfs;
+		bpbfs = NULL;
+	}
 	
 	scheduler = false;
 	//graphchi_engine<VertexDataType, EdgeDataType> enginex(filename, nshards, scheduler, m); 
@@ -1254,6 +1283,7 @@ int main(int argc, const char ** argv) {
 		//std::cout<<"check wcc init finished"<<std::endl;	
 
 		graphchi_engine<VertexDataType, EdgeDataType> engine4(filename, nshards, scheduler, m); 
+		engine4.add_aggregator(&block_labels);
 		WCC wcc_program;	
 		engine4.run(wcc_program, niters);
 		std::cout<<"WCC is finished"<<std::endl;	
@@ -1277,16 +1307,20 @@ int main(int argc, const char ** argv) {
 
 	//std::vector<label_count> collect_result;
 	//count_labels<VertexDataType, label_count>(filename, 40, collect_result); 
-	msbfs_count_labels<VertexDataType, label_count>(filename, 40, collect_result); 
+	if(active_curr > 0){
+		//WCC touched every vertex in its last iteration, so its label counts are final
+		std::vector<std::pair<int, long> > counts = block_labels.sorted_by_count();
+		collect_result.resize(counts.size());
+		for(int i=0; i<(int)counts.size(); i++){
+			collect_result[i] = label_count(counts[i].first, (vid_t)counts[i].second);
+		}
+	}else{
+		msbfs_count_labels<VertexDataType, label_count>(filename, 40, collect_result); 
+	}
 	std::cout<<"blocks size: "<<collect_result.size()<<"\t partition number: "<<num_par<<std::endl;
 	assert((int)collect_result.size() > 0);
-	merged.resize(collect_result.size(), false);
 	Size = (int)collect_result.size();
-	adjmatrix = (int **) malloc(sizeof(int*)*Size);
-	for(int i=0; i<(int)collect_result.size(); i++){
-		adjmatrix[i] = (int*)malloc(sizeof(int)*Size);	
-		memset(adjmatrix[i], 0, sizeof(int)*Size);
-	}
+	blockbuilder = new block_graph_builder(Size);
 	
 	for(int i=0; i<(int)collect_result.size(); i++){
 		label2idx.insert(std::pair<int, int>(collect_result[i].label, i));	
@@ -1296,49 +1330,23 @@ int main(int argc, const char ** argv) {
 	engine5.set_save_edgesfiles_after_inmemmode(false);
 	initAdjMatrix matrix_program;	
 	engine5.run(matrix_program, niters);
+	blockbuilder->build(blockgraph);
+	delete blockbuilder;
+	blockbuilder = NULL;
 	
 	std::cout<<"-------------------start assigning blocks to partitions--------------------"<<std::endl;
-	partitions.resize(num_par);	
-	partition_size.resize(num_par, 0);
-	nbblocks.resize(num_par);
-	//std::vector< std::set<int> > nbblocks; 
-	//number of cut-edges of each bfs tree
-	cutedges.resize(Size, 0);
-	//initialize cutedges array
+	//blocks are sorted by size, so the top num_par blocks seed the partitions
+	std::vector<long> block_sizes(Size);
 	for(int i=0; i<Size; i++){
-		assert(adjmatrix[i][i] == 0);
-		//sum i-th row and i-th column
-		for(int j=0; j<Size; j++){
-			cutedges[i] += adjmatrix[i][j];	
-			cutedges[i] += adjmatrix[j][i];
-		}	
+		block_sizes[i] = collect_result[i].count;
 	}
-	//number of unmerged blocks
-	int active_blocks = (int)collect_result.size();
+	partition_assignment assignment(num_par, block_sizes, &blockgraph);
+	assignment.assign_greedy();
+	partitions.resize(num_par);	
+	partition_size.resize(num_par, 0);
 	for(int i=0; i<num_par; i++){
-		//choose the top num_par blocks as the initial vertex
-		//label_count lcount = collect_result[i];
-
-		partitions[i].push_back(i);		
-		//partitions[i].push_back(collect_result[i].label);		
-		partition_size[i] = collect_result[i].count;	
-		//merged[label_index(collect_result[i].label)] = true;	
-		merged[i] = true;	
-		add_neighbors(i, i);
-	}
-
-	active_blocks = active_blocks - num_par;				
-
-	while(active_blocks-- > 0){
-		//choose the least loaded partition to merge blocks	
-		int partid = least_loaded_partition();		
-		//choose the most connected neighbor block to merge 
-		int blkid = best_nbblock(partid);			
-		//partitions[partid].push_back(collect_result[blkid].label);
-		partitions[partid].push_back(blkid);
-		partition_size[partid] += collect_result[blkid].count;
-		merged[blkid] = true;
-		add_neighbors(partid, blkid);
+		partitions[i] = assignment.blocks(i);
+		partition_size[i] = (int)assignment.load(i);
 	}
 					
 	//FILE* finterval = fopen((orig_filename+".dag.interval").c_str(), "w+");
@@ -1365,18 +1373,19 @@ int main(int argc, const char ** argv) {
 
 	std::cout<<"---------------ReMap is started-------------------"<<std::endl;
 	//open vertex map file for appending	
-	vfout = fopen((orig_filename+".vmap").c_str(), "a");
+	vfout = new parallel_output_writer(orig_filename+".vmap", OUTPUT_TEXT, true);
 	assert(vfout != NULL);
 	//efout = fopen((filename+".be").c_str(), "w+");
 	//assert(vfout != NULL && efout != NULL);
-	fprintf(vfout, "# old_vid\tnew_vid\n");
+	vfout->print("# old_vid\tnew_vid\n");
+	vfout->flush();
 	//fprintf(efout, "# new_src\tnew_dst\n");
 
 	//graphchi_engine<Vertexinfo, EdgeDataType> engine(filename, nshards, scheduler, m);	
 	ReMap remap;
 	engine5.run(remap, 1);
 	
-	fclose(vfout);
+	delete vfout;
 	free_matrix();
 	//fclose(efout);
 	FILE* finterval = fopen((orig_filename+".dag.interval").c_str(), "w+");
@@ -0,0 +1,97 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Strongly Connected Components with trimming, multi-pivot
+ * forward-backward passes and an in-memory Tarjan finish, see
+ * util/multipivot_scc.hpp. The labels are stored as vertex data and
+ * summarized with analyze_labels().
+ */
+
+#include <string>
+
+#include "graphchi_basic_includes.hpp"
+#include "util/labelanalysis.hpp"
+#include "util/multipivot_scc.hpp"
+
+using namespace graphchi;
+
+typedef vid_t VertexDataType;   // SCC label
+typedef vid_t EdgeDataType;     // not used, the state is kept in memory
+
+vid_t * labels = NULL;
+
+/**
+ * Stores the labels as vertex data for analyze_labels().
+ */
+struct StoreLabels : public GraphChiProgram<VertexDataType, EdgeDataType> {
+
+    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+        vertex.set_data(labels[vertex.id()]);
+    }
+};
+
+int main(int argc, const char ** argv) {
+    /* GraphChi initialization will read the command line
+     arguments and the configuration file. */
+    graphchi_init(argc, argv);
+
+    /* Metrics object for keeping track of performance counters
+     and other information. Currently required. */
+    metrics m("multipivot-scc");
+
+    /* Basic arguments for application */
+    std::string filename = get_option_string("file");  // Base filename
+    int niters           = get_option_int("niters", 1000);
+    int npivots          = get_option_int("npivots", 64);
+    size_t tarjan_edges  = (size_t) get_option_long("tarjan_edges", 16 * 1024 * 1024);
+
+    /* Detect the number of shards or preprocess an input to create them */
+    int nshards          = convert_if_notexists<EdgeDataType>(filename,
+                                                              get_option_string("nshards", "auto"));
+
+    graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, true, m);
+    engine.set_only_adjacency(true);
+    engine.set_modifies_inedges(false);
+    engine.set_modifies_outedges(false);
+    vid_t nvertices = (vid_t) engine.num_vertices();
+
+    labels = (vid_t *) malloc(sizeof(vid_t) * nvertices);
+
+    metrics_entry me = m.start_time();
+    scc_stats stats = multipivot_scc(engine, filename, labels, niters, npivots, tarjan_edges);
+    m.stop_time(me, "scc");
+
+    StoreLabels store;
+    engine.run(store, 1);
+
+    analyze_labels<VertexDataType>(filename);
+
+    free(labels);
+
+    /* Report execution metrics */
+    std::cout << "Forward-backward passes: " << stats.npasses << std::endl;
+    metrics_report(m);
+    return 0;
+}
@@ -63,12 +63,12 @@ bool scheduler = false;
 //bool num_tasks_print = false;
 vid_t sum_tasks= 0;
 vid_t curr_sum = 0;
-int* bvertices = NULL;
 int* interval_array = NULL;
-vid_t** partitions = NULL;
-int* numvertices = NULL;
+//per-interval statistics, reduced by the engine
+matrix_aggregator<vid_t>* partitions = NULL;
+array_aggregator<int>* bvertices = NULL;
+array_aggregator<int>* numvertices = NULL;
 int vnum = 0;
-mutex lock; 
 int nshards = 0;
 //get the inteval id to which vid belongs
 int locate_interval(vid_t vid){
@@ -127,24 +127,18 @@ struct PagerankProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
         if (ginfo.iteration == 0) {
 			int ith = locate_interval(v.id());
 			if(v.num_edges() > 0){
-				lock.lock();
-				numvertices[ith]++;	
-				lock.unlock();
+				numvertices->add(ith);
 			}
 			bool boundary = false;
             for(int i=0; i < v.num_outedges(); i++) {
 				int jth = locate_interval(v.outedge(i)->vertex_id());	
 				if(ith != jth){
 					boundary = true;	
-					lock.lock();
-					partitions[ith][jth]++;
-					lock.unlock();
+					partitions->add(ith, jth);
 				}
             }
 			if(boundary){
-				lock.lock();
-				bvertices[ith]++;
-				lock.unlock();
+				bvertices->add(ith);
 			}
             //v.set_data(RANDOMRESETPROB); 
 			//schedule this vertex for next iteration
@@ -227,18 +221,15 @@ int main(int argc, const char ** argv) {
 	//array = (int*)malloc(sizeof(int)*nshards);
 	interval_array = (int*)malloc(sizeof(int)*nshards);	
 	memset(interval_array, 0, nshards*sizeof(int));
-	bvertices = (int *)malloc(sizeof(int)*nshards);
-	memset(bvertices, 0, nshards*sizeof(int));
-	partitions = (vid_t**)malloc(sizeof(vid_t*)*nshards);
-	for(int i=0; i<nshards; i++){
-		partitions[i] = (vid_t*)malloc(sizeof(vid_t)*nshards);	
-		memset(partitions[i], 0, nshards*sizeof(int));	
-	}
-	numvertices = (int*)malloc(sizeof(int)*nshards);
-	memset(numvertices, 0, nshards*sizeof(int));
+	bvertices = new array_aggregator<int>(nshards);
+	partitions = new matrix_aggregator<vid_t>(nshards, nshards);
+	numvertices = new array_aggregator<int>(nshards);
     /* Run */
     graphchi_engine<float, float> engine(filename, nshards, scheduler, m); 
     engine.set_modifies_inedges(false); // Improves I/O performance.
+	engine.add_aggregator(bvertices);
+	engine.add_aggregator(partitions);
+	engine.add_aggregator(numvertices);
 	vnum = engine.num_vertices();	
 	engine.set_exec_threads(1);
 	for(int i=0; i<nshards; i++){
@@ -309,25 +300,22 @@ int main(int argc, const char ** argv) {
 		if(i == nshards-1) total = vnum - interval_array[i];
 		else total = (float)interval_array[i+1] - interval_array[i];
 		*/
-		assert(numvertices[i] != 0);
-		std::cout<<i<<"="<<bvertices[i]/(float)numvertices[i]<<"\t";
+		assert(numvertices->value(i) != 0);
+		std::cout<<i<<"="<<bvertices->value(i)/(float)numvertices->value(i)<<"\t";
 		//std::cout<<i<<"="<<bvertices[i]<<"\t";
 	}
 	std::cout<<std::endl;
 	for(int i=0; i<nshards; i++){
 		for(int j=0; j<nshards; j++){
-			std::cout<<partitions[i][j]<<"\t";	
+			std::cout<<partitions->value(i, j)<<"\t";	
 		}
 		std::cout<<std::endl;
 	}
 
 	free(interval_array); 
-	free(bvertices);
-	free(numvertices);
-	for(int i=0; i<nshards; i++){
-		free(partitions[i]);
-	}
-	free(partitions);
+	delete bvertices;
+	delete numvertices;
+	delete partitions;
 
     return 0;
 }
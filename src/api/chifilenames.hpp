@@ -152,6 +152,29 @@ namespace graphchi {
         return adjfilename + "idx";
     }
     
+    /**
+     * Source-sorted edge stream written by the sharder
+     * (preprocessing/sorted_edgestream.hpp)
+     */
+    static std::string VARIABLE_IS_NOT_USED filename_sorted_edgestream(std::string basefilename);
+    static std::string VARIABLE_IS_NOT_USED filename_sorted_edgestream(std::string basefilename) {
+        return basefilename + ".srcsorted.edges";
+    }
+    
+    /**
+     * Vertex permutation and id map written by the reordering stage
+     * (preprocessing/vertex_reorder.hpp)
+     */
+    static std::string VARIABLE_IS_NOT_USED filename_vertex_permutation(std::string basefilename);
+    static std::string VARIABLE_IS_NOT_USED filename_vertex_permutation(std::string basefilename) {
+        return basefilename + ".vperm";
+    }
+    
+    static std::string VARIABLE_IS_NOT_USED filename_vertex_map(std::string basefilename);
+    static std::string VARIABLE_IS_NOT_USED filename_vertex_map(std::string basefilename) {
+        return basefilename + ".reorder.vmap";
+    }
+    
     /**
      * Configuration file name
      */
@@ -276,15 +299,74 @@ namespace graphchi {
     
     
     /**
-     * Delete the shard files
+     * Delete the files of one shard (adjacency, index and edge data blocks).
      */
     template<typename EdgeDataType_>
-    static void delete_shards(std::string base_filename, int nshards) {
+    static void delete_shard(std::string base_filename, int p, int nshards) {
 #ifdef DYNAMICEDATA
         typedef int EdgeDataType;
 #else
         typedef EdgeDataType_ EdgeDataType;
 #endif
+        size_t blocksize = 1024 * 1024;
+        while (blocksize % sizeof(EdgeDataType) != 0) blocksize++;
+        
+        int blockid = 0;
+        std::string filename_edata = filename_shard_edata<EdgeDataType>(base_filename, p, nshards);
+        std::string fsizename = filename_edata + ".size";
+        if (file_exists(fsizename)) {
+            int err = remove(fsizename.c_str());
+            if (err != 0) logstream(LOG_ERROR) << "Error removing file " << fsizename
+                << ", " << strerror(errno) << std::endl;
+        }
+        while(true) {
+            std::string block_filename = filename_shard_edata_block(filename_edata, blockid, blocksize);
+            if (file_exists(block_filename)) {
+                int err = remove(block_filename.c_str());
+                if (err != 0) logstream(LOG_ERROR) << "Error removing file " << block_filename
+                    << ", " << strerror(errno) << std::endl;
+                
+            } else {
+                
+                break;
+            }
+#ifdef DYNAMICEDATA
+            delete_block_uncompressed_sizefile(block_filename);
+#endif
+            blockid++;
+        }
+        std::string dirname = dirname_shard_edata_block(filename_edata, blocksize);
+        if (file_exists(dirname)) {
+            int err = remove(dirname.c_str());
+            if (err != 0) logstream(LOG_ERROR) << "Error removing directory " << dirname
+                << ", " << strerror(errno) << std::endl;
+            
+        }
+        
+        std::string adjname = filename_shard_adj(base_filename, p, nshards);
+        logstream(LOG_DEBUG) << "Deleting " << adjname << " exists: " << file_exists(adjname) << std::endl;
+        
+        if (file_exists(adjname)) {
+            int err = remove(adjname.c_str());
+            if (err != 0) logstream(LOG_ERROR) << "Error removing file " << adjname
+                << ", " << strerror(errno) << std::endl;
+        }
+        
+        std::string idxname = filename_shard_adjidx(adjname);
+        logstream(LOG_DEBUG) << "Deleting " << idxname << " exists: " << file_exists(idxname) << std::endl;
+        
+        if (file_exists(idxname)) {
+            int err = remove(idxname.c_str());
+            if (err != 0) logstream(LOG_ERROR) << "Error removing file " << idxname
+                << ", " << strerror(errno) << std::endl;
+        }
+    }
+    
+    /**
+     * Delete the shard files
+     */
+    template<typename EdgeDataType_>
+    static void delete_shards(std::string base_filename, int nshards) {
         logstream(LOG_DEBUG) << "Deleting files for " << base_filename << " shards=" << nshards << std::endl;
         std::string intervalfname = filename_intervals(base_filename, nshards);
         if (file_exists(intervalfname)) {
@@ -300,60 +382,8 @@ namespace graphchi {
          remove(degreefname.c_str());
          } */
         
-        size_t blocksize = 1024 * 1024;
-        while (blocksize % sizeof(EdgeDataType) != 0) blocksize++;
-        
         for(int p=0; p < nshards; p++) {
-            int blockid = 0;
-            std::string filename_edata = filename_shard_edata<EdgeDataType>(base_filename, p, nshards);
-            std::string fsizename = filename_edata + ".size";
-            if (file_exists(fsizename)) {
-                int err = remove(fsizename.c_str());
-                if (err != 0) logstream(LOG_ERROR) << "Error removing file " << fsizename
-                    << ", " << strerror(errno) << std::endl;
-            }
-            while(true) {
-                std::string block_filename = filename_shard_edata_block(filename_edata, blockid, blocksize);
-                if (file_exists(block_filename)) {
-                    int err = remove(block_filename.c_str());
-                    if (err != 0) logstream(LOG_ERROR) << "Error removing file " << block_filename
-                        << ", " << strerror(errno) << std::endl;
-                    
-                } else {
-                    
-                    break;
-                }
-#ifdef DYNAMICEDATA
-                delete_block_uncompressed_sizefile(block_filename);
-#endif
-                blockid++;
-            }
-            std::string dirname = dirname_shard_edata_block(filename_edata, blocksize);
-            if (file_exists(dirname)) {
-                int err = remove(dirname.c_str());
-                if (err != 0) logstream(LOG_ERROR) << "Error removing directory " << dirname
-                    << ", " << strerror(errno) << std::endl;
-                
-            }
-            
-            std::string adjname = filename_shard_adj(base_filename, p, nshards);
-            logstream(LOG_DEBUG) << "Deleting " << adjname << " exists: " << file_exists(adjname) << std::endl;
-            
-            if (file_exists(adjname)) {
-                int err = remove(adjname.c_str());
-                if (err != 0) logstream(LOG_ERROR) << "Error removing file " << adjname
-                    << ", " << strerror(errno) << std::endl;
-            }
-            
-            std::string idxname = filename_shard_adjidx(adjname);
-            logstream(LOG_DEBUG) << "Deleting " << idxname << " exists: " << file_exists(idxname) << std::endl;
-            
-            if (file_exists(idxname)) {
-                int err = remove(idxname.c_str());
-                if (err != 0) logstream(LOG_ERROR) << "Error removing file " << idxname
-                    << ", " << strerror(errno) << std::endl;
-            }
-
+            delete_shard<EdgeDataType_>(base_filename, p, nshards);
         }
        	/* 
         std::string numv_filename = base_filename + ".numvertices";
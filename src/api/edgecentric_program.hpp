@@ -0,0 +1,89 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * EdgeCentricProgram is subclassed by programs of the edge-centric
+ * engine (engine/graphchi_edgecentric_engine.hpp). Instead of an update
+ * function over a vertex and its edges, the program gives a scatter
+ * function, run for every edge, and a gather function that folds the
+ * updates scattered along the in-edges of a vertex into its value.
+ *
+ * The engine is templated on the program, so the functions are not
+ * virtual: a subclass hides the defaults below, and must define
+ *
+ *   bool scatter(vid_t src, const VertexDataType &srcval, const degree &srcdeg,
+ *                vid_t dst, const EdgeDataType * edata, UpdateType &update,
+ *                graphchi_context &gcontext);
+ *   void gather(vid_t dst, VertexDataType &dstval, const UpdateType &update,
+ *               graphchi_context &gcontext);
+ *
+ * scatter() returns false if the edge carries no update. edata is NULL
+ * if the engine runs with only adjacency.
+ */
+
+#ifndef GRAPHCHI_EDGECENTRIC_PROGRAM_DEF
+#define GRAPHCHI_EDGECENTRIC_PROGRAM_DEF
+
+#include "graphchi_types.hpp"
+#include "api/graphchi_context.hpp"
+
+namespace graphchi {
+
+    template <typename VertexDataType_, typename EdgeDataType_, typename UpdateType_>
+    class EdgeCentricProgram {
+
+    public:
+        typedef VertexDataType_ VertexDataType;
+        typedef EdgeDataType_ EdgeDataType;
+        typedef UpdateType_ UpdateType;
+
+        /**
+         * Called for every vertex once, before the first iteration.
+         */
+        void init(vid_t vertexid, VertexDataType &val) {
+        }
+
+        /**
+         * Called before an iteration starts.
+         */
+        void before_iteration(int iteration, graphchi_context &gcontext) {
+        }
+
+        /**
+         * Called after an iteration has finished.
+         */
+        void after_iteration(int iteration, graphchi_context &gcontext) {
+        }
+
+        /**
+         * Called for every vertex of an interval after the updates to
+         * the interval have been gathered.
+         */
+        void apply(vid_t vertexid, VertexDataType &val, graphchi_context &gcontext) {
+        }
+    };
+
+}
+
+#endif
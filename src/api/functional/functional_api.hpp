@@ -66,7 +66,8 @@ namespace graphchi {
         // Note: Unweighted version, edge value should also be passed
         // "Gather"
         virtual EdgeDataType op_neighborval(graphchi_context &info, vertex_info& myvertex, vid_t nbid, EdgeDataType nbval)= 0;         
-        // "Sum"
+        // "Sum". If this is a sum, min or max, declare combiner_type
+        // (see functional_defs.hpp).
         virtual EdgeDataType plus(VertexDataType curval, EdgeDataType toadd) = 0;
          // "Apply"
         virtual VertexDataType compute_vertexvalue(graphchi_context &ginfo, vertex_info& myvertex, EdgeDataType nbvalsum) = 0;        
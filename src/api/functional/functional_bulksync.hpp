@@ -90,13 +90,11 @@ namespace graphchi {
         // we do not need atomic instructions here!
         inline void add_inedge(vid_t src, ET * ptr, bool special_edge) {
             if (gcontext->iteration > 0) {
-                get_lock(vinfo.vertexid).lock();
-                cumval = kernel.plus(cumval, kernel.op_neighborval(*gcontext,
-                                                               vinfo, 
-                                                               src, 
-                                                               ptr->oldval(gcontext->iteration)));
-                get_lock(vinfo.vertexid).unlock();
-
+                functional_gather<KERNEL>::combine(kernel, vinfo.vertexid, cumval,
+                                                   kernel.op_neighborval(*gcontext,
+                                                                         vinfo, 
+                                                                         src, 
+                                                                         ptr->oldval(gcontext->iteration)));
             }
         }
         
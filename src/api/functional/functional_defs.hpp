@@ -23,6 +23,15 @@
  * @section DESCRIPTION
  *
  * Functional API defs.
+ *
+ * A kernel whose plus() is a sum, min or max can declare it, e.g.
+ *
+ *   typedef functional_sum_combiner combiner_type;
+ *
+ * If its vertex value is a plain number, gathered in-edge values are then
+ * combined into the vertex with one atomic instruction (for min and max,
+ * usually none) instead of taking the vertex lock for every edge.
+ * plus() is not called in that case.
  */
 #ifndef GRAPHCHI_FUNCTIONALDEFS_DEF
 #define GRAPHCHI_FUNCTIONALDEFS_DEF
@@ -30,6 +39,7 @@
 #include "api/graphchi_program.hpp"
 #include <vector>
 #include "util/pthread_tools.hpp"
+#include "util/atomic.hpp"
 
 namespace graphchi {
     
@@ -44,6 +54,98 @@ namespace graphchi {
         static std::vector<mutex> locks(1024);
         return locks[vertexid % 1024];
     }
+    
+    /* Known combiners, see above */
+    struct functional_no_combiner {};
+    struct functional_sum_combiner {};
+    struct functional_min_combiner {};
+    struct functional_max_combiner {};
+    
+    template <typename KERNEL>
+    class functional_has_combiner {
+        typedef char yes;
+        typedef long no;
+        template <typename K> static yes test(typename K::combiner_type *);
+        template <typename K> static no test(...);
+    public:
+        static const bool value = sizeof(test<KERNEL>(0)) == sizeof(yes);
+    };
+    
+    template <typename KERNEL, bool declared = functional_has_combiner<KERNEL>::value>
+    struct functional_combiner_of {
+        typedef functional_no_combiner type;
+    };
+    
+    template <typename KERNEL>
+    struct functional_combiner_of<KERNEL, true> {
+        typedef typename KERNEL::combiner_type type;
+    };
+    
+    /* Types that atomic_compare_and_swap() supports */
+    template <typename T> struct functional_atomic_type { static const bool value = false; };
+    template <> struct functional_atomic_type<int> { static const bool value = true; };
+    template <> struct functional_atomic_type<unsigned int> { static const bool value = true; };
+    template <> struct functional_atomic_type<long> { static const bool value = true; };
+    template <> struct functional_atomic_type<unsigned long> { static const bool value = true; };
+    template <> struct functional_atomic_type<float> { static const bool value = true; };
+    template <> struct functional_atomic_type<double> { static const bool value = true; };
+    
+    /**
+     * Combines a gathered value into the accumulator of a vertex. The
+     * generic version calls the kernel's plus() under the vertex lock.
+     */
+    template <typename KERNEL,
+              typename Combiner = typename functional_combiner_of<KERNEL>::type,
+              bool atomic = functional_atomic_type<typename KERNEL::VertexDataType>::value>
+    struct functional_gather {
+        typedef typename KERNEL::VertexDataType VT;
+        typedef typename KERNEL::EdgeDataType ET;
+        
+        static inline void combine(KERNEL &kernel, vid_t vertexid, VT &acc, ET x) {
+            get_lock(vertexid).lock();
+            acc = kernel.plus(acc, x);
+            get_lock(vertexid).unlock();
+        }
+    };
+    
+    template <typename KERNEL>
+    struct functional_gather<KERNEL, functional_sum_combiner, true> {
+        typedef typename KERNEL::VertexDataType VT;
+        typedef typename KERNEL::EdgeDataType ET;
+        
+        static inline void combine(KERNEL &kernel, vid_t vertexid, VT &acc, ET x) {
+            VT oldval = acc;
+            while(!atomic_compare_and_swap(acc, oldval, (VT) (oldval + x))) {
+                oldval = *(volatile VT *) &acc;
+            }
+        }
+    };
+    
+    template <typename KERNEL>
+    struct functional_gather<KERNEL, functional_min_combiner, true> {
+        typedef typename KERNEL::VertexDataType VT;
+        typedef typename KERNEL::EdgeDataType ET;
+        
+        static inline void combine(KERNEL &kernel, vid_t vertexid, VT &acc, ET x) {
+            VT oldval = acc;
+            while((VT) x < oldval && !atomic_compare_and_swap(acc, oldval, (VT) x)) {
+                oldval = *(volatile VT *) &acc;
+            }
+        }
+    };
+    
+    template <typename KERNEL>
+    struct functional_gather<KERNEL, functional_max_combiner, true> {
+        typedef typename KERNEL::VertexDataType VT;
+        typedef typename KERNEL::EdgeDataType ET;
+        
+        static inline void combine(KERNEL &kernel, vid_t vertexid, VT &acc, ET x) {
+            VT oldval = acc;
+            while(oldval < (VT) x && !atomic_compare_and_swap(acc, oldval, (VT) x)) {
+                oldval = *(volatile VT *) &acc;
+            }
+        }
+    };
 
 };
 
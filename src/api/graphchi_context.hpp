@@ -39,6 +39,8 @@
 
 #include "graphchi_types.hpp"
 #include "api/ischeduler.hpp"
+#include "api/iteration_aggregator.hpp"
+#include "api/message_store.hpp"
 
 namespace graphchi {
     
@@ -63,6 +65,9 @@ namespace graphchi {
 		vid_t exec_interval;
 		//////////////
         
+        std::vector<iaggregator *> aggregators;
+        std::vector<imessage_store *> message_stores;
+        
         graphchi_context() : scheduler(NULL), iteration(0), last_iteration(-1) {
             gettimeofday(&start, NULL);
             last_deltasum = 0.0;
@@ -109,6 +114,40 @@ namespace graphchi {
             assert(delta >= 0);
             assert(!isnan(delta)); /* Sanity check */
         }
+        
+        /**
+          * Registers an aggregator, see api/iteration_aggregator.hpp. The
+          * context does not take ownership. An aggregator registered
+          * during an iteration is first reduced at the end of the current
+          * interval.
+          */
+        void add_aggregator(iaggregator * aggregator) {
+            aggregators.push_back(aggregator);
+        }
+        
+        void start_aggregators() {
+            for(int i=0; i < (int)aggregators.size(); i++) aggregators[i]->iteration_start(iteration);
+        }
+        
+        void reduce_aggregators() {
+            for(int i=0; i < (int)aggregators.size(); i++) aggregators[i]->reduce(iteration);
+        }
+        
+        /**
+          * Registers a message store, see api/message_store.hpp. The
+          * context does not take ownership.
+          */
+        void add_message_store(imessage_store * store) {
+            message_stores.push_back(store);
+        }
+        
+        void start_messages(const std::vector<std::pair<vid_t, vid_t> > &intervals) {
+            for(int i=0; i < (int)message_stores.size(); i++) message_stores[i]->iteration_start(iteration, scheduler, intervals);
+        }
+        
+        void deliver_messages(vid_t st, vid_t en) {
+            for(int i=0; i < (int)message_stores.size(); i++) message_stores[i]->deliver(st, en);
+        }
     };
     
 }
@@ -24,12 +24,23 @@
  * @section DESCRIPTION
  *
  * Wrapper classes for GraphLab v2.1 API.
+ *
+ * Gather caching (option use_cache=1): the result of the gather of each
+ * vertex is kept in memory next to the vertex data. A vertex with a valid
+ * cache skips gather, and vertex programs keep the caches of their
+ * neighbors up to date with icontext::post_delta() from scatter, or drop
+ * them with icontext::clear_gather_cache(). Deltas to a vertex can be
+ * posted from several threads at once and are added under a lock. A
+ * vertex is never updated at the same time as its neighbors, so a cache
+ * is not written while it is read; this needs the deterministic
+ * parallelism of the engine (the default).
  */
 
 #ifndef DEF_GRAPHLAB_WRAPPERS
 #define DEF_GRAPHLAB_WRAPPERS
 
 #include "graphchi_basic_includes.hpp"
+#include "util/pthread_tools.hpp"
 
 using namespace graphchi;
  
@@ -68,6 +79,58 @@ namespace graphlab {
     
     typedef vid_t vertex_id_type;
     
+    /**
+     * Cached gather results, see the description above.
+     */
+    template <typename GatherType>
+    class gather_cache {
+        static const int NLOCKS = 1024;
+        
+        std::vector<GatherType> values;
+        std::vector<char> valid;
+        spinlock locks[NLOCKS];
+        
+        inline spinlock & lock_for(vid_t v) {
+            return locks[v % NLOCKS];
+        }
+        
+    public:
+        /* Drops all entries */
+        void reset(size_t nvertices) {
+            values.assign(nvertices, GatherType());
+            valid.assign(nvertices, 0);
+        }
+        
+        /* Returns false if v has no valid cache */
+        bool get(vid_t v, GatherType &out) {
+            lock_for(v).lock();
+            bool found = valid[v] != 0;
+            if (found) out = values[v];
+            lock_for(v).unlock();
+            return found;
+        }
+        
+        void set(vid_t v, const GatherType &value) {
+            lock_for(v).lock();
+            values[v] = value;
+            valid[v] = 1;
+            lock_for(v).unlock();
+        }
+        
+        /* Adds delta to the cache of v, if it has one */
+        void post_delta(vid_t v, const GatherType &delta) {
+            lock_for(v).lock();
+            if (valid[v]) values[v] += delta;
+            lock_for(v).unlock();
+        }
+        
+        void invalidate(vid_t v) {
+            lock_for(v).lock();
+            valid[v] = 0;
+            lock_for(v).unlock();
+        }
+    };
+    
     template<typename GraphType,
     typename GatherType, 
     typename MessageType>
@@ -107,11 +170,12 @@ namespace graphlab {
         /* GraphChi */
         graphchi_context * gcontext;
         
-        
+        /* NULL if gather caching is disabled */
+        gather_cache<gather_type> * cache;
         
     public:        
         
-        icontext(graphchi_context * gcontext) : gcontext(gcontext) {}
+        icontext(graphchi_context * gcontext, gather_cache<gather_type> * cache = NULL) : gcontext(gcontext), cache(cache) {}
         
         /** \brief icontext destructor */
         virtual ~icontext() { }
@@ -274,7 +338,8 @@ namespace graphlab {
          * Therefore it is the responsibility of the vertex program to
          * update the cache values for neighboring vertices. This is
          * accomplished by using the icontext::post_delta function.
-         * Posted deltas are atomically added to the cache.
+         * Posted deltas are atomically added to the cache. If the vertex
+         * has no cache, or caching is disabled, the delta is dropped.
          *
          * \param vertex [in] the vertex whose cache we want to update
          * \param delta [in] the change that we want to *add* to the
@@ -283,7 +348,7 @@ namespace graphlab {
          */
         virtual void post_delta(const vertex_type& vertex, 
                                 const gather_type& delta) { 
-            assert(false); // Not implemented
+            if (cache != NULL) cache->post_delta(vertex.id(), delta);
         } 
         
         /**
@@ -295,7 +360,7 @@ namespace graphlab {
          * \param vertex [in] the vertex whose cache to clear.
          */
         virtual void clear_gather_cache(const vertex_type& vertex) {
-            assert(false); // Not implemented
+            if (cache != NULL) cache->invalidate(vertex.id());
         } 
         
     }; // end of icontext
@@ -484,7 +549,7 @@ namespace graphlab {
          * \return The vertex object representing the source vertex.
          */
         vertex_type source() const { 
-            if (is_inedge) {
+            if (!is_inedge) {
                 return GraphLabVertexWrapper<GLVertexDataType, EdgeDataType>(vertex->id(), vertex, vertexArray); 
             } else {
                 return GraphLabVertexWrapper<GLVertexDataType, EdgeDataType>(edge->vertex_id(), NULL, vertexArray); 
@@ -504,7 +569,7 @@ namespace graphlab {
          * \return The vertex object representing the target vertex.
          */
         vertex_type target() const { 
-            if (!is_inedge) {
+            if (is_inedge) {
                 return GraphLabVertexWrapper<GLVertexDataType, EdgeDataType>(vertex->id(), vertex, vertexArray); 
             } else {
                 return GraphLabVertexWrapper<GLVertexDataType, EdgeDataType>(edge->vertex_id(), NULL, vertexArray); 
@@ -534,9 +599,16 @@ namespace graphlab {
         typedef typename GraphLabVertexProgram::message_type message_type;
         
         std::vector<GLVertexDataType> * vertexInmemoryArray;
+        
+        bool use_cache;
+        gather_cache<gather_type> cache;
+        counter_aggregator cache_hits, updates;
+        graphchi_context * aggregators_added;  // context the aggregators were added to
      
         GraphLabWrapper() {
             vertexInmemoryArray = new std::vector<GLVertexDataType>();
+            use_cache = get_option_int("use_cache", 0) != 0;
+            aggregators_added = NULL;
         }
         
         /**
@@ -546,6 +618,15 @@ namespace graphlab {
             if (gcontext.iteration == 0) {
                 logstream(LOG_INFO) << "Initialize vertices in memory." << std::endl;
                 vertexInmemoryArray->resize(gcontext.nvertices);
+                if (use_cache) {
+                    cache.reset(gcontext.nvertices);
+                    /* Once per engine: the wrapper may be run again */
+                    if (aggregators_added != &gcontext) {
+                        gcontext.add_aggregator(&cache_hits);
+                        gcontext.add_aggregator(&updates);
+                        aggregators_added = &gcontext;
+                    }
+                }
             }
         }
         
@@ -553,6 +634,10 @@ namespace graphlab {
          * Called after an iteration has finished.
          */
         virtual void after_iteration(int iteration, graphchi_context &gcontext) {
+            if (use_cache) {
+                logstream(LOG_INFO) << "Gather cache: " << cache_hits.value() << " / " << updates.value()
+                    << " updates skipped gather." << std::endl;
+            }
         }
         
         /**
@@ -571,7 +656,7 @@ namespace graphlab {
          * Update function.
          */
         void update(graphchi_vertex<bool, EdgeDataType> &vertex, graphchi_context &gcontext) {
-            graphlab::icontext<graph_type, gather_type, message_type> glcontext(&gcontext);
+            graphlab::icontext<graph_type, gather_type, message_type> glcontext(&gcontext, use_cache ? &cache : NULL);
             
             /* Create the vertex program */
             GraphLabVertexWrapper<GLVertexDataType, EdgeDataType> wrapperVertex(vertex.id(), &vertex, vertexInmemoryArray);
@@ -581,11 +666,18 @@ namespace graphlab {
             glVertexProgram.init(glcontext, wrapperVertex, typename GraphLabVertexProgram::message_type());
             const GraphLabVertexProgram& const_vprog = glVertexProgram;
             
-            /* Gather */
+            /* Gather, unless the cache is valid */
             edge_dir_type gather_direction = const_vprog.gather_edges(glcontext, wrapperVertex);
-            gather_type sum;
+            gather_type sum = gather_type();
             
             int gathered = 0;
+            if (use_cache) {
+                updates.add();
+                if (cache.get(vertex.id(), sum)) {
+                    cache_hits.add();
+                    gather_direction = NO_EDGES;
+                }
+            }
             switch (gather_direction) {
                 case ALL_EDGES:
                 case IN_EDGES:
@@ -612,6 +704,10 @@ namespace graphlab {
             }
             
             
+            if (use_cache && gather_direction != NO_EDGES) {
+                cache.set(vertex.id(), sum);
+            }
+            
             /* Apply */
             glVertexProgram.apply(glcontext, wrapperVertex, sum);
             
@@ -39,6 +39,16 @@ namespace graphchi {
     public:
         virtual ~ischeduler() {} 
         virtual void add_task(vid_t vid, bool also_this_iteration=false) = 0;
+        
+        /**
+         * Adds a task with a priority (lower runs first). Schedulers
+         * without priorities schedule it for the next iteration.
+         * This is not an add_task() overload, so that add_task(v, 1)
+         * is never mistaken for a priority.
+         */
+        virtual void add_task_priority(vid_t vid, double priority) {
+            add_task(vid, false);
+        }
         virtual void add_task_to_all()  = 0;
         virtual bool is_scheduled(vid_t vertex) = 0;
         virtual size_t num_tasks() = 0;
@@ -0,0 +1,322 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Aggregators that are updated from update functions and reduced by the
+ * engine, so statistics such as the number of active vertices or the size
+ * of each label need no separate pass over the vertex data file and no
+ * global lock. Register them with engine.add_aggregator() or
+ * graphchi_context::add_aggregator().
+ *
+ * Updates go to per-thread slots (util/thread_slots.hpp) without locks.
+ * The engine calls iteration_start() before before_iteration(), and
+ * reduce() before every after_exec_interval() and before
+ * after_iteration(). The program can read the running totals of the
+ * iteration in after_exec_interval() and the totals of the iteration in
+ * after_iteration() and after run().
+ * reduce() only reads the slots, so it can be called any number of times.
+ *
+ *   sum_aggregator<T>, min_aggregator<T>, max_aggregator<T>: one value;
+ *   histogram_aggregator<K>: a count per key;
+ *   array_aggregator<T>, matrix_aggregator<T>: sums over a fixed
+ *     number of cells, e.g. one per interval or per pair of intervals.
+ */
+
+#ifndef DEF_GRAPHCHI_ITERATION_AGGREGATOR
+#define DEF_GRAPHCHI_ITERATION_AGGREGATOR
+
+#include <assert.h>
+#include <stdlib.h>
+#include <new>
+#include <memory>
+#include <vector>
+#include <map>
+#include <limits>
+#include <algorithm>
+
+#include "util/thread_slots.hpp"
+
+namespace graphchi {
+
+    class iaggregator {
+    public:
+        virtual ~iaggregator() {}
+        virtual void iteration_start(int iteration) = 0;
+        virtual void reduce(int iteration) = 0;
+    };
+
+    /* One cache line per slot to avoid false sharing; allocate with
+       cacheline_alloc() so that the slots start on a line */
+    template <typename T>
+    struct padded_slot {
+        T value;
+        char pad[64 - sizeof(T) % 64];
+    };
+
+    /* Allocates bytes rounded up to whole 64-byte cache lines, aligned to a line */
+    static inline void * cacheline_alloc(size_t bytes) {
+        void * p = NULL;
+        int err = posix_memalign(&p, 64, (bytes + 63) / 64 * 64);
+        assert(err == 0);
+        return p;
+    }
+
+    template <typename T>
+    struct sum_reducer {
+        static T identity() { return T(0); }
+        static inline T combine(const T &a, const T &b) { return a + b; }
+    };
+
+    template <typename T>
+    struct min_reducer {
+        static T identity() { return std::numeric_limits<T>::max(); }
+        static inline T combine(const T &a, const T &b) { return b < a ? b : a; }
+    };
+
+    template <typename T>
+    struct max_reducer {
+        static T identity() {
+            return std::numeric_limits<T>::is_integer ? std::numeric_limits<T>::min() : -std::numeric_limits<T>::max();
+        }
+        static inline T combine(const T &a, const T &b) { return a < b ? b : a; }
+    };
+
+    /**
+     * Reduction of the values added during an iteration with
+     * Reducer::combine(), starting from Reducer::identity().
+     */
+    template <typename T, typename Reducer>
+    class reduce_aggregator : public iaggregator {
+        padded_slot<T> * local;
+        T total;
+
+        reduce_aggregator(const reduce_aggregator &);
+        reduce_aggregator & operator= (const reduce_aggregator &);
+
+    public:
+        reduce_aggregator() : total(Reducer::identity()) {
+            local = (padded_slot<T> *) cacheline_alloc(MAX_THREAD_SLOTS * sizeof(padded_slot<T>));
+            for(int i=0; i < MAX_THREAD_SLOTS; i++) new (&local[i].value) T(Reducer::identity());
+        }
+
+        virtual ~reduce_aggregator() {
+            for(int i=0; i < MAX_THREAD_SLOTS; i++) local[i].value.~T();
+            free(local);
+        }
+
+        inline void add(const T &x) {
+            T &v = local[thread_slots::current()].value;
+            v = Reducer::combine(v, x);
+        }
+
+        void iteration_start(int iteration) {
+            for(int i=0; i < thread_slots::count(); i++) local[i].value = Reducer::identity();
+        }
+
+        void reduce(int iteration) {
+            total = Reducer::identity();
+            for(int i=0; i < thread_slots::count(); i++) total = Reducer::combine(total, local[i].value);
+        }
+
+        /* Total of the last reduce, the identity if nothing was added */
+        T value() const {
+            return total;
+        }
+    };
+
+    template <typename T>
+    class sum_aggregator : public reduce_aggregator<T, sum_reducer<T> > {};
+
+    template <typename T>
+    class min_aggregator : public reduce_aggregator<T, min_reducer<T> > {};
+
+    template <typename T>
+    class max_aggregator : public reduce_aggregator<T, max_reducer<T> > {};
+
+    /**
+     * Sum of values added during an iteration.
+     */
+    class counter_aggregator : public sum_aggregator<long> {
+    public:
+        inline void add(long x=1) {
+            sum_aggregator<long>::add(x);
+        }
+    };
+
+    /**
+     * Number of times each key was added during an iteration.
+     */
+    template <typename KeyType>
+    class histogram_aggregator : public iaggregator {
+        typedef std::map<KeyType, long> histogram_t;
+        std::vector<histogram_t *> local;
+        histogram_t totals;
+
+        static bool count_greater(const std::pair<KeyType, long> &a, const std::pair<KeyType, long> &b) {
+            if (a.second != b.second) return a.second > b.second;
+            return a.first < b.first;
+        }
+
+    public:
+        histogram_aggregator() : local(MAX_THREAD_SLOTS, (histogram_t *) NULL) {}
+
+        virtual ~histogram_aggregator() {
+            for(size_t i=0; i < local.size(); i++) {
+                if (local[i] != NULL) delete local[i];
+            }
+        }
+
+        inline void add(KeyType key, long n=1) {
+            int slot = thread_slots::current();
+            if (local[slot] == NULL) local[slot] = new histogram_t();
+            (*local[slot])[key] += n;
+        }
+
+        void iteration_start(int iteration) {
+            for(int i=0; i < thread_slots::count(); i++) {
+                if (local[i] != NULL) local[i]->clear();
+            }
+        }
+
+        void reduce(int iteration) {
+            totals.clear();
+            for(int i=0; i < thread_slots::count(); i++) {
+                if (local[i] == NULL) continue;
+                for(typename histogram_t::iterator it=local[i]->begin(); it != local[i]->end(); ++it) {
+                    totals[it->first] += it->second;
+                }
+            }
+        }
+
+        /* Counts of the last reduced iteration, by key */
+        const histogram_t & counts() const {
+            return totals;
+        }
+
+        /* Counts of the last reduced iteration, largest first */
+        std::vector<std::pair<KeyType, long> > sorted_by_count() const {
+            std::vector<std::pair<KeyType, long> > ret(totals.begin(), totals.end());
+            std::sort(ret.begin(), ret.end(), count_greater);
+            return ret;
+        }
+    };
+
+    /**
+     * Sums of a fixed number of cells. The cells of a thread are
+     * allocated on its first add(), on cache lines of their own.
+     */
+    template <typename T>
+    class array_aggregator : public iaggregator {
+        size_t ncells;
+        std::vector<T *> local;
+        std::vector<T> totals;
+
+        array_aggregator(const array_aggregator &);
+        array_aggregator & operator= (const array_aggregator &);
+
+    public:
+        array_aggregator(size_t ncells) : ncells(ncells), local(MAX_THREAD_SLOTS, (T *) NULL), totals(ncells, T(0)) {}
+
+        virtual ~array_aggregator() {
+            for(size_t i=0; i < local.size(); i++) {
+                if (local[i] == NULL) continue;
+                for(size_t c=0; c < ncells; c++) local[i][c].~T();
+                free(local[i]);
+            }
+        }
+
+        inline void add(size_t cell, const T &x=T(1)) {
+            assert(cell < ncells);
+            int slot = thread_slots::current();
+            if (local[slot] == NULL) {
+                local[slot] = (T *) cacheline_alloc(ncells * sizeof(T));
+                std::uninitialized_fill(local[slot], local[slot] + ncells, T(0));
+            }
+            local[slot][cell] += x;
+        }
+
+        void iteration_start(int iteration) {
+            for(int i=0; i < thread_slots::count(); i++) {
+                if (local[i] != NULL) std::fill(local[i], local[i] + ncells, T(0));
+            }
+        }
+
+        void reduce(int iteration) {
+            std::fill(totals.begin(), totals.end(), T(0));
+            for(int i=0; i < thread_slots::count(); i++) {
+                if (local[i] == NULL) continue;
+                for(size_t c=0; c < ncells; c++) totals[c] += local[i][c];
+            }
+        }
+
+        size_t size() const {
+            return ncells;
+        }
+
+        /* Sum of a cell at the last reduce */
+        T value(size_t cell) const {
+            return totals[cell];
+        }
+
+        const std::vector<T> & values() const {
+            return totals;
+        }
+    };
+
+    /**
+     * Sums over a rows x cols matrix, stored by rows.
+     */
+    template <typename T>
+    class matrix_aggregator : public array_aggregator<T> {
+        size_t nrows, ncols;
+
+    public:
+        matrix_aggregator(size_t nrows, size_t ncols) : array_aggregator<T>(nrows * ncols), nrows(nrows), ncols(ncols) {}
+
+        inline void add(size_t row, size_t col, const T &x=T(1)) {
+            assert(col < ncols);
+            array_aggregator<T>::add(row * ncols + col, x);
+        }
+
+        T value(size_t row, size_t col) const {
+            return array_aggregator<T>::value(row * ncols + col);
+        }
+
+        size_t rows() const {
+            return nrows;
+        }
+
+        size_t cols() const {
+            return ncols;
+        }
+    };
+
+    /* Built-in aggregators: call add() for every active vertex, or
+       add(label) for every labeled vertex, in the update function. */
+    typedef counter_aggregator active_count_aggregator;
+    typedef histogram_aggregator<int> label_count_aggregator;
+
+}
+
+#endif
@@ -0,0 +1,333 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Pregel-style messages between update functions. An update sends
+ * messages with send(dst, msg); they are delivered when the engine next
+ * runs the interval of dst in the following iteration, where the update
+ * of dst reads them with receive(). Messages to the same vertex are
+ * folded with Combiner::combine(a, b), e.g. sum_reducer, min_reducer or
+ * max_reducer of api/iteration_aggregator.hpp. So labels can be sent
+ * without storing them in the edge data, and the engine can run with
+ * only adjacency or without writing edges back.
+ *
+ * Sent messages are appended to a buffer of the sending thread, one per
+ * destination interval. When a thread has buffered more than its share
+ * of message_budget_mb (default 256), each of its buffers is sorted by
+ * destination, combined and written to disk as a run. Before an
+ * interval is run, its buffers and runs of the previous iteration are
+ * folded into one message per vertex. Sending schedules dst for the
+ * next iteration if the engine uses a scheduler.
+ *
+ * The engine passes its intervals at the start of every iteration, and
+ * messages are bucketed by the intervals of the iteration they were sent
+ * in. So the intervals can change between iterations (the dynamic engine
+ * splits shards and grows the last interval): delivery then filters the
+ * overlapping buckets by destination.
+ *
+ * Runs are written and read back as raw bytes, so MessageType must be a
+ * POD type (no std::string, std::vector or other owned memory), like
+ * edge and vertex data.
+ *
+ *   message_store<vid_t, min_reducer<vid_t> > labels(engine.get_intervals(), filename);
+ *   engine.add_message_store(&labels);
+ *   ...
+ *   vid_t l;
+ *   if (labels.receive(v.id(), l)) ...
+ *   labels.send(v.outedge(i)->vertex_id(), mylabel);
+ */
+
+#ifndef DEF_GRAPHCHI_MESSAGE_STORE
+#define DEF_GRAPHCHI_MESSAGE_STORE
+
+#include <assert.h>
+#include <fcntl.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "graphchi_types.hpp"
+#include "api/ischeduler.hpp"
+#include "logger/logger.hpp"
+#include "util/ioutil.hpp"
+#include "util/pthread_tools.hpp"
+#include "util/thread_slots.hpp"
+#include "util/cmdopts.hpp"
+
+namespace graphchi {
+
+    /**
+     * Interface used by the engine (through graphchi_context) to move
+     * messages between iterations and intervals.
+     */
+    class imessage_store {
+    public:
+        virtual ~imessage_store() {}
+        virtual void iteration_start(int iteration, ischeduler * scheduler,
+                                     const std::vector<std::pair<vid_t, vid_t> > &intervals) = 0;
+        virtual void deliver(vid_t interval_st, vid_t interval_en) = 0;
+    };
+
+    template <typename MessageType, typename Combiner>
+    class message_store : public imessage_store {
+
+        struct message {
+            vid_t dst;
+            MessageType value;
+            message(vid_t dst, const MessageType &value) : dst(dst), value(value) {}
+            bool operator< (const message &o) const {
+                return dst < o.dst;
+            }
+        };
+
+        /* Buffers of one thread, by destination interval */
+        struct outbox {
+            std::vector<std::vector<message> > intervals;
+            size_t nbuffered;
+        };
+
+        std::string prefix;
+        size_t max_buffered;
+
+        /* Two generations: sent in this iteration, and sent in the previous */
+        std::vector<std::pair<vid_t, vid_t> > intervals[2];   // at the start of the iteration
+        std::vector<outbox *> outboxes[2];
+        std::vector<std::vector<std::string> > runs[2];   // by interval
+        mutex runlock;
+        int nextrun;
+        int sendgen;
+        ischeduler * scheduler;
+
+        /* Messages of the delivered interval */
+        vid_t inbox_st;
+        vid_t inbox_en;
+        std::vector<MessageType> inbox;
+        std::vector<char> inbox_valid;
+
+        /* Bucket of v in a generation; the last bucket is open-ended */
+        int interval_of(int gen, vid_t v) const {
+            const std::vector<std::pair<vid_t, vid_t> > &iv = intervals[gen];
+            int lo = 0, hi = (int) iv.size() - 1;
+            while(lo < hi) {
+                int mid = (lo + hi) / 2;
+                if (iv[mid].second < v) lo = mid + 1;
+                else hi = mid;
+            }
+            return lo;
+        }
+
+        outbox * my_outbox() {
+            int slot = thread_slots::current();
+            outbox * box = outboxes[sendgen][slot];
+            if (box == NULL) {
+                box = new outbox();
+                box->intervals.resize(intervals[sendgen].size());
+                box->nbuffered = 0;
+                outboxes[sendgen][slot] = box;
+            }
+            return box;
+        }
+
+        /* Sorts, combines and writes the buffers of a thread to disk */
+        void spill(outbox * box) {
+            for(int p=0; p < (int) box->intervals.size(); p++) {
+                std::vector<message> &buf = box->intervals[p];
+                if (buf.empty()) continue;
+                std::sort(buf.begin(), buf.end());
+                size_t n = 0;
+                for(size_t i=1; i < buf.size(); i++) {
+                    if (buf[i].dst == buf[n].dst) {
+                        buf[n].value = Combiner::combine(buf[n].value, buf[i].value);
+                    } else {
+                        buf[++n] = buf[i];
+                    }
+                }
+                n++;
+                std::stringstream ss;
+                ss << prefix << ".msgs." << __sync_fetch_and_add(&nextrun, 1);
+                std::string fname = ss.str();
+                int f = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
+                if (f < 0) {
+                    logstream(LOG_FATAL) << "Could not write message run " << fname << std::endl;
+                }
+                assert(f >= 0);
+                writea(f, &buf[0], n * sizeof(message));
+                close(f);
+                runlock.lock();
+                runs[sendgen][p].push_back(fname);
+                runlock.unlock();
+                std::vector<message>().swap(buf);
+            }
+            box->nbuffered = 0;
+        }
+
+        void clear_generation(int gen) {
+            for(int i=0; i < thread_slots::count(); i++) {
+                if (outboxes[gen][i] != NULL) delete outboxes[gen][i];
+                outboxes[gen][i] = NULL;
+            }
+            for(size_t p=0; p < runs[gen].size(); p++) {
+                for(size_t j=0; j < runs[gen][p].size(); j++) unlink(runs[gen][p][j].c_str());
+                runs[gen][p].clear();
+            }
+        }
+
+        inline void fold(const message &m) {
+            assert(m.dst >= inbox_st && m.dst <= inbox_en);
+            size_t i = m.dst - inbox_st;
+            if (inbox_valid[i]) {
+                inbox[i] = Combiner::combine(inbox[i], m.value);
+            } else {
+                inbox[i] = m.value;
+                inbox_valid[i] = 1;
+            }
+        }
+
+        /* Folds the messages of buf that are sent to the inbox; all if whole */
+        inline void fold_all(const message * buf, size_t n, bool whole) {
+            for(size_t k=0; k < n; k++) {
+                if (whole || (buf[k].dst >= inbox_st && buf[k].dst <= inbox_en)) fold(buf[k]);
+            }
+        }
+
+    public:
+        /**
+         * @param intervals the engine's intervals (engine.get_intervals()),
+         *        replaced by the engine's current ones on every iteration
+         * @param prefix prefix of the files of spilled runs, e.g. the graph filename
+         */
+        message_store(const std::vector<std::pair<vid_t, vid_t> > &_intervals, std::string prefix) :
+                prefix(prefix), nextrun(0), sendgen(0), scheduler(NULL), inbox_st(0), inbox_en(0) {
+            assert(!_intervals.empty());
+            int nthreads = std::max(1, omp_get_max_threads());
+            max_buffered = (size_t) get_option_int("message_budget_mb", 256) * 1024 * 1024 / sizeof(message) / nthreads;
+            for(int g=0; g < 2; g++) {
+                intervals[g] = _intervals;
+                outboxes[g].resize(MAX_THREAD_SLOTS, NULL);
+                runs[g].resize(_intervals.size());
+            }
+        }
+
+        ~message_store() {
+            clear_generation(0);
+            clear_generation(1);
+        }
+
+        /**
+         * Sends msg to vertex dst, to be received in the next iteration.
+         * Thread-safe.
+         */
+        inline void send(vid_t dst, const MessageType &msg) {
+            outbox * box = my_outbox();
+            box->intervals[interval_of(sendgen, dst)].push_back(message(dst, msg));
+            if (++box->nbuffered > max_buffered) spill(box);
+            if (scheduler != NULL) scheduler->add_task(dst);
+        }
+
+        /**
+         * Combined message sent to v in the previous iteration. Returns
+         * false if none. v must be in the interval being run.
+         */
+        inline bool receive(vid_t v, MessageType &msg) const {
+            assert(v >= inbox_st && v <= inbox_en);
+            if (!inbox_valid[v - inbox_st]) return false;
+            msg = inbox[v - inbox_st];
+            return true;
+        }
+
+        inline bool has_message(vid_t v) const {
+            assert(v >= inbox_st && v <= inbox_en);
+            return inbox_valid[v - inbox_st] != 0;
+        }
+
+        /**
+         * Messages sent in the previous iteration become receivable.
+         * Iteration 0 starts a run: the messages left from an earlier run
+         * are dropped and their spilled runs deleted.
+         */
+        void iteration_start(int iteration, ischeduler * _scheduler,
+                             const std::vector<std::pair<vid_t, vid_t> > &_intervals) {
+            assert(!_intervals.empty());
+            scheduler = _scheduler;
+            sendgen = iteration % 2;
+            if (iteration == 0) {
+                clear_generation(1);
+                runs[1].resize(_intervals.size());
+                intervals[1] = _intervals;
+                nextrun = 0;
+            }
+            clear_generation(sendgen);
+            intervals[sendgen] = _intervals;
+            runs[sendgen].resize(_intervals.size());
+            inbox_st = inbox_en = 0;
+            inbox.clear();
+            inbox_valid.clear();
+        }
+
+        /**
+         * Folds the messages to vertices interval_st..interval_en. If the
+         * intervals are the same as when the messages were sent, this
+         * reads one bucket.
+         */
+        void deliver(vid_t interval_st, vid_t interval_en) {
+            assert(interval_st <= interval_en);
+            int recvgen = 1 - sendgen;
+            const std::vector<std::pair<vid_t, vid_t> > &iv = intervals[recvgen];
+            inbox_st = interval_st;
+            inbox_en = interval_en;
+            size_t len = interval_en - interval_st + 1;
+            inbox.resize(len);
+            inbox_valid.assign(len, 0);
+
+            int last = (int) iv.size() - 1;
+            for(int p=interval_of(recvgen, interval_st); p <= last && iv[p].first <= interval_en; p++) {
+                bool whole = iv[p].first >= interval_st && p < last && iv[p].second <= interval_en;
+                for(int i=0; i < thread_slots::count(); i++) {
+                    outbox * box = outboxes[recvgen][i];
+                    if (box == NULL) continue;
+                    std::vector<message> &buf = box->intervals[p];
+                    if (!buf.empty()) fold_all(&buf[0], buf.size(), whole);
+                }
+                for(size_t j=0; j < runs[recvgen][p].size(); j++) {
+                    int f = open(runs[recvgen][p][j].c_str(), O_RDONLY);
+                    assert(f >= 0);
+                    size_t n = lseek(f, 0, SEEK_END) / sizeof(message);
+                    message * buf = (message *) malloc(n * sizeof(message));
+                    preada(f, buf, n * sizeof(message), 0);
+                    close(f);
+                    fold_all(buf, n, whole);
+                    free(buf);
+                }
+            }
+        }
+    };
+
+}
+
+#endif
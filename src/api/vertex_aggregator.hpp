@@ -27,6 +27,13 @@
  *
  * Simple vertex-aggregators/scanners which allows reductions over all vertices
  * in an I/O efficient manner.
+ *
+ * The vertex data file is read in chunks, and the next chunk is read on
+ * a separate thread while the current one is processed.
+ * foreach_vertices() calls its callback on one thread;
+ * parallel_foreach_vertices() splits every chunk between OpenMP threads,
+ * each with its own accumulator, and combines the accumulators after
+ * each chunk.
  */
 
 
@@ -35,7 +42,11 @@
 
 #include <errno.h>
 #include <memory.h>
+#include <pthread.h>
+#include <omp.h>
 #include <string>
+#include <vector>
+#include <algorithm>
 
 #include "graphchi_types.hpp"
 #include "api/chifilenames.hpp"
@@ -56,6 +67,117 @@ namespace graphchi {
     };
     
     
+    /**
+      * Abstract class for parallel scans with parallel_foreach_vertices()
+      * (see below). Every thread gets its own accumulator from init();
+      * callback() is called concurrently, but each accumulator is used by
+      * one thread at a time. combine() is called under a lock, in no
+      * particular thread order.
+      */
+    template <typename VertexDataType, typename ResultType>
+    class VReducer {
+    public:
+        virtual ~VReducer() {}
+        virtual ResultType init() = 0;
+        virtual void callback(vid_t vertex_id, VertexDataType &value, ResultType &accum) = 0;
+        virtual void combine(ResultType &accum, const ResultType &other) = 0;
+    };
+    
+    /**
+      * Reads the vertex values of a range in chunks of readwindow vertices.
+      * The chunk after the current one is loaded on a separate thread while
+      * the current one is processed. The values are not saved.
+      */
+    template <typename VertexDataType>
+    class vertex_chunk_reader {
+        typedef vertex_data_store<VertexDataType> store_t;
+        
+        struct prefetch_job {
+            store_t * store;
+            vid_t st, en;
+        };
+        
+        metrics m;
+        stripedio * iomgr;
+        store_t * stores[2];
+        prefetch_job job;
+        pthread_t prefetch_thread;
+        bool prefetching;
+        
+        vid_t tov, readwindow;
+        vid_t next_st;
+        vid_t chunk_st, chunk_en;
+        int cur;
+        
+        static void * load_chunk(void * arg) {
+            prefetch_job * job = (prefetch_job *) arg;
+            job->store->load(job->st, job->en);
+            return NULL;
+        }
+        
+        /* Starts loading the chunk at next_st into the other store */
+        void prefetch() {
+            prefetching = next_st < tov;
+            if (!prefetching) return;
+            job.store = stores[1 - cur];
+            job.st = next_st;
+            job.en = std::min(tov - 1, next_st + readwindow - 1);
+            int err = pthread_create(&prefetch_thread, NULL, load_chunk, &job);
+            assert(err == 0);
+        }
+        
+    public:
+        /**
+          * @param basefilename base filename
+          * @param fromv first vertex
+          * @param tov last vertex (exclusive)
+          */
+        vertex_chunk_reader(std::string basefilename, vid_t fromv, vid_t tov, vid_t readwindow = 1024 * 1024) :
+                m("foreach"), tov(tov), readwindow(readwindow), next_st(fromv), cur(0) {
+            iomgr = new stripedio(m);
+            size_t numvertices = get_num_vertices(basefilename);
+            assert(tov <= numvertices);
+            stores[0] = new store_t(basefilename, numvertices, iomgr);
+            stores[1] = new store_t(basefilename, numvertices, iomgr);
+            prefetch();
+        }
+        
+        ~vertex_chunk_reader() {
+            if (prefetching) pthread_join(prefetch_thread, NULL);
+            delete stores[0];
+            delete stores[1];
+            delete iomgr;
+        }
+        
+        /**
+          * Moves to the next chunk. Returns false at the end of the range.
+          */
+        bool next() {
+            if (!prefetching) return false;
+            pthread_join(prefetch_thread, NULL);
+            cur = 1 - cur;
+            chunk_st = job.st;
+            chunk_en = job.en;
+            next_st = chunk_en + 1;
+            prefetch();
+            return true;
+        }
+        
+        /* First vertex of the current chunk */
+        vid_t first() const {
+            return chunk_st;
+        }
+        
+        /* Last vertex of the current chunk, inclusive */
+        vid_t last() const {
+            return chunk_en;
+        }
+        
+        inline VertexDataType * vertex_data_ptr(vid_t v) {
+            return stores[cur]->vertex_data_ptr(v);
+        }
+    };
+    
     /**
       * Foreach: a callback object is invoked for every vertex in the given range.
       * See VCallback above.
@@ -66,38 +188,53 @@ namespace graphchi {
       */
     template <typename VertexDataType>
     void foreach_vertices(std::string basefilename, vid_t fromv, vid_t tov, VCallback<VertexDataType> &callback) {
-        std::string filename = filename_vertex_data<VertexDataType>(basefilename);
-        metrics m("foreach");
-        stripedio * iomgr = new stripedio(m);
-        
-        vid_t readwindow = 1024 * 1024;
-        size_t numvertices = get_num_vertices(basefilename);
-        vertex_data_store<VertexDataType> * vertexdata =
-            new vertex_data_store<VertexDataType>(basefilename, numvertices, iomgr);
+        vertex_chunk_reader<VertexDataType> reader(basefilename, fromv, tov);
+        while(reader.next()) {
+            for(vid_t v=reader.first(); v <= reader.last(); v++) {
+                callback.callback(v, *reader.vertex_data_ptr(v));
+            }
+        }
+    }
+    
+    /**
+      * Parallel foreach: like foreach_vertices(), but the vertices of a chunk
+      * are split between nthreads threads. See VReducer above.
+      * @param basefilename base filename
+      * @param fromv first vertex
+      * @param tov last vertex (exclusive)
+      * @param reducer user-defined reducer-object.
+      * @param nthreads number of threads, default the OpenMP maximum
+      * @return the combined accumulators
+      */
+    template <typename VertexDataType, typename ResultType>
+    ResultType parallel_foreach_vertices(std::string basefilename, vid_t fromv, vid_t tov,
+                                         VReducer<VertexDataType, ResultType> &reducer, int nthreads = 0) {
+        if (nthreads <= 0) nthreads = omp_get_max_threads();
+        ResultType result = reducer.init();
         
-        vid_t st = fromv;
-        vid_t en = 0;
-        while(st <= tov) {
-            en = st + readwindow - 1;
-            if (en >= tov) en = tov - 1;
-            
-            if (st < en) {
-                vertexdata->load(st, en);
-                for(vid_t v=st; v<=en; v++) {
-                    VertexDataType * vptr = vertexdata->vertex_data_ptr(v);
-                    callback.callback(v, (VertexDataType&) *vptr);
+        vertex_chunk_reader<VertexDataType> reader(basefilename, fromv, tov);
+        while(reader.next()) {
+            long st = (long) reader.first();
+            long en = (long) reader.last();
+            /* Accumulators on the threads' own stacks, so they do not share cache lines */
+#pragma omp parallel num_threads(nthreads)
+            {
+                ResultType acc = reducer.init();
+#pragma omp for schedule(static)
+                for(long v=st; v <= en; v++) {
+                    reducer.callback((vid_t) v, *reader.vertex_data_ptr((vid_t) v), acc);
+                }
+#pragma omp critical
+                {
+                    reducer.combine(result, acc);
                 }
             }
-            
-            st += readwindow;
         }
-        delete vertexdata;
-        delete iomgr;
+        return result;
     }
     
     /**
       * Callback for computing a sum.
-      * TODO: a functional version instead of imperative.
       */
     template <typename VertexDataType, typename SumType>
     class SumCallback : public VCallback<VertexDataType> {
@@ -112,6 +249,25 @@ namespace graphchi {
         }
     };
     
+    /**
+      * Reducer for computing a sum in parallel.
+      */
+    template <typename VertexDataType, typename SumType>
+    class SumReducer : public VReducer<VertexDataType, SumType> {
+    public:
+        SumType init() {
+            return SumType(0);
+        }
+        
+        void callback(vid_t vertex_id, VertexDataType &value, SumType &accum) {
+            accum += value;
+        }
+        
+        void combine(SumType &accum, const SumType &other) {
+            accum += other;
+        }
+    };
+    
     /** 
       * Computes a sum over a range of vertices' values.
       * Type SumType defines the accumulator type, which may be different
@@ -123,9 +279,8 @@ namespace graphchi {
       */
     template <typename VertexDataType, typename SumType>
     SumType sum_vertices(std::string base_filename, vid_t fromv, vid_t tov) {
-        SumCallback<VertexDataType, SumType> sumc(0);
-        foreach_vertices<VertexDataType>(base_filename, fromv, tov, sumc);
-        return sumc.accum;
+        SumReducer<VertexDataType, SumType> sumr;
+        return parallel_foreach_vertices<VertexDataType, SumType>(base_filename, fromv, tov, sumr);
     }
     
 }
@@ -0,0 +1,170 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Delta-stepping scheduler. Tasks added with add_task_priority(vid,
+ * priority) are put to bucket floor(priority / bucket_width), and each
+ * iteration runs only the lowest non-empty bucket (together with tasks
+ * added without a priority). A vertex is kept only in the lowest bucket
+ * it was added to. Tasks a bucket adds into itself are run in the
+ * following iteration, so a bucket is repeated until it settles.
+ */
+
+#ifndef DEF_GRAPHCHI_BUCKETSCHEDULER
+#define DEF_GRAPHCHI_BUCKETSCHEDULER
+
+#include <map>
+#include <vector>
+#include <cmath>
+
+#include "graphchi_types.hpp"
+#include "engine/frontier_scheduler.hpp"
+#include "logger/logger.hpp"
+#include "util/pthread_tools.hpp"
+
+namespace graphchi {
+
+    class bucket_scheduler : public frontier_scheduler {
+    private:
+        typedef std::map<uint32_t, std::vector<vid_t> > bucketmap_t;
+        static const uint32_t NO_BUCKET = 0xffffffffu;
+        static const int BUCKET_SCHEDULER_STRIPES = 64;
+
+        double bucket_width;
+        std::vector<uint32_t> vertex_bucket;     // lowest bucket of a pending vertex, or NO_BUCKET
+
+        /* Buckets are striped by vertex id to reduce lock contention */
+        bucketmap_t buckets[BUCKET_SCHEDULER_STRIPES];
+        mutex locks[BUCKET_SCHEDULER_STRIPES];
+        uint32_t curbucket;
+
+        /* Write-locked by resize(), which the dynamic engine calls while updates add tasks */
+        rwlock resizelock;
+
+        inline uint32_t bucket_of(double priority) const {
+            if (!(priority > 0)) return 0;
+            double b = std::floor(priority / bucket_width);
+            return b >= (double) (NO_BUCKET - 1) ? NO_BUCKET - 1 : (uint32_t) b;
+        }
+
+        /* Lowest non-empty bucket, or NO_BUCKET */
+        uint32_t min_bucket() {
+            uint32_t minb = NO_BUCKET;
+            for(int s=0; s < BUCKET_SCHEDULER_STRIPES; s++) {
+                if (!buckets[s].empty()) minb = std::min(minb, (uint32_t) buckets[s].begin()->first);
+            }
+            return minb;
+        }
+
+    public:
+        bucket_scheduler(int nvertices, double bucket_width, double sparse_density=0.02) :
+                frontier_scheduler(nvertices, sparse_density), bucket_width(bucket_width),
+                vertex_bucket(nvertices, uint32_t(NO_BUCKET)), curbucket(0) {
+            assert(bucket_width > 0);
+            logstream(LOG_INFO) << "Using delta-stepping scheduler, bucket width: " << bucket_width << std::endl;
+        }
+
+        virtual ~bucket_scheduler() {}
+
+        /**
+         * Schedules vertex to the bucket of the priority (e.g. the tentative
+         * distance). Lower priorities run first.
+         */
+        inline void add_task_priority(vid_t vertex, double priority) {
+            uint32_t b = bucket_of(priority);
+            resizelock.readlock();
+            assert(vertex < vertex_bucket.size());
+            uint32_t prev = vertex_bucket[vertex];
+            while (b < prev) {
+                uint32_t old = __sync_val_compare_and_swap(&vertex_bucket[vertex], prev, b);
+                if (old == prev) {
+                    int s = vertex % BUCKET_SCHEDULER_STRIPES;
+                    locks[s].lock();
+                    buckets[s][b].push_back(vertex);
+                    locks[s].unlock();
+                    has_new_tasks = true;
+                    break;
+                }
+                prev = old;
+            }
+            resizelock.rdunlock();
+        }
+
+        void new_iteration(int iteration) {
+            if (iteration > 0) {
+                /* Move the lowest bucket with a live entry to the frontier.
+                   Entries of vertices that moved to a lower bucket are stale. */
+                size_t moved = 0;
+                uint32_t b;
+                while (moved == 0 && (b = min_bucket()) != NO_BUCKET) {
+                    for(int s=0; s < BUCKET_SCHEDULER_STRIPES; s++) {
+                        bucketmap_t::iterator it = buckets[s].find(b);
+                        if (it == buckets[s].end()) continue;
+                        std::vector<vid_t> &vids = it->second;
+                        for(size_t i=0; i < vids.size(); i++) {
+                            if (vertex_bucket[vids[i]] == b) {
+                                vertex_bucket[vids[i]] = NO_BUCKET;
+                                frontier_scheduler::add_task(vids[i], false);
+                                moved++;
+                            }
+                        }
+                        buckets[s].erase(it);
+                    }
+                    curbucket = b;
+                }
+                logstream(LOG_DEBUG) << "Bucket " << curbucket << ": " << moved << " vertices" << std::endl;
+            }
+            frontier_scheduler::new_iteration(iteration);
+            /* Later buckets keep the engine running */
+            if (min_bucket() != NO_BUCKET) has_new_tasks = true;
+        }
+
+        void remove_tasks(vid_t fromvertex, vid_t tovertex) {
+            frontier_scheduler::remove_tasks(fromvertex, tovertex);
+            for(vid_t v=fromvertex; v <= tovertex && v < vertex_bucket.size(); v++) {
+                vertex_bucket[v] = NO_BUCKET;
+            }
+        }
+
+        virtual void resize(vid_t maxsize) {
+            frontier_scheduler::resize(maxsize);
+            resizelock.writelock();
+            vertex_bucket.resize(maxsize, uint32_t(NO_BUCKET));
+            resizelock.wrunlock();
+        }
+
+        /* Bucket that is run in the current iteration */
+        uint32_t current_bucket() const {
+            return curbucket;
+        }
+
+        double get_bucket_width() const {
+            return bucket_width;
+        }
+    };
+
+}
+
+
+#endif
@@ -30,7 +30,11 @@
 #define DEF_GRAPHCHI_EDGEBUFFERS
 
 #include <stdlib.h>
+#include <string.h>
 #include <vector> 
+#include <algorithm>
+
+#include "util/pthread_tools.hpp"
 
 
 namespace graphchi {
@@ -61,6 +65,7 @@ namespace graphchi {
         
         unsigned int count;
         std::vector<created_edge<ET> *> bufs;
+        spinlock chunklock;
         
     public:    
         
@@ -100,6 +105,33 @@ namespace graphchi {
             bufs[bufidx][idx % EDGE_BUFFER_CHUNKSIZE] = cedge;
         }
         
+        /**
+         * Appends n edges. Can be called concurrently with other add_range()
+         * calls, but not with add() or reads: the slots are reserved with an
+         * atomic add, and only growing the chunk list takes a lock.
+         */
+        void add_range(const created_edge<ET> * edges, unsigned int n) {
+            if (n == 0) return;
+            unsigned int st = __sync_fetch_and_add(&count, n);
+            unsigned int en = st + n;
+            int firstchunk = st / EDGE_BUFFER_CHUNKSIZE;
+            int lastchunk = (en - 1) / EDGE_BUFFER_CHUNKSIZE;
+            
+            chunklock.lock();
+            while((int) bufs.size() <= lastchunk) {
+                bufs.push_back((created_edge<ET>*)calloc(sizeof(created_edge<ET>), EDGE_BUFFER_CHUNKSIZE));
+            }
+            std::vector<created_edge<ET> *> chunks(bufs.begin() + firstchunk, bufs.begin() + lastchunk + 1);
+            chunklock.unlock();
+            
+            for(unsigned int i=st; i < en; ) {
+                unsigned int off = i % EDGE_BUFFER_CHUNKSIZE;
+                unsigned int len = std::min(en - i, (unsigned int) EDGE_BUFFER_CHUNKSIZE - off);
+                memcpy(&chunks[i / EDGE_BUFFER_CHUNKSIZE - firstchunk][off], edges + (i - st), len * sizeof(created_edge<ET>));
+                i += len;
+            }
+        }
+        
     private:
         // Disable value copying
         edge_buffer_flat(const edge_buffer_flat&);
@@ -36,7 +36,9 @@
 
 #include "engine/graphchi_engine.hpp"
 #include "engine/dynamic_graphs/edgebuffers.hpp"
+#include "engine/dynamic_graphs/shard_compactor.hpp"
 #include "logger/logger.hpp"
+#include "util/thread_slots.hpp"
 
 
 namespace graphchi {
@@ -56,7 +58,22 @@ namespace graphchi {
             _m.set("engine", "dynamicgraphs");
             added_edges = 0;
             last_commit = 0;
-            maxshardsize = 200 * 1024 * 1024;
+            sealed_edges = 0;
+            maxshardsize = get_option_long("compaction.maxshardsize_mb", 200) * 1024 * 1024;
+            ingest_wait_ms = get_option_int("ingest_wait_ms", 1000);
+            stages.resize(MAX_THREAD_SLOTS);
+            
+            background_compaction = get_option_int("compaction.background", 1) != 0;
+            compaction_horizon = get_option_int("compaction.horizon", 10);
+            bufedge_cost = get_option_float("compaction.bufedge_cost", 8.0f);
+            compaction_buffer_fraction = get_option_float("compaction.buffer_fraction", 0.8f);
+            compaction_deleted_fraction = get_option_float("compaction.deleted_fraction", 0.1f);
+            compactor = NULL;
+        }
+        
+        virtual ~graphchi_dynamicgraph_engine() {
+            /* An unfinished batch is dropped; its edges are still in the buffers */
+            if (compactor != NULL) delete compactor;
         }
         
     protected:
@@ -78,10 +95,38 @@ namespace graphchi {
         size_t orig_edges;
         
         /**
-         * Concurrency control
+         * Concurrency control. Edge ingestion holds buffer_lock for reading
+         * and appends to the buffers concurrently; the engine holds it for
+         * writing when it reads or rebuilds the buffers. buffer_lock is
+         * always taken after modification_lock, never before it. Ingestion
+         * only tries the locks and backs off, so add_edges() returns
+         * within ingest_wait_ms even during a long commit.
          */
         mutex schedulerlock;
         mutex shardlock;
+        spinrwlock buffer_lock;
+        
+        /* Per-thread staging area for routing a batch of new edges */
+        struct ingest_stage {
+            std::vector<created_edge<EdgeDataType> > edges;
+            std::vector<int> bins;
+            std::vector<unsigned int> offsets;
+        };
+        std::vector<ingest_stage> stages;
+        int ingest_wait_ms;
+        
+        /**
+         * Compaction. Edges [0, sealed[shard][window]) of a buffer belong to
+         * the running batch; the rest were added after it was started.
+         */
+        shard_compactor<EdgeDataType> * compactor;
+        std::vector<std::vector<unsigned int> > sealed;
+        size_t sealed_edges;
+        bool background_compaction;
+        int compaction_horizon;
+        float bufedge_cost;
+        float compaction_buffer_fraction;
+        float compaction_deleted_fraction;
         
         /** 
          * Preloading will interfere with the operation.
@@ -103,12 +148,14 @@ namespace graphchi {
         }
         virtual size_t num_edges() {
             shardlock.lock();
+            buffer_lock.readlock();
             size_t ne = 0;
             for(int i=0; i < this->nshards; i++) {
                 ne += this->sliding_shards[i]->num_edges();
                 for(int j=0; j < (int) new_edge_buffers[i].size(); j++)
                     ne += new_edge_buffers[i][j]->size();
             }
+            buffer_lock.rdunlock();
             shardlock.unlock();
             return ne;
         }
@@ -137,23 +184,24 @@ namespace graphchi {
                 tmp_new_edge_buffers.push_back(shardbuffers);
             }
             
-            // Move old edges. This is not the fastest way... but takes only about 0.05 secs
-            // on the twitter experiment
+            // Move old edges, except the ones committed by compaction. This is not the
+            // fastest way... but takes only about 0.05 secs on the twitter experiment
             int i = 0;
-            for(typename std::vector< std::vector< edge_buffer * > >::iterator oldit = new_edge_buffers.begin(); 
-                oldit != new_edge_buffers.end(); ++oldit) {
-                for(typename std::vector< edge_buffer *>::iterator bufit = oldit->begin(); bufit != oldit->end(); ++bufit) {
-                    edge_buffer &buffer_for_window = **bufit;
-                    for(unsigned int ebi = 0; ebi < buffer_for_window.size(); ebi++ ) {
+            for(size_t oldshard=0; oldshard < new_edge_buffers.size(); oldshard++) {
+                for(size_t oldwin=0; oldwin < new_edge_buffers[oldshard].size(); oldwin++) {
+                    edge_buffer &buffer_for_window = *new_edge_buffers[oldshard][oldwin];
+                    unsigned int first = (oldshard < sealed.size() ? sealed[oldshard][oldwin] : 0);
+                    for(unsigned int ebi = first; ebi < buffer_for_window.size(); ebi++ ) {
                         created_edge<EdgeDataType> * edge = buffer_for_window[ebi];
                         int shard = get_shard_for(edge->dst);
                         int srcshard = get_shard_for(edge->src);
                         i++;
                         tmp_new_edge_buffers[shard][srcshard]->add(*edge);            
                     }
-                    delete *bufit;
+                    delete new_edge_buffers[oldshard][oldwin];
                 }
             }
+            sealed.clear();
             
             std::cout << "TRANSFERRED " << i << " EDGES OVER." << std::endl;
             
@@ -277,41 +325,77 @@ namespace graphchi {
         }
         
         int get_shard_for(vid_t dst) {
-            for(int i=0; i < this->nshards; i++) {
-                if (dst >= this->intervals[i].first && dst <= this->intervals[i].second) {
-                    return i;
-                }
+            /* Intervals are consecutive; ids past the last interval go to the last shard */
+            int lo = 0, hi = this->nshards - 1;
+            while(lo < hi) {
+                int mid = (lo + hi) / 2;
+                if (dst <= this->intervals[mid].second) hi = mid;
+                else lo = mid + 1;
             }
-            return this->nshards - 1; // Last shard
+            return lo;
         }
         
-    public:       
-        bool add_edge(vid_t src, vid_t dst, EdgeDataType edata) {
-            if (src == dst) {
-                logstream(LOG_WARNING) << "WARNING : tried to add self-edge!" << std::endl;
-                return true;
+        /* Backoff of add_edges(): up to ingest_wait_ms in total over all its waits */
+        struct ingest_backoff {
+            int waited;
+            int sleepms;
+            ingest_backoff() : waited(0), sleepms(1) {}
+        };
+        
+        /* Sleeps for the next backoff step; false if the time is up */
+        bool backoff(ingest_backoff &b) {
+            if (b.waited >= ingest_wait_ms) return false;
+            usleep(b.sleepms * 1000);
+            b.waited += b.sleepms;
+            b.sleepms = std::min(b.sleepms * 2, 64);
+            return true;
+        }
+        
+        /**
+         * Waits until edges can be added: the first iteration has passed
+         * and the buffers are below 120% of their limit. Edges sealed for
+         * a running compaction do not count.
+         */
+        bool wait_for_ingest(ingest_backoff &b) {
+            while(this->iter < 1 || added_edges - last_commit - sealed_edges > 1.2 * max_edge_buffer) {
+                if (!backoff(b)) {
+                    if (this->iter < 1) {
+                        logstream(LOG_WARNING) << "Tried to add edge before first iteration has passed" << std::endl;
+                    } else {
+                        logstream(LOG_INFO) << "Over 20% of max buffer... hold on...." << std::endl;
+                    }
+                    return false;
+                }
             }
-            if (this->iter < 1) {
-                logstream(LOG_WARNING) << "Tried to add edge before first iteration has passed" << std::endl;
-                usleep(1000000);
-                return false;
+            return true;
+        }
+        
+        /**
+         * Takes buffer_lock for reading. The engine holds it for writing
+         * while it commits, swaps in compacted shards or reads the
+         * buffers, so this does not block but backs off.
+         */
+        bool lock_for_ingest(ingest_backoff &b) {
+            while(!buffer_lock.try_readlock()) {
+                if (!backoff(b)) {
+                    logstream(LOG_INFO) << "Edge buffers are being committed... hold on...." << std::endl;
+                    return false;
+                }
             }
-            if (added_edges - last_commit > 1.2 * max_edge_buffer) {
-                logstream(LOG_INFO) << "Over 20% of max buffer... hold on...." << std::endl;
-                usleep(1000000); // Sleep 1 sec
-                return false;
+            return true;
+        }
+        
+        /* Extends the degree file and scheduler for new vertex ids; backs off while the graph is modified */
+        bool ensure_max_vertex_id(vid_t maxid, ingest_backoff &b) {
+            if (maxid <= max_vertex_id) return true;
+            while(!this->modification_lock.try_lock()) {
+                if (!backoff(b)) {
+                    logstream(LOG_INFO) << "Graph is being modified... hold on...." << std::endl;
+                    return false;
+                }
             }
-            this->modification_lock.lock();
-            added_edges++;
-            int shard = get_shard_for(dst);
-            int srcshard = get_shard_for(src);
-            /* Maintain max vertex id */
-            vid_t prev_max_id = max_vertex_id;
-            max_vertex_id = std::max(max_vertex_id, dst);
-            max_vertex_id = std::max(max_vertex_id, src);
-            
-            // Extend degree and vertex data files
-            if (max_vertex_id>prev_max_id) {
+            if (maxid > max_vertex_id) {
+                max_vertex_id = maxid;
                 this->degree_handler->ensure_size(this->max_vertex_id); // Expand the file
                 
                 // Expand scheduler
@@ -321,13 +405,95 @@ namespace graphchi {
                     schedulerlock.unlock();
                 }
             }
-            
-            // Add edge to buffers
-            new_edge_buffers[shard][srcshard]->add(src, dst, edata);            
             this->modification_lock.unlock();
             return true;
         }
         
+    public:       
+        /**
+         * Adds a batch of edges. Can be called from many threads, also
+         * while updates are running. The batch is routed to the buffers of
+         * its shards in a per-thread staging area and each buffer gets one
+         * atomic append, so no lock is taken per edge. Self-edges are dropped.
+         * If the buffers are full, or a commit or the swap of compacted
+         * shards holds them, backs off for up to ingest_wait_ms
+         * milliseconds in total (see set_ingest_wait_ms()).
+         * @return number of edges added, 0 if the batch was refused
+         */
+        size_t add_edges(const created_edge<EdgeDataType> * edges, size_t n) {
+            if (n == 0) return 0;
+            ingest_backoff b;
+            if (!wait_for_ingest(b)) return 0;
+            
+            vid_t maxid = 0;
+            for(size_t i=0; i < n; i++) {
+                maxid = std::max(maxid, std::max(edges[i].src, edges[i].dst));
+            }
+            if (!ensure_max_vertex_id(maxid, b)) return 0;
+            
+            ingest_stage &stage = stages[thread_slots::current()];
+            if (!lock_for_ingest(b)) return 0;
+            int nbins = this->nshards * this->nshards;
+            stage.bins.resize(n);
+            stage.offsets.assign(nbins + 1, 0);
+            size_t nselfedges = 0;
+            for(size_t i=0; i < n; i++) {
+                if (edges[i].src == edges[i].dst) {
+                    stage.bins[i] = -1;
+                    nselfedges++;
+                    continue;
+                }
+                int bin = get_shard_for(edges[i].dst) * this->nshards + get_shard_for(edges[i].src);
+                stage.bins[i] = bin;
+                stage.offsets[bin + 1]++;
+            }
+            for(int b=0; b < nbins; b++) stage.offsets[b + 1] += stage.offsets[b];
+            
+            size_t nadded = n - nselfedges;
+            stage.edges.resize(nadded, edges[0]);
+            std::vector<unsigned int> pos(stage.offsets.begin(), stage.offsets.end() - 1);
+            for(size_t i=0; i < n; i++) {
+                if (stage.bins[i] < 0) continue;
+                created_edge<EdgeDataType> &e = stage.edges[pos[stage.bins[i]]++];
+                e = edges[i];
+                e.accounted_for_inc = e.accounted_for_outc = false;
+            }
+            for(int b=0; b < nbins; b++) {
+                unsigned int cnt = stage.offsets[b + 1] - stage.offsets[b];
+                if (cnt > 0) {
+                    new_edge_buffers[b / this->nshards][b % this->nshards]->add_range(&stage.edges[stage.offsets[b]], cnt);
+                }
+            }
+            __sync_fetch_and_add(&added_edges, nadded);
+            buffer_lock.rdunlock();
+            
+            if (nselfedges > 0) {
+                logstream(LOG_WARNING) << "WARNING : tried to add " << nselfedges << " self-edges!" << std::endl;
+            }
+            return nadded;
+        }
+        
+        size_t add_edges(const std::vector<created_edge<EdgeDataType> > &edges) {
+            return edges.empty() ? 0 : add_edges(&edges[0], edges.size());
+        }
+        
+        bool add_edge(vid_t src, vid_t dst, EdgeDataType edata) {
+            if (src == dst) {
+                logstream(LOG_WARNING) << "WARNING : tried to add self-edge!" << std::endl;
+                return true;
+            }
+            created_edge<EdgeDataType> edge(src, dst, edata);
+            return add_edges(&edge, 1) == 1;
+        }
+        
+        /**
+         * Maximum time add_edges() waits for the buffers to be committed,
+         * in total over all its waits, before refusing a batch.
+         */
+        void set_ingest_wait_ms(int ms) {
+            ingest_wait_ms = ms;
+        }
+        
         void add_task(vid_t vid) {
             if (this->scheduler != NULL) {
                 this->modification_lock.lock();
@@ -349,6 +515,9 @@ namespace graphchi {
                         if (vertices[edge->src-window_st].scheduled) {
                             if (vertices[edge->src-window_st].scheduled)
                                 vertices[edge->src-window_st].add_outedge(edge->dst, &edge->data, false);
+                            /* As in memory_shard, an edge inside the window is updated serially */
+                            if (edge->dst >= window_st && edge->dst <= window_en)
+                                vertices[edge->src-window_st].parallel_safe = false;
                             ncreated++;
                         }
                     }
@@ -364,6 +533,8 @@ namespace graphchi {
                         if (vertices[edge->dst - window_st].scheduled) {
                             if (vertices[edge->dst-window_st].scheduled)
                                 vertices[edge->dst - window_st].add_inedge(edge->src, &edge->data, false);
+                            if (edge->src >= window_st && edge->src <= window_en)
+                                vertices[edge->dst - window_st].parallel_safe = false;
                             ncreated++;
                         }
                     }
@@ -435,6 +606,14 @@ namespace graphchi {
         }
         
         virtual vid_t determine_next_window(vid_t iinterval, vid_t fromvid, vid_t maxvid, size_t membudget) {
+            buffer_lock.writelock();
+            vid_t window_en = determine_next_window_locked(iinterval, fromvid, maxvid, membudget);
+            buffer_lock.wrunlock();
+            return window_en;
+        }
+        
+        /* As determine_next_window(), with buffer_lock held for writing */
+        vid_t determine_next_window_locked(vid_t iinterval, vid_t fromvid, vid_t maxvid, size_t membudget) {
             /* Load degrees */
             this->degree_handler->load(fromvid, maxvid);
             if (incorporate_new_edge_degrees(iinterval, fromvid, maxvid)) {
@@ -476,7 +655,9 @@ namespace graphchi {
         
         virtual void init_vertices(std::vector<svertex_t> &vertices, graphchi_edge<EdgeDataType> * &edata) {
             base_engine::init_vertices(vertices, edata);
+            buffer_lock.writelock();
             incorporate_buffered_edges(this->exec_interval, this->sub_interval_st, this->sub_interval_en, vertices);
+            buffer_lock.wrunlock();
         }
         
         
@@ -505,9 +686,24 @@ namespace graphchi {
             }
         }
         
+        /**
+         * A batch still running in the background is swapped in before
+         * run() returns, so that the compactor thread does not outlive
+         * the run (and its trace spans are complete when the trace is
+         * written).
+         */
+        virtual void run_finished() {
+            if (compactor != NULL && compactor->busy()) {
+                swap_compacted_shards();
+            }
+        }
+        
         virtual void initialize_before_run() {
             prepare_clean_slate();
             init_buffers();
+            if (compactor == NULL) {
+                compactor = new shard_compactor<EdgeDataType>(this->blocksize, maxshardsize);
+            }
 
             max_vertex_id = (vid_t) (this->num_vertices() - 1);
             
@@ -530,388 +726,209 @@ namespace graphchi {
     protected:
         
         
-#define BBUF 32000000
+        /**
+         * Shard file names of a version.
+         */
+        std::string dyngraph_adj_prefix() {
+            return filename_shard_adj(this->base_filename, 0, 0) + ".dyngraph";
+        }
+        
+        std::string dyngraph_edata_prefix() {
+            return filename_shard_edata<EdgeDataType>(this->base_filename, 0, 0) + ".dyngraph";
+        }
         
-        size_t curadjfilepos;
-
         /**
-         * Code for committing changes to disk.
+         * Cost model for compaction, in units of one edge read from a
+         * shard. A buffered edge costs compaction.bufedge_cost per
+         * iteration, because it is scanned for every window of its two
+         * intervals; a deleted edge costs one, because it is still read
+         * from disk. Rewriting a shard costs reading and writing each of its
+         * edges once. A shard is compacted when its overhead over the next
+         * compaction.horizon iterations (at most the remaining ones)
+         * exceeds the rewrite cost. So near the end of a run, when the
+         * overhead has few iterations left to pay off, only heavily
+         * changed shards are compacted. Independently of the remaining
+         * iterations, a shard is compacted once compaction.deleted_fraction
+         * (default 10%) of its edges are deleted, as before the cost
+         * model. If the buffers are over compaction.buffer_fraction of
+         * max_edgebuffer_mb, the shards with most buffered edges are
+         * compacted too, until the buffers would be under half of that.
          */
-        void commit_graph_changes() {            
-            // Count deleted
-            size_t ndeleted = 0;
-            for(size_t i=0; i < deletecounts.size(); i++) {
-                ndeleted += deletecounts[i];
-            }
+        std::vector<int> choose_shards_to_compact() {
+            std::vector<int> chosen;
+            int remaining = std::min(compaction_horizon, this->niters - this->iter - 1);
+            std::vector<std::pair<size_t, int> > bybuffered;
             
-            // TODO: remove ad hoc limits, move to configuration.
-            // Perhaps do some cost estimation?
-            logstream(LOG_DEBUG) << "Total deleted: " << ndeleted << " total edges: " << this->num_edges() << std::endl;
-
-            if (added_edges - last_commit < max_edge_buffer * 0.8 && ndeleted < this->num_edges() * 0.1) {
-                std::cout << "==============================" << std::endl;
-                std::cout << "No time to commit yet.... Only " << (added_edges - last_commit) << " / " << max_edge_buffer
-                << " in buffers" << std::endl;
-                return;
+            buffer_lock.readlock();
+            for(int shard=0; shard < this->nshards; shard++) {
+                size_t bufedges = 0;
+                for(int w=0; w < this->nshards; w++) bufedges += new_edge_buffers[shard][w]->size();
+                size_t deleted = deletecounts[shard];
+                size_t shardedges = (this->sliding_shards[shard] != NULL ? this->sliding_shards[shard]->num_edges() : 0);
+                
+                double overhead = remaining * (bufedge_cost * bufedges + deleted);
+                double cost = 2.0 * (shardedges + bufedges);
+                if (bufedges + deleted > 0 && overhead >= cost) {
+                    logstream(LOG_DEBUG) << shard << ": compacting, buffered: " << bufedges << " deleted: " << deleted
+                        << "/" << shardedges << std::endl;
+                    chosen.push_back(shard);
+                } else if (deleted > 0 && deleted >= compaction_deleted_fraction * shardedges) {
+                    logstream(LOG_DEBUG) << shard << ": compacting deleted edges, buffered: " << bufedges << " deleted: " << deleted
+                        << "/" << shardedges << std::endl;
+                    chosen.push_back(shard);
+                } else if (bufedges > 0) {
+                    bybuffered.push_back(std::pair<size_t, int>(bufedges, shard));
+                }
             }
+            buffer_lock.rdunlock();
             
-            
-            bool rangeschanged = false;
-            state = "commit-ingests";
-            vid_t maxwindow = 4000000; // FIXME: HARDCODE
-            size_t mem_budget = this->membudget_mb * 1024 * 1024;
-            this->modification_lock.lock();
-            
-            // Clean up sliding shards
-            // NOTE: there is a problem since this will waste
-            // io-sessions
-            std::vector<int> edgespershard;
-            for(int p=0; p < this->nshards; p++) {
-                edgespershard.push_back(this->sliding_shards[p]->num_edges());
+            size_t buffered = added_edges - last_commit;
+            if (buffered > compaction_buffer_fraction * max_edge_buffer) {
+                std::sort(bybuffered.rbegin(), bybuffered.rend());
+                for(size_t i=0; i < bybuffered.size() && buffered > compaction_buffer_fraction * max_edge_buffer / 2; i++) {
+                    logstream(LOG_DEBUG) << bybuffered[i].second << ": compacting to free buffers, buffered: " << bybuffered[i].first << std::endl;
+                    chosen.push_back(bybuffered[i].second);
+                    buffered -= bybuffered[i].first;
+                }
+                std::sort(chosen.begin(), chosen.end());
             }
-            
-            std::vector<std::pair<vid_t, vid_t> > newranges;
-            std::vector<std::string> newsuffices;
-            
+            if (chosen.empty()) {
+                logstream(LOG_DEBUG) << "No shards to compact, " << (added_edges - last_commit) << " / " << max_edge_buffer
+                    << " in buffers." << std::endl;
+            }
+            return chosen;
+        }
+        
+        /**
+         * Seals the buffered edges of the shards and hands them to the
+         * compactor. Edges added later go to the same buffers after the
+         * sealed ones and are kept at the swap.
+         */
+        void start_compaction(const std::vector<int> &shards) {
+            state = "compaction-seal";
+            bool live_edata = background_compaction && (this->modifies_inedges || this->modifies_outedges);
+#ifdef SUPPORT_DELETIONS
+            if (live_edata) this->iomgr->commit_cached_blocks();
+#endif
             char iterstr[128];
             sprintf(iterstr, "%d", this->iter);
             
-            size_t min_buffer_in_shard_to_commit = max_edge_buffer / this->nshards / 2;
+            std::vector<compaction_job<EdgeDataType> *> jobs;
+            buffer_lock.writelock();
+            sealed.assign(this->nshards, std::vector<unsigned int>(this->nshards, 0));
+            for(size_t i=0; i < shards.size(); i++) {
+                int shard = shards[i];
+                compaction_job<EdgeDataType> * job = new compaction_job<EdgeDataType>();
+                job->shard = shard;
+                job->adjprefix = dyngraph_adj_prefix();
+                job->edataprefix = dyngraph_edata_prefix();
+                job->suffix = shard_suffices[shard];
+                char partstr[128];
+                sprintf(partstr, "%d", shard);
+                job->newsuffix = std::string(partstr) + ".i" + std::string(iterstr);
+                job->range_st = this->intervals[shard].first;
+                job->range_en = (shard == this->nshards - 1 ? max_vertex_id : this->intervals[shard].second);
+                job->live_edata = live_edata;
+#ifdef SUPPORT_DELETIONS
+                /* Deletions are read from a copy, the shard itself is being written */
+                if (live_edata) {
+                    job->snapshot = job->edatafile(job->newsuffix + ".snapshot");
+                    cpedata(job->edatafile(job->suffix), job->snapshot);
+                }
+#endif
+                for(int w=0; w < this->nshards; w++) {
+                    edge_buffer &buffer_for_window = *new_edge_buffers[shard][w];
+                    sealed[shard][w] = buffer_for_window.size();
+                    sealed_edges += buffer_for_window.size();
+                    for(unsigned int ebi=0; ebi < buffer_for_window.size(); ebi++) {
+                        job->edges.push_back(buffer_for_window[ebi]);
+                    }
+                }
+                jobs.push_back(job);
+            }
+            buffer_lock.wrunlock();
             
-            std::vector<bool> was_commited(this->nshards, true);
+            state = "compaction";
+            compactor->start(jobs, background_compaction);
+        }
+        
+        /**
+         * Swaps the new shard versions of the finished batch in and drops
+         * the sealed edges from the buffers. Waits for the batch if it is
+         * still running. Called between iterations.
+         */
+        void swap_compacted_shards() {
+            std::vector<compaction_job<EdgeDataType> *> &jobs = compactor->wait();
+            state = "compaction-swap";
+            bool replay = false;
+            for(size_t i=0; i < jobs.size(); i++) replay = replay || jobs[i]->live_edata;
+            if (replay) {
+                this->iomgr->commit_cached_blocks();
+                for(size_t i=0; i < jobs.size(); i++) compactor->replay(*jobs[i]);
+            }
+            
+            this->modification_lock.lock();
+            buffer_lock.writelock();
             
+            /* The sealed edges leave the buffers, so the degree file has to count them */
+            bool unaccounted = false;
             for(int shard=0; shard < this->nshards; shard++) {
-                std::vector<edge_buffer*> &shard_buffer = new_edge_buffers[shard];
-                
-                // Check there are any new edges
-                size_t bufedges = 0;
                 for(int w=0; w < this->nshards; w++) {
-                    bufedges += shard_buffer[w]->size();
-                    
-                }
-                
-                if (bufedges < min_buffer_in_shard_to_commit && deletecounts[shard] * 1.0 / edgespershard[shard] < 0.2) {
-                    logstream(LOG_DEBUG) << shard << ": not enough edges for shard: " << bufedges << " deleted:" << deletecounts[shard] << "/" << edgespershard[shard] << std::endl;
-                    newranges.push_back(this->intervals[shard]);
-                    newsuffices.push_back(shard_suffices[shard]);
-                    was_commited[shard] = false;
-                    continue;
-                } else {
-                    logstream(LOG_DEBUG) << shard << ": going to rewrite, deleted:" << deletecounts[shard] << "/" << edgespershard[shard] << " bufedges: " << bufedges << std::endl;
-                    shardlock.lock();
-                    delete this->sliding_shards[shard];
-                    this->sliding_shards[shard] = NULL;
-                    shardlock.unlock();
-                }
-                std::string origshardfile = filename_shard_edata<EdgeDataType>(this->base_filename, 0, 0) + ".dyngraph" + shard_suffices[shard];
-                std::string origadjfile = filename_shard_adj(this->base_filename, 0, 0) + ".dyngraph" + shard_suffices[shard];
-                
-                // Get file size
-                off_t sz = get_shard_edata_filesize<EdgeDataType>(origshardfile);
-                
-                int outparts = ( sz >= (off_t) maxshardsize ? 2 : 1);
-                
-                vid_t splitpos = 0;
-                std::cout << "Size: " << sz << " vs. maxshardsize: " << maxshardsize << std::endl;
-                if (sz > (off_t)maxshardsize) {
-                    rangeschanged = true;
-                    // Compute number edges (not including ingested ones!)
-                    size_t halfedges = (sz / sizeof(EdgeDataType)) / 2;
-                    // Correct to include estimate of ingested ones
-                    for(int w=0; w < this->nshards; w++) {
-                        halfedges += new_edge_buffers[shard][w]->size() / 2;
+                    for(unsigned int ebi=0; ebi < sealed[shard][w]; ebi++) {
+                        created_edge<EdgeDataType> * edge = (*new_edge_buffers[shard][w])[ebi];
+                        unaccounted = unaccounted || !edge->accounted_for_inc || !edge->accounted_for_outc;
                     }
-                    size_t nedges = 0;
-                    
-                    vid_t st = this->intervals[shard].first;
-                    splitpos = st + (this->intervals[shard].second - st) / 2;
-                    bool found = false;
-                    while(st < this->intervals[shard].second) {
-                        vid_t en = std::min(st + maxwindow, this->intervals[shard].second);
+                }
+            }
+            if (unaccounted) {
+                vid_t maxwindow = 4000000;
+                for(int window=0; window < this->nshards; window++) {
+                    vid_t range_en = (window == this->nshards - 1 ? max_vertex_id : this->intervals[window].second);
+                    for(vid_t st=this->intervals[window].first; st <= range_en; st += maxwindow) {
+                        vid_t en = std::min(range_en, st + maxwindow - 1);
                         this->degree_handler->load(st, en);
-                        int nv = en - st + 1;
-                        
-                        for(int i=0; i<nv; i++) {
-                            nedges += this->degree_handler->get_degree(st + i).indegree;
-                            if (nedges >= halfedges) {
-                                splitpos = i+st-1;
-                                found = true;
-                                break;
-                            }
+                        if (incorporate_new_edge_degrees(window, st, en)) {
+                            this->degree_handler->save();
                         }
-                        if (found) break;
-                        st = en+1;
+                        if (en == range_en) break;
                     }
-                    assert(splitpos > this->intervals[shard].first && splitpos < this->intervals[shard].second);
                 }
-                
-                for(int splits=0; splits<outparts; splits++) { // Note: this is not super-efficient because we do the operation twice in case of split
-                    typename base_engine::slidingshard_t * curshard = 
-                    new typename base_engine::slidingshard_t(this->iomgr, origshardfile, origadjfile, 
-                                                             this->intervals[shard].first, this->intervals[shard].second, 
-                                                             base_engine::blocksize, this->m, true);
-                    
-                    
-                    std::string suffix = "";
-                    char partstr[128];
-                    sprintf(partstr, "%d", shard);
-                    if (splits == 0) {
-                        suffix = std::string(partstr);
-                    } else {
-                        suffix = std::string(partstr) + ".split";  
-                    }
-                    suffix = suffix + ".i" + std::string(iterstr);
-                    newsuffices.push_back(suffix);
-                    curadjfilepos = 0;
-                    std::string outfile_edata = filename_shard_edata<EdgeDataType>(this->base_filename, 0, 0) + ".dyngraph" + suffix;
-                    std::string outfile_edata_dirname = dirname_shard_edata_block(outfile_edata, base_engine::blocksize);
-                    mkdir(outfile_edata_dirname.c_str(), 0777);
-                    std::string outfile_adj = filename_shard_adj(this->base_filename, 0, 0) + ".dyngraph" + suffix;
-                    
-                    vid_t splitstart = this->intervals[shard].first;
-                    vid_t splitend = this->intervals[shard].second;
-                    if (shard == this->nshards - 1) splitend = max_vertex_id;
-                    
-                    // This is looking more and more hacky
-                    if (outparts == 2) {
-                        if (splits==0) splitend = splitpos;
-                        else splitstart = splitpos+1;
-                    }
-                    newranges.push_back(std::pair<vid_t,vid_t>(splitstart, splitend)); 
-                    
-                    // Create the adj file
-                    int f = open(outfile_adj.c_str(), O_WRONLY | O_CREAT, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
-                    int err = ftruncate(f, 0);
-                    if (err != 0) {
-                        logstream(LOG_ERROR) << "Error truncating " << outfile_adj << ", error: " << strerror(errno) << std::endl;
-                    }
-                    assert(err == 0);
-                    /* Create edge data file */
-                    int ef = open(outfile_edata.c_str(), O_WRONLY | O_CREAT, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
-                    err = ftruncate(ef, 0);
-                    if (err != 0) {
-                        logstream(LOG_ERROR) << "Error truncating " << outfile_edata << ", error: " << strerror(errno) << std::endl;
-                    }
-                    assert(err == 0);
-                    char * buf = (char*) malloc(BBUF); 
-                    char * bufptr = buf;
-                    char * ebuf = (char*) malloc(BBUF);
-                    char * ebufptr = ebuf;
-                    size_t tot_edatabytes = 0;
-                    
-                    // Index file
-                    std::string indexfile = filename_shard_adjidx(outfile_adj);
-                    int idxf = open(indexfile.c_str(),  O_WRONLY | O_CREAT, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
-                    size_t last_index_output = 0;
-                    size_t index_interval_edges = 1024 * 1024;
-                    size_t edgecounter = 0;
-                    assert(idxf>0);
-
-                    
-                    // Now create a new shard file window by window
-                    for(int window=0; window < this->nshards; window++) {
-                        vid_t range_st = this->intervals[window].first;
-                        vid_t range_en = this->intervals[window].second;
-                        if (window == this->nshards - 1) range_en = max_vertex_id;
-                        edge_buffer &buffer_for_window = *new_edge_buffers[shard][window];
-                        
-                        for(vid_t window_st=range_st; window_st<range_en; ) {
-                            // Check how much we can read
-                            vid_t window_en = determine_next_window(window, window_st, 
-                                                                    std::min(range_en, window_st + (vid_t)maxwindow), mem_budget);
-                            // Create vertices
-                            int nvertices = window_en-window_st+1;
-                            std::vector< svertex_t > vertices(nvertices, svertex_t());
-                            /* Allocate edge data: to do this, need to compute sum of in & out edges */
-                            graphchi_edge<EdgeDataType> * edata = NULL;
-                            size_t num_edges=0;
-                            for(int i=0; i<nvertices; i++) {
-                                degree d = this->degree_handler->get_degree(i + window_st);
-                                num_edges += d.indegree+d.outdegree;
-                            }
-                            size_t ecounter = 0;
-                            edata = (graphchi_edge<EdgeDataType>*)malloc(num_edges * sizeof(graphchi_edge<EdgeDataType>));
-                            for(int i=0; i<(int)nvertices; i++) {
-                                //  int inc = degrees[i].indegree;
-                                degree d = this->degree_handler->get_degree(i + window_st);
-                                int outc = d.outdegree;
-                                vertices[i] = svertex_t(window_st+i, &edata[ecounter], 
-                                                        &edata[ecounter+0], 0, outc);
-                                vertices[i].scheduled = true; // guarantee that shard will read it
-                                ecounter += 0 + outc;
-                            }
-                            
-                            // Read vertices in
-                            curshard->read_next_vertices(nvertices, window_st, vertices, false, true);
-                            
-                            // Incorporate buffered edges
-                            for(unsigned int ebi=0; ebi<buffer_for_window.size(); ebi++) {
-                                created_edge<EdgeDataType> * edge = buffer_for_window[ebi];
-                                if (edge->src >= window_st && edge->src <= window_en) {
-                                    vertices[edge->src-window_st].add_outedge(edge->dst, &edge->data, false);
-                                    
-                                }
-                            }
-                            this->iomgr->wait_for_reads();
-                            
-                            // If we are splitting, need to adjust counts
-                            std::vector<int> adjusted_counts(vertices.size(), 0);
-                            for(int iv=0; iv< (int)vertices.size(); iv++) adjusted_counts[iv] = vertices[iv].outc;
-                            
-                            if (outparts == 2) {
-                                // do actual counts by removing the edges not in this split
-                                for(int iv=0; iv< (int)vertices.size(); iv++) {
-                                    svertex_t &vertex = vertices[iv];
-                                    for(int i=0; i<vertex.outc; i++) {
-                                        if (!(vertex.outedge(i)->vertexid >= splitstart && vertex.outedge(i)->vertexid <= splitend)) {
-                                            adjusted_counts[iv]--;  
-                                        }
-                                    }
-                                }
-                            }   
-                            
-#ifdef SUPPORT_DELETIONS
-                            // Adjust counts to remove deleted edges
-                            for(int iv=0; iv< (int)vertices.size(); iv++) {
-                                svertex_t &vertex = vertices[iv];
-                                for(int i=0; i<vertex.outc; i++) {
-                                    if (is_deleted_edge_value(vertex.outedge(i)->get_data())) {
-                                        adjusted_counts[iv]--;  
-                                        assert(false);
-                                    }
-                                }
-                            }
-                            
-                            // Adjust degrees
-                            //   adjust_degrees_for_deleted(vertices, window_st); // Double counting problem, that is why commented out.
-#endif
-                            
-                            size_t ne = 0;
-                            for(vid_t curvid=window_st; curvid<=window_en;) {
-                                int iv = curvid - window_st;
-                                svertex_t &vertex = vertices[iv];
-                                int count = adjusted_counts[iv];                            
-                                if (count == 0) {
-                                    // Check how many next ones are zeros
-                                    int nz=0;
-                                    curvid++;
-                                    for(; curvid <= window_en && nz<254; curvid++) {
-                                        if (adjusted_counts[curvid - window_st] == 0) {
-                                            nz++;
-                                        } else {
-                                            break;
-                                        }
-                                    }
-                                    uint8_t nnz = (uint8_t)nz;
-                                    // Write zero
-                                    bwrite<uint8_t>(f, buf, bufptr, 0);
-                                    bwrite<uint8_t>(f, buf, bufptr, nnz);
-                                } else {
-                                    
-                                    // Write index
-                                    if (edgecounter - last_index_output >= index_interval_edges) {
-                                        size_t curfpos = curadjfilepos;
-                                        shard_index sidx(curvid, curfpos, edgecounter);
-                                        size_t a = write(idxf, &sidx, sizeof(shard_index));
-                                        assert(a>0);
-                                        last_index_output = edgecounter;
-                                    }
-
-                                    
-                                    if (count < 255) {
-                                        uint8_t x = (uint8_t)count;
-                                        bwrite<uint8_t>(f, buf, bufptr, x);
-                                    } else {
-                                        bwrite<uint8_t>(f, buf, bufptr, 0xff);
-                                        bwrite<uint32_t>(f, buf, bufptr, (uint32_t)count);
-                                    }
-                                    
-                                    for(int i=0; i<vertex.outc; i++) {
-                                        if (vertex.outedge(i)->vertexid >= splitstart && vertex.outedge(i)->vertexid <= splitend) {
-#ifdef SUPPORT_DELETIONS
-                                            if (is_deleted_edge_value(vertex.outedge(i)->get_data())) {
-                                                assert(false);
-                                                
-                                            } 
-#endif
-                                            bwrite(f, buf, bufptr,  vertex.outedge(i)->vertexid);
-                                            bwrite_edata<EdgeDataType>(ebuf, ebufptr, vertex.outedge(i)->get_data(), tot_edatabytes, outfile_edata);
-                                            ne++;
-                                            edgecounter++;
-                                        } else assert(outparts == 2);
-                                    }
-                                    curvid++;
-                                }
-                            } 
-                            free(edata);
-                            window_st = window_en+1;
-                        }
-                        
-                    } // end window
-                    
-                    // Flush buffers
-                    writea(f, buf, bufptr-buf);
-                    
-                    edata_flush<EdgeDataType>(ebuf, ebufptr, outfile_edata, tot_edatabytes);
-                    
-                    // Write .size file for the edata firectory
-                    std::string sizefilename = outfile_edata + ".size";
-                    std::ofstream ofs(sizefilename.c_str());
-                    ofs << tot_edatabytes;
-                    ofs.close();
-
-                    // Release
-                    free(buf); 
-                    free(ebuf);
-                    
-                    delete curshard;
-                    close(f);
-                    close(ef);
-                    close(idxf);
-                    
-                    this->iomgr->wait_for_writes();
-                } // splits
-                
-                // Delete old shard
-                std::string old_file_adj = filename_shard_adj(this->base_filename, 0, 0) + ".dyngraph" + shard_suffices[shard];          
-                std::string old_file_edata = filename_shard_edata<EdgeDataType>(this->base_filename, 0, 0) + ".dyngraph" + shard_suffices[shard];
-                std::string old_blockdir =  dirname_shard_edata_block(old_file_edata, base_engine::blocksize);
-                std::string old_file_adj_idx = filename_shard_adjidx(old_file_adj);
-                remove(old_file_adj.c_str());
-                remove(old_blockdir.c_str());
-                remove(old_file_adj_idx.c_str());
-
-                std::string old_sizefilename = old_file_edata + ".size";
-                remove(old_sizefilename.c_str());
             }
             
-            // Clear buffers
+            std::vector<std::pair<vid_t, vid_t> > newranges;
+            std::vector<std::string> newsuffices;
+            std::vector<compaction_job<EdgeDataType> *> jobforshard(this->nshards, (compaction_job<EdgeDataType> *) NULL);
+            for(size_t i=0; i < jobs.size(); i++) jobforshard[jobs[i]->shard] = jobs[i];
+            
+            bool rangeschanged = false;
+            size_t committed = 0;
             for(int shard=0; shard < this->nshards; shard++) {
-                if (was_commited[shard]) {
-                    for (int win=0; win < this->nshards; win++) {
-                        edge_buffer &buffer_for_window = *new_edge_buffers[shard][win];
-                        for(unsigned int ebi=0; ebi<buffer_for_window.size(); ebi++) {
-                            created_edge<EdgeDataType> * edge = buffer_for_window[ebi];                            
-                            if (!edge->accounted_for_outc) {
-                                std::cout << "Edge not accounted (out)! " << edge->src << " -- " << edge->dst << std::endl;
-                            }
-                            if (!edge->accounted_for_inc) {
-                                std::cout << "Edge not accounted (in)! " << edge->src << " -- " << edge->dst << std::endl;
-                            }
-                            
-                            assert(edge->accounted_for_inc);
-                            assert(edge->accounted_for_outc);
-                        }
-                        buffer_for_window.clear();
-                    }
+                compaction_job<EdgeDataType> * job = jobforshard[shard];
+                if (job == NULL) {
+                    newranges.push_back(this->intervals[shard]);
+                    newsuffices.push_back(shard_suffices[shard]);
+                    continue;
                 }
+                newranges.insert(newranges.end(), job->ranges.begin(), job->ranges.end());
+                newsuffices.insert(newsuffices.end(), job->suffices.begin(), job->suffices.end());
+                rangeschanged = rangeschanged || job->ranges.size() > 1;
+                for(int w=0; w < this->nshards; w++) committed += sealed[shard][w];
+                
+                shardlock.lock();
+                delete this->sliding_shards[shard];
+                this->sliding_shards[shard] = NULL;
+                shardlock.unlock();
+                shard_compactor<EdgeDataType>::remove_version(job->edatafile(job->suffix), base_engine::blocksize,
+                                                              job->adjfile(job->suffix));
             }
             
-            // Update number of shards:
-            last_commit = added_edges;
+            /* The buffers are rebuilt without the sealed edges */
             this->intervals = newranges;
             shard_suffices = newsuffices;
             this->nshards = (int) this->intervals.size();
+            init_buffers();
+            last_commit += committed;
+            sealed_edges = 0;
             
             /* If the vertex intervals change, need to recreate the shard objects. */
             if (rangeschanged) {
@@ -928,47 +945,41 @@ namespace graphchi {
             fprintf(f, "%lu\n", base_engine::num_vertices());
             fclose(f);
             
-            init_buffers();
+            buffer_lock.wrunlock();
             this->modification_lock.unlock();
+            
+            logstream(LOG_INFO) << "Swapped in " << jobs.size() << " compacted shard(s), " << committed
+                << " edges left the buffers, now " << this->nshards << " shards." << std::endl;
+            compactor->release();
         }
         
-        
-        template <typename T>
-        void bwrite(int f, char * buf, char * &bufptr, T val) {
-            curadjfilepos += sizeof(T);
-            if (bufptr+sizeof(T)-buf>=BBUF) {
-                writea(f, buf, bufptr-buf);
-                bufptr = buf;
+        /**
+         * Commits buffered edges and deleted edges to the shards. A
+         * finished compaction batch is swapped in; if there is none, the
+         * cost model may start a new one. With compaction.background, the
+         * batch runs while the next iterations compute on the old shards.
+         * The engine waits for a running batch only when the buffers are
+         * full again.
+         */
+        void commit_graph_changes() {
+            if (compactor->busy()) {
+                if (!compactor->done() && added_edges - last_commit - sealed_edges < max_edge_buffer) {
+                    logstream(LOG_INFO) << "Compaction still running, computing on the old shards." << std::endl;
+                    return;
+                }
+                /* The statistics of this iteration are for the old shards */
+                swap_compacted_shards();
+                return;
             }
-            *((T*)bufptr) = val;
-            bufptr += sizeof(T);
-        }
-        
-        
-        template <typename T>
-        void edata_flush(char * buf, char * bufptr, std::string & shard_filename, size_t totbytes) {
-            int blockid = (int) ((totbytes - sizeof(T)) / base_engine::blocksize);
-            int len = (int) (bufptr - buf);
-            assert(len <= (int)base_engine::blocksize);
             
-            std::string block_filename = filename_shard_edata_block(shard_filename, blockid, base_engine::blocksize);
-            int f = open(block_filename.c_str(), O_RDWR | O_CREAT, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
-            write_compressed(f, buf, len);
-            close(f);
-        }
-        
-        template <typename T>
-        void bwrite_edata(char * buf, char * &bufptr, T val, size_t & totbytes, std::string & shard_filename) {            
-            if ((int) (bufptr + sizeof(T) - buf) > (int)base_engine::blocksize) {
-                edata_flush<T>(buf, bufptr, shard_filename, totbytes);
-                bufptr = buf;
+            std::vector<int> shards = choose_shards_to_compact();
+            if (shards.empty()) return;
+            start_compaction(shards);
+            if (!background_compaction) {
+                swap_compacted_shards();
             }
-            totbytes += sizeof(T);
-            *((T*)bufptr) = val;
-            bufptr += sizeof(T);
         }
         
-
         
         /** 
           * HTTP admin
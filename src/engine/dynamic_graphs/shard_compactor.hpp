@@ -0,0 +1,582 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Background compaction of the shards of the dynamic graph engine.
+ *
+ * A compaction job rewrites one shard as a new version (a new file
+ * suffix). The buffered edges of the shard are merged into the
+ * out-edges of their source, which stay sorted by target as the memory
+ * shard expects; deleted edges are dropped, and a shard
+ * that grows over the maximum size is split in two by in-edge count.
+ * The jobs of a batch run one after another on a background thread.
+ * The thread only reads the current shard files, so the engine keeps
+ * computing on them until it swaps the new versions in at an iteration
+ * boundary.
+ *
+ * If the program writes edge values, the current edge data keeps
+ * changing while the job runs. Then the job writes only the adjacency,
+ * and replay() copies the edge values at the swap. Replay is one
+ * sequential pass over the edge data.
+ */
+
+#ifndef DEF_GRAPHCHI_SHARD_COMPACTOR
+#define DEF_GRAPHCHI_SHARD_COMPACTOR
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "graphchi_types.hpp"
+#include "api/chifilenames.hpp"
+#include "api/graph_objects.hpp"
+#include "engine/dynamic_graphs/edgebuffers.hpp"
+#include "logger/logger.hpp"
+#include "metrics/trace_recorder.hpp"
+#include "util/ioutil.hpp"
+
+namespace graphchi {
+    
+    /**
+     * One shard to compact. The engine fills in the input part; the
+     * compactor fills in the result.
+     */
+    template <typename ET>
+    struct compaction_job {
+        int shard;
+        std::string adjprefix;      // shard file names are prefix + suffix
+        std::string edataprefix;
+        std::string suffix;         // current version
+        std::string newsuffix;      // new version; the second split part gets ".split"
+        std::string snapshot;       // copy of the edge data to check deletions from, or empty
+        vid_t range_st, range_en;
+        bool live_edata;            // edge values change while the job runs
+        std::vector<created_edge<ET> *> edges;    // buffered edges of the shard
+        
+        /* Result */
+        std::vector<std::pair<vid_t, vid_t> > ranges;
+        std::vector<std::string> suffices;
+        std::vector<bool> dropped;  // old edges left out, if live_edata
+        size_t nold;
+        size_t nwritten;
+        
+        compaction_job() : shard(-1), range_st(0), range_en(0), live_edata(false), nold(0), nwritten(0) {}
+        
+        std::string adjfile(const std::string &sfx) const { return adjprefix + sfx; }
+        std::string edatafile(const std::string &sfx) const { return edataprefix + sfx; }
+    };
+    
+    /* Sequential reader of a shard adjacency file */
+    class shard_adj_reader {
+        int f;
+        std::vector<char> buf;
+        size_t pos, len;
+        
+        bool fill(size_t need) {
+            if (len - pos >= need) return true;
+            memmove(&buf[0], &buf[pos], len - pos);
+            len -= pos;
+            pos = 0;
+            while(len < need) {
+                ssize_t a = read(f, &buf[len], buf.size() - len);
+                assert(a >= 0);
+                if (a == 0) return false;
+                len += a;
+            }
+            return true;
+        }
+        
+    public:
+        shard_adj_reader(std::string filename) : buf(4 * 1024 * 1024), pos(0), len(0) {
+            f = open(filename.c_str(), O_RDONLY);
+            if (f < 0) {
+                logstream(LOG_ERROR) << "Could not open " << filename << " error: " << strerror(errno) << std::endl;
+                assert(f >= 0);
+            }
+        }
+        
+        ~shard_adj_reader() {
+            close(f);
+        }
+        
+        /**
+         * Reads the next vertex with edges and its edge count.
+         * @return false at the end of the file
+         */
+        bool next_vertex(vid_t &vid, uint32_t &count) {
+            while(fill(1)) {
+                uint8_t ns = (uint8_t) buf[pos++];
+                if (ns == 0x00) {
+                    // next value tells the number of vertices with zeros
+                    bool ok = fill(1);
+                    assert(ok);
+                    vid += 1 + (uint8_t) buf[pos++];
+                    continue;
+                }
+                count = ns;
+                if (ns == 0xff) {
+                    bool ok = fill(sizeof(uint32_t));
+                    assert(ok);
+                    memcpy(&count, &buf[pos], sizeof(uint32_t));
+                    pos += sizeof(uint32_t);
+                }
+                return true;
+            }
+            return false;
+        }
+        
+        vid_t next_target() {
+            vid_t dst;
+            bool ok = fill(sizeof(vid_t));
+            assert(ok);
+            memcpy(&dst, &buf[pos], sizeof(vid_t));
+            pos += sizeof(vid_t);
+            return dst;
+        }
+    };
+    
+    /* Sequential reader of the compressed edge data blocks of a shard */
+    template <typename ET>
+    class shard_edata_reader {
+        std::string filename;
+        size_t blocksize, totbytes;
+        std::vector<char> block;
+        int curblock;
+        
+    public:
+        shard_edata_reader(std::string filename, size_t blocksize) : filename(filename), blocksize(blocksize), block(blocksize), curblock(-1) {
+            totbytes = get_shard_edata_filesize<ET>(filename);
+        }
+        
+        ET get(size_t edgeidx) {
+            size_t off = edgeidx * sizeof(ET);
+            assert(off + sizeof(ET) <= totbytes);
+            int blockid = (int) (off / blocksize);
+            if (blockid != curblock) {
+                std::string blockname = filename_shard_edata_block(filename, blockid, blocksize);
+                int bf = open(blockname.c_str(), O_RDONLY);
+                if (bf < 0) {
+                    logstream(LOG_ERROR) << "Could not open " << blockname << " error: " << strerror(errno) << std::endl;
+                    assert(bf >= 0);
+                }
+                read_compressed(bf, &block[0], std::min(blocksize, totbytes - blockid * blocksize));
+                close(bf);
+                curblock = blockid;
+            }
+            ET val;
+            memcpy(&val, &block[off - curblock * blocksize], sizeof(ET));
+            return val;
+        }
+    };
+    
+    /**
+     * Writes a shard version: adjacency, its index and the compressed
+     * edge data blocks, in the same format as the engine reads.
+     */
+    template <typename ET>
+    class shard_version_writer {
+        int adjf, idxf;
+        std::string edatafile;
+        size_t blocksize;
+        bool write_adj, write_edata;
+        
+        std::vector<char> adjbuf;
+        size_t adjpos;              // bytes of adjacency written
+        std::vector<char> eblock;
+        size_t eblocklen;
+        int blockid;
+        
+        vid_t nextvid;
+        size_t nedges;
+        size_t last_index_output;
+        
+        template <typename T>
+        void put(T val) {
+            if (adjbuf.size() + sizeof(T) > 32000000) {
+                writea(adjf, &adjbuf[0], adjbuf.size());
+                adjbuf.clear();
+            }
+            adjbuf.insert(adjbuf.end(), (char *) &val, (char *) &val + sizeof(T));
+            adjpos += sizeof(T);
+        }
+        
+        void flush_edata() {
+            if (eblocklen == 0) return;
+            std::string blockname = filename_shard_edata_block(edatafile, blockid, blocksize);
+            int f = open(blockname.c_str(), O_RDWR | O_CREAT, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
+            assert(f >= 0);
+            write_compressed(f, &eblock[0], eblocklen);
+            close(f);
+            blockid++;
+            eblocklen = 0;
+        }
+        
+    public:
+        shard_version_writer(std::string adjfile, std::string edatafile, size_t blocksize, bool write_adj, bool write_edata) :
+                adjf(-1), idxf(-1), edatafile(edatafile), blocksize(blocksize), write_adj(write_adj), write_edata(write_edata),
+                adjpos(0), eblocklen(0), blockid(0), nextvid(0), nedges(0), last_index_output(0) {
+            if (write_adj) {
+                adjf = open(adjfile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
+                idxf = open(filename_shard_adjidx(adjfile).c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
+                if (adjf < 0 || idxf < 0) {
+                    logstream(LOG_ERROR) << "Could not create " << adjfile << " error: " << strerror(errno) << std::endl;
+                    assert(false);
+                }
+            }
+            if (write_edata) {
+                mkdir(dirname_shard_edata_block(edatafile, blocksize).c_str(), 0777);
+                eblock.resize(blocksize);
+            }
+        }
+        
+        /* Adds the out-edges of vid; vertices must come in increasing order */
+        void add_vertex(vid_t vid, const std::vector<std::pair<vid_t, ET> > &edges) {
+            if (edges.empty()) return;
+            assert(vid >= nextvid);
+            if (write_adj) {
+                for(vid_t gap = vid - nextvid; gap > 0; ) {
+                    vid_t nz = std::min(gap, (vid_t) 255);
+                    put<uint8_t>(0);
+                    put<uint8_t>((uint8_t) (nz - 1));
+                    gap -= nz;
+                }
+                if (nedges - last_index_output >= 1024 * 1024) {
+                    shard_index sidx(vid, adjpos, nedges);
+                    writea(idxf, (char *) &sidx, sizeof(shard_index));
+                    last_index_output = nedges;
+                }
+                uint32_t count = (uint32_t) edges.size();
+                if (count < 255) {
+                    put<uint8_t>((uint8_t) count);
+                } else {
+                    put<uint8_t>(0xff);
+                    put<uint32_t>(count);
+                }
+                for(size_t i=0; i < edges.size(); i++) put<vid_t>(edges[i].first);
+            }
+            if (write_edata) {
+                for(size_t i=0; i < edges.size(); i++) {
+                    if (eblocklen + sizeof(ET) > blocksize) flush_edata();
+                    memcpy(&eblock[eblocklen], &edges[i].second, sizeof(ET));
+                    eblocklen += sizeof(ET);
+                }
+            }
+            nextvid = vid + 1;
+            nedges += edges.size();
+        }
+        
+        /* Flushes the buffers and closes the files; returns the number of edges */
+        size_t finish() {
+            if (write_adj) {
+                if (!adjbuf.empty()) writea(adjf, &adjbuf[0], adjbuf.size());
+                close(adjf);
+                close(idxf);
+            }
+            if (write_edata) {
+                flush_edata();
+                std::string sizefilename = edatafile + ".size";
+                std::ofstream ofs(sizefilename.c_str());
+                ofs << nedges * sizeof(ET);
+                ofs.close();
+            }
+            return nedges;
+        }
+    };
+    
+    /**
+     * Runs batches of compaction jobs on a background thread.
+     */
+    template <typename ET>
+    class shard_compactor {
+        size_t blocksize;
+        size_t maxshardsize;
+        std::vector<compaction_job<ET> *> jobs;
+        pthread_t thread;
+        bool running;
+        bool background;
+        volatile bool finished;
+        
+        struct by_src {
+            bool operator()(const created_edge<ET> * a, const created_edge<ET> * b) const {
+                return a->src < b->src;
+            }
+        };
+        
+        struct by_target {
+            bool operator()(const std::pair<vid_t, ET> &a, const std::pair<vid_t, ET> &b) const {
+                return a.first < b.first;
+            }
+        };
+        
+        static void * run_batch(void * arg) {
+            shard_compactor * self = (shard_compactor *) arg;
+            if (self->background && trace_recorder::get() != NULL) trace_recorder::get()->name_thread("compactor");
+            for(size_t i=0; i < self->jobs.size(); i++) {
+                self->compact(*self->jobs[i]);
+            }
+            __sync_synchronize();
+            self->finished = true;
+            return NULL;
+        }
+        
+        /**
+         * Picks the split position: the last vertex of the first part,
+         * where half of the in-edges are reached. Returns false if the
+         * shard cannot be split.
+         */
+        bool find_split(compaction_job<ET> &job, vid_t &splitpos) {
+            std::vector<size_t> indeg(job.range_en - job.range_st + 1, 0);
+            shard_adj_reader adj(job.adjfile(job.suffix));
+            vid_t vid = 0;
+            uint32_t count;
+            size_t total = 0;
+            while(adj.next_vertex(vid, count)) {
+                for(uint32_t k=0; k < count; k++) indeg[adj.next_target() - job.range_st]++;
+                total += count;
+                vid++;
+            }
+            for(size_t i=0; i < job.edges.size(); i++) indeg[job.edges[i]->dst - job.range_st]++;
+            total += job.edges.size();
+            
+            size_t cum = 0;
+            for(size_t i=0; i < indeg.size(); i++) {
+                cum += indeg[i];
+                if (cum >= total / 2) {
+                    splitpos = job.range_st + (vid_t) i;
+                    return splitpos < job.range_en;
+                }
+            }
+            return false;
+        }
+        
+        /**
+         * Merges the old shard with the buffered edges into the new
+         * version. The structure pass writes the adjacency (and the edge
+         * data, unless it is live) and decides which edges are dropped;
+         * the replay pass writes only the edge data, with the same layout.
+         */
+        void merge(compaction_job<ET> &job, bool structure) {
+            bool write_edata = !structure || !job.live_edata;
+            std::string edatasrc = job.edatafile(job.suffix);
+            if (structure && job.live_edata) edatasrc = job.snapshot;
+            shard_edata_reader<ET> * edata = (edatasrc.empty() ? NULL : new shard_edata_reader<ET>(edatasrc, blocksize));
+            
+            int nparts = (int) job.ranges.size();
+            std::vector<shard_version_writer<ET> *> writers;
+            for(int p=0; p < nparts; p++) {
+                writers.push_back(new shard_version_writer<ET>(job.adjfile(job.suffices[p]), job.edatafile(job.suffices[p]),
+                                                               blocksize, structure, write_edata));
+            }
+            std::vector<std::vector<std::pair<vid_t, ET> > > outedges(nparts);
+            std::vector<created_edge<ET> *> kept;
+            
+            shard_adj_reader adj(job.adjfile(job.suffix));
+            vid_t oldvid = 0;
+            uint32_t oldcount = 0;
+            bool more = adj.next_vertex(oldvid, oldcount);
+            size_t edgeidx = 0;
+            size_t bi = 0;
+            
+            while(more || bi < job.edges.size()) {
+                vid_t vid = (more ? oldvid : job.edges[bi]->src);
+                if (bi < job.edges.size()) vid = std::min(vid, job.edges[bi]->src);
+                
+                /* Existing edges first, then the buffered ones */
+                if (more && oldvid == vid) {
+                    for(uint32_t k=0; k < oldcount; k++, edgeidx++) {
+                        vid_t dst = adj.next_target();
+                        ET val = (edata != NULL ? edata->get(edgeidx) : ET());
+                        bool drop = false;
+                        if (structure) {
+#ifdef SUPPORT_DELETIONS
+                            drop = (edata != NULL && is_deleted_edge_value(val));
+#endif
+                            if (job.live_edata) job.dropped.push_back(drop);
+                        } else if (job.live_edata) {
+                            drop = job.dropped[edgeidx];
+                        }
+                        if (drop) continue;
+                        int p = (nparts == 2 && dst > job.ranges[0].second ? 1 : 0);
+                        outedges[p].push_back(std::pair<vid_t, ET>(dst, val));
+                    }
+                    oldvid++;
+                    more = adj.next_vertex(oldvid, oldcount);
+                }
+                for(; bi < job.edges.size() && job.edges[bi]->src == vid; bi++) {
+                    created_edge<ET> * e = job.edges[bi];
+#ifdef SUPPORT_DELETIONS
+                    if (structure && !job.live_edata && is_deleted_edge_value(e->data)) continue;
+#endif
+                    if (structure) kept.push_back(e);
+                    int p = (nparts == 2 && e->dst > job.ranges[0].second ? 1 : 0);
+                    outedges[p].push_back(std::pair<vid_t, ET>(e->dst, e->data));
+                }
+                
+                for(int p=0; p < nparts; p++) {
+                    std::stable_sort(outedges[p].begin(), outedges[p].end(), by_target());
+                    writers[p]->add_vertex(vid, outedges[p]);
+                    outedges[p].clear();
+                }
+            }
+            
+            if (structure) {
+                job.nold = edgeidx;
+                job.edges.swap(kept);
+                job.nwritten = 0;
+            }
+            for(int p=0; p < nparts; p++) {
+                size_t n = writers[p]->finish();
+                if (structure) job.nwritten += n;
+                delete writers[p];
+            }
+            if (edata != NULL) delete edata;
+        }
+        
+        void compact(compaction_job<ET> &job) {
+            trace_span span("compaction");
+            std::stable_sort(job.edges.begin(), job.edges.end(), by_src());
+            
+            size_t oldbytes = get_shard_edata_filesize<ET>(job.edatafile(job.suffix));
+            vid_t splitpos = 0;
+            job.ranges.clear();
+            job.suffices.clear();
+            if (oldbytes + job.edges.size() * sizeof(ET) > maxshardsize && find_split(job, splitpos)) {
+                job.ranges.push_back(std::pair<vid_t, vid_t>(job.range_st, splitpos));
+                job.ranges.push_back(std::pair<vid_t, vid_t>(splitpos + 1, job.range_en));
+                job.suffices.push_back(job.newsuffix);
+                job.suffices.push_back(job.newsuffix + ".split");
+            } else {
+                job.ranges.push_back(std::pair<vid_t, vid_t>(job.range_st, job.range_en));
+                job.suffices.push_back(job.newsuffix);
+            }
+            merge(job, true);
+            if (!job.snapshot.empty()) {
+                remove_version(job.snapshot, blocksize);
+                job.snapshot = "";
+            }
+            logstream(LOG_INFO) << "Compacted shard " << job.shard << ": " << job.nold << " old edges, "
+                << job.nwritten << " in " << job.ranges.size() << " new part(s)." << std::endl;
+        }
+        
+    public:
+        shard_compactor(size_t blocksize, size_t maxshardsize) : blocksize(blocksize), maxshardsize(maxshardsize),
+                running(false), background(false), finished(false) {}
+        
+        ~shard_compactor() {
+            discard();
+        }
+        
+        /* Removes the edge data files (and the adjacency, if given) of a shard version */
+        static void remove_version(std::string edatafile, size_t blocksize, std::string adjfile="") {
+            if (!adjfile.empty()) {
+                remove(adjfile.c_str());
+                remove(filename_shard_adjidx(adjfile).c_str());
+            }
+            std::string sizefile = edatafile + ".size";
+            if (file_exists(sizefile)) {
+                size_t sz = get_shard_edata_filesize<ET>(edatafile);
+                for(int b=0; (size_t) b * blocksize < sz; b++) {
+                    remove(filename_shard_edata_block(edatafile, b, blocksize).c_str());
+                }
+                remove(sizefile.c_str());
+            }
+            remove(dirname_shard_edata_block(edatafile, blocksize).c_str());
+        }
+        
+        /**
+         * Starts a batch. The compactor owns the jobs until release().
+         * @param background if false, runs the batch on the calling thread
+         */
+        void start(const std::vector<compaction_job<ET> *> &batch, bool background) {
+            assert(!running && jobs.empty());
+            jobs = batch;
+            finished = false;
+            running = true;
+            this->background = background;
+            if (background) {
+                int ret = pthread_create(&thread, NULL, run_batch, (void *) this);
+                assert(ret == 0);
+            } else {
+                run_batch(this);
+                running = false;
+            }
+        }
+        
+        /* True if a batch has been started and not released */
+        bool busy() const {
+            return !jobs.empty();
+        }
+        
+        bool done() const {
+            return finished;
+        }
+        
+        /* Waits for the batch to finish and returns its jobs */
+        std::vector<compaction_job<ET> *> & wait() {
+            if (running) {
+                pthread_join(thread, NULL);
+                running = false;
+            }
+            return jobs;
+        }
+        
+        /* Writes the current edge values into the new version of a job */
+        void replay(compaction_job<ET> &job) {
+            assert(job.live_edata && finished);
+            merge(job, false);
+        }
+        
+        /* Deletes the jobs of a swapped-in batch */
+        void release() {
+            wait();
+            for(size_t i=0; i < jobs.size(); i++) delete jobs[i];
+            jobs.clear();
+        }
+        
+        /* Waits for the batch and deletes its new versions */
+        void discard() {
+            wait();
+            for(size_t i=0; i < jobs.size(); i++) {
+                compaction_job<ET> &job = *jobs[i];
+                for(size_t p=0; p < job.suffices.size(); p++) {
+                    remove_version(job.edatafile(job.suffices[p]), blocksize, job.adjfile(job.suffices[p]));
+                }
+            }
+            release();
+        }
+    };
+    
+}
+
+#endif
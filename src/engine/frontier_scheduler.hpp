@@ -0,0 +1,266 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Hybrid sparse/dense frontier scheduler. Same semantics as new_scheduler,
+ * but while a frontier is small it is also kept as a list of vertex ids, so
+ * that clearing, counting and enumerating it costs O(|frontier|) instead
+ * of O(|V|). Once a frontier grows past the density threshold, the list is
+ * abandoned and the bitset alone is used (counted with popcount).
+ * The bitsets stay authoritative for is_scheduled() in both modes.
+ */
+
+#ifndef DEF_GRAPHCHI_FRONTIERSCHEDULER
+#define DEF_GRAPHCHI_FRONTIERSCHEDULER
+
+#include <vector>
+#include <algorithm>
+
+#include "graphchi_types.hpp"
+#include "api/ischeduler.hpp"
+#include "util/dense_bitset.hpp"
+
+namespace graphchi {
+
+    /**
+     * Vertex id list that threads append to by reserving a slot with
+     * an atomic increment. Overflowing the capacity turns the list dense,
+     * after which only the count is maintained.
+     */
+    struct frontier_list {
+        std::vector<vid_t> ids;
+        size_t count;       // number of distinct ids added (may exceed ids.size())
+        size_t nsorted;     // ids[0..nsorted) is sorted
+        bool dense;
+
+        frontier_list() : count(0), nsorted(0), dense(false) {}
+
+        inline void append(vid_t v) {
+            size_t idx = __sync_fetch_and_add(&count, (size_t)1);
+            if (idx < ids.size()) {
+                ids[idx] = v;
+            } else {
+                dense = true;
+            }
+        }
+
+        inline size_t listed() const {
+            return std::min(count, ids.size());
+        }
+    };
+
+    class frontier_scheduler : public ischeduler {
+    private:
+        dense_bitset * curiteration_bitset;
+        dense_bitset * nextiteration_bitset;
+        frontier_list * cur;
+        frontier_list * next;
+
+    public:
+        bool has_new_tasks;
+
+        /**
+         * Iterates the scheduled vertices of the current iteration
+         * in a vertex range, in ascending order.
+         */
+        class iterator {
+            const frontier_scheduler * sched;
+            vid_t en;
+            uint32_t bit;
+            bool started;
+            size_t pos;
+
+        public:
+            iterator(const frontier_scheduler * sched, vid_t st, vid_t en) : sched(sched), en(en), bit(st), started(false), pos(0) {
+                if (sched != NULL && !sched->cur->dense) {
+                    const std::vector<vid_t> &ids = sched->cur->ids;
+                    pos = std::lower_bound(ids.begin(), ids.begin() + sched->cur->nsorted, st) - ids.begin();
+                }
+            }
+
+            /* Returns false when the range is exhausted */
+            inline bool next(vid_t &v) {
+                if (!sched->cur->dense) {
+                    if (pos >= sched->cur->nsorted || sched->cur->ids[pos] > en) return false;
+                    v = sched->cur->ids[pos++];
+                    return true;
+                }
+                if (started) {
+                    if (bit >= en) return false;
+                    bit++;
+                }
+                started = true;
+                if (!sched->curiteration_bitset->next_set_bit(bit) || bit > en) return false;
+                v = bit;
+                return true;
+            }
+        };
+
+        /**
+         * @param nvertices number of vertices
+         * @param sparse_density fraction of vertices up to which a frontier
+         *        is kept as a list
+         */
+        frontier_scheduler(int nvertices, double sparse_density=0.02) {
+            curiteration_bitset = new dense_bitset(nvertices);
+            nextiteration_bitset = new dense_bitset(nvertices);
+            cur = new frontier_list();
+            next = new frontier_list();
+            size_t capacity = (size_t) (sparse_density * nvertices);
+            cur->ids.resize(capacity);
+            next->ids.resize(capacity);
+            has_new_tasks = false;
+        }
+
+        virtual ~frontier_scheduler() {
+            delete nextiteration_bitset;
+            delete curiteration_bitset;
+            delete cur;
+            delete next;
+        }
+
+        void new_iteration(int iteration) {
+            if (iteration > 0) {
+                /* The old current frontier becomes the next one; clear it */
+                if (cur->dense) {
+                    curiteration_bitset->clear();
+                } else {
+                    size_t n = cur->listed();
+                    for(size_t i=0; i < n; i++) curiteration_bitset->clear_bit(cur->ids[i]);
+                }
+                std::swap(curiteration_bitset, nextiteration_bitset);
+                std::swap(cur, next);
+                next->count = next->nsorted = 0;
+                next->dense = false;
+
+                if (!cur->dense) {
+                    /* remove_tasks() may have cleared listed bits, so the bitset decides */
+                    size_t n = cur->listed();
+                    size_t j = 0;
+                    for(size_t i=0; i < n; i++) {
+                        if (curiteration_bitset->get(cur->ids[i])) cur->ids[j++] = cur->ids[i];
+                    }
+                    std::sort(cur->ids.begin(), cur->ids.begin() + j);
+                    cur->count = cur->nsorted = j;
+                }
+            }
+        }
+
+        inline void add_task(vid_t vertex, bool also_this_iteration=false) {
+            if (also_this_iteration) {
+                // If possible, add to schedule already this iteration
+                if (!curiteration_bitset->set_bit(vertex)) cur->append(vertex);
+            } else {
+                if (!nextiteration_bitset->set_bit(vertex)) next->append(vertex);
+                has_new_tasks = true;
+            }
+        }
+
+        virtual void resize(vid_t maxsize) {
+            curiteration_bitset->resize(maxsize);
+            nextiteration_bitset->resize(maxsize);
+            /* The lists may be concurrently appended to, so do not reallocate them */
+            cur->dense = next->dense = true;
+        }
+
+        inline bool is_scheduled(vid_t vertex) {
+            return curiteration_bitset->get(vertex);
+        }
+
+        void remove_tasks(vid_t fromvertex, vid_t tovertex) {
+            nextiteration_bitset->clear_bits(fromvertex, tovertex);
+        }
+
+        void add_task_to_all() {
+            has_new_tasks = true;
+            curiteration_bitset->setall();
+            cur->dense = true;
+        }
+
+        /**
+         * Merges tasks added with also_this_iteration into the sorted list.
+         * Must not run concurrently with add_task(); the engine calls the
+         * range queries only between update phases.
+         */
+        void sort_current() {
+            if (cur->dense || cur->nsorted == cur->count) return;
+            std::vector<vid_t>::iterator mid = cur->ids.begin() + cur->nsorted;
+            std::vector<vid_t>::iterator end = cur->ids.begin() + cur->count;
+            std::sort(mid, end);
+            std::inplace_merge(cur->ids.begin(), mid, end);
+            cur->nsorted = cur->count;
+        }
+
+        bool is_sparse() const {
+            return !cur->dense;
+        }
+
+        iterator scheduled(vid_t st, vid_t en) {
+            sort_current();
+            return iterator(this, st, en);
+        }
+
+        bool any_scheduled(vid_t st, vid_t en) {
+            if (cur->dense) return curiteration_bitset->any_in_range(st, en);
+            vid_t v;
+            return scheduled(st, en).next(v);
+        }
+
+        /**
+         * Finds the first scheduled vertex in st..en.
+         * Returns false if there is none.
+         */
+        bool first_scheduled(vid_t st, vid_t en, vid_t &v) {
+            return scheduled(st, en).next(v);
+        }
+
+        size_t num_scheduled(vid_t st, vid_t en) {
+            if (cur->dense) return curiteration_bitset->count_in_range(st, en);
+            sort_current();
+            std::vector<vid_t>::iterator begin = cur->ids.begin(), end = cur->ids.begin() + cur->nsorted;
+            return std::upper_bound(begin, end, en) - std::lower_bound(begin, end, st);
+        }
+
+        size_t num_tasks() {
+            if (!cur->dense) return cur->count;
+            return curiteration_bitset->popcount();
+        }
+
+        /* Number of tasks for the next iteration */
+        size_t num_next_tasks() {
+            if (!next->dense) {
+                // Bits cleared by remove_tasks() are still listed
+                size_t n = 0;
+                for(size_t i=0; i < next->count; i++) n += nextiteration_bitset->get(next->ids[i]);
+                return n;
+            }
+            return nextiteration_bitset->popcount();
+        }
+
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,295 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Edge-centric scatter/gather engine over the GraphChi shards.
+ *
+ * The vertex-centric engine builds a vertex object with a pointer for
+ * every in- and out-edge of the interval before it runs any update.
+ * For programs that only need one pass over the edges (PageRank,
+ * connected components, BFS levels) this engine skips that: each
+ * iteration visits the intervals in order, and for interval p
+ *
+ *  1. scatter: streams shard p (the in-edges of the interval, sorted by
+ *     source) and calls the program's scatter() for each edge with the
+ *     value and degree of the source. The source values are read through
+ *     a small window per thread that moves forward with the sources of
+ *     the piece the thread streams. The updates go to per-thread buffers
+ *     bucketed by destination.
+ *  2. gather: loads the vertex values of the interval, folds the updates
+ *     of each bucket into them in parallel (one thread per bucket, so no
+ *     locks), calls apply() for every vertex and saves the values.
+ *
+ * Like the vertex-centric engine, the values of the intervals already
+ * processed in an iteration are visible to the later ones. Edge values
+ * are read-only. The iterations stop early if no edge carried an update.
+ */
+
+#ifndef DEF_GRAPHCHI_EDGECENTRIC_ENGINE
+#define DEF_GRAPHCHI_EDGECENTRIC_ENGINE
+
+#include <assert.h>
+#include <omp.h>
+#include <string>
+#include <vector>
+
+#include "api/edgecentric_program.hpp"
+#include "engine/graphchi_engine.hpp"
+#include "logger/logger.hpp"
+
+namespace graphchi {
+
+    template <typename Program>
+    class graphchi_edgecentric_engine : public graphchi_engine<typename Program::VertexDataType, typename Program::EdgeDataType> {
+    public:
+        typedef typename Program::VertexDataType VertexDataType;
+        typedef typename Program::EdgeDataType EdgeDataType;
+        typedef typename Program::UpdateType UpdateType;
+        typedef graphchi_engine<VertexDataType, EdgeDataType> base_engine;
+        typedef typename base_engine::memshard_t memshard_t;
+
+    protected:
+        struct vertex_update {
+            vid_t dst;
+            UpdateType value;
+            vertex_update(vid_t dst, const UpdateType &value) : dst(dst), value(value) {}
+        };
+
+        /* Values and degrees of sources [st, en) of one thread */
+        struct source_window {
+            vid_t st;
+            vid_t en;
+            std::vector<VertexDataType> values;
+            std::vector<degree> degrees;
+        };
+
+        /* Visitor for memory_shard::stream_edges() */
+        struct scatter_visitor {
+            graphchi_edgecentric_engine * engine;
+            Program * program;
+            vid_t interval_st;
+
+            inline void operator() (vid_t src, vid_t dst, EdgeDataType * edata) {
+                int t = omp_get_thread_num();
+                source_window &w = engine->windows[t];
+                if (src < w.st || src >= w.en) engine->load_window(w, src);
+                UpdateType update = UpdateType();
+                if (program->scatter(src, w.values[src - w.st], w.degrees[src - w.st], dst, edata, update, engine->chicontext)) {
+                    engine->buffers[t][(dst - interval_st) >> engine->bucket_shift].push_back(vertex_update(dst, update));
+                }
+            }
+        };
+
+        int nthreads;
+        vid_t window_size;
+        int vertexdata_session;
+        int degree_session;
+        std::vector<source_window> windows;
+        std::vector<std::vector<std::vector<vertex_update> > > buffers;  // thread, bucket
+        int nbuckets;
+        int bucket_shift;
+        metrics_handle scatter_timer;
+        metrics_handle gather_timer;
+
+        void load_window(source_window &w, vid_t src) {
+            w.st = src;
+            w.en = (vid_t) std::min((size_t) src + window_size, this->num_vertices());
+            size_t n = w.en - w.st;
+            w.values.resize(n);
+            w.degrees.resize(n);
+            this->iomgr->preada_now(vertexdata_session, &w.values[0], n * sizeof(VertexDataType), w.st * sizeof(VertexDataType), true);
+            this->iomgr->preada_now(degree_session, &w.degrees[0], n * sizeof(degree), w.st * sizeof(degree), true);
+        }
+
+        /* Buckets of about 4096 vertices, at most 1024 of them */
+        void init_buckets(vid_t interval_st, vid_t interval_en) {
+            size_t len = interval_en - interval_st + 1;
+            bucket_shift = 12;
+            while ((len >> bucket_shift) >= 1024) bucket_shift++;
+            nbuckets = (int) ((len - 1) >> bucket_shift) + 1;
+            for(int t=0; t < nthreads; t++) {
+                buffers[t].resize(nbuckets);
+                for(int b=0; b < nbuckets; b++) buffers[t][b].clear();
+                windows[t].st = windows[t].en = 0;
+            }
+        }
+
+        void initialize_vertices(Program &program) {
+            for(int p=0; p < this->nshards; p++) {
+                vid_t st = this->get_interval_start(p);
+                vid_t en = this->get_interval_end(p);
+                if (st > en) continue;
+                this->vertex_data_handler->load(st, en);
+#pragma omp parallel for
+                for(int i=0; i <= (int) (en - st); i++) {
+                    program.init(st + i, *this->vertex_data_handler->vertex_data_ptr(st + i));
+                }
+                this->vertex_data_handler->save();
+            }
+        }
+
+        size_t scatter(Program &program, vid_t interval_st, vid_t interval_en) {
+            memshard_t * shard = this->create_memshard(interval_st, interval_en);
+            shard->only_adjacency = this->only_adjacency;
+            shard->load();
+            this->iomgr->wait_for_reads();
+
+            scatter_visitor visitor;
+            visitor.engine = this;
+            visitor.program = &program;
+            visitor.interval_st = interval_st;
+            shard->stream_edges(visitor);
+
+            shard->commit(false, false);
+            delete shard;
+
+            size_t nupdates = 0;
+            for(int t=0; t < nthreads; t++) {
+                for(int b=0; b < nbuckets; b++) nupdates += buffers[t][b].size();
+            }
+            return nupdates;
+        }
+
+        void gather(Program &program, vid_t interval_st, vid_t interval_en) {
+            this->vertex_data_handler->load(interval_st, interval_en);
+#pragma omp parallel for schedule(dynamic, 1)
+            for(int b=0; b < nbuckets; b++) {
+                for(int t=0; t < nthreads; t++) {
+                    std::vector<vertex_update> &buf = buffers[t][b];
+                    for(size_t i=0; i < buf.size(); i++) {
+                        program.gather(buf[i].dst, *this->vertex_data_handler->vertex_data_ptr(buf[i].dst), buf[i].value, this->chicontext);
+                    }
+                }
+            }
+#pragma omp parallel for
+            for(int i=0; i <= (int) (interval_en - interval_st); i++) {
+                program.apply(interval_st + i, *this->vertex_data_handler->vertex_data_ptr(interval_st + i), this->chicontext);
+            }
+            this->vertex_data_handler->save();
+        }
+
+    public:
+
+        /**
+         * @param base_filename prefix of the graph files
+         * @param nshards number of shards
+         */
+        graphchi_edgecentric_engine(std::string base_filename, int nshards, metrics &_m) :
+                base_engine(base_filename, nshards, false, _m) {
+            window_size = (vid_t) get_option_int("edgecentric_window", 65536);
+            _m.set("engine", "edgecentric");
+            scatter_timer = _m.register_timer("edgecentric_scatter");
+            gather_timer = _m.register_timer("edgecentric_gather");
+        }
+
+        /**
+         * Run the edge-centric program.
+         * @param niters number of iterations
+         */
+        void run(Program &program, int niters) {
+            metrics &m = this->m;
+            m.start_time("runtime");
+            this->niters = niters;
+            if (this->vertex_data_handler == NULL)
+                this->vertex_data_handler = new vertex_data_store<VertexDataType>(this->base_filename, this->num_vertices(), this->iomgr);
+            this->initialize_before_run();
+
+            nthreads = omp_get_max_threads();
+            windows.resize(nthreads);
+            buffers.resize(nthreads);
+            vertexdata_session = this->iomgr->open_session(filename_vertex_data<VertexDataType>(this->base_filename), true);
+            degree_session = this->iomgr->open_session(filename_degree_data(this->base_filename), true);
+
+            size_t nedges = 0;
+            if (!this->only_adjacency) {
+                for(int p=0; p < this->nshards; p++) {
+                    nedges += get_shard_edata_filesize<EdgeDataType>(filename_shard_edata<EdgeDataType>(this->base_filename, p, this->nshards)) / sizeof(EdgeDataType);
+                }
+            }
+
+            if (trace_recorder::get() != NULL) trace_recorder::get()->name_thread("engine");
+            logstream(LOG_INFO) << "GraphChi edge-centric engine starting, " << nthreads << " threads, "
+                << "source window " << window_size << " vertices." << std::endl;
+
+            this->chicontext.filename = this->base_filename;
+            this->chicontext.num_iterations = niters;
+            this->chicontext.nvertices = this->num_vertices();
+            this->chicontext.nedges = nedges;
+            this->chicontext.execthreads = nthreads;
+            this->chicontext.last_iteration = -1;
+
+            initialize_vertices(program);
+
+            for(this->iter=0; this->iter < niters; this->iter++) {
+                int iter = this->iter;
+                logstream(LOG_INFO) << "Start iteration: " << iter << std::endl;
+                this->chicontext.iteration = iter;
+                this->chicontext.reset_deltas(nthreads);
+                this->chicontext.start_aggregators();
+                program.before_iteration(iter, this->chicontext);
+
+                size_t nupdates = 0;
+                for(int p=0; p < this->nshards; p++) {
+                    vid_t interval_st = this->get_interval_start(p);
+                    vid_t interval_en = this->get_interval_end(p);
+                    if (interval_st > interval_en) continue;
+                    this->exec_interval = p;
+                    this->chicontext.interval_st = interval_st;
+                    this->chicontext.interval_en = interval_en;
+                    this->chicontext.exec_interval = p;
+
+                    init_buckets(interval_st, interval_en);
+                    uint64_t started = m.start_timer();
+                    size_t n = scatter(program, interval_st, interval_en);
+                    m.stop_timer(scatter_timer, started, interval_st, interval_en);
+                    started = m.start_timer();
+                    gather(program, interval_st, interval_en);
+                    m.stop_timer(gather_timer, started, interval_st, interval_en);
+                    logstream(LOG_INFO) << this->chicontext.runtime() << "s: interval " << interval_st << " -- "
+                        << interval_en << ", " << n << " updates" << std::endl;
+                    nupdates += n;
+                }
+                this->nupdates += nupdates;
+
+                this->chicontext.reduce_aggregators();
+                program.after_iteration(iter, this->chicontext);
+                if (nupdates == 0) {
+                    logstream(LOG_INFO) << "No updates were scattered, stop." << std::endl;
+                    this->chicontext.set_last_iteration(iter);
+                    break;
+                }
+            }
+
+            this->iomgr->close_session(vertexdata_session);
+            this->iomgr->close_session(degree_session);
+            m.stop_time("runtime");
+            m.set("updates", this->nupdates);
+            m.set("iterations", (size_t) this->iter);
+            if (trace_recorder::get() != NULL) trace_recorder::get()->write();
+        }
+    };
+
+}
+
+#endif
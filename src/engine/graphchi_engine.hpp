@@ -45,11 +45,14 @@
 #include "api/graph_objects.hpp"
 #include "api/graphchi_context.hpp"
 #include "api/graphchi_program.hpp"
+#include "api/iteration_aggregator.hpp"
 #include "engine/auxdata/degree_data.hpp"
 #include "engine/auxdata/vertex_data.hpp"
 #include "engine/bitset_scheduler.hpp"
 
 #include "engine/new_scheduler.hpp"
+#include "engine/frontier_scheduler.hpp"
+#include "engine/bucket_scheduler.hpp"
 
 #include "io/stripedio.hpp"
 #include "logger/logger.hpp"
@@ -91,7 +94,7 @@ namespace graphchi {
        	///////////////////////////////////////////////// 
         /* Scheduler */
         //bitset_scheduler * scheduler;
-        new_scheduler * scheduler;
+        frontier_scheduler * scheduler;
         
         /* Configuration */
         bool modifies_outedges;
@@ -105,6 +108,7 @@ namespace graphchi {
 
         bool randomization;
         bool initialize_edges_before_run;
+        double bucket_width;
         
         size_t blocksize;
         int membudget_mb;
@@ -131,6 +135,10 @@ namespace graphchi {
         
         /* Metrics */
         metrics &m;
+        metrics_handle exec_updates_timer;
+        metrics_handle interval_timer;
+        metrics_handle subinterval_timer;
+        metrics_handle load_timer;
         
         void print_config() {
             logstream(LOG_INFO) << "Engine configuration: " << std::endl;
@@ -139,6 +147,8 @@ namespace graphchi {
             logstream(LOG_INFO) << " membudget_mb = " << membudget_mb << std::endl;
             logstream(LOG_INFO) << " blocksize = " << blocksize << std::endl;
             logstream(LOG_INFO) << " scheduler = " << use_selective_scheduling << std::endl;
+            if (use_selective_scheduling && bucket_width > 0)
+                logstream(LOG_INFO) << " bucket_width = " << bucket_width << std::endl;
         }
         
     public:
@@ -150,6 +160,8 @@ namespace graphchi {
          * @param selective_scheduling if true, uses selective scheduling 
          */
         graphchi_engine(std::string _base_filename, int _nshards, bool _selective_scheduling, metrics &_m) : base_filename(_base_filename), nshards(_nshards), use_selective_scheduling(_selective_scheduling), m(_m) {
+            trace_recorder::enable(get_option_string("trace", ""));
+            
             /* Initialize IO */
             m.start_time("iomgr_init");
             iomgr = new stripedio(m);
@@ -200,7 +212,12 @@ namespace graphchi {
             enable_deterministic_parallelism = true;
             load_threads = get_option_int("loadthreads", 2);
             exec_threads = get_option_int("execthreads", omp_get_max_threads());
+            bucket_width = get_option_float("bucket_width", 0.0f);
             maxwindow = 40000000;
+            exec_updates_timer = m.register_timer("execute-updates");
+            interval_timer = m.register_timer("interval");
+            subinterval_timer = m.register_timer("subinterval");
+            load_timer = m.register_timer("load_before_updates");
 
             /* Load graph shard interval information */
             _load_vertex_intervals();
@@ -292,7 +309,11 @@ namespace graphchi {
                 if (scheduler != NULL) delete scheduler;
 				/////////////////////////////////////////////
                 //scheduler = new bitset_scheduler((int) num_vertices());
-                scheduler = new new_scheduler((int) num_vertices());
+                if (bucket_width > 0) {
+                    scheduler = new bucket_scheduler((int) num_vertices(), bucket_width, get_option_float("frontier_density", 0.02f));
+                } else {
+                    scheduler = new frontier_scheduler((int) num_vertices(), get_option_float("frontier_density", 0.02f));
+                }
                 scheduler->add_task_to_all();
             } else {
                 scheduler = NULL;
@@ -318,6 +339,26 @@ namespace graphchi {
             /* If is in-memory-mode, memory budget is not considered. */
             if (is_inmemory_mode() || svertex_t().computational_edges()) {
                 return maxvid;
+            } else if (scheduler != NULL) {
+                /* Only scheduled vertices get their edges loaded */
+                const size_t vertex_cost = sizeof(svertex_t);
+                size_t edgemem = 0;
+                frontier_scheduler::iterator it = scheduler->scheduled(fromvid, maxvid);
+                vid_t v;
+                while(it.next(v)) {
+                    degree deg = degree_handler->get_degree(v);
+                    int inc = deg.indegree;
+                    int outc = deg.outdegree * (!disable_outedges);
+                    size_t vmem = (sizeof(EdgeDataType) + sizeof(vid_t) + sizeof(graphchi_edge<EdgeDataType>))*(outc + inc);
+                    if (vertex_cost * (v - fromvid + 1) + edgemem + vmem > membudget) {
+                        logstream(LOG_DEBUG) << "Memory budget exceeded at vertex " << v << std::endl;
+                        size_t nfit = (edgemem >= membudget ? 0 : (membudget - edgemem) / vertex_cost);
+                        return fromvid + (vid_t) std::max(size_t(1), std::min(nfit, size_t(v - fromvid))) - 1;
+                    }
+                    edgemem += vmem;
+                }
+                size_t nfit = (edgemem >= membudget ? 0 : (membudget - edgemem) / vertex_cost);
+                return fromvid + (vid_t) std::max(size_t(1), std::min(nfit, size_t(maxvid - fromvid) + 1)) - 1;
             } else {
                 size_t memreq = 0;
                 int max_interval = maxvid - fromvid;
@@ -345,12 +386,11 @@ namespace graphchi {
             size_t num_edges = 0;
             int nvertices = en - st + 1;
             if (scheduler != NULL) {
-                for(int i=0; i < nvertices; i++) {
-                    bool is_sched = scheduler->is_scheduled(st + i);
-                    if (is_sched) {
-                        degree d = degree_handler->get_degree(st + i);
-                        num_edges += d.indegree * store_inedges + d.outdegree;
-                    }
+                frontier_scheduler::iterator it = scheduler->scheduled(st, en);
+                vid_t v;
+                while(it.next(v)) {
+                    degree d = degree_handler->get_degree(v);
+                    num_edges += d.indegree * store_inedges + d.outdegree;
                 }
             } else {
                 for(int i=0; i < nvertices; i++) {
@@ -404,7 +444,7 @@ namespace graphchi {
         
         virtual void exec_updates(GraphChiProgram<VertexDataType, EdgeDataType, svertex_t> &userprogram,
                           std::vector<svertex_t> &vertices) {
-            metrics_entry me = m.start_time();
+            uint64_t me = m.start_timer();
             size_t nvertices = vertices.size();
             if (!enable_deterministic_parallelism) {
                 for(int i=0; i < (int)nvertices; i++) vertices[i].parallel_safe = true;
@@ -459,7 +499,7 @@ namespace graphchi {
                 }
             } while (userprogram.repeat_updates(chicontext));
             
-            m.stop_time(me, "execute-updates");
+            m.stop_timer(exec_updates_timer, me);
         }
         
 
@@ -478,8 +518,12 @@ namespace graphchi {
             for(iter=0; iter<niters; iter++) {
                 logstream(LOG_INFO) << "In-memory mode: Iteration " << iter << " starts. (" << chicontext.runtime() << " secs)" << std::endl;
                 chicontext.iteration = iter;
-                if (iter > 0) // First one run before -- ugly
+                if (iter > 0) { // First one run before -- ugly
+                    chicontext.start_aggregators();
+                    chicontext.start_messages(intervals);
+                    chicontext.deliver_messages(0, (vid_t) num_vertices() - 1);
                     userprogram.before_iteration(iter, chicontext);
+                }
                 userprogram.before_exec_interval(0, (int)num_vertices(), chicontext);
                 
                 if (use_selective_scheduling) {
@@ -488,6 +532,7 @@ namespace graphchi {
                         niters = iter;
                         break;
                     }
+                    scheduler->has_new_tasks = false; // Kind of misleading since scheduler may still have tasks - but no new tasks.
                     scheduler->new_iteration(iter);
                     
                     bool newtasks = false;
@@ -507,7 +552,6 @@ namespace graphchi {
                         break;
 
                     }
-                    scheduler->has_new_tasks = false; // Kind of misleading since scheduler may still have tasks - but no new tasks.
                 } else {
                     nupdates += num_vertices();
                     if (!only_adjacency) {
@@ -523,6 +567,7 @@ namespace graphchi {
                 
                 load_after_updates(vertices);
                 
+                chicontext.reduce_aggregators();
                 userprogram.after_exec_interval(0, (int)num_vertices(), chicontext);
                 userprogram.after_iteration(iter, chicontext);
                 if (chicontext.last_iteration > 0 && chicontext.last_iteration <= iter){
@@ -548,6 +593,15 @@ namespace graphchi {
             /* Allocate edge buffer */
             edata = (graphchi_edge<EdgeDataType>*) malloc(num_edges * sizeof(graphchi_edge<EdgeDataType>));
             
+            /* Scheduled vertices are visited in ascending order, in step with i */
+            vid_t next_sched = 0;
+            bool has_sched = false;
+            frontier_scheduler::iterator sched_it(NULL, 0, 0);
+            if (scheduler != NULL) {
+                sched_it = scheduler->scheduled(sub_interval_st, sub_interval_en);
+                has_sched = sched_it.next(next_sched);
+            }
+            
             /* Assign vertex edge array pointers */
             size_t ecounter = 0;
             for(int i=0; i < (int)nvertices; i++) {
@@ -563,8 +617,9 @@ namespace graphchi {
                 }
                 
                 if (scheduler != NULL) {
-                    bool is_sched = ( scheduler->is_scheduled(sub_interval_st + i));
+                    bool is_sched = (has_sched && next_sched == sub_interval_st + i);
                     if (is_sched) {
+                        has_sched = sched_it.next(next_sched);
                         vertices[i].scheduled =  true;
                         nupdates++;
                         ecounter += inc * store_inedges + outc;
@@ -681,12 +736,7 @@ namespace graphchi {
         // TODO: support for a minimum fraction of scheduled vertices
         bool is_any_vertex_scheduled(vid_t st, vid_t en) {
             if (scheduler == NULL) return true;
-            for(vid_t v=st; v<=en; v++) {
-                if (scheduler->is_scheduled(v)) {
-                    return true;
-                }
-            }
-            return false;
+            return scheduler->any_scheduled(st, en);
         }
         
         virtual void initialize_iter() {
@@ -752,6 +802,7 @@ namespace graphchi {
             niters = _niters;
 			//std::cout<<"niters ="<<niters<<std::endl;
             logstream(LOG_INFO) << "GraphChi starting" << std::endl;
+            if (trace_recorder::get() != NULL) trace_recorder::get()->name_thread("engine");
             logstream(LOG_INFO) << "Licensed under the Apache License 2.0" << std::endl;
             logstream(LOG_INFO) << "Copyright Aapo Kyrola et al., Carnegie Mellon University (2012)" << std::endl;
             
@@ -811,6 +862,8 @@ namespace graphchi {
                 chicontext.reset_deltas(exec_threads);
                 
                 /* Call iteration-begin event handler */
+                chicontext.start_aggregators();
+                chicontext.start_messages(intervals);
                 userprogram.before_iteration(iter, chicontext);
                 
                 /* Check scheduler. If no scheduled tasks, terminate. */
@@ -859,6 +912,9 @@ namespace graphchi {
                     vid_t interval_en = get_interval_end(exec_interval);
                     
                     if (interval_st > interval_en) continue; // Can happen on very very small graphs.
+                    uint64_t interval_started = m.start_timer();
+
+                    chicontext.deliver_messages(interval_st, interval_en);
 
                     if (!is_inmemory_mode())
                        userprogram.before_exec_interval(interval_st, interval_en, chicontext);
@@ -880,6 +936,18 @@ namespace graphchi {
                     while (sub_interval_st <= interval_en) {
                         
                         modification_lock.lock();
+                        
+                        /* Jump directly to the next scheduled vertex */
+                        if (scheduler != NULL && !is_inmemory_mode()) {
+                            vid_t first_scheduled;
+                            if (!scheduler->first_scheduled(sub_interval_st, interval_en, first_scheduled)) {
+                                logstream(LOG_INFO) << "No vertices scheduled in " << sub_interval_st << " - " << interval_en << ", skip." << std::endl;
+                                modification_lock.unlock();
+                                break;
+                            }
+                            sub_interval_st = first_scheduled;
+                        }
+                        
                         /* Determine the sub interval */
                         sub_interval_en = determine_next_window(exec_interval,
                                                                 sub_interval_st, 
@@ -904,6 +972,7 @@ namespace graphchi {
                         }
                         
                         /* Initialize vertices */
+                        uint64_t subinterval_started = m.start_timer();
                         int nvertices = sub_interval_en - sub_interval_st + 1;
                         graphchi_edge<EdgeDataType> * edata = NULL;
                         
@@ -913,7 +982,9 @@ namespace graphchi {
                         init_vertices(vertices, edata);
                         
                         /* Load data */
+                        uint64_t load_started = m.start_timer();
                         load_before_updates(vertices);                        
+                        m.stop_timer(load_timer, load_started, sub_interval_st, sub_interval_en);
                         
                         modification_lock.unlock();
                         
@@ -933,6 +1004,7 @@ namespace graphchi {
                         if (!disable_vertexdata_storage) {
                             save_vertices(vertices);
                         }
+                        m.stop_timer(subinterval_timer, subinterval_started, sub_interval_st, sub_interval_en);
                         sub_interval_st = sub_interval_en + 1;
                         
                         /* Delete edge buffer. TODO: reuse. */
@@ -953,13 +1025,18 @@ namespace graphchi {
                         delete memoryshard;
                         memoryshard = NULL;
                     }     
-                    if (!is_inmemory_mode())
+                    if (!is_inmemory_mode()) {
+                        chicontext.reduce_aggregators();
                         userprogram.after_exec_interval(interval_st, interval_en, chicontext);
+                    }
+                    m.stop_timer(interval_timer, interval_started, interval_st, interval_en);
 
                 } // For exec_interval
                 
-                if (!is_inmemory_mode())  // Run sepately
+                if (!is_inmemory_mode()) { // Run sepately
+                    chicontext.reduce_aggregators();
                     userprogram.after_iteration(iter, chicontext);
+                }
                 
                 /* Move the sliding shard of the current interval to correct position and flush
                  writes of all shards for next iteration. */
@@ -981,6 +1058,7 @@ namespace graphchi {
                 iomgr->first_pass_finished(); // Tell IO-manager that we have passed over the graph (used for optimization)
             } // Iterations
             
+            run_finished();
             m.stop_time("runtime");
             
             m.set("updates", nupdates);
@@ -1020,12 +1098,18 @@ namespace graphchi {
 				scheduler = NULL;
 				chicontext.scheduler = NULL;
 			}
+            if (trace_recorder::get() != NULL) trace_recorder::get()->write();
         }
         
         virtual void iteration_finished() {
             // Do nothing
         }
         
+        /* Called after the last iteration, before the run is wrapped up */
+        virtual void run_finished() {
+            // Do nothing
+        }
+        
         stripedio * get_iomanager() {
             return iomgr;
         }
@@ -1068,6 +1152,16 @@ namespace graphchi {
             return membudget_mb;
         }
         
+        /**
+         * With selective scheduling, runs tasks by priority in buckets of
+         * the given width (delta-stepping). Programs schedule with
+         * add_task_priority(vid, priority). Zero (default) disables the buckets.
+         * Can also be set with command-line option 'bucket_width'.
+         */
+        void set_bucket_width(double width) {
+            bucket_width = width;
+        }
+        
         void set_load_threads(int lt) {
             load_threads = lt;
         }
@@ -1117,6 +1211,23 @@ namespace graphchi {
             return (outputs.size() - 1);
         }
          
+        /**
+         * Registers an aggregator. It is reset before every iteration and
+         * reduced after every interval; the engine does not take ownership.
+         */
+        void add_aggregator(iaggregator * aggregator) {
+            chicontext.add_aggregator(aggregator);
+        }
+        
+        /**
+         * Registers a message store. Messages sent during an iteration are
+         * delivered to the intervals of the next one; the engine does not
+         * take ownership.
+         */
+        void add_message_store(imessage_store * store) {
+            chicontext.add_message_store(store);
+        }
+        
         ioutput<VertexDataType, EdgeDataType> * output(size_t idx) {
             if (idx >= outputs.size()) {
                 logstream(LOG_FATAL) << "Tried to get output with index " << idx << ", but only " << outputs.size() << " outputs were initialized!" << std::endl;
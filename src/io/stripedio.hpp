@@ -42,6 +42,7 @@
 #include <sys/mman.h>
 
 
+#include <sstream>
 #include <vector>
 
 #include "logger/logger.hpp"
@@ -118,6 +119,9 @@ namespace graphchi {
         
         bool running;
         metrics * m;
+        metrics_handle commit_timer;
+        metrics_handle read_timer;
+        int id;
         volatile int pending_writes;
         volatile int pending_reads;
         int mplex;
@@ -238,6 +242,10 @@ namespace graphchi {
         std::vector< pthread_t > threads;
         std::vector< thrinfo * > thread_infos;
         metrics &m;        
+        metrics_handle preada_now_timer;
+        metrics_handle pwritea_now_timer;
+        metrics_handle wait_for_reads_timer;
+        metrics_handle wait_for_writes_timer;
         
         int niothreads; // threads per mplex
         
@@ -263,6 +271,10 @@ namespace graphchi {
                 stripesize = 1024*1024*1024;
             }
             m.set("stripesize", (size_t)stripesize);
+            preada_now_timer = m.register_timer("preada_now");
+            pwritea_now_timer = m.register_timer("pwritea_now");
+            wait_for_reads_timer = m.register_timer("stripedio_wait_for_reads");
+            wait_for_writes_timer = m.register_timer("stripedio_wait_for_writes");
             
             // Start threads (niothreads is now threads per multiplex)
             niothreads = get_option_int("niothreads", 1);
@@ -287,6 +299,9 @@ namespace graphchi {
                     cthreadinfo->pending_reads = 0;
                     cthreadinfo->mplex = i;
                     cthreadinfo->m = &m;
+                    cthreadinfo->commit_timer = m.register_timer("commit_thr");
+                    cthreadinfo->read_timer = m.register_timer("read_thr");
+                    cthreadinfo->id = k;
                     thread_infos.push_back(cthreadinfo);
                     
                     pthread_t iothread;
@@ -527,12 +542,12 @@ namespace graphchi {
         
         template <typename T>
         void preada_now(int session,  T * tbuf, size_t nbytes, size_t off, bool dupfd=false) {
-            metrics_entry me = m.start_time();
+            uint64_t me = m.start_timer();
             if (compressed_session(session)) {
                 // Compressed sessions do not support multiplexing for now
                 assert(off == 0);
                 read_compressed(sessions[session]->readdescs[0], tbuf, nbytes);
-                m.stop_time(me, "preada_now", false);
+                m.stop_timer(preada_now_timer, me);
                 return;
             }
 
@@ -568,18 +583,18 @@ namespace graphchi {
 
                 }
             }
-            m.stop_time(me, "preada_now", false);
+            m.stop_timer(preada_now_timer, me);
         }
         
         template <typename T>
         void pwritea_now(int session, T * tbuf, size_t nbytes, size_t off) {
-            metrics_entry me = m.start_time();
+            uint64_t me = m.start_timer();
 
             if (compressed_session(session)) {
                 // Compressed sessions do not support multiplexing for now
                 assert(off == 0);
                 write_compressed(sessions[session]->writedescs[0], tbuf, nbytes);
-                m.stop_time(me, "pwritea_now", false);
+                m.stop_timer(pwritea_now_timer, me);
 
                 return;
             }
@@ -592,7 +607,7 @@ namespace graphchi {
                 checklen += chunk.len;
             }
             assert(checklen == nbytes);
-            m.stop_time(me, "pwritea_now", false);
+            m.stop_timer(pwritea_now_timer, me);
             
         }
         
@@ -650,7 +665,7 @@ namespace graphchi {
         }
         
         void wait_for_reads() {
-            metrics_entry me = m.start_time();
+            uint64_t me = m.start_timer();
             int loops = 0;
             int mplex = (int) thread_infos.size();
             for(int i=0; i<mplex; i++) {
@@ -659,18 +674,18 @@ namespace graphchi {
                     loops++;
                 }
             }
-            m.stop_time(me, "stripedio_wait_for_reads", false);
+            m.stop_timer(wait_for_reads_timer, me);
         }
         
         void wait_for_writes() {
-            metrics_entry me = m.start_time();
+            uint64_t me = m.start_timer();
             int mplex = (int) thread_infos.size();
             for(int i=0; i<mplex; i++) {
                 while(thread_infos[i]->pending_writes>0) {
                     usleep(10000);
                 }
             }
-            m.stop_time(me, "stripedio_wait_for_writes", false);
+            m.stop_timer(wait_for_writes_timer, me);
         }
         
         
@@ -726,6 +741,11 @@ namespace graphchi {
         thrinfo * info = (thrinfo*)_info;
         int ntasks = 0;
         // logstream(LOG_INFO) << "Thread for multiplex :" << info->mplex << " starting." << std::endl;
+        if (trace_recorder::get() != NULL) {
+            std::stringstream ss;
+            ss << "io " << info->mplex << "." << info->id;
+            trace_recorder::get()->name_thread(ss.str());
+        }
         while(info->running) {
             bool success;
             if (info->pending_reads>0) {  // Prioritize read queue
@@ -739,7 +759,7 @@ namespace graphchi {
             if (success) {
                 ++ntasks;
                 if (task.action == WRITE) {  // Write
-                    metrics_entry me = info->m->start_time();
+                    uint64_t me = info->m->start_timer();
                     
                     if (task.compressed) {
                         assert(task.offset == 0);
@@ -759,8 +779,9 @@ namespace graphchi {
                     }
                    
                     __sync_sub_and_fetch(&info->pending_writes, 1);
-                    info->m->stop_time(me, "commit_thr");
+                    info->m->stop_timer(info->commit_timer, me);
                 } else {
+                    uint64_t me = info->m->start_timer();
                     if (task.compressed) {
                         assert(task.offset == 0);
                         read_compressed(task.fd, task.ptr->ptr, task.length);
@@ -768,6 +789,7 @@ namespace graphchi {
                     } else {
                         preada(task.fd, task.ptr->ptr+task.ptroffset, task.length, task.offset);
                     }
+                    info->m->stop_timer(info->read_timer, me);
                     __sync_sub_and_fetch(&info->pending_reads, 1);
                     if (__sync_sub_and_fetch(&task.ptr->count, 1) == 0) {
                         free(task.ptr);
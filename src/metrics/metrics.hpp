@@ -24,6 +24,14 @@
  * @section DESCRIPTION
  *
  * Metrics. 
+ *
+ * Besides the string-keyed entries, a metrics instance has handles for
+ * hot paths: register_timer()/register_counter() resolve a key once to
+ * an integer id, and add()/stop_timer() with the id then update a
+ * counter of the calling thread without a map lookup or a lock. The
+ * per-thread counters are merged into the entries only when reported.
+ * If tracing is enabled (metrics/trace_recorder.hpp), handle timers also
+ * record their spans.
  */
 
   
@@ -35,10 +43,15 @@
 #include <vector>
 #include <limits>
 #include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
 #include <sys/time.h>
 
 #include "util/pthread_tools.hpp"
 #include "util/cmdopts.hpp"
+#include "util/thread_slots.hpp"
+#include "metrics/trace_recorder.hpp"
 
 namespace graphchi {
 
@@ -151,6 +164,25 @@ namespace graphchi {
     }
   };
  
+  typedef int metrics_handle;
+
+  static const int MAX_METRICS_HANDLES = 256;
+
+  /* Per-thread value of a metrics handle */
+  struct metrics_cell {
+    size_t count;
+    double sum;
+    double minvalue;
+    double maxvalue;
+
+    inline void add(double x) {
+      if (count == 0 || x < minvalue) minvalue = x;
+      if (count == 0 || x > maxvalue) maxvalue = x;
+      sum += x;
+      count++;
+    }
+  };
+
   class imetrics_reporter {
         
     public:
@@ -167,14 +199,127 @@ namespace graphchi {
     std::string name, ident;
     std::map<std::string, metrics_entry> entries;
       mutex mlock;
+
+      /* Handles: keys and types, and a cache-line aligned block of cells per thread slot */
+      std::vector<std::string> handle_keys;   // reserved, never reallocated
+      std::vector<metrictype> handle_types;
+      std::vector<metrics_cell *> cells;
+      volatile int trace_names[MAX_METRICS_HANDLES];
+
+      metrics_handle register_handle(std::string key, metrictype type) {
+          mlock.lock();
+          int h = 0;
+          while(h < (int) handle_keys.size() && handle_keys[h] != key) h++;
+          if (h == (int) handle_keys.size()) {
+              assert(h < MAX_METRICS_HANDLES);
+              handle_keys.push_back(key);
+              handle_types.push_back(type);
+          }
+          mlock.unlock();
+          return h;
+      }
+
+      inline metrics_cell * my_cells() {
+          int slot = thread_slots::current();
+          metrics_cell * c = cells[slot];
+          if (c == NULL) {
+              void * p = NULL;
+              int err = posix_memalign(&p, 64, MAX_METRICS_HANDLES * sizeof(metrics_cell));
+              assert(err == 0);
+              memset(p, 0, MAX_METRICS_HANDLES * sizeof(metrics_cell));
+              c = cells[slot] = (metrics_cell *) p;
+          }
+          return c;
+      }
+
+      /* Entries with the handle cells of all threads merged in */
+      std::map<std::string, metrics_entry> merged_entries() {
+          std::map<std::string, metrics_entry> all = entries;
+          int nslots = thread_slots::count();
+          for(int h=0; h < (int) handle_keys.size(); h++) {
+              metrics_cell tot;
+              memset(&tot, 0, sizeof(tot));
+              for(int t=0; t < nslots; t++) {
+                  metrics_cell * c = cells[t];
+                  if (c == NULL || c[h].count == 0) continue;
+                  if (tot.count == 0 || c[h].minvalue < tot.minvalue) tot.minvalue = c[h].minvalue;
+                  if (tot.count == 0 || c[h].maxvalue > tot.maxvalue) tot.maxvalue = c[h].maxvalue;
+                  tot.sum += c[h].sum;
+                  tot.count += c[h].count;
+              }
+              if (tot.count == 0) continue;
+              if (all.count(handle_keys[h]) == 0) {
+                  all[handle_keys[h]] = metrics_entry(handle_types[h]);
+              }
+              metrics_entry &e = all[handle_keys[h]];
+              e.minvalue = (e.count == 0 ? tot.minvalue : std::min(e.minvalue, tot.minvalue));
+              e.maxvalue = (e.count == 0 ? tot.maxvalue : std::max(e.maxvalue, tot.maxvalue));
+              e.value += tot.sum;
+              e.cumvalue += tot.sum;
+              e.count += tot.count;
+          }
+          return all;
+      }
+
+      /* Owns the cells: not copyable */
+      metrics(const metrics &);
+      metrics & operator= (const metrics &);
         
   public: 
-    inline metrics(std::string _name = "", std::string _id = "") : name(_name), ident (_id) {
+    inline metrics(std::string _name = "", std::string _id = "") : name(_name), ident (_id), cells(MAX_THREAD_SLOTS, (metrics_cell *) NULL) {
         this->set("app", _name);
+        handle_keys.reserve(MAX_METRICS_HANDLES);
+        for(int h=0; h < MAX_METRICS_HANDLES; h++) trace_names[h] = -1;
+    }
+
+    ~metrics() {
+        for(size_t i=0; i < cells.size(); i++) free(cells[i]);
+    }
+
+    /**
+     * Handle of a timer, for stop_timer(). Registering the same key
+     * again returns the same handle.
+     */
+    metrics_handle register_timer(std::string key) {
+        return register_handle(key, TIME);
+    }
+
+    /**
+     * Handle of a counter, for add(handle, x).
+     */
+    metrics_handle register_counter(std::string key, metrictype type = REAL) {
+        return register_handle(key, type);
+    }
+
+    /* Adds to the calling thread's cell of a counter. Thread-safe. */
+    inline void add(metrics_handle h, double x) {
+        my_cells()[h].add(x);
+    }
+
+    inline uint64_t start_timer() {
+        return trace_now();
+    }
+
+    /**
+     * Adds the time since start_timer() to a timer. Thread-safe.
+     * from and to are shown with the span in a trace.
+     */
+    inline void stop_timer(metrics_handle h, uint64_t started, int64_t from=-1, int64_t to=-1) {
+        uint64_t now = trace_now();
+        my_cells()[h].add((now - started) * 1.0E-9);
+        trace_recorder * recorder = trace_recorder::get();
+        if (recorder != NULL) {
+            int name = trace_names[h];
+            if (name < 0) name = trace_names[h] = recorder->intern(handle_keys[h]);
+            recorder->record(name, started, now, from, to);
+        }
     }
 
     inline void clear() {
       entries.clear();
+      for(size_t i=0; i < cells.size(); i++) {
+        if (cells[i] != NULL) memset(cells[i], 0, MAX_METRICS_HANDLES * sizeof(metrics_cell));
+      }
     }
       
       
@@ -324,14 +469,17 @@ namespace graphchi {
       }
         
     inline metrics_entry get(std::string key) {
-      return entries[key];
+      std::map<std::string, metrics_entry> all = merged_entries();
+      return all[key];
     }
       
       
     void report(imetrics_reporter & reporter) {
           if (name != "") {
-              reporter.do_report(name, ident, entries);
+              std::map<std::string, metrics_entry> all = merged_entries();
+              reporter.do_report(name, ident, all);
           }
+          if (trace_recorder::get() != NULL) trace_recorder::get()->write();
       }
       
   };
@@ -0,0 +1,242 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Timeline of engine phases in the Chrome trace_event format, for
+ * chrome://tracing or ui.perfetto.dev. Enabled with the command-line
+ * option "trace <filename>". Every timer of a metrics handle
+ * (metrics::stop_timer()) then also records a span on the thread that
+ * ran it, so the timeline shows the intervals and subintervals, shard
+ * loading, updates, commits, I/O waits and the I/O threads' tasks.
+ * Other code can add spans with trace_span. The spans are kept in
+ * memory, one buffer per thread, and the file is written by
+ * metrics::report(), i.e. metrics_report().
+ */
+
+#ifndef DEF_GRAPHCHI_TRACE_RECORDER
+#define DEF_GRAPHCHI_TRACE_RECORDER
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "logger/logger.hpp"
+#include "util/pthread_tools.hpp"
+#include "util/thread_slots.hpp"
+
+namespace graphchi {
+
+    /* Monotonic clock in nanoseconds */
+    static inline uint64_t trace_now() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    struct trace_event {
+        uint64_t start;
+        uint64_t end;
+        int name;
+        int tid;
+        int64_t from;
+        int64_t to;
+    };
+
+    /* Spans of a thread slot. The lock is only contended by write(). */
+    struct trace_buffer {
+        mutex lock;
+        std::vector<trace_event> events;
+    };
+
+    class trace_recorder {
+        std::string filename;
+        uint64_t t0;
+        mutex lock;
+        int nthreads;
+        std::vector<std::string> names;
+        std::vector<trace_buffer *> buffers;   // by thread slot
+        std::vector<std::string> thread_names; // by trace thread id
+
+        trace_recorder(std::string filename) : filename(filename), t0(trace_now()), nthreads(0),
+                buffers(MAX_THREAD_SLOTS, (trace_buffer *) NULL) {}
+
+        static trace_recorder *& instance() {
+            static trace_recorder * recorder = NULL;
+            return recorder;
+        }
+
+        static void write_escaped(FILE * f, const std::string &s) {
+            for(size_t i=0; i < s.size(); i++) {
+                if (s[i] == '"' || s[i] == '\\') fputc('\\', f);
+                fputc(s[i], f);
+            }
+        }
+
+        /**
+         * Thread id of the calling thread in the timeline. Thread slots
+         * are recycled when their thread exits, so the timeline numbers
+         * the threads itself: a later thread in the same slot gets a
+         * new row and does not inherit the name of the earlier one.
+         */
+        int thread_id() {
+            static __thread int tid = -1;
+            if (tid < 0) {
+                lock.lock();
+                tid = nthreads++;
+                thread_names.push_back(std::string());
+                lock.unlock();
+            }
+            return tid;
+        }
+
+    public:
+        /* The recorder, or NULL if tracing is not enabled */
+        static inline trace_recorder * get() {
+            return instance();
+        }
+
+        /**
+         * Starts recording into filename. Does nothing if filename is
+         * empty or tracing is already enabled.
+         */
+        static void enable(std::string filename) {
+            if (filename.empty() || instance() != NULL) return;
+            instance() = new trace_recorder(filename);
+            logstream(LOG_INFO) << "Recording a trace of the engine phases to " << filename << std::endl;
+        }
+
+        /* Id of a span name. Thread-safe. */
+        int intern(const std::string &name) {
+            lock.lock();
+            int id = 0;
+            while(id < (int) names.size() && names[id] != name) id++;
+            if (id == (int) names.size()) names.push_back(name);
+            lock.unlock();
+            return id;
+        }
+
+        /* Records a span of the calling thread; from and to are optional arguments (-1) */
+        inline void record(int name, uint64_t start, uint64_t end, int64_t from=-1, int64_t to=-1) {
+            int slot = thread_slots::current();
+            trace_buffer * buf = buffers[slot];
+            if (buf == NULL) {
+                lock.lock();
+                buf = buffers[slot] = new trace_buffer();
+                lock.unlock();
+            }
+            trace_event e;
+            e.start = start;
+            e.end = end;
+            e.name = name;
+            e.tid = thread_id();
+            e.from = from;
+            e.to = to;
+            buf->lock.lock();
+            buf->events.push_back(e);
+            buf->lock.unlock();
+        }
+
+        /* Names the calling thread in the timeline */
+        void name_thread(std::string name) {
+            int tid = thread_id();
+            lock.lock();
+            thread_names[tid] = name;
+            lock.unlock();
+        }
+
+        /**
+         * Writes all spans recorded so far. Threads may keep recording
+         * while the file is written; their later spans are not included.
+         */
+        void write() {
+            FILE * f = fopen(filename.c_str(), "w");
+            if (f == NULL) {
+                logstream(LOG_ERROR) << "Could not write trace to " << filename << std::endl;
+                return;
+            }
+            lock.lock();
+            fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+            for(int t=0; t < nthreads; t++) {
+                fprintf(f, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %d, \"args\": {\"name\": \"", t == 0 ? "" : ",\n", t);
+                if (thread_names[t].empty()) fprintf(f, "thread %d", t);
+                else write_escaped(f, thread_names[t]);
+                fprintf(f, "\"}}");
+            }
+            size_t n = 0;
+            int nslots = thread_slots::count();
+            for(int s=0; s < nslots; s++) {
+                if (buffers[s] == NULL) continue;
+                trace_buffer &buf = *buffers[s];
+                buf.lock.lock();
+                for(size_t i=0; i < buf.events.size(); i++) {
+                    trace_event &e = buf.events[i];
+                    fprintf(f, ",\n{\"name\": \"");
+                    write_escaped(f, names[e.name]);
+                    fprintf(f, "\", \"ph\": \"X\", \"pid\": 0, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f",
+                            e.tid, (e.start - t0) * 1.0E-3, (e.end - e.start) * 1.0E-3);
+                    if (e.from >= 0) {
+                        fprintf(f, ", \"args\": {\"from\": %lld, \"to\": %lld}", (long long) e.from, (long long) e.to);
+                    }
+                    fprintf(f, "}");
+                }
+                n += buf.events.size();
+                buf.lock.unlock();
+            }
+            fprintf(f, "\n]}\n");
+            lock.unlock();
+            fclose(f);
+            logstream(LOG_INFO) << "Wrote " << n << " trace events to " << filename << std::endl;
+        }
+    };
+
+    /**
+     * Records a span from construction to destruction, if tracing is
+     * enabled.
+     */
+    class trace_span {
+        trace_recorder * recorder;
+        int name;
+        uint64_t start;
+        int64_t from;
+        int64_t to;
+
+    public:
+        trace_span(const char * spanname, int64_t from=-1, int64_t to=-1) : recorder(trace_recorder::get()), name(0), start(0), from(from), to(to) {
+            if (recorder != NULL) {
+                name = recorder->intern(spanname);
+                start = trace_now();
+            }
+        }
+
+        ~trace_span() {
+            if (recorder != NULL) recorder->record(name, start, trace_now(), from, to);
+        }
+    };
+
+}
+
+#endif
@@ -0,0 +1,220 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Output file that update functions can write to concurrently without
+ * a global lock. Every thread appends records to its own buffer; a full
+ * buffer reserves a range at the end of the file with an atomic add and
+ * is written there with pwrite. Records are never split, but records of
+ * different threads interleave in no particular order.
+ *
+ * Records are encoded as text ("from\tto\n", as written with fprintf
+ * before) or as binary (raw vid_t / float values).
+ *
+ * Buffers are kept by thread slot, see util/thread_slots.hpp.
+ */
+
+#ifndef DEF_GRAPHCHI_PARALLEL_OUTPUT_WRITER
+#define DEF_GRAPHCHI_PARALLEL_OUTPUT_WRITER
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "graphchi_types.hpp"
+#include "logger/logger.hpp"
+#include "util/ioutil.hpp"
+#include "util/thread_slots.hpp"
+
+namespace graphchi {
+
+    enum output_encoding { OUTPUT_TEXT, OUTPUT_BINARY };
+
+    class parallel_output_writer {
+        struct thread_buffer {
+            char * data;
+            size_t len;
+            thread_buffer() : data(NULL), len(0) {}
+        };
+
+        std::string filename;
+        output_encoding encoding;
+        size_t bufsize;
+        int fd;
+        size_t endoffset;
+        std::vector<thread_buffer> buffers;
+
+        /* Longest text edge, "4294967295\t4294967295\n" */
+        static const size_t MAX_EDGE_RECORD = 22;
+
+        /* Writes out a buffer at a freshly reserved range of the file */
+        void flush_buffer(thread_buffer &b) {
+            if (b.len == 0) return;
+            size_t off = __sync_fetch_and_add(&endoffset, b.len);
+            pwritea(fd, b.data, b.len, off);
+            b.len = 0;
+        }
+
+        /* Buffer of the calling thread with room for n <= bufsize more bytes */
+        inline thread_buffer & reserve(size_t n) {
+            thread_buffer &b = buffers[thread_slots::current()];
+            if (b.data == NULL) b.data = (char *) malloc(bufsize);
+            if (b.len + n > bufsize) flush_buffer(b);
+            return b;
+        }
+
+        static inline size_t format_uint(char * out, unsigned int x) {
+            char tmp[10];
+            size_t n = 0;
+            do { tmp[n++] = (char) ('0' + x % 10); x /= 10; } while (x != 0);
+            for(size_t i=0; i < n; i++) out[i] = tmp[n - 1 - i];
+            return n;
+        }
+
+    public:
+        /**
+         * @param filename output file
+         * @param encoding text or binary records
+         * @param append if true, records are added after the current end of
+         *        the file (e.g. after a header), otherwise it is truncated
+         * @param bufsize size of the per-thread buffers in bytes, at least
+         *        the length of the longest text edge
+         */
+        parallel_output_writer(std::string filename, output_encoding encoding=OUTPUT_TEXT, bool append=false,
+                               size_t bufsize=1024 * 1024) : filename(filename), encoding(encoding), bufsize(bufsize),
+                               buffers(MAX_THREAD_SLOTS) {
+            if (this->bufsize < MAX_EDGE_RECORD) this->bufsize = MAX_EDGE_RECORD;
+            fd = open(filename.c_str(), O_WRONLY | O_CREAT | (append ? 0 : O_TRUNC), S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
+            if (fd < 0) {
+                logstream(LOG_FATAL) << "Could not open " << filename << " for writing: " << strerror(errno) << std::endl;
+                assert(false);
+            }
+            off_t end = lseek(fd, 0, SEEK_END);
+            endoffset = end < 0 ? 0 : (size_t) end;
+        }
+
+        ~parallel_output_writer() {
+            close();
+        }
+
+        /* Writes an edge, "from\tto\n" as text */
+        inline void write_edge(vid_t from, vid_t to) {
+            if (encoding == OUTPUT_BINARY) {
+                vid_t rec[2] = {from, to};
+                write(rec, sizeof(rec));
+                return;
+            }
+            thread_buffer &b = reserve(MAX_EDGE_RECORD);
+            char * p = b.data + b.len;
+            size_t n = format_uint(p, from);
+            p[n++] = '\t';
+            n += format_uint(p + n, to);
+            p[n++] = '\n';
+            b.len += n;
+        }
+
+        /* Writes a weighted edge, "from\tto\tweight\n" (weight with 3 decimals) as text */
+        inline void write_edge(vid_t from, vid_t to, float weight) {
+            if (encoding == OUTPUT_BINARY) {
+                char rec[2 * sizeof(vid_t) + sizeof(float)];
+                memcpy(rec, &from, sizeof(vid_t));
+                memcpy(rec + sizeof(vid_t), &to, sizeof(vid_t));
+                memcpy(rec + 2 * sizeof(vid_t), &weight, sizeof(float));
+                write(rec, sizeof(rec));
+                return;
+            }
+            print("%u\t%u\t%.3f\n", from, to, weight);
+        }
+
+        /* Writes raw bytes as one record */
+        inline void write(const void * data, size_t n) {
+            if (n > bufsize) {
+                pwritea(fd, (const char *) data, n, __sync_fetch_and_add(&endoffset, n));
+                return;
+            }
+            thread_buffer &b = reserve(n);
+            memcpy(b.data + b.len, data, n);
+            b.len += n;
+        }
+
+        /* Writes a formatted text record */
+        void print(const char * fmt, ...) {
+            char tmp[256];
+            va_list args;
+            va_start(args, fmt);
+            int n = vsnprintf(tmp, sizeof(tmp), fmt, args);
+            va_end(args);
+            assert(n >= 0);
+            if (n < (int) sizeof(tmp)) {
+                write(tmp, n);
+            } else {
+                std::vector<char> big(n + 1);
+                va_start(args, fmt);
+                vsnprintf(&big[0], n + 1, fmt, args);
+                va_end(args);
+                write(&big[0], n);
+            }
+        }
+
+        /**
+         * Writes out all buffers. Must not be called concurrently with
+         * writes; e.g. call after a header to keep it first in the file.
+         */
+        void flush() {
+            for(int i=0; i < thread_slots::count(); i++) flush_buffer(buffers[i]);
+        }
+
+        void close() {
+            if (fd < 0) return;
+            flush();
+            for(int i=0; i < thread_slots::count(); i++) {
+                if (buffers[i].data != NULL) free(buffers[i].data);
+                buffers[i].data = NULL;
+            }
+            ::close(fd);
+            fd = -1;
+        }
+
+        /* Number of per-thread buffers allocated */
+        int num_buffers() const {
+            int n = 0;
+            for(int i=0; i < thread_slots::count(); i++) n += buffers[i].data != NULL;
+            return n;
+        }
+
+        size_t bytes_written() const {
+            return endoffset;
+        }
+    };
+
+}
+
+#endif
@@ -42,6 +42,7 @@
 #include "graphchi_types.hpp"
 #include "logger/logger.hpp"
 #include "preprocessing/sharder.hpp"
+#include "preprocessing/incremental_sharder.hpp"
 
 /**
  * GNU COMPILER HACK TO PREVENT WARNINGS "Unused variable", if
@@ -559,6 +560,33 @@ namespace graphchi {
         }
     }
     
+    /**
+     * Reads a binary sorted edge stream written by sharder::buildsrcfile().
+     */
+    template <typename EdgeDataType, typename FinalEdgeDataType>
+    void convert_sortededges(std::string inputfile, sharder<EdgeDataType, FinalEdgeDataType> &sharderobj) {
+        sorted_edgestream_reader<EdgeDataType> reader(inputfile);
+        logstream(LOG_INFO) << "Reading " << reader.num_edges() << " edges from sorted edge stream " << inputfile << std::endl;
+        vid_t from, to;
+        if (reader.has_values()) {
+            // Edge types may have an empty constructor; clear the bytes
+            // that next() overwrites so nothing is read uninitialized.
+            EdgeDataType edgeval;
+            memset((void *) &edgeval, 0, sizeof(EdgeDataType));
+            while(reader.next(from, to, edgeval)) {
+                if (from != to) {
+                    sharderobj.preprocessing_add_edge(from, to, edgeval);
+                }
+            }
+        } else {
+            while(reader.next(from, to)) {
+                if (from != to) {
+                    sharderobj.preprocessing_add_edge(from, to);
+                }
+            }
+        }
+    }
+    
     // TODO: remove code duplication.
     template <typename EdgeDataType, typename FinalEdgeDataType>
     void convert_binedgelistval(std::string basefilename, sharder<EdgeDataType, FinalEdgeDataType> &sharderobj) {
@@ -616,11 +644,11 @@ namespace graphchi {
 		if(file_type_str == "auto")	
 			file_type_str = "edgelist";
 		else
-        	file_type_str = get_option_string_interactive("filetype", "edgelist, adjlist, binedgelist, metis");
+        	file_type_str = get_option_string_interactive("filetype", "edgelist, adjlist, binedgelist, sortededges, metis");
         //std::string file_type_str = get_option_string_interactive("filetype", "edgelist, adjlist, binedgelist, metis");
         if (file_type_str != "adjlist" && file_type_str != "edgelist"  && file_type_str != "binedgelist" &&
-            file_type_str != "multivalueedgelist" && file_type_str != "metis") {
-            logstream(LOG_ERROR) << "You need to specify filetype: 'edgelist',  'adjlist', 'binedgelist', or 'metis'." << std::endl;
+            file_type_str != "multivalueedgelist" && file_type_str != "metis" && file_type_str != "sortededges") {
+            logstream(LOG_ERROR) << "You need to specify filetype: 'edgelist',  'adjlist', 'binedgelist', 'sortededges' or 'metis'." << std::endl;
             assert(false);
         }
        	//std::cout<<"==========================filetype is: "<<file_type_str<<std::endl;
@@ -639,6 +667,8 @@ namespace graphchi {
             convert_binedgelistval<EdgeDataType, FinalEdgeDataType>(basefilename, sharderobj);
         } else if (file_type_str == "metis") {
             convert_metis<EdgeDataType, FinalEdgeDataType>(basefilename, sharderobj);
+        } else if (file_type_str == "sortededges") {
+            convert_sortededges<EdgeDataType, FinalEdgeDataType>(basefilename, sharderobj);
         } else {
             assert(false);
         }
@@ -776,6 +806,32 @@ namespace graphchi {
         return nshards;
     }
     
+#ifndef DYNAMICEDATA
+    /**
+     * Adds the edges in an edge list file (optionally with values) to the existing
+     * shards of basefilename, without re-sharding the whole graph.
+     * If basefilename has not been sharded yet, it is converted first
+     * and the delta is then added to the new shards.
+     * See incremental_sharder.hpp.
+     * @return the number of shards after the update
+     */
+    template <typename EdgeDataType>
+    int add_edges_incremental(std::string basefilename, std::string deltafile, std::string nshards_string="auto") {
+        int nshards = find_shards<EdgeDataType>(basefilename, nshards_string);
+        if (nshards == 0) {
+            logstream(LOG_INFO) << "No shards found for " << basefilename << ", doing a full conversion first." << std::endl;
+            nshards = convert<EdgeDataType, EdgeDataType>(basefilename, nshards_string);
+            assert(nshards > 0);
+        }
+        incremental_sharder<EdgeDataType> incsharder(basefilename, nshards);
+        convert_edgelist<EdgeDataType, EdgeDataType>(deltafile, incsharder);
+        logstream(LOG_INFO) << "Adding " << incsharder.num_pending_edges() << " edges from " << deltafile << std::endl;
+        nshards = incsharder.commit();
+        logstream(LOG_INFO) << "Incremental update finished, shards: " << nshards << std::endl;
+        return nshards;
+    }
+#endif
+    
     template <typename EdgeDataType, typename FinalEdgeType>
     int convert_if_notexists(std::string basefilename, std::string nshards_string) {
         bool b;
@@ -0,0 +1,355 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Incremental sharder: adds a batch of new edges to an already sharded
+ * graph without re-running the whole preprocessing pipeline.
+ *
+ * New edges are routed to the shard whose interval contains the
+ * destination vertex. On commit(), only the shards that received edges
+ * are read back, merged with the new edges and rewritten with
+ * sharder::finish_shard(); the degree file, intervals and the number
+ * of vertices are updated. An interval is split when its in- and
+ * out-edges together grow beyond the memory budget (option
+ * "incremental.maxshardedges", by default derived from membudget_mb).
+ * New out-edges can push an interval over the budget even if its own
+ * shard got no new edges, so such shards are rewritten too. After a
+ * split the shards are renumbered for the new shard count.
+ *
+ * Note: with a duplicate edge filter, the degree file counts the new
+ * edges before duplicates are removed.
+ */
+
+#ifndef GRAPHCHI_INCREMENTAL_SHARDER_DEF
+#define GRAPHCHI_INCREMENTAL_SHARDER_DEF
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "api/chifilenames.hpp"
+#include "preprocessing/sharder.hpp"
+#include "util/ioutil.hpp"
+
+namespace graphchi {
+
+#ifndef DYNAMICEDATA
+
+    template <typename EdgeDataType>
+    class incremental_sharder : public sharder<EdgeDataType, EdgeDataType> {
+
+        typedef sharder<EdgeDataType, EdgeDataType> base_t;
+        typedef edge_with_value<EdgeDataType> edge_t;
+
+        std::vector< std::vector<edge_t> > pending;
+        size_t num_pending;
+        size_t max_shard_edges;
+
+    public:
+        incremental_sharder(std::string basefilename, int nshards) : base_t(basefilename), num_pending(0) {
+            this->nshards = nshards;
+            load_vertex_intervals(basefilename, nshards, this->intervals);
+            assert((int)this->intervals.size() == nshards);
+            this->max_vertex_id = this->intervals[nshards - 1].second;
+            this->degrees = NULL;
+
+            /* Shards created without edge values have no block directory */
+            std::string edfname = filename_shard_edata<EdgeDataType>(basefilename, 0, nshards);
+            if (!file_exists(dirname_shard_edata_block(edfname, this->compressed_block_size))) {
+                this->set_no_edgevalues();
+            }
+
+            size_t membudget_b = (size_t) get_option_int("membudget_mb", 1024) * 1024 * 1024;
+            size_t Kdeg = sizeof(EdgeDataType) + sizeof(vid_t) + sizeof(graphchi_edge<EdgeDataType>);
+            // The in- and out-edges of an interval have to fit in the budget together
+            max_shard_edges = (size_t) get_option_long("incremental.maxshardedges", membudget_b / Kdeg);
+
+            pending.resize(nshards);
+        }
+
+        virtual ~incremental_sharder() {}
+
+        /**
+         * Adds a new edge to the batch. Vertex ids beyond the current
+         * maximum extend the last interval.
+         */
+        virtual void preprocessing_add_edge(vid_t from, vid_t to, EdgeDataType val, bool input_value=false) {
+            if (from == to) return;
+            vid_t newmax = std::max(this->max_vertex_id, std::max(from, to));
+            if (newmax > this->max_vertex_id) {
+                this->max_vertex_id = newmax;
+                this->intervals[this->nshards - 1].second = newmax;
+            }
+            pending[shard_for(to)].push_back(edge_t(from, to, val));
+            num_pending++;
+        }
+
+        size_t num_pending_edges() {
+            return num_pending;
+        }
+
+        /**
+         * Writes the pending edges into the shards.
+         * @return the number of shards after the commit
+         */
+        int commit() {
+            if (num_pending == 0) return this->nshards;
+            this->m.start_time("incremental_commit");
+
+            int oldn = this->nshards;
+            std::vector<degree> degs;
+            load_degrees(degs);
+            for(int p=0; p < oldn; p++) {
+                for(size_t i=0; i < pending[p].size(); i++) {
+                    degs[pending[p][i].src].outdegree++;
+                    degs[pending[p][i].dst].indegree++;
+                }
+            }
+
+            /* Plan the new intervals: only overflowing shards are split. Any
+               interval can overflow, as new out-edges live in other shards. */
+            std::vector< std::vector< std::pair<vid_t, vid_t> > > pieces(oldn);
+            int newn = 0;
+            for(int p=0; p < oldn; p++) {
+                split_interval(this->intervals[p], degs, pieces[p]);
+                newn += (int) pieces[p].size();
+            }
+            if (newn != oldn) {
+                logstream(LOG_INFO) << "Rebalancing: number of shards " << oldn << " --> " << newn << std::endl;
+            }
+
+            /* Rewrite affected shards, renumber the rest if needed */
+            std::vector< std::pair<vid_t, vid_t> > newintervals;
+            int q = 0;
+            for(int p=0; p < oldn; p++) {
+                if (pending[p].empty() && pieces[p].size() == 1) {
+                    if (newn != oldn) rename_shard(p, oldn, q, newn);
+                    newintervals.push_back(this->intervals[p]);
+                    q++;
+                    continue;
+                }
+                logstream(LOG_INFO) << "Merging " << pending[p].size() << " new edges into shard " << p
+                    << " (" << pieces[p].size() << " pieces)" << std::endl;
+                std::vector<edge_t> edges;
+                read_shard_edges(p, oldn, edges);
+                edges.insert(edges.end(), pending[p].begin(), pending[p].end());
+                std::vector<edge_t>().swap(pending[p]);
+                delete_shard<EdgeDataType>(this->basefilename, p, oldn);
+
+                this->nshards = newn;
+                for(size_t k=0; k < pieces[p].size(); k++) {
+                    std::pair<vid_t, vid_t> iv = pieces[p][k];
+                    size_t cnt = 0;
+                    for(size_t i=0; i < edges.size(); i++) {
+                        if (edges[i].dst >= iv.first && edges[i].dst <= iv.second) cnt++;
+                    }
+                    edge_t * buf = (edge_t *) malloc(std::max(cnt, (size_t)1) * sizeof(edge_t));
+                    size_t j = 0;
+                    for(size_t i=0; i < edges.size(); i++) {
+                        if (edges[i].dst >= iv.first && edges[i].dst <= iv.second) buf[j++] = edges[i];
+                    }
+                    /* finish_shard() sorts stably by src, so sort by dst first to keep adjacency lists ordered */
+                    piSort(buf, (intT)cnt, (intT)this->max_vertex_id, dstF<EdgeDataType>(), this->sort_threads);
+                    this->finish_shard(q++, buf, cnt * sizeof(edge_t));
+                    newintervals.push_back(iv);
+                }
+                this->nshards = oldn;
+            }
+            assert(q == newn);
+            num_pending = 0;
+
+            this->nshards = newn;
+            this->intervals = newintervals;
+            write_metadata(oldn, degs);
+
+            this->m.stop_time("incremental_commit");
+            return newn;
+        }
+
+    protected:
+
+        int shard_for(vid_t dst) {
+            int lo = 0, hi = this->nshards - 1;
+            while (lo < hi) {
+                int mid = (lo + hi) / 2;
+                if (this->intervals[mid].second < dst) lo = mid + 1;
+                else hi = mid;
+            }
+            return lo;
+        }
+
+        void load_degrees(std::vector<degree> &degs) {
+            degree zero = {0, 0};
+            degs.resize(1 + this->max_vertex_id, zero);
+            std::string degfname = filename_degree_data(this->basefilename);
+            int f = open(degfname.c_str(), O_RDONLY);
+            if (f < 0) {
+                logstream(LOG_ERROR) << "Could not open degree file " << degfname << " error: " << strerror(errno) << std::endl;
+                assert(f >= 0);
+            }
+            size_t nbytes = std::min(get_filesize(degfname), degs.size() * sizeof(degree));
+            preada(f, &degs[0], nbytes, 0);
+            close(f);
+        }
+
+        /* Splits the interval so that each piece has at most max_shard_edges in- and out-edges */
+        void split_interval(std::pair<vid_t, vid_t> iv, std::vector<degree> &degs,
+                            std::vector< std::pair<vid_t, vid_t> > &out) {
+            size_t total = 0;
+            for(size_t v=iv.first; v <= iv.second; v++) total += degs[v].indegree + degs[v].outdegree;
+            if (total <= max_shard_edges) {
+                out.push_back(iv);
+                return;
+            }
+            size_t npieces = (total + max_shard_edges - 1) / max_shard_edges;
+            size_t target = total / npieces + 1;
+            size_t acc = 0;
+            vid_t st = iv.first;
+            for(size_t v=iv.first; v < iv.second; v++) {
+                acc += degs[v].indegree + degs[v].outdegree;
+                if (acc >= target && out.size() + 1 < npieces) {
+                    out.push_back(std::pair<vid_t, vid_t>(st, (vid_t)v));
+                    st = (vid_t)v + 1;
+                    acc = 0;
+                }
+            }
+            out.push_back(std::pair<vid_t, vid_t>(st, iv.second));
+        }
+
+        void rename_file(std::string from, std::string to) {
+            if (file_exists(from)) {
+                int err = rename(from.c_str(), to.c_str());
+                if (err != 0) logstream(LOG_ERROR) << "Error renaming " << from << " to " << to << ", " << strerror(errno) << std::endl;
+                assert(err == 0);
+            }
+        }
+
+        void rename_shard(int p, int oldn, int q, int newn) {
+            std::string oldadj = filename_shard_adj(this->basefilename, p, oldn);
+            std::string newadj = filename_shard_adj(this->basefilename, q, newn);
+            rename_file(oldadj, newadj);
+            rename_file(filename_shard_adjidx(oldadj), filename_shard_adjidx(newadj));
+            if (!this->no_edgevalues) {
+                std::string olded = filename_shard_edata<EdgeDataType>(this->basefilename, p, oldn);
+                std::string newed = filename_shard_edata<EdgeDataType>(this->basefilename, q, newn);
+                rename_file(olded + ".size", newed + ".size");
+                rename_file(dirname_shard_edata_block(olded, this->compressed_block_size),
+                            dirname_shard_edata_block(newed, this->compressed_block_size));
+            }
+        }
+
+        /* Decodes a shard written by finish_shard() back into an edge list */
+        void read_shard_edges(int p, int n, std::vector<edge_t> &edges) {
+            std::string adjname = filename_shard_adj(this->basefilename, p, n);
+            size_t adjsize = get_filesize(adjname);
+            uint8_t * adj = (uint8_t *) malloc(std::max(adjsize, (size_t)1));
+            int f = open(adjname.c_str(), O_RDONLY);
+            assert(f >= 0);
+            preada(f, adj, adjsize, 0);
+            close(f);
+
+            char * edata = NULL;
+            if (!this->no_edgevalues) {
+                std::string edfname = filename_shard_edata<EdgeDataType>(this->basefilename, p, n);
+                size_t edatasize = get_shard_edata_filesize<EdgeDataType>(edfname);
+                size_t bs = this->compressed_block_size;
+                edata = (char *) malloc(std::max(edatasize, (size_t)1));
+                for(size_t off=0, blockid=0; off < edatasize; off += bs, blockid++) {
+                    std::string blockname = filename_shard_edata_block(edfname, (int)blockid, bs);
+                    int bf = open(blockname.c_str(), O_RDONLY);
+                    if (bf < 0) {
+                        logstream(LOG_ERROR) << "Could not open " << blockname << " error: " << strerror(errno) << std::endl;
+                        assert(bf >= 0);
+                    }
+                    read_compressed(bf, edata + off, std::min(bs, edatasize - off));
+                    close(bf);
+                }
+            }
+
+            uint8_t * ptr = adj;
+            uint8_t * end = adj + adjsize;
+            vid_t vid = 0;
+            size_t edgeidx = 0;
+            while(ptr < end) {
+                uint8_t ns = *ptr++;
+                if (ns == 0x00) {
+                    // next value tells the number of vertices with zeros
+                    uint8_t nz = *ptr++;
+                    vid += 1 + nz;
+                    continue;
+                }
+                uint32_t cnt = ns;
+                if (ns == 0xff) {
+                    memcpy(&cnt, ptr, sizeof(uint32_t));
+                    ptr += sizeof(uint32_t);
+                }
+                for(uint32_t k=0; k < cnt; k++) {
+                    vid_t dst;
+                    memcpy(&dst, ptr, sizeof(vid_t));
+                    ptr += sizeof(vid_t);
+                    EdgeDataType val = EdgeDataType();
+                    if (edata != NULL) memcpy(&val, edata + edgeidx * sizeof(EdgeDataType), sizeof(EdgeDataType));
+                    edges.push_back(edge_t(vid, dst, val));
+                    edgeidx++;
+                }
+                vid++;
+            }
+            free(adj);
+            if (edata != NULL) free(edata);
+        }
+
+        void write_metadata(int oldn, std::vector<degree> &degs) {
+            int n = this->nshards;
+            if (n != oldn) {
+                remove(filename_intervals(this->basefilename, oldn).c_str());
+            }
+            std::string fname = filename_intervals(this->basefilename, n);
+            FILE * f = fopen(fname.c_str(), "w");
+            if (f == NULL) {
+                logstream(LOG_ERROR) << "Could not open file: " << fname << " error: " << strerror(errno) << std::endl;
+            }
+            assert(f != NULL);
+            for(int i=0; i < n; i++) {
+                fprintf(f, "%u\n", this->intervals[i].second);
+            }
+            fclose(f);
+
+            std::string numv_filename = this->basefilename + ".numvertices";
+            f = fopen(numv_filename.c_str(), "w");
+            fprintf(f, "%u\n", 1 + this->max_vertex_id);
+            fclose(f);
+
+            std::string degreefname = filename_degree_data(this->basefilename);
+            int degreeOutF = open(degreefname.c_str(), O_RDWR | O_CREAT, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
+            assert(degreeOutF >= 0);
+            pwritea(degreeOutF, &degs[0], degs.size() * sizeof(degree), 0);
+            close(degreeOutF);
+        }
+    };
+
+#endif
+
+}; // namespace
+
+#endif
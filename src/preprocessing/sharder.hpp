@@ -62,6 +62,8 @@
 #include "shards/memoryshard.hpp"
 #include "shards/slidingshard.hpp"
 #include "output/output.hpp"
+#include "preprocessing/sorted_edgestream.hpp"
+#include "preprocessing/vertex_reorder.hpp"
 #include "util/ioutil.hpp"
 #include "util/radixSort.hpp"
 #include "util/kwaymerge.hpp"
@@ -151,6 +153,87 @@ namespace graphchi {
     
   
     
+    /**
+     * Accumulates vertex degrees from the shovels while they are flushed,
+     * so that the intervals can be computed without merging the shovels.
+     * Flush threads call count() after sorting; the array grows as
+     * larger vertex ids are seen.
+     */
+    struct shovel_degree_counter {
+        degree * degrees;
+        size_t capacity;
+        mutex lock;
+        
+        shovel_degree_counter() : degrees(NULL), capacity(0) {}
+        
+        ~shovel_degree_counter() {
+            if (degrees != NULL) free(degrees);
+        }
+        
+        template <typename EdgeDataType>
+        void count(edge_with_value<EdgeDataType> * buffer, size_t numedges, vid_t max_vertex) {
+            lock.lock();
+            if (capacity < size_t(max_vertex) + 1) {
+                size_t newcap = std::max(size_t(max_vertex) + 1, capacity * 3 / 2);
+                degrees = (degree *) realloc(degrees, newcap * sizeof(degree));
+                assert(degrees != NULL);
+                memset(degrees + capacity, 0, (newcap - capacity) * sizeof(degree));
+                capacity = newcap;
+            }
+            for(size_t i=0; i < numedges; i++) {
+                degrees[buffer[i].dst].indegree++;
+                degrees[buffer[i].src].outdegree++;
+            }
+            lock.unlock();
+        }
+        
+        size_t bytes() {
+            lock.lock();
+            size_t b = capacity * sizeof(degree);
+            lock.unlock();
+            return b;
+        }
+        
+        degree get(vid_t v) {
+            if (v >= capacity) {
+                degree zero = {0, 0};
+                return zero;
+            }
+            return degrees[v];
+        }
+        
+        /* Relabels the counts after vertex reordering */
+        void permute(const vertex_permutation &perm) {
+            size_t n = std::max(capacity, perm.size());
+            degree * permuted = (degree *) calloc(n, sizeof(degree));
+            for(size_t v=0; v < capacity; v++) {
+                permuted[perm.to_new((vid_t)v)] = degrees[v];
+            }
+            free(degrees);
+            degrees = permuted;
+            capacity = n;
+        }
+        
+        /**
+         * Hands the array over to the caller, resized to n vertices and
+         * zeroed, so that the final degree count does not need a second
+         * per-vertex array. Pass n = 0 to just free it.
+         */
+        degree * release(size_t n) {
+            degree * d = NULL;
+            if (n > 0) {
+                d = (degree *) realloc(degrees, n * sizeof(degree));
+                assert(d != NULL);
+                memset(d, 0, n * sizeof(degree));
+            } else if (degrees != NULL) {
+                free(degrees);
+            }
+            degrees = NULL;
+            capacity = 0;
+            return d;
+        }
+    };
+    
     template <typename EdgeDataType>
     struct shard_flushinfo {
         std::string shovelname;
@@ -159,9 +242,14 @@ namespace graphchi {
         edge_with_value<EdgeDataType> * buffer;
         vid_t max_vertex;
         DuplicateEdgeFilter<EdgeDataType> *  duplicate_filter;
+        int sort_threads;
+        shovel_degree_counter * degree_counter;
+        bool write_src_shovel;
         
-        shard_flushinfo(std::string shovelname, vid_t max_vertex, size_t numedges, edge_with_value<EdgeDataType> * buffer, DuplicateEdgeFilter<EdgeDataType> * duplicate_filter) :
-        shovelname(shovelname), numedges(numedges), buffer(buffer), max_vertex(max_vertex), duplicate_filter(duplicate_filter) {}
+        shard_flushinfo(std::string shovelname, vid_t max_vertex, size_t numedges, edge_with_value<EdgeDataType> * buffer, DuplicateEdgeFilter<EdgeDataType> * duplicate_filter,
+                        int sort_threads = 1, shovel_degree_counter * degree_counter = NULL, bool write_src_shovel = false) :
+        shovelname(shovelname), numedges(numedges), buffer(buffer), max_vertex(max_vertex), duplicate_filter(duplicate_filter), sort_threads(sort_threads),
+        degree_counter(degree_counter), write_src_shovel(write_src_shovel) {}
         
         void flush() {
             /* Sort */
@@ -170,7 +258,7 @@ namespace graphchi {
             if (duplicate_filter != NULL) {
                 // Sort by dst, then by src so can effectively remove duplicates
                 logstream(LOG_INFO) << "Sorting shovel: " << shovelname << ", max:" << max_vertex << std::endl;
-                iSort(buffer, (intT)numedges, intT(max_vertex)*intT(max_vertex)+intT(max_vertex), dstSrcF<EdgeDataType>(max_vertex));
+                piSort(buffer, (intT)numedges, intT(max_vertex)*intT(max_vertex)+intT(max_vertex), dstSrcF<EdgeDataType>(max_vertex), sort_threads);
                 logstream(LOG_INFO) << "Sort done." << shovelname << std::endl;
            
                 edge_with_value<EdgeDataType> * tmpbuf = (edge_with_value<EdgeDataType> *) calloc(sizeof(edge_with_value<EdgeDataType>), numedges);
@@ -200,7 +288,7 @@ namespace graphchi {
 				*/
 				//create dst ordered shovel file
                 logstream(LOG_INFO) << "Sorting shovel: " << shovelname << ", max:" << max_vertex << std::endl;
-                iSort(buffer, (intT)numedges, (intT)max_vertex, dstF<EdgeDataType>());
+                piSort(buffer, (intT)numedges, (intT)max_vertex, dstF<EdgeDataType>(), sort_threads);
                 logstream(LOG_INFO) << "Sort done." << shovelname << std::endl;
 				/*
 				for(size_t k=0; k<200; k++){
@@ -222,24 +310,22 @@ namespace graphchi {
 			assert(f != 0);
             writea(f, buffer, numedges * sizeof(edge_with_value<EdgeDataType>));
             close(f);
-            // create src ordered shovel file
-				
-			iSort(buffer, (intT)numedges, (intT)max_vertex, srcF<EdgeDataType>());
-			shovelname2 = shovelname + "s";
-			logstream(LOG_INFO)<<"my file name2::::::"<<shovelname2<<std::endl;
-            int f2 = open(shovelname2.c_str(), O_WRONLY | O_CREAT, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
-            writea(f2, buffer, numedges * sizeof(edge_with_value<EdgeDataType>));
-            close(f2);
-			logstream(LOG_INFO)<<"Sorting edges in buffer by src Done!++++++++++++++++++++++++++"<<shovelname2<<std::endl;	
-				
-				for(size_t k=1; k<numedges; k++){
-					//	logstream(LOG_INFO)<<k<<"::::"<<buffer[k].src<<"->"<<buffer[k].dst<<std::endl;
-					if(buffer[k].src <  buffer[k-1].src)
-						assert(false);
-				}
-			
-                logstream(LOG_INFO)<<"=============================================="<<"All sorted by src check!!!"<<std::endl;
-		//	assert(false);	
+            
+            // Count degrees for the interval computation (the shovel is dst-sorted,
+            // so the indegree updates are sequential)
+            if (degree_counter != NULL) {
+                degree_counter->count(buffer, numedges, max_vertex);
+            }
+            
+            // create src ordered shovel file, only needed by buildsrcfile()
+            if (write_src_shovel) {
+                piSort(buffer, (intT)numedges, (intT)max_vertex, srcF<EdgeDataType>(), sort_threads);
+                shovelname2 = shovelname + "s";
+                logstream(LOG_INFO)<<"my file name2::::::"<<shovelname2<<std::endl;
+                int f2 = open(shovelname2.c_str(), O_WRONLY | O_CREAT, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
+                writea(f2, buffer, numedges * sizeof(edge_with_value<EdgeDataType>));
+                close(f2);
+            }
             free(buffer);
         }
     };
@@ -377,6 +463,10 @@ namespace graphchi {
         edge_with_value<EdgeDataType> * curshovel_buffer;
         std::vector<pthread_t> shovelthreads;
         std::vector<shard_flushinfo<EdgeDataType> *> shoveltasks;
+        int sort_threads;
+        shovel_degree_counter shovel_degrees;
+        bool build_srcfile;
+        std::string reorder_method;
 		//////////////////////////////
        	std::vector<int> prange; 
 		////////////////////////////
@@ -392,6 +482,9 @@ namespace graphchi {
             while (compressed_block_size % sizeof(FinalEdgeDataType) != 0) compressed_block_size++;
             edges_per_block = compressed_block_size / sizeof(FinalEdgeDataType);
             duplicate_edge_filter = NULL;
+            sort_threads = get_option_int("execthreads", omp_get_max_threads());
+            build_srcfile = get_option_int("buildsrcfile", 0) != 0;
+            reorder_method = get_option_string("reorder", "none");
         }
         
         
@@ -443,7 +536,8 @@ namespace graphchi {
         
         void flush_shovel(bool async=true) {
             /* Flush in separate thread unless the last one */
-            shard_flushinfo<EdgeDataType> * flushinfo = new shard_flushinfo<EdgeDataType>(shovel_filename(numshovels), max_vertex_id, curshovel_idx, curshovel_buffer, duplicate_edge_filter);
+            shard_flushinfo<EdgeDataType> * flushinfo = new shard_flushinfo<EdgeDataType>(shovel_filename(numshovels), max_vertex_id, curshovel_idx, curshovel_buffer, duplicate_edge_filter,
+                                                                                                 sort_threads, &shovel_degrees, build_srcfile);
             shoveltasks.push_back(flushinfo);
 
             if (!async) {
@@ -456,7 +550,12 @@ namespace graphchi {
                     pthread_join(shovelthreads[i], NULL);
                 }	
 		      } else {
-                if (shovelthreads.size() > 2) {
+                // The degree counts share the shoveling budget with the
+                // buffers of the outstanding flush threads and the next shovel.
+                size_t shovel_bytes = shovelsize * sizeof(edge_with_value<EdgeDataType>);
+                size_t membudget_b = 1024l * 1024l * size_t(get_option_int("membudget_mb", 1024));
+                size_t inflight_bytes = (shovelthreads.size() + 2) * shovel_bytes + shovel_degrees.bytes();
+                if (shovelthreads.size() > 2 || inflight_bytes > membudget_b) {
                     logstream(LOG_INFO) << "Too many outstanding shoveling threads..." << std::endl;
 
                     for(int i=0; i < (int)shovelthreads.size(); i++) {
@@ -477,7 +576,7 @@ namespace graphchi {
         /**
          * Add edge to be preprocessed with a value.
          */
-        void preprocessing_add_edge(vid_t from, vid_t to, EdgeDataType val, bool input_value=false) {
+        virtual void preprocessing_add_edge(vid_t from, vid_t to, EdgeDataType val, bool input_value=false) {
             if (from == to) {
                 // Do not allow self-edges
                 return;
@@ -588,6 +687,9 @@ namespace graphchi {
         int execute_sharding(std::string nshards_string) {
             m.start_time("execute_sharding");
             
+            if (reorder_method != "none") {
+                reorder_vertices();
+            }
             determine_number_of_shards(nshards_string);
             write_shards();
             
@@ -605,6 +707,126 @@ namespace graphchi {
          */
     protected:
         
+        /**
+         * Reordering stage: computes a vertex permutation with the method given
+         * in option "reorder" (see vertex_reorder.hpp), saves it and relabels
+         * the shovels before the intervals are computed.
+         * The orderings need the degrees or the whole graph, so the permutation
+         * is known only after shoveling: relabeling costs one more pass that
+         * reads, re-sorts and rewrites every shovel (and every source-sorted
+         * shovel with buildsrcfile), see vertex_reorder.hpp.
+         */
+        void reorder_vertices() {
+            m.start_time("reorder");
+            size_t n = 1 + (size_t)max_vertex_id;
+            std::vector<size_t> deg(n);
+            size_t nedges = 0;
+            for(size_t v=0; v < n; v++) {
+                degree d = shovel_degrees.get((vid_t)v);
+                deg[v] = d.indegree + d.outdegree;
+                nedges += d.indegree;
+            }
+            
+            std::string method = reorder_method;
+            size_t membudget_b = (size_t) get_option_int("membudget_mb", 1024) * 1024 * 1024;
+            if (method != "degree" && reorder_csr::memory_needed(n, nedges) > membudget_b) {
+                logstream(LOG_WARNING) << "Graph does not fit in membudget_mb for '" << method
+                    << "' ordering, falling back to degree ordering." << std::endl;
+                method = "degree";
+            }
+            logstream(LOG_INFO) << "Reordering " << n << " vertices, method: " << method << std::endl;
+            
+            std::vector<vid_t> order;
+            if (method == "degree") {
+                order_by_degree_desc(deg, order, sort_threads);
+            } else {
+                reorder_csr g;
+                g.init(deg);
+                for(int i=0; i < numshovels; i++) {
+                    size_t numedges = 0;
+                    edge_t * buf = load_shovel(shovel_filename(i), numedges);
+                    for(size_t j=0; j < numedges; j++) g.add_edge(buf[j].src, buf[j].dst);
+                    free(buf);
+                }
+                g.done();
+                if (method == "bfs") {
+                    std::vector<vid_t> starts;
+                    order_by_degree_desc(deg, starts, sort_threads);
+                    order_bfs(g, starts, false, order);
+                } else if (method == "rcm") {
+                    order_rcm(g, deg, order, sort_threads);
+                } else if (method == "community") {
+                    order_community(g, deg, order, sort_threads, get_option_int("reorder.rounds", 10));
+                } else {
+                    logstream(LOG_FATAL) << "Unknown reorder method: " << method << ". Use degree, bfs, rcm or community." << std::endl;
+                    assert(false);
+                }
+            }
+            
+            vertex_permutation perm;
+            perm.from_order(order);
+            perm.save(filename_vertex_permutation(basefilename));
+            perm.save_vmap(filename_vertex_map(basefilename));
+            std::vector<vid_t>().swap(order);
+            
+            relabel_shovels(perm);
+            shovel_degrees.permute(perm);
+            m.stop_time("reorder");
+        }
+        
+        edge_t * load_shovel(std::string fname, size_t &numedges) {
+            size_t sz = get_filesize(fname);
+            numedges = sz / sizeof(edge_t);
+            edge_t * buf = (edge_t *) malloc(std::max(sz, sizeof(edge_t)));
+            int f = open(fname.c_str(), O_RDONLY);
+            assert(f >= 0);
+            preada(f, buf, sz, 0);
+            close(f);
+            return buf;
+        }
+        
+        void relabel_shovel(std::string fname, const vertex_permutation &perm, bool bysrc, double &span_before, double &span_after) {
+            size_t numedges = 0;
+            edge_t * buf = load_shovel(fname, numedges);
+            for(size_t j=0; j < numedges; j++) {
+                span_before += (double) (buf[j].src > buf[j].dst ? buf[j].src - buf[j].dst : buf[j].dst - buf[j].src);
+                buf[j].src = perm.to_new(buf[j].src);
+                buf[j].dst = perm.to_new(buf[j].dst);
+                span_after += (double) (buf[j].src > buf[j].dst ? buf[j].src - buf[j].dst : buf[j].dst - buf[j].src);
+            }
+            if (bysrc) {
+                piSort(buf, (intT)numedges, (intT)max_vertex_id, srcF<EdgeDataType>(), sort_threads);
+            } else {
+                piSort(buf, (intT)numedges, (intT)max_vertex_id, dstF<EdgeDataType>(), sort_threads);
+            }
+            int f = open(fname.c_str(), O_WRONLY);
+            assert(f >= 0);
+            pwritea(f, buf, numedges * sizeof(edge_t), 0);
+            close(f);
+            free(buf);
+        }
+        
+        void relabel_shovels(const vertex_permutation &perm) {
+            double span_before = 0, span_after = 0, unused = 0;
+            size_t nbytes = shoveled_edges_total() * sizeof(edge_t) * (build_srcfile ? 2 : 1);
+            logstream(LOG_INFO) << "Relabeling the shovels: reads and rewrites " << nbytes / 1024.0 / 1024.0 << " MB." << std::endl;
+            for(int i=0; i < numshovels; i++) {
+                relabel_shovel(shovel_filename(i), perm, false, span_before, span_after);
+                if (build_srcfile) {
+                    relabel_shovel(shovel_filename(i) + "s", perm, true, unused, unused);
+                }
+            }
+            size_t nedges = std::max(shoveled_edges_total(), (size_t)1);
+            logstream(LOG_INFO) << "Average edge span |src - dst| before reordering: " << span_before / nedges
+                << ", after: " << span_after / nedges << std::endl;
+        }
+        
+        size_t shoveled_edges_total() {
+            size_t tot = 0;
+            for(int i=0; i < (int)shoveltasks.size(); i++) tot += shoveltasks[i]->numedges;
+            return tot;
+        }
+        
         virtual void determine_number_of_shards(std::string nshards_string) {
             /* Count shoveled edges */
             shoveled_edges = 0;
@@ -710,7 +932,7 @@ namespace graphchi {
             
             m.start_time("finish_shard.sort");
 #ifndef DYNAMICEDATA
-            iSort(shovelbuf, (int)numedges, max_vertex_id, srcF<EdgeDataType>());
+            piSort(shovelbuf, (intT)numedges, (intT)max_vertex_id, srcF<EdgeDataType>(), sort_threads);
 #else
             quickSort(shovelbuf, (int)numedges, edge_t_src_less<EdgeDataType>);
 #endif
@@ -1038,248 +1260,65 @@ namespace graphchi {
 			
 		//construct intervals before write_shards!
        ///////////////////////////////////////////////////
-		void buildsrcfile(size_t membudget, size_t Bsize){
-			int numv = membudget/(numshovels*8*2);
-			numv *= 2;
+		// Writes the src-sorted edge list as a binary sorted edge stream
+		// (see sorted_edgestream.hpp); read it back with filetype=sortededges.
+		void buildsrcfile(size_t Bsize){
 			edge_with_value<EdgeDataType> edge1;
-			vid_t* ebuffer	= (vid_t*)malloc(sizeof(vid_t)*numv);
-			bool flag = false;
-			int i=0;
-			int count = 0;
-			std::string tmpname = shovel_filename(0)+"x";
-			FILE* fp = fopen(tmpname.c_str(), "a+");
+			bool compress = get_option_int("sortededges.compress", 1) != 0;
+			sorted_edgestream_writer<EdgeDataType> writer(filename_sorted_edgestream(basefilename), !no_edgevalues, compress);
+			
 		    std::vector< merge_source<edge_with_value<EdgeDataType> > *> sources1;
 			for(int i = 0; i < numshovels; i++){
 				sources1.push_back(new shovel_merge_source<EdgeDataType>(Bsize, shovel_filename(i)+"s"));
 			}
 
-		    //myway_merge<edge_with_value<EdgeDataType>, dstF<EdgeDataType> > merger1(sources1, dstF<EdgeDataType>());
 		    myway_merge<edge_with_value<EdgeDataType>, srcF<EdgeDataType> > merger1(sources1, srcF<EdgeDataType>());
-			flag = merger1.getedge2(edge1);
-			logstream(LOG_INFO)<<"in buildsrcfile:::edge1.src"<<edge1.src<<"----------------------------"<<edge1.dst<<"numv::"<<numv<<std::endl;
-			while(flag){
-				count++;
-				ebuffer[i] = edge1.src;
-				ebuffer[i+1] = edge1.dst;
-				i += 2;	
-			//	logstream(LOG_INFO)<<"i"<<i/2<<"==============edge.src"<<edge1.src<<"-->"<<edge1.dst<<std::endl;
-				if(numv == i ){
-					for(int k = 0; k < i; k+=2){
-						fprintf(fp , "%u\t%u\n" , ebuffer[k], ebuffer[k+1]);
-						//logstream(LOG_INFO)<<"in for loop k"<<k<<"edge:::"<<ebuffer[k]<<"->"<<ebuffer[k+1]<<std::endl;
-						//assert( k < 200);
-					}
-					i=0;
-				}
-				flag = merger1.getedge2(edge1);
-				/*
-				fclose(fp);
-				free(ebuffer);
-		   		for(int i=0; i < (int)sources1.size(); i++) {
-			//	((shovel_merge_source<EdgeDataType> *)sources1[i])->deleteshovel();
-			//	((shovel_merge_source<EdgeDataType> *)sources2[i])->deleteshovel();
-                delete (shovel_merge_source<EdgeDataType> *)sources1[i];
-            	}
-				assert(false);
-				*/
-			}
-			if(i != 0){
-				for(int k=0; k < i; k += 2){
-					fprintf(fp , "%u\t%u\n" ,ebuffer[k], ebuffer[k+1]);
-				}
+			while(merger1.getedge2(edge1)){
+				writer.add(edge1.src, edge1.dst, edge1.value);
 			}
-			fclose(fp);
-			free(ebuffer);
+			writer.close();
+			
 		   for(int i=0; i < (int)sources1.size(); i++) {
-			//	((shovel_merge_source<EdgeDataType> *)sources1[i])->deleteshovel();
-			//	((shovel_merge_source<EdgeDataType> *)sources2[i])->deleteshovel();
+				((shovel_merge_source<EdgeDataType> *)sources1[i])->deleteshovel();
                 delete (shovel_merge_source<EdgeDataType> *)sources1[i];
             }
-			//assert(false);
 		}
 
-
 			std::vector<vid_t> intervalarray;
 		// notice: membudget is in Bytes
-		void constructAll(size_t membudget, size_t Bsize){
-				gindex = 1;
+		// Intervals are computed in one linear scan over the degrees counted
+		// while the shovels were flushed (see shovel_degree_counter).
+		void constructAll(size_t membudget){
+			gindex = 1;
 			intervalend = 0;
-		    std::vector< merge_source<edge_with_value<EdgeDataType> > *> sources1;
-            std::vector< merge_source<edge_with_value<EdgeDataType> > *> sources2;
-		
-            for(int i=0; i < numshovels; i++) {
-              	sources1.push_back(new shovel_merge_source<EdgeDataType>(Bsize, shovel_filename(i)));
-                sources2.push_back(new shovel_merge_source<EdgeDataType>(Bsize, shovel_filename(i)+"s"));
-			//	logstream(LOG_INFO)<<"in construct All ,insert id:"<<i<<std::endl;
-            }
 			
-		    myway_merge<edge_with_value<EdgeDataType>, dstF<EdgeDataType> > merger1(sources1, dstF<EdgeDataType>());
-            myway_merge<edge_with_value<EdgeDataType>, srcF<EdgeDataType> > merger2(sources2, srcF<EdgeDataType>());
-
-            int indeg=0;
-            int outdeg=0;
-			size_t memsum=0;
-			vid_t curid = 0;
-			vid_t previd = 0;
 			size_t Bdeg=sizeof(svertex_t);
 			size_t Kdeg=sizeof(EdgeDataType) + sizeof(vid_t) + sizeof(graphchi_edge<EdgeDataType>);
 			logstream(LOG_INFO)<<"Kdeg::"<<Kdeg<<"\tBdeg::"<<Bdeg<<std::endl;
-        	edge_with_value<EdgeDataType>  outedge;
-        	edge_with_value<EdgeDataType>  inedge;
-			bool flagin = false;
-			bool flagout = false;
-			flagin = merger1.getedge2(inedge);
-			flagout = merger2.getedge2(outedge);
-
-			curid = (outedge.src > inedge.dst) ? inedge.dst : outedge.src;
-			intervalarray.push_back(curid);
-			int i=0;	
-			//kway_merge
-			while(flagin && flagout) {
-				i++;
-				if(inedge.dst == outedge.src){
-					if(inedge.dst != curid){
-						assert(inedge.dst > curid);
-						// some vertices is isolated!
-						while(curid < inedge.dst){
-							memsum += Kdeg*(indeg + outdeg) + Bdeg;
-							//logstream(LOG_INFO)<<"veid"<<curid<<"\t indeg"<<indeg<<"\t outdeg"<<outdeg<<std::endl;
-							if(memsum > membudget){
-								logstream(LOG_INFO)<<"1memreq======"<<memsum-(Kdeg*(indeg + outdeg) + Bdeg)<<"\t membudget:"<<membudget<<"\t push id:"<<previd<<std::endl;
-								intervalarray.push_back(previd);
-								memsum = Kdeg*(indeg + outdeg ) + Bdeg;
-							}
-							previd = curid;
-							curid++;
-							indeg = outdeg = 0; 
-						}
-						//curid = inedge.dst;
-						indeg = outdeg = 1; 
-					}else{
-						indeg++; outdeg++;
-					}
-					flagin = merger1.getedge2(inedge);
-					flagout = merger2.getedge2(outedge);
-				}else if(inedge.dst < outedge.src){
-					if(inedge.dst != curid){
-						//	logstream(LOG_INFO)<<"2inedge->dst"<<inedge->dst<<"\t outedge->src"<<outedge->src<<"------curid"<<curid<<"\t previd"<<previd<<std::endl;
-						assert(inedge.dst >curid);
-						while(curid < inedge.dst){	
-							memsum += Kdeg*(indeg + outdeg) + Bdeg;
-
-							//logstream(LOG_INFO)<<"veid"<<curid<<"\t indeg"<<indeg<<"\t outdeg"<<outdeg<<std::endl;
-							if(memsum > membudget){
-								logstream(LOG_INFO)<<"2memreq======"<<memsum-(Kdeg*(indeg + outdeg) + Bdeg)<<"\t membudget:"<<membudget<<"\t push id:"<<previd<<std::endl;
-								intervalarray.push_back(previd);
-								memsum = Kdeg*(indeg + outdeg ) + Bdeg;
-							}
-							previd = curid;
-							curid++;
-							indeg = outdeg = 0;
-						}
-						indeg=1; outdeg=0;
-						//curid = inedge.dst;
-					}else{
-						indeg++;		
-					}
-					flagin = merger1.getedge2(inedge);	
-				}else{
-					if(outedge.src != curid ){
-						//	logstream(LOG_INFO)<<"3inedge->dst"<<inedge->dst<<"\t outedge->src"<<outedge->src<<"------curid"<<curid<<"\t previd"<<previd<<std::endl;
-						assert(outedge.src > curid);
-						while(curid < outedge.src){
-							memsum += Kdeg*(outdeg + indeg) + Bdeg;
-
-							//logstream(LOG_INFO)<<"veid"<<curid<<"\t indeg"<<indeg<<"\t outdeg"<<outdeg<<std::endl;
-							if(memsum > membudget){
-								logstream(LOG_INFO)<<"3memreq======"<<memsum-(Kdeg*(indeg + outdeg) + Bdeg)<<"\t membudget:"<<membudget<<"\t push id:"<<previd<<std::endl;
-								intervalarray.push_back(previd);
-								memsum = Kdeg*(indeg + outdeg ) + Bdeg;
-							}
-							previd = curid;
-							curid++;
-							indeg = outdeg = 0;
-						}
-						outdeg = 1; indeg=0;
-						//curid = outedge.src;
-					}else{
-						outdeg++;
-					}
-					flagout = merger2.getedge2(outedge);
-				}
-			};
-				//assert(false);	
-			while(flagin){
-					i++;
-				if(inedge.dst != curid){
-					assert(inedge.dst > curid);
-					while(curid < inedge.dst){
-					memsum += Kdeg*(indeg + outdeg) + Bdeg;
-					if(memsum > membudget){
-						logstream(LOG_INFO)<<"4memreq======"<<memsum-(Kdeg*(indeg + outdeg) + Bdeg)<<"\t membudget:"<<membudget<<"\t push id:"<<previd<<std::endl;
-							intervalarray.push_back(previd);
-							memsum = Kdeg*(indeg + outdeg ) + Bdeg;
-					}
-					previd = curid;
-					curid++;
-					indeg = outdeg = 0;
-					}
-					indeg = 1; outdeg = 0;
-					//curid = inedge.dst;
-				}else{
-					indeg++;			
-				}
-				flagin = merger1.getedge2(inedge);		
-			};
-			while(flagout){
-					i++;
-				if(outedge.src != curid){
-					assert(outedge.src >curid);
-					while(curid < outedge.src){
-					memsum += Kdeg*(indeg + outdeg) + Bdeg;
-					if(memsum > membudget){
-						logstream(LOG_INFO)<<"5memreq======"<<memsum-(Kdeg*(indeg + outdeg) + Bdeg)<<"\t membudget:"<<membudget<<"\t push id:"<<previd<<std::endl;
-							intervalarray.push_back(previd);
-							memsum = Kdeg*(indeg + outdeg ) + Bdeg;
-					}
-					previd = curid;
-					curid++;
-					indeg = outdeg = 0;
-					}
-					outdeg = 1; indeg = 0;
-					//curid = outedge.src;
-				}else{
-					outdeg++;
-				}
-				flagout = merger2.getedge2(outedge);
-			};
-			while(curid <= max_vertex_id){
-				memsum += Kdeg*(indeg + outdeg) + Bdeg;
+			
+			// Intervals start from the first vertex that has any edges
+			size_t curid = 0;
+			while (curid < max_vertex_id) {
+				degree d = shovel_degrees.get((vid_t)curid);
+				if (d.indegree + d.outdegree > 0) break;
+				curid++;
+			}
+			intervalarray.push_back((vid_t)curid);
+			
+			size_t memsum = 0;
+			vid_t previd = 0;
+			for(; curid <= max_vertex_id; curid++) {
+				degree d = shovel_degrees.get((vid_t)curid);
+				size_t memreq = Kdeg*(d.indegree + d.outdegree) + Bdeg;
+				memsum += memreq;
 				if(memsum > membudget){
-					logstream(LOG_INFO)<<"6memreq======"<<memsum-(Kdeg*(indeg + outdeg) + Bdeg)<<"\t membudget:"<<membudget<<"\t push id:"<<previd<<std::endl;
+					logstream(LOG_INFO)<<"memreq======"<<memsum-memreq<<"\t membudget:"<<membudget<<"\t push id:"<<previd<<std::endl;
 					intervalarray.push_back(previd);
-					//intervalarray.push_back(curid);
-					memsum = Kdeg*(indeg + outdeg) + Bdeg;
+					memsum = memreq;
 				}
-					previd = curid;
-					curid++;
-					indeg = outdeg = 0;
-				//	intervalarray.push_back(curid);
+				previd = (vid_t)curid;
 			}
 			intervalarray.push_back(previd);
-			/*	
-		//	logstream(LOG_INFO)<<"in constructAll ----------------------------before destruct!!!!!!!!::edges number::"<<i<<std::endl;
-			for(int k=0; k<(int)intervalarray.size(); k++){
-			logstream(LOG_INFO)<<"interval end vertex id"<<intervalarray[k]<<"\t maxVid::"<<max_vertex_id<<"\tcurid ::"<<curid<<std::endl;	
-			}
-			*/
-				  // Delete sources
-            for(int i=0; i < (int)sources2.size(); i++) {
-			//	((shovel_merge_source<EdgeDataType> *)sources1[i])->deleteshovel();
-				((shovel_merge_source<EdgeDataType> *)sources2[i])->deleteshovel();
-                delete (shovel_merge_source<EdgeDataType> *)sources1[i];
-                delete (shovel_merge_source<EdgeDataType> *)sources2[i];
-            }
 		}
 		///////////////////////////////////////////////////////
         
@@ -1296,15 +1335,6 @@ namespace graphchi {
             // of the vertex degrees in-memory (heuristic)
             bool count_degrees_inmem = membudget_mb * 1024 * 1024 / 3 > max_vertex_id * sizeof(degree);
             degrees = NULL;
-			if (count_degrees_inmem) {
-                degrees = (degree *) calloc(1 + max_vertex_id, sizeof(degree));
-            }
-
-			/*
-			if (count_degrees_inmem) {
-                degrees = (degree *) calloc(1 + max_vertex_id, sizeof(degree));
-            }	
-			*/
 #ifdef DYNAMICEDATA
             if (!count_degrees_inmem) {
                 /* Temporary: force in-memory count of degrees because the PSW-based computation
@@ -1335,14 +1365,21 @@ namespace graphchi {
 			size_t Bsize = B/2-sizeof(edge_with_value<EdgeDataType>);
 			while(Bsize % sizeof(edge_with_value<EdgeDataType>) != 0) Bsize++;
 			// generate edgelist file ordered by src id for other purposes
-			//buildsrcfile(membudget_b, Bsize);
+			if (build_srcfile) {
+				buildsrcfile(Bsize);
+			}
 
 			if(prange.size() == 0){
-				constructAll(membudget_b, Bsize);
+				constructAll(membudget_b);
 				///////////////////////////////////////////
 				// change number of shards
 				nshards = intervalarray.size()-1;
-			}/*else{
+			}
+			
+			// The shoveling degree counts are not needed after this point:
+			// reuse their array for the final counts instead of allocating another.
+			degrees = shovel_degrees.release(count_degrees_inmem ? 1 + (size_t)max_vertex_id : 0);
+			/*else{
 				for(int i=0; i<(int)prange.size(); i+=2){
 					intervalarray.push_back(prange[i]);		
 				}
@@ -0,0 +1,308 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Binary, block-framed stream of sorted edges. The file starts with
+ * a sorted_edgestream_header, followed by blocks. Each block has a
+ * small sorted_edgestream_block header and a payload of packed
+ * (src, dst[, value]) records, optionally zlib-compressed.
+ * The sharder writes one of these in buildsrcfile(), and the converters
+ * can read it back with filetype=sortededges.
+ */
+
+#ifndef DEF_GRAPHCHI_SORTED_EDGESTREAM
+#define DEF_GRAPHCHI_SORTED_EDGESTREAM
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <zlib.h>
+#include <string>
+#include <algorithm>
+
+#include "graphchi_types.hpp"
+#include "api/chifilenames.hpp"
+#include "logger/logger.hpp"
+#include "util/ioutil.hpp"
+
+namespace graphchi {
+
+#define SORTED_EDGESTREAM_MAGIC    0x53454347   // "GCES"
+#define SORTED_EDGESTREAM_VERSION  1
+
+    enum sorted_edgestream_flags { SORTED_EDGESTREAM_COMPRESSED = 1, SORTED_EDGESTREAM_HAS_VALUES = 2 };
+
+    struct sorted_edgestream_header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t flags;
+        uint32_t value_size;
+        uint64_t num_edges;
+        uint32_t edges_per_block;
+        vid_t max_vertex;
+    };
+
+    struct sorted_edgestream_block {
+        uint32_t num_edges;
+        uint32_t raw_bytes;
+        uint32_t stored_bytes;    // == raw_bytes if the block was not compressed
+        uint32_t reserved;
+    };
+
+    template <typename EdgeDataType>
+    class sorted_edgestream_writer {
+
+        std::string filename;
+        int f;
+        size_t fpos;
+        sorted_edgestream_header header;
+        size_t record_size;
+
+        char * blockbuf;
+        char * blockptr;
+        uint32_t block_edges;
+
+        unsigned char * zbuf;
+        size_t zbuf_size;
+
+    public:
+        sorted_edgestream_writer(std::string filename, bool with_values, bool compressed,
+                                 uint32_t edges_per_block = 1024 * 1024) : filename(filename) {
+            f = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
+            if (f < 0) {
+                logstream(LOG_ERROR) << "Could not open " << filename << " error: " << strerror(errno) << std::endl;
+            }
+            assert(f >= 0);
+
+            memset(&header, 0, sizeof(header));
+            header.magic = SORTED_EDGESTREAM_MAGIC;
+            header.version = SORTED_EDGESTREAM_VERSION;
+            header.flags = (compressed ? SORTED_EDGESTREAM_COMPRESSED : 0) | (with_values ? SORTED_EDGESTREAM_HAS_VALUES : 0);
+            header.value_size = with_values ? sizeof(EdgeDataType) : 0;
+            header.edges_per_block = edges_per_block;
+
+            record_size = 2 * sizeof(vid_t) + header.value_size;
+            blockbuf = (char *) malloc(record_size * edges_per_block);
+            blockptr = blockbuf;
+            block_edges = 0;
+
+            zbuf_size = compressed ? compressBound(record_size * edges_per_block) : 0;
+            zbuf = compressed ? (unsigned char *) malloc(zbuf_size) : NULL;
+
+            /* Header is rewritten with the final counts on close() */
+            writea(f, &header, sizeof(header));
+            fpos = sizeof(header);
+        }
+
+        ~sorted_edgestream_writer() {
+            if (f >= 0) close();
+        }
+
+        void add(vid_t src, vid_t dst, EdgeDataType value) {
+            memcpy(blockptr, &src, sizeof(vid_t));
+            memcpy(blockptr + sizeof(vid_t), &dst, sizeof(vid_t));
+            if (header.value_size > 0) {
+                memcpy(blockptr + 2 * sizeof(vid_t), &value, sizeof(EdgeDataType));
+            }
+            blockptr += record_size;
+            header.num_edges++;
+            header.max_vertex = std::max(header.max_vertex, std::max(src, dst));
+            if (++block_edges == header.edges_per_block) {
+                flush_block();
+            }
+        }
+
+        void flush_block() {
+            if (block_edges == 0) return;
+            sorted_edgestream_block bh;
+            bh.num_edges = block_edges;
+            bh.raw_bytes = (uint32_t) (blockptr - blockbuf);
+            bh.stored_bytes = bh.raw_bytes;
+            bh.reserved = 0;
+
+            const void * payload = blockbuf;
+            if (zbuf != NULL) {
+                uLongf zlen = (uLongf) zbuf_size;
+                int ret = compress2(zbuf, &zlen, (const Bytef *) blockbuf, bh.raw_bytes, Z_BEST_SPEED);
+                assert(ret == Z_OK);
+                // Incompressible blocks are stored as-is
+                if (zlen < bh.raw_bytes) {
+                    bh.stored_bytes = (uint32_t) zlen;
+                    payload = zbuf;
+                }
+            }
+            writea(f, &bh, sizeof(bh));
+            writea(f, (char *) payload, bh.stored_bytes);
+            fpos += sizeof(bh) + bh.stored_bytes;
+
+            blockptr = blockbuf;
+            block_edges = 0;
+        }
+
+        size_t num_edges() {
+            return header.num_edges;
+        }
+
+        void close() {
+            flush_block();
+            pwritea(f, &header, sizeof(header), 0);
+            ::close(f);
+            f = -1;
+            free(blockbuf);
+            blockbuf = NULL;
+            if (zbuf != NULL) free(zbuf);
+            zbuf = NULL;
+            logstream(LOG_INFO) << "Wrote " << header.num_edges << " sorted edges (" << fpos << " bytes) to " << filename << std::endl;
+        }
+    };
+
+
+    template <typename EdgeDataType>
+    class sorted_edgestream_reader {
+
+        std::string filename;
+        int f;
+        size_t fpos;
+        size_t fsize;
+        sorted_edgestream_header header;
+        size_t record_size;
+
+        char * blockbuf;
+        char * blockptr;
+        uint32_t block_remaining;
+        unsigned char * zbuf;
+        size_t zbuf_size;
+
+    public:
+        sorted_edgestream_reader(std::string filename) : filename(filename), block_remaining(0) {
+            f = open(filename.c_str(), O_RDONLY);
+            if (f < 0) {
+                logstream(LOG_ERROR) << "Could not open " << filename << " error: " << strerror(errno) << std::endl;
+            }
+            assert(f >= 0);
+            fsize = lseek(f, 0, SEEK_END);
+
+            preada(f, &header, sizeof(header), 0);
+            fpos = sizeof(header);
+            if (header.magic != SORTED_EDGESTREAM_MAGIC || header.version != SORTED_EDGESTREAM_VERSION) {
+                logstream(LOG_FATAL) << filename << " is not a sorted edge stream (version " << SORTED_EDGESTREAM_VERSION << ")." << std::endl;
+                assert(false);
+            }
+            if (header.value_size != 0 && header.value_size != sizeof(EdgeDataType)) {
+                logstream(LOG_FATAL) << "Edge value size mismatch in " << filename << ": file has " << header.value_size
+                    << " bytes, reader expects " << sizeof(EdgeDataType) << std::endl;
+                assert(false);
+            }
+
+            record_size = 2 * sizeof(vid_t) + header.value_size;
+            blockbuf = (char *) malloc(record_size * header.edges_per_block);
+            blockptr = blockbuf;
+            zbuf_size = compressBound(record_size * header.edges_per_block);
+            zbuf = (header.flags & SORTED_EDGESTREAM_COMPRESSED) ? (unsigned char *) malloc(zbuf_size) : NULL;
+        }
+
+        ~sorted_edgestream_reader() {
+            ::close(f);
+            free(blockbuf);
+            if (zbuf != NULL) free(zbuf);
+        }
+
+        size_t num_edges() {
+            return header.num_edges;
+        }
+
+        vid_t max_vertex() {
+            return header.max_vertex;
+        }
+
+        bool has_values() {
+            return header.value_size > 0;
+        }
+
+        /**
+         * Reads the next edge. Returns false at the end of the stream.
+         * If the stream has no values, value is left untouched.
+         */
+        bool next(vid_t &src, vid_t &dst, EdgeDataType &value) {
+            if (block_remaining == 0 && !load_next_block()) {
+                return false;
+            }
+            memcpy(&src, blockptr, sizeof(vid_t));
+            memcpy(&dst, blockptr + sizeof(vid_t), sizeof(vid_t));
+            if (header.value_size > 0) {
+                memcpy(&value, blockptr + 2 * sizeof(vid_t), sizeof(EdgeDataType));
+            }
+            blockptr += record_size;
+            block_remaining--;
+            return true;
+        }
+
+        /**
+         * Reads the next edge, skipping its value if the stream has one.
+         */
+        bool next(vid_t &src, vid_t &dst) {
+            if (block_remaining == 0 && !load_next_block()) {
+                return false;
+            }
+            memcpy(&src, blockptr, sizeof(vid_t));
+            memcpy(&dst, blockptr + sizeof(vid_t), sizeof(vid_t));
+            blockptr += record_size;
+            block_remaining--;
+            return true;
+        }
+
+    private:
+        bool load_next_block() {
+            if (fpos + sizeof(sorted_edgestream_block) > fsize) return false;
+            sorted_edgestream_block bh;
+            preada(f, &bh, sizeof(bh), fpos);
+            fpos += sizeof(bh);
+            assert(bh.raw_bytes == bh.num_edges * record_size);
+
+            if (bh.stored_bytes == bh.raw_bytes) {
+                preada(f, blockbuf, bh.stored_bytes, fpos);
+            } else {
+                assert(zbuf != NULL && bh.stored_bytes <= zbuf_size);
+                preada(f, zbuf, bh.stored_bytes, fpos);
+                uLongf rawlen = bh.raw_bytes;
+                int ret = uncompress((Bytef *) blockbuf, &rawlen, zbuf, bh.stored_bytes);
+                if (ret != Z_OK || rawlen != bh.raw_bytes) {
+                    logstream(LOG_FATAL) << "Corrupted block at offset " << fpos << " in " << filename << std::endl;
+                    assert(false);
+                }
+            }
+            fpos += bh.stored_bytes;
+            blockptr = blockbuf;
+            block_remaining = bh.num_edges;
+            return block_remaining > 0 || load_next_block();
+        }
+    };
+
+}
+
+#endif
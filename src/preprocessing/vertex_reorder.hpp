@@ -0,0 +1,324 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Vertex orderings for the sharder's reordering stage (option "reorder"):
+ *   degree     -- by descending total degree
+ *   bfs        -- breadth-first order, components started from the hubs
+ *   rcm        -- reverse Cuthill-McKee
+ *   community  -- label propagation communities, laid out contiguously
+ *                 (in the spirit of Rabbit order), BFS order inside
+ *                 each community.
+ * The resulting permutation is stored in binary in <base>.vperm and can be
+ * loaded with vertex_permutation::load() for translating ids both ways.
+ * It is also written as text to <base>.reorder.vmap, one "old_vid new_vid"
+ * pair per line like the other .vmap files, so that results computed on the
+ * shards can be reported in the original ids.
+ *
+ * Cost: every ordering, degree included, needs the degrees of the whole
+ * graph, so the permutation is known only after all edges have been
+ * shoveled. The sharder then reads, relabels, re-sorts and rewrites every
+ * shovel once more: an extra read and write of the edge list, doubled with
+ * buildsrcfile (which keeps a second copy sorted by source). bfs, rcm and
+ * community also read the shovels once to build the graph in memory,
+ * falling back to degree if it does not fit in membudget_mb.
+ */
+
+#ifndef GRAPHCHI_VERTEX_REORDER_DEF
+#define GRAPHCHI_VERTEX_REORDER_DEF
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <omp.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "graphchi_types.hpp"
+#include "api/chifilenames.hpp"
+#include "logger/logger.hpp"
+#include "util/ioutil.hpp"
+#include "util/radixSort.hpp"
+
+namespace graphchi {
+
+#define VERTEX_PERMUTATION_MAGIC 0x50455256   // "VREP"
+
+    /**
+     * Bijection between the original vertex ids and the ids used in the shards.
+     * Both directions are kept in memory, so lookups are O(1).
+     */
+    class vertex_permutation {
+        std::vector<vid_t> newids;   // original id -> shard id
+        std::vector<vid_t> oldids;   // shard id -> original id
+
+    public:
+        vertex_permutation() {}
+
+        /* order[i] is the original id of the vertex that gets the new id i */
+        void from_order(const std::vector<vid_t> &order) {
+            oldids = order;
+            newids.resize(order.size());
+            for(size_t i=0; i < order.size(); i++) {
+                newids[order[i]] = (vid_t) i;
+            }
+        }
+
+        size_t size() const {
+            return newids.size();
+        }
+
+        inline vid_t to_new(vid_t original) const {
+            return original < newids.size() ? newids[original] : original;
+        }
+
+        inline vid_t to_old(vid_t newid) const {
+            return newid < oldids.size() ? oldids[newid] : newid;
+        }
+
+        void save(std::string filename) {
+            int f = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
+            if (f < 0) {
+                logstream(LOG_ERROR) << "Could not write vertex permutation: " << filename << " error: " << strerror(errno) << std::endl;
+            }
+            assert(f >= 0);
+            uint64_t hdr[2] = { VERTEX_PERMUTATION_MAGIC, (uint64_t) newids.size() };
+            writea(f, hdr, sizeof(hdr));
+            if (!newids.empty()) {
+                writea(f, &newids[0], newids.size() * sizeof(vid_t));
+                writea(f, &oldids[0], oldids.size() * sizeof(vid_t));
+            }
+            close(f);
+        }
+
+        /* Writes the permutation as text, "old_vid\tnew_vid" per line */
+        void save_vmap(std::string filename) {
+            FILE * f = fopen(filename.c_str(), "w");
+            if (f == NULL) {
+                logstream(LOG_ERROR) << "Could not write vertex map: " << filename << " error: " << strerror(errno) << std::endl;
+            }
+            assert(f != NULL);
+            fprintf(f, "#old_vid\tnew_vid\n");
+            for(size_t v=0; v < newids.size(); v++) {
+                fprintf(f, "%u\t%u\n", (vid_t) v, newids[v]);
+            }
+            fclose(f);
+        }
+
+        bool load(std::string filename) {
+            int f = open(filename.c_str(), O_RDONLY);
+            if (f < 0) return false;
+            uint64_t hdr[2];
+            preada(f, hdr, sizeof(hdr), 0);
+            if (hdr[0] != VERTEX_PERMUTATION_MAGIC) {
+                logstream(LOG_ERROR) << filename << " is not a vertex permutation file." << std::endl;
+                close(f);
+                return false;
+            }
+            size_t n = (size_t) hdr[1];
+            newids.resize(n);
+            oldids.resize(n);
+            if (n > 0) {
+                preada(f, &newids[0], n * sizeof(vid_t), sizeof(hdr));
+                preada(f, &oldids[0], n * sizeof(vid_t), sizeof(hdr) + n * sizeof(vid_t));
+            }
+            close(f);
+            return true;
+        }
+    };
+
+    /**
+     * Undirected CSR used for computing the orderings.
+     */
+    struct reorder_csr {
+        size_t nvertices;
+        std::vector<size_t> offsets;
+        std::vector<size_t> cursor;
+        std::vector<vid_t> adj;
+
+        /* deg[v] is the number of undirected adjacencies of v */
+        void init(const std::vector<size_t> &deg) {
+            nvertices = deg.size();
+            offsets.resize(nvertices + 1);
+            offsets[0] = 0;
+            for(size_t v=0; v < nvertices; v++) offsets[v + 1] = offsets[v] + deg[v];
+            cursor.assign(offsets.begin(), offsets.end() - 1);
+            adj.resize(offsets[nvertices]);
+        }
+
+        inline void add_edge(vid_t a, vid_t b) {
+            adj[cursor[a]++] = b;
+            adj[cursor[b]++] = a;
+        }
+
+        void done() {
+            std::vector<size_t>().swap(cursor);
+        }
+
+        inline size_t degree(vid_t v) const {
+            return offsets[v + 1] - offsets[v];
+        }
+
+        static size_t memory_needed(size_t nvertices, size_t nedges) {
+            return (2 * nvertices + 1) * sizeof(size_t) + 2 * nedges * sizeof(vid_t);
+        }
+    };
+
+    struct reorder_degree_key {
+        const std::vector<size_t> * deg;
+        size_t maxdeg;
+        reorder_degree_key(const std::vector<size_t> * deg, size_t maxdeg) : deg(deg), maxdeg(maxdeg) {}
+        inline size_t operator() (vid_t v) { return maxdeg - (*deg)[v]; }
+    };
+
+    /* Vertices by descending degree, ties by id (radix sort is stable) */
+    static VARIABLE_IS_NOT_USED void order_by_degree_desc(const std::vector<size_t> &deg, std::vector<vid_t> &order, int nthreads);
+    static VARIABLE_IS_NOT_USED void order_by_degree_desc(const std::vector<size_t> &deg, std::vector<vid_t> &order, int nthreads) {
+        order.resize(deg.size());
+        size_t maxdeg = 0;
+        for(size_t v=0; v < deg.size(); v++) {
+            order[v] = (vid_t) v;
+            maxdeg = std::max(maxdeg, deg[v]);
+        }
+        if (order.empty()) return;
+        piSort(&order[0], (intT)order.size(), (intT)maxdeg, reorder_degree_key(&deg, maxdeg), nthreads);
+    }
+
+    /**
+     * BFS over all components. Components are started in the order of 'starts'.
+     * If sort_neighbors is set, each vertex's unvisited neighbors are queued by
+     * ascending degree (Cuthill-McKee).
+     */
+    static VARIABLE_IS_NOT_USED void order_bfs(const reorder_csr &g, const std::vector<vid_t> &starts, bool sort_neighbors, std::vector<vid_t> &order);
+    static VARIABLE_IS_NOT_USED void order_bfs(const reorder_csr &g, const std::vector<vid_t> &starts, bool sort_neighbors, std::vector<vid_t> &order) {
+        std::vector<bool> visited(g.nvertices, false);
+        std::vector<std::pair<size_t, vid_t> > nbrs;
+        order.clear();
+        order.reserve(g.nvertices);
+        for(size_t i=0; i < starts.size(); i++) {
+            vid_t s = starts[i];
+            if (visited[s]) continue;
+            visited[s] = true;
+            size_t head = order.size();
+            order.push_back(s);
+            while(head < order.size()) {
+                vid_t v = order[head++];
+                nbrs.clear();
+                for(size_t j=g.offsets[v]; j < g.offsets[v + 1]; j++) {
+                    vid_t w = g.adj[j];
+                    if (!visited[w]) {
+                        visited[w] = true;
+                        nbrs.push_back(std::pair<size_t, vid_t>(sort_neighbors ? g.degree(w) : 0, w));
+                    }
+                }
+                if (sort_neighbors) std::sort(nbrs.begin(), nbrs.end());
+                for(size_t j=0; j < nbrs.size(); j++) order.push_back(nbrs[j].second);
+            }
+        }
+        assert(order.size() == g.nvertices);
+    }
+
+    static VARIABLE_IS_NOT_USED void order_rcm(const reorder_csr &g, const std::vector<size_t> &deg, std::vector<vid_t> &order, int nthreads);
+    static VARIABLE_IS_NOT_USED void order_rcm(const reorder_csr &g, const std::vector<size_t> &deg, std::vector<vid_t> &order, int nthreads) {
+        /* Start each component from a low-degree (peripheral) vertex */
+        std::vector<vid_t> starts;
+        order_by_degree_desc(deg, starts, nthreads);
+        std::reverse(starts.begin(), starts.end());
+        order_bfs(g, starts, true, order);
+        std::reverse(order.begin(), order.end());
+    }
+
+    /**
+     * Label propagation communities; communities are laid out by descending size,
+     * vertices inside a community keep their relative BFS order.
+     */
+    static VARIABLE_IS_NOT_USED void order_community(const reorder_csr &g, const std::vector<size_t> &deg, std::vector<vid_t> &order, int nthreads, int maxrounds);
+    static VARIABLE_IS_NOT_USED void order_community(const reorder_csr &g, const std::vector<size_t> &deg, std::vector<vid_t> &order, int nthreads, int maxrounds) {
+        size_t n = g.nvertices;
+        std::vector<vid_t> label(n), next(n);
+        for(size_t v=0; v < n; v++) label[v] = (vid_t) v;
+
+        for(int round=0; round < maxrounds; round++) {
+            size_t changed = 0;
+#pragma omp parallel num_threads(nthreads) reduction(+:changed)
+            {
+                std::vector<vid_t> nl;
+#pragma omp for schedule(dynamic, 4096)
+                for(long long v=0; v < (long long)n; v++) {
+                    vid_t best = label[v];
+                    if (g.degree((vid_t)v) > 0) {
+                        nl.clear();
+                        for(size_t j=g.offsets[v]; j < g.offsets[v + 1]; j++) nl.push_back(label[g.adj[j]]);
+                        std::sort(nl.begin(), nl.end());
+                        size_t bestcount = 0;
+                        for(size_t j=0; j < nl.size(); ) {
+                            size_t k = j;
+                            while(k < nl.size() && nl[k] == nl[j]) k++;
+                            // Prefer keeping the current label on ties, to damp oscillation
+                            if (k - j > bestcount || (k - j == bestcount && nl[j] == label[v])) {
+                                bestcount = k - j;
+                                best = nl[j];
+                            }
+                            j = k;
+                        }
+                    }
+                    next[v] = best;
+                    if (best != label[v]) changed++;
+                }
+            }
+            label.swap(next);
+            logstream(LOG_DEBUG) << "Label propagation round " << round << ", changed: " << changed << std::endl;
+            if (changed < n / 1000 + 1) break;
+        }
+
+        /* Community sizes and their rank */
+        std::vector<size_t> csize(n, 0);
+        for(size_t v=0; v < n; v++) csize[label[v]]++;
+        std::vector<vid_t> comms;
+        order_by_degree_desc(csize, comms, nthreads);   // by descending size
+        std::vector<vid_t> rank(n);
+        for(size_t i=0; i < n; i++) rank[comms[i]] = (vid_t) i;
+
+        std::vector<vid_t> starts, bfsorder;
+        order_by_degree_desc(deg, starts, nthreads);
+        order_bfs(g, starts, false, bfsorder);
+
+        order.resize(n);
+        std::vector<size_t> pos(n + 1, 0);
+        for(size_t v=0; v < n; v++) pos[rank[label[v]] + 1]++;
+        for(size_t i=0; i < n; i++) pos[i + 1] += pos[i];
+        for(size_t i=0; i < n; i++) {
+            vid_t v = bfsorder[i];
+            order[pos[rank[label[v]]]++] = v;
+        }
+    }
+
+}
+
+#endif
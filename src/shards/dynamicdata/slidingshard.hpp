@@ -161,6 +161,9 @@ namespace graphchi {
         sblock<ET> * curblock;
         sblock<ET> * curadjblock;
         metrics &m;
+        metrics_handle blockload_timer;
+        metrics_handle read_next_vertices_timer;
+        metrics_handle commit_timer;
         
         std::map<int, indexentry> sparse_index; // Sparse index that can be created in the fly
         bool disable_writes;
@@ -190,6 +193,9 @@ namespace graphchi {
             curblock = NULL;
             curadjblock = NULL;
             window_start_edataoffset = 0;
+            blockload_timer = m.register_timer("blockload");
+            read_next_vertices_timer = m.register_timer("read_next_vertices");
+            commit_timer = m.register_timer("commit");
             disable_async_writes = false;
             
             while(blocksize % sizeof(int) != 0) blocksize++;
@@ -310,9 +316,9 @@ namespace graphchi {
                 assert(newblock->end >= newblock->offset);
                 iomgr->managed_malloc(adjfile_session, &newblock->data, newblock->end - newblock->offset, adjoffset);
                 newblock->ptr = newblock->data;
-                metrics_entry me = m.start_time();
+                uint64_t me = m.start_timer();
                 iomgr->managed_preada_now(adjfile_session, &newblock->data, newblock->end - newblock->offset, adjoffset);
-                m.stop_time(me, "blockload");
+                m.stop_timer(blockload_timer, me);
                 curadjblock = newblock;
             }
         }
@@ -353,7 +359,7 @@ namespace graphchi {
         void read_next_vertices(int nvecs, vid_t start,  std::vector<svertex_t> & prealloc, bool record_index=false, bool disable_writes=false)  {
             
             
-            metrics_entry me = m.start_time();
+            uint64_t me = m.start_timer();
             if (!record_index)
                 move_close_to(start);
             
@@ -425,7 +431,7 @@ namespace graphchi {
                 }
                 curvid++;
             }
-            m.stop_time(me, "read_next_vertices");
+            m.stop_timer(read_next_vertices_timer, me);
             curblock = NULL;
         }
         
@@ -436,9 +442,9 @@ namespace graphchi {
         void commit(sblock<ET> &b, bool synchronously, bool disable_writes=false) {
             if (disable_async_writes) synchronously = true;
             if (synchronously) {
-                metrics_entry me = m.start_time();
+                uint64_t me = m.start_timer();
                 if (!disable_writes) b.commit_now(iomgr);
-                m.stop_time(me, "commit");
+                m.stop_timer(commit_timer, me);
                 b.release(iomgr);
             } else {
                 if (!disable_writes) b.commit_async(iomgr);
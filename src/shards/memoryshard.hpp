@@ -86,6 +86,10 @@ namespace graphchi {
         bool enable_parallel_loading;
         size_t blocksize;
         metrics &m;
+        metrics_handle load_timer;
+        metrics_handle create_edges_timer;
+        metrics_handle stream_edges_timer;
+        metrics_handle commit_timer;
         std::vector<shard_index> index;
         
     public:
@@ -108,6 +112,10 @@ namespace graphchi {
             doneptr = NULL;
             enable_parallel_loading = true;
             disable_async_writes = false;
+            load_timer = m.register_timer("memshard_load");
+            create_edges_timer = m.register_timer("memoryshard_create_edges");
+            stream_edges_timer = m.register_timer("memoryshard_stream_edges");
+            commit_timer = m.register_timer("memshard_commit");
             async_edata_loading = !svertex_t().computational_edges();
 #ifdef SUPPORT_DELETIONS
             async_edata_loading = false; // See comment above for memshard, async_edata_loading = false;
@@ -146,7 +154,7 @@ namespace graphchi {
         void commit(bool commit_inedges, bool commit_outedges) {
             if (block_edatasessions.size() == 0 || only_adjacency) return;
             assert(is_loaded);
-            metrics_entry cm = m.start_time();
+            uint64_t cm = m.start_timer();
             
             /**
              * This is an optimization that is relevant only if memory shard
@@ -219,7 +227,7 @@ namespace graphchi {
                 }
             }
             
-            m.stop_time(cm, "memshard_commit");
+            m.stop_timer(commit_timer, cm, range_st, range_end);
             
             iomgr->managed_release(adj_session, &adjdata);
             // FIXME: this is duplicated code from destructor
@@ -335,6 +343,7 @@ namespace graphchi {
         
         // TODO: recycle ptr!
         void load() {
+            uint64_t started = m.start_timer();
             is_loaded = true;
             adjfilesize = get_filesize(filename_adj);
             
@@ -378,13 +387,14 @@ namespace graphchi {
             // Get index
 			//logstream(LOG_INFO)<<"in mem shard load index file``````````"<<std::endl;
             index = load_index();
+            m.stop_timer(load_timer, started, range_st, range_end);
         }
         
         
         
         void load_vertices(vid_t window_st, vid_t window_en, std::vector<svertex_t> & prealloc, bool inedges=true, bool outedges=true) {
             /* Find file size */
-            m.start_time("memoryshard_create_edges");
+            uint64_t started = m.start_timer();
             
             assert(adjdata != NULL);
             
@@ -516,9 +526,92 @@ namespace graphchi {
                     vid++;
                 }
             }
-            m.stop_time("memoryshard_create_edges", false);
+            m.stop_timer(create_edges_timer, started, window_st, window_en);
         }
-        
+
+        /**
+         * Streams the edges of the shard in file order without creating
+         * vertex objects (used by the edge-centric engine). The sparse index
+         * is refined to pieces of about chunkedges edges by walking the vertex
+         * headers, and the pieces are streamed in parallel. Calls
+         * visitor(src, dst, edata) for each edge; edata is NULL if only
+         * adjacency was loaded. Edge data must have been read in first.
+         */
+        template <typename EdgeVisitor>
+        void stream_edges(EdgeVisitor &visitor, size_t chunkedges=65536) {
+            assert(adjdata != NULL);
+            uint64_t started = m.start_timer();
+
+            std::vector<std::vector<shard_index> > pieces(index.size());
+#pragma omp parallel for schedule(dynamic, 1)
+            for(int chunk=0; chunk < (int)index.size(); chunk++) {
+                uint8_t * ptr = adjdata + index[chunk].filepos;
+                uint8_t * end = adjdata + (chunk < (int) index.size() - 1 ? index[chunk + 1].filepos :  adjfilesize);
+                vid_t vid = index[chunk].vertexid;
+                size_t edgecounter = index[chunk].edgecounter;
+                size_t last = edgecounter;
+                pieces[chunk].push_back(index[chunk]);
+                while(ptr < end) {
+                    if (edgecounter - last >= chunkedges) {
+                        pieces[chunk].push_back(shard_index(vid, ptr - adjdata, edgecounter));
+                        last = edgecounter;
+                    }
+                    uint8_t ns = *ptr;
+                    ptr += sizeof(uint8_t);
+                    if (ns == 0x00) {
+                        uint8_t nz = *ptr;
+                        ptr += sizeof(uint8_t);
+                        vid += 1 + nz;
+                        continue;
+                    }
+                    size_t n = ns;
+                    if (ns == 0xff) {
+                        n = *((uint32_t*)ptr);
+                        ptr += sizeof(uint32_t);
+                    }
+                    ptr += n * sizeof(vid_t);
+                    edgecounter += n;
+                    vid++;
+                }
+            }
+            std::vector<shard_index> chunks;
+            for(size_t i=0; i < pieces.size(); i++) {
+                chunks.insert(chunks.end(), pieces[i].begin(), pieces[i].end());
+            }
+
+#pragma omp parallel for schedule(dynamic, 1)
+            for(int chunk=0; chunk < (int)chunks.size(); chunk++) {
+                uint8_t * ptr = adjdata + chunks[chunk].filepos;
+                uint8_t * end = adjdata + (chunk < (int) chunks.size() - 1 ? chunks[chunk + 1].filepos :  adjfilesize);
+                vid_t vid = chunks[chunk].vertexid;
+                size_t edgeptr = chunks[chunk].edgecounter * sizeof(ET);
+                while(ptr < end) {
+                    uint8_t ns = *ptr;
+                    ptr += sizeof(uint8_t);
+                    if (ns == 0x00) {
+                        uint8_t nz = *ptr;
+                        ptr += sizeof(uint8_t);
+                        vid += 1 + nz;
+                        continue;
+                    }
+                    int n = ns;
+                    if (ns == 0xff) {
+                        n = *((uint32_t*)ptr);
+                        ptr += sizeof(uint32_t);
+                    }
+                    while(--n >= 0) {
+                        vid_t target = *((vid_t*) ptr);
+                        ptr += sizeof(vid_t);
+                        ET * eptr = (only_adjacency ? NULL : (ET*) &(edgedata[edgeptr / blocksize][edgeptr % blocksize]));
+                        visitor(vid, target, eptr);
+                        edgeptr += sizeof(ET);
+                    }
+                    vid++;
+                }
+            }
+            m.stop_timer(stream_edges_timer, started, range_st, range_end);
+        }
+
         size_t offset_for_stream_cont() {
             return streaming_offset;
         }
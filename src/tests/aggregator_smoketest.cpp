@@ -0,0 +1,160 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ 
+ *
+ * @section DESCRIPTION
+ *
+ * Smoke test for the iteration aggregators on the on-disk engine. The
+ * update functions run in nested OpenMP teams, which start new threads
+ * on every sub-interval, so this runs many iterations with a small
+ * window to check that the per-thread slots are recycled. If the input
+ * file does not exist, a graph with nvertices vertices is written to it.
+ * The array and matrix aggregators are checked against totals kept
+ * under a lock.
+ */
+
+#include <string>
+#include <vector>
+
+#include "graphchi_basic_includes.hpp"
+#include "tests/test_graphs.hpp"
+
+using namespace graphchi;
+
+typedef vid_t VertexDataType;
+typedef vid_t EdgeDataType;
+
+static const int NOUTEDGES = 4;
+static const int NCELLS = 13;
+static const int NBLOCKS = 5;
+
+counter_aggregator active;
+counter_aggregator outdegrees;
+histogram_aggregator<int> residues;
+sum_aggregator<double> idsum;
+min_aggregator<vid_t> minid;
+max_aggregator<vid_t> maxid;
+array_aggregator<long> indegrees(NCELLS);
+matrix_aggregator<long> blockedges(NBLOCKS, NBLOCKS);
+
+/* Reference totals of the array and matrix aggregators */
+mutex reflock;
+std::vector<long> ref_indegrees;
+std::vector<long> ref_blockedges;
+
+struct AggregatorTestProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
+    int maxslots;
+    
+    AggregatorTestProgram() : maxslots(0) {}
+    
+    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+        active.add();
+        outdegrees.add(vertex.num_outedges());
+        residues.add(vertex.id() % 7);
+        idsum.add((double) vertex.id());
+        minid.add(vertex.id());
+        maxid.add(vertex.id());
+        
+        indegrees.add(vertex.id() % NCELLS, vertex.num_inedges());
+        for(int i=0; i < vertex.num_outedges(); i++) {
+            blockedges.add(vertex.id() % NBLOCKS, vertex.outedge(i)->vertex_id() % NBLOCKS);
+        }
+        reflock.lock();
+        ref_indegrees[vertex.id() % NCELLS] += vertex.num_inedges();
+        for(int i=0; i < vertex.num_outedges(); i++) {
+            ref_blockedges[(vertex.id() % NBLOCKS) * NBLOCKS + vertex.outedge(i)->vertex_id() % NBLOCKS]++;
+        }
+        reflock.unlock();
+    }
+    
+    void before_iteration(int iteration, graphchi_context &gcontext) {
+        ref_indegrees.assign(NCELLS, 0);
+        ref_blockedges.assign(NBLOCKS * NBLOCKS, 0);
+    }
+    
+    void after_iteration(int iteration, graphchi_context &gcontext) {
+        size_t nvertices = gcontext.nvertices;
+        size_t nedges = gcontext.nedges;
+        assert(active.value() == (long) nvertices);
+        assert(outdegrees.value() == (long) nedges);
+        long total = 0;
+        for(int r=0; r < 7; r++) {
+            long expected = (long) (nvertices / 7 + (r < (int) (nvertices % 7)));
+            assert(residues.counts().find(r)->second == expected);
+            total += expected;
+        }
+        assert(total == (long) nvertices);
+        
+        assert(idsum.value() == (double) nvertices * (nvertices - 1) / 2);
+        assert(minid.value() == 0);
+        assert(maxid.value() == (vid_t) (nvertices - 1));
+        
+        long inedges = 0;
+        for(int c=0; c < NCELLS; c++) {
+            assert(indegrees.value(c) == ref_indegrees[c]);
+            inedges += indegrees.value(c);
+        }
+        assert(inedges == (long) nedges);
+        long blocktotal = 0;
+        for(int i=0; i < NBLOCKS; i++) {
+            for(int j=0; j < NBLOCKS; j++) {
+                assert(blockedges.value(i, j) == ref_blockedges[i * NBLOCKS + j]);
+                blocktotal += blockedges.value(i, j);
+            }
+        }
+        assert(blocktotal == (long) nedges);
+        if (thread_slots::count() > maxslots) maxslots = thread_slots::count();
+    }
+};
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+    metrics m("aggregator-smoketest");
+    
+    std::string filename = get_option_string("file");
+    int niters           = get_option_int("niters", 50);
+    vid_t nvertices      = get_option_int("nvertices", 20000);
+    
+    if (!file_exists(filename)) write_test_graph(filename, nvertices, NOUTEDGES);
+    int nshards          = convert_if_notexists<EdgeDataType>(filename, get_option_string("nshards", "auto"));
+    
+    graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, false, m);
+    /* Many sub-intervals, each executed by a new nested team */
+    engine.set_maxwindow(get_option_int("maxwindow", 1000));
+    engine.add_aggregator(&active);
+    engine.add_aggregator(&outdegrees);
+    engine.add_aggregator(&residues);
+    engine.add_aggregator(&idsum);
+    engine.add_aggregator(&minid);
+    engine.add_aggregator(&maxid);
+    engine.add_aggregator(&indegrees);
+    engine.add_aggregator(&blockedges);
+    
+    AggregatorTestProgram program;
+    engine.run(program, niters);
+    
+    logstream(LOG_INFO) << "Used " << program.maxslots << " thread slots in " << niters << " iterations." << std::endl;
+    assert(program.maxslots < MAX_THREAD_SLOTS / 16);
+    
+    metrics_report(m);
+    logstream(LOG_INFO) << "Aggregator smoketest passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,142 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ 
+ *
+ * @section DESCRIPTION
+ *
+ * Test for bitparallel_bfs with a memory budget that fits only one lane
+ * of sources: the sources are run in several sweeps, and the level and
+ * first source of every vertex in a sweep are checked against a BFS from
+ * each source. A budget too small for one lane has to be a fatal error.
+ */
+
+#include <string>
+#include <vector>
+#include <queue>
+
+#include "graphchi_basic_includes.hpp"
+#include "util/bitparallel_bfs.hpp"
+
+using namespace graphchi;
+
+static const int NOUTEDGES = 3;
+
+/* Distances from src over the out-edges, -1 if not reached */
+static void bfs(const std::vector<std::vector<vid_t> > &out, vid_t src, std::vector<int> &dist) {
+    dist.assign(out.size(), -1);
+    std::queue<vid_t> q;
+    dist[src] = 0;
+    q.push(src);
+    while(!q.empty()) {
+        vid_t v = q.front();
+        q.pop();
+        for(size_t i=0; i < out[v].size(); i++) {
+            if (dist[out[v][i]] < 0) {
+                dist[out[v][i]] = dist[v] + 1;
+                q.push(out[v][i]);
+            }
+        }
+    }
+}
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+    
+    vid_t nvertices = get_option_int("nvertices", 20000);
+    size_t nsources = get_option_int("sources", 600);
+    
+    /* Random graph with a fixed seed */
+    std::vector<std::vector<vid_t> > out(nvertices), in(nvertices);
+    unsigned int seed = 12345;
+    for(vid_t v=0; v < nvertices; v++) {
+        for(int k=0; k < NOUTEDGES; k++) {
+            seed = seed * 1103515245 + 12345;
+            vid_t dst = (seed >> 8) % nvertices;
+            if (dst == v) continue;
+            out[v].push_back(dst);
+            in[dst].push_back(v);
+        }
+    }
+    
+    /* Budget for one lane of 256 sources */
+    size_t lanemb = (3 * 4 * sizeof(uint64_t) * (size_t) nvertices) / (1024 * 1024) + 1;
+    bitparallel_bfs bp(nvertices, nsources, lanemb);
+    assert(bp.max_sources() == 256);
+    
+    std::vector<vid_t> sources;
+    for(size_t i=0; i < nsources; i++) sources.push_back((vid_t) ((i * 7919) % nvertices));
+    
+    size_t nsweeps = 0;
+    for(size_t st=0; st < sources.size(); st += bp.max_sources()) {
+        std::vector<vid_t> sweep(sources.begin() + st, sources.begin() + std::min(sources.size(), st + bp.max_sources()));
+        nsweeps++;
+        
+        /* Expected: nearest source, the first one among equals */
+        std::vector<int> level(nvertices, -1), first(nvertices, -1), dist;
+        std::vector<char> issource(nvertices, 0);
+        for(size_t i=0; i < sweep.size(); i++) issource[sweep[i]] = 1;
+        for(size_t i=0; i < sweep.size(); i++) {
+            bfs(out, sweep[i], dist);
+            for(vid_t v=0; v < nvertices; v++) {
+                if (issource[v] || dist[v] < 0) continue;
+                if (level[v] < 0 || dist[v] < level[v]) {
+                    level[v] = dist[v];
+                    first[v] = (int) i;
+                }
+            }
+        }
+        
+        bp.reset(sweep);
+        std::vector<int> gotlevel(nvertices, -1), gotfirst(nvertices, -1);
+        bool reached = true;
+        for(int l=1; reached; l++) {
+            bp.advance();
+            reached = false;
+            for(vid_t v=0; v < nvertices; v++) {
+                for(size_t i=0; i < in[v].size(); i++) bp.gather(v, in[v][i]);
+                int src = bp.settle(v);
+                if (src >= 0) {
+                    assert(gotlevel[v] < 0);
+                    gotlevel[v] = l;
+                    gotfirst[v] = src;
+                    reached = true;
+                }
+            }
+        }
+        for(vid_t v=0; v < nvertices; v++) {
+            assert(gotlevel[v] == level[v]);
+            assert(gotfirst[v] == first[v]);
+        }
+    }
+    assert(nsweeps == (nsources + 255) / 256);
+    
+    /* Not even one lane fits */
+    bool failed = false;
+    try {
+        bitparallel_bfs toolarge(nvertices * 100, 256, 1);
+    } catch (const char * err) {
+        failed = true;
+    }
+    assert(failed);
+    
+    logstream(LOG_INFO) << "Bit-parallel BFS test passed with " << nsweeps << " sweeps." << std::endl;
+    return 0;
+}
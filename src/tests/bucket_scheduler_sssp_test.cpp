@@ -0,0 +1,175 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Test for the delta-stepping bucket scheduler on the static engine.
+ * Runs the SSSP update of example_apps/sssp.cpp with selective
+ * scheduling, first without buckets (Bellman-Ford, every task in the
+ * next iteration) and then with bucket_width > 0,
+ * where vertices are scheduled by tentative distance with
+ * add_task_priority(). The distances of both runs must be equal, and the
+ * bucketed run must have gone through more than one bucket. Edge weights
+ * are multiples of 1/4, so the float distances are exact. The graph,
+ * with nvertices vertices, is written to the input file.
+ */
+
+#include <string>
+#include <vector>
+
+#include "graphchi_basic_includes.hpp"
+#include "tests/test_graphs.hpp"
+
+using namespace graphchi;
+
+struct edgeWithSrcValue {
+    float value;
+    float srcValue;
+
+    edgeWithSrcValue() {}
+    edgeWithSrcValue(float v) : value(v), srcValue(0) {}
+};
+
+typedef float VertexDataType;
+typedef edgeWithSrcValue EdgeDataType;
+
+static void parse(EdgeDataType &edata, const char * s) {
+    edata.value = (float) atof(s);
+}
+
+static const float infinity = 99999999.0f;
+
+struct SSSPTestProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
+    bool bucketed;
+    bool converged;
+    uint32_t maxbucket;
+    std::vector<float> dist;
+
+    SSSPTestProgram(bool bucketed, vid_t nvertices) : bucketed(bucketed), converged(false), maxbucket(0),
+        dist(nvertices, infinity) {}
+
+    /* Without buckets, tasks go to the next iteration: a task added for the
+       current one is lost if its vertex has already been passed. */
+    void schedule(graphchi_context &gcontext, vid_t vid, float tentative) {
+        if (bucketed) {
+            gcontext.scheduler->add_task_priority(vid, (double) tentative);
+        } else {
+            gcontext.scheduler->add_task(vid, false);
+        }
+    }
+
+    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+        if (gcontext.iteration == 0) {
+            float d = (vertex.id() == 0 ? 0.0f : infinity);
+            vertex.set_data(d);
+            dist[vertex.id()] = d;
+            for(int j=0; j < vertex.num_outedges(); j++) {
+                EdgeDataType edata = vertex.outedge(j)->get_data();
+                if (vertex.id() == 0) schedule(gcontext, vertex.outedge(j)->vertex_id(), edata.value);
+                edata.srcValue = d;
+                vertex.outedge(j)->set_data(edata);
+            }
+            return;
+        }
+        float min = vertex.get_data();
+        for(int i=0; i < vertex.num_inedges(); i++) {
+            EdgeDataType edata = vertex.inedge(i)->get_data();
+            if (edata.srcValue + edata.value < min) min = edata.srcValue + edata.value;
+        }
+        if (min < vertex.get_data()) {
+            vertex.set_data(min);
+            dist[vertex.id()] = min;
+            for(int j=0; j < vertex.num_outedges(); j++) {
+                EdgeDataType edata = vertex.outedge(j)->get_data();
+                schedule(gcontext, vertex.outedge(j)->vertex_id(), min + edata.value);
+                edata.srcValue = min;
+                vertex.outedge(j)->set_data(edata);
+            }
+            converged = false;
+        }
+    }
+
+    void before_iteration(int iteration, graphchi_context &gcontext) {
+        converged = iteration > 0;
+    }
+
+    void after_iteration(int iteration, graphchi_context &gcontext) {
+        if (bucketed) {
+            bucket_scheduler * bs = dynamic_cast<bucket_scheduler *>(gcontext.scheduler);
+            assert(bs != NULL);
+            maxbucket = std::max(maxbucket, bs->current_bucket());
+        } else if (converged) {
+            gcontext.set_last_iteration(iteration);
+        }
+    }
+};
+
+/* Multiples of 1/4 from 1/4 to 4 */
+static float edge_weight(vid_t src, vid_t dst) {
+    return (float) (1 + (src * 3 + dst * 5) % 16) / 4.0f;
+}
+
+static std::vector<float> run_sssp(std::string filename, int nshards, double bucket_width, uint32_t &maxbucket) {
+    metrics m("bucket-scheduler-sssp-test");
+    graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, true, m);
+    engine.set_bucket_width(bucket_width);
+    /* Several sub-intervals, so that the graph is not run in memory */
+    engine.set_maxwindow(2000);
+    SSSPTestProgram program(bucket_width > 0, (vid_t) engine.num_vertices());
+    engine.run(program, 100000);
+    maxbucket = program.maxbucket;
+    return program.dist;
+}
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+
+    std::string filename = get_option_string("file");
+    vid_t nvertices      = get_option_int("nvertices", 10000);
+    double bucket_width  = get_option_float("bucket_width", 1.0f);
+    assert(bucket_width > 0);
+
+    write_test_graph(filename, nvertices, 4, false, edge_weight);
+    int nshards = convert<EdgeDataType, EdgeDataType>(filename, "auto");
+
+    uint32_t maxbucket = 0;
+    std::vector<float> plain = run_sssp(filename, nshards, 0, maxbucket);
+    std::vector<float> bucketed = run_sssp(filename, nshards, bucket_width, maxbucket);
+    logstream(LOG_INFO) << "Bucketed run went up to bucket " << maxbucket << std::endl;
+    assert(maxbucket > 0);
+
+    assert(plain.size() == bucketed.size());
+    size_t reached = 0;
+    for(size_t v=0; v < plain.size(); v++) {
+        if (plain[v] != bucketed[v]) {
+            logstream(LOG_ERROR) << "Vertex " << v << ": " << bucketed[v] << " != " << plain[v] << std::endl;
+            assert(false);
+        }
+        if (plain[v] < infinity) reached++;
+    }
+    assert(reached > 1);
+    logstream(LOG_INFO) << reached << " of " << plain.size() << " vertices reached." << std::endl;
+
+    delete_shards<EdgeDataType>(filename, nshards);
+    logstream(LOG_INFO) << "Bucket scheduler SSSP test passed." << std::endl;
+    return 0;
+}
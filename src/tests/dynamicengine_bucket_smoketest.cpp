@@ -0,0 +1,105 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ 
+ *
+ * @section DESCRIPTION
+ *
+ * Smoke test for the delta-stepping bucket scheduler on the dynamic
+ * engine. In the second iteration (edges can be added only after the
+ * first), vertex 0 adds edges to new vertices and schedules them with
+ * priorities; the scheduler has to grow with the
+ * vertices, and each bucket has to run in its own iteration, lowest
+ * first. If the input file does not exist, a ring with nvertices
+ * vertices is written to it.
+ */
+
+#include <string>
+#include <vector>
+
+#include "graphchi_basic_includes.hpp"
+#include "engine/dynamic_graphs/graphchi_dynamicgraph_engine.hpp"
+#include "tests/test_graphs.hpp"
+
+using namespace graphchi;
+
+typedef vid_t VertexDataType;
+typedef vid_t EdgeDataType;
+
+static const int NBUCKETS = 10;
+
+graphchi_dynamicgraph_engine<VertexDataType, EdgeDataType> * dynengine = NULL;
+vid_t nbase = 0;
+vid_t nnew = 0;
+std::vector<int> ran_in;   // iteration each new vertex was updated in, or -1
+
+struct BucketTestProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
+    
+    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+        if (gcontext.iteration == 0) {
+            if (vertex.id() == 0) gcontext.scheduler->add_task(0);
+        } else if (gcontext.iteration == 1) {
+            if (vertex.id() != 0) return;
+            std::vector<created_edge<EdgeDataType> > edges;
+            for(vid_t k=0; k < nnew; k++) {
+                edges.push_back(created_edge<EdgeDataType>(0, nbase + k, 0));
+            }
+            size_t added = dynengine->add_edges(edges);
+            assert(added == edges.size());
+            for(vid_t k=0; k < nnew; k++) {
+                gcontext.scheduler->add_task_priority(nbase + k, (double) (k % NBUCKETS));
+            }
+        } else if (vertex.id() >= nbase) {
+            assert(ran_in[vertex.id() - nbase] == -1);
+            ran_in[vertex.id() - nbase] = gcontext.iteration;
+        }
+    }
+};
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+    metrics m("dynamicengine-bucket-smoketest");
+    
+    std::string filename = get_option_string("file");
+    vid_t nvertices      = get_option_int("nvertices", 10000);
+    nnew                 = get_option_int("newvertices", 1000);
+    
+    if (!file_exists(filename)) write_ring_graph(filename, nvertices);
+    int nshards          = convert_if_notexists<EdgeDataType>(filename, get_option_string("nshards", "auto"));
+    
+    graphchi_dynamicgraph_engine<VertexDataType, EdgeDataType> engine(filename, nshards, true, m);
+    engine.set_bucket_width(1.0);
+    /* Keep out of the in-memory mode, which does not add vertices */
+    engine.set_maxwindow(get_option_int("maxwindow", 2000));
+    dynengine = &engine;
+    nbase = (vid_t) engine.num_vertices();
+    ran_in.assign(nnew, -1);
+    
+    BucketTestProgram program;
+    engine.run(program, NBUCKETS + 3);
+    
+    for(vid_t k=0; k < nnew; k++) {
+        assert(ran_in[k] == 2 + (int) (k % NBUCKETS));
+    }
+    
+    metrics_report(m);
+    logstream(LOG_INFO) << "Dynamic engine bucket scheduler smoketest passed." << std::endl;
+    return 0;
+}
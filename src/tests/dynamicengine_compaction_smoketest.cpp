@@ -0,0 +1,167 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Smoke test for edge ingest and shard compaction of the dynamic graph
+ * engine. Vertices add edges from new vertices while the engine runs.
+ * The edge buffers and maximum shard size are small, so the buffered
+ * edges are compacted into the shards in the background, the shards
+ * split, and the values written meanwhile are replayed into the new
+ * shards. Each vertex writes id + iteration to its out-edges and checks
+ * the values of its in-edges; the number of edges is checked in the last
+ * iteration. If the input file does not exist, a graph with nvertices
+ * vertices is written to it.
+ */
+
+#include <algorithm>
+#include <string>
+#include <fstream>
+#include <vector>
+
+#include "graphchi_basic_includes.hpp"
+#include "engine/dynamic_graphs/graphchi_dynamicgraph_engine.hpp"
+#include "tests/test_graphs.hpp"
+
+using namespace graphchi;
+
+typedef vid_t VertexDataType;
+typedef vid_t EdgeDataType;
+
+/* Value of an added edge until its source has written it */
+#define NEWEDGE 0x7fffffff
+
+typedef graphchi_dynamicgraph_engine<VertexDataType, EdgeDataType> engine_t;
+
+struct CompactionTestProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
+    engine_t * engine;
+    vid_t norig;
+    int stop_adding;
+    size_t added;
+    std::vector<int> firstrun;
+    counter_aggregator outedges, inedges;
+
+    CompactionTestProgram(engine_t * engine, vid_t norig, int niters) : engine(engine), norig(norig),
+        stop_adding(niters - 3), added(0), firstrun((niters + 1) * (size_t) new_sources(norig), -1) {}
+
+    static vid_t new_sources(vid_t norig) {
+        return norig / 50 + 1;
+    }
+
+    /* Each iteration adds edges from its own set of new vertices */
+    vid_t new_source(vid_t v, int iteration) {
+        return norig + iteration * new_sources(norig) + v / 50;
+    }
+
+    void check_inedge(vid_t dst, vid_t src, vid_t value, int iteration) {
+        vid_t expected = src + iteration - (src > dst);
+        if (value == expected) return;
+        /* An added edge is not written until its source first runs */
+        if (src >= norig && value == NEWEDGE && (firstrun[src - norig] < 0 || firstrun[src - norig] == iteration)) return;
+        logstream(LOG_ERROR) << "Edge " << src << " -> " << dst << ": " << value << " != " << expected << std::endl;
+        assert(false);
+    }
+
+    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+        int iteration = gcontext.iteration;
+        if (iteration > 0) {
+            for(int i=0; i < vertex.num_inedges(); i++) {
+                check_inedge(vertex.id(), vertex.inedge(i)->vertex_id(), vertex.inedge(i)->get_data(), iteration);
+            }
+        }
+        if (vertex.id() >= norig && firstrun[vertex.id() - norig] < 0) firstrun[vertex.id() - norig] = iteration;
+        for(int i=0; i < vertex.num_outedges(); i++) {
+            vertex.outedge(i)->set_data(vertex.id() + iteration);
+        }
+
+        if (iteration >= 1 && iteration <= stop_adding && vertex.id() < norig && vertex.id() % 50 == 0) {
+            std::vector<created_edge<EdgeDataType> > edges;
+            for(vid_t k=0; k < 20; k++) {
+                vid_t dst = (vid_t) (((size_t) vertex.id() + iteration * 7919 + k * 31) % norig);
+                edges.push_back(created_edge<EdgeDataType>(new_source(vertex.id(), iteration), dst, NEWEDGE));
+            }
+            __sync_add_and_fetch(&added, engine->add_edges(edges));
+        }
+
+        if (iteration == gcontext.num_iterations - 1) {
+            outedges.add(vertex.num_outedges());
+            inedges.add(vertex.num_inedges());
+        }
+    }
+};
+
+static size_t count_edges(std::string filename) {
+    std::ifstream f(filename.c_str());
+    size_t n = 0;
+    vid_t src, dst;
+    while (f >> src >> dst) {
+        if (src != dst) n++;
+    }
+    return n;
+}
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+    metrics m("dynamicengine-compaction-smoketest");
+
+    /* Small buffers and shards, so that compaction starts and shards split */
+    set_conf("max_edgebuffer_mb", "1");
+    set_conf("compaction.maxshardsize_mb", "1");
+
+    std::string filename = get_option_string("file");
+    int niters           = get_option_int("niters", 10);
+    vid_t nvertices      = get_option_int("nvertices", 100000);
+
+    if (!file_exists(filename)) write_test_graph(filename, nvertices, 4);
+    int nshards          = convert_if_notexists<EdgeDataType>(filename, get_option_string("nshards", "auto"));
+    size_t norigedges    = count_edges(filename);
+
+    engine_t engine(filename, nshards, false, m);
+    vid_t norig = (vid_t) engine.num_vertices();
+    /* Several sub-intervals, so the engine never switches to in-memory
+       mode (which does not commit the buffered edges) even with one shard */
+    engine.set_maxwindow(std::max(norig / 5, (vid_t) 1));
+    engine.set_ingest_wait_ms(100);
+
+    CompactionTestProgram program(&engine, norig, niters);
+    engine.add_aggregator(&program.outedges);
+    engine.add_aggregator(&program.inedges);
+    engine.run(program, niters);
+
+    size_t nedges = norigedges + program.added;
+    logstream(LOG_INFO) << "Added " << program.added << " edges, " << nedges << " edges in total; "
+        << program.outedges.value() << " out-edges and " << program.inedges.value()
+        << " in-edges in the last iteration, " << nshards << " -> " << engine.get_nshards() << " shards." << std::endl;
+    assert(program.added > 0);
+    assert(program.outedges.value() == (long) nedges);
+    assert(program.inedges.value() == (long) nedges);
+    /* Buffered edges were compacted into the shards, and the shards split
+       if the graph outgrew them */
+    assert(engine.num_buffered_edges() < program.added);
+    if (nedges * sizeof(EdgeDataType) > (size_t) nshards * 1024 * 1024) {
+        assert(engine.get_nshards() > nshards);
+    }
+
+    metrics_report(m);
+    logstream(LOG_INFO) << "Dynamic engine compaction smoketest passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,208 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Smoke test for the edge-centric engine. Runs PageRank and min-label
+ * propagation and checks them against results computed in memory from
+ * the edge list. PageRank runs with several source windows
+ * (edgecentric_window) and once with only adjacency. The generated graph
+ * has more edges per shard than memory_shard::stream_edges() puts in one
+ * piece, so the shards are streamed by several threads. If the input
+ * file does not exist, a graph with nvertices vertices is written to it;
+ * run with e.g. membudget_mb 8 to shard it into several intervals.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <vector>
+
+#include "graphchi_basic_includes.hpp"
+#include "engine/graphchi_edgecentric_engine.hpp"
+#include "tests/test_graphs.hpp"
+
+using namespace graphchi;
+
+#define RANDOM_RESET 0.15f
+
+struct pagerank_value {
+    float rank;
+    float acc;
+};
+
+struct PagerankProgram : public EdgeCentricProgram<pagerank_value, float, float> {
+    void init(vid_t vertexid, pagerank_value &val) {
+        val.rank = 1.0f;
+        val.acc = 0.0f;
+    }
+
+    bool scatter(vid_t src, const pagerank_value &srcval, const degree &srcdeg,
+                 vid_t dst, const float * edata, float &update, graphchi_context &gcontext) {
+        update = srcval.rank / srcdeg.outdegree;
+        return true;
+    }
+
+    void gather(vid_t dst, pagerank_value &dstval, const float &update, graphchi_context &gcontext) {
+        dstval.acc += update;
+    }
+
+    void apply(vid_t vertexid, pagerank_value &val, graphchi_context &gcontext) {
+        val.rank = RANDOM_RESET + (1 - RANDOM_RESET) * val.acc;
+        val.acc = 0.0f;
+    }
+};
+
+/* Scatters only from vertices whose label changed in the previous iteration */
+struct MinlabelProgram : public EdgeCentricProgram<vid_t, float, vid_t> {
+    std::vector<vid_t> previous;
+    std::vector<char> changed;
+
+    MinlabelProgram(size_t nvertices) : previous(nvertices), changed(nvertices, 1) {}
+
+    void init(vid_t vertexid, vid_t &label) {
+        label = vertexid;
+        previous[vertexid] = vertexid;
+    }
+
+    bool scatter(vid_t src, const vid_t &srclabel, const degree &srcdeg,
+                 vid_t dst, const float * edata, vid_t &update, graphchi_context &gcontext) {
+        update = srclabel;
+        return changed[src] != 0;
+    }
+
+    void gather(vid_t dst, vid_t &label, const vid_t &update, graphchi_context &gcontext) {
+        if (update < label) label = update;
+    }
+
+    void apply(vid_t vertexid, vid_t &label, graphchi_context &gcontext) {
+        changed[vertexid] = label != previous[vertexid];
+        previous[vertexid] = label;
+    }
+};
+
+typedef std::pair<vid_t, vid_t> edge_t;
+
+static std::vector<edge_t> read_edges(std::string filename) {
+    std::vector<edge_t> edges;
+    std::ifstream f(filename.c_str());
+    vid_t src, dst;
+    while (f >> src >> dst) {
+        if (src != dst) edges.push_back(edge_t(src, dst));
+    }
+    return edges;
+}
+
+/* PageRank iterated in memory until it does not change anymore */
+static std::vector<float> reference_pagerank(const std::vector<edge_t> &edges, size_t nvertices) {
+    std::vector<float> rank(nvertices, 1.0f), acc(nvertices), outdeg(nvertices, 0.0f);
+    for(size_t i=0; i < edges.size(); i++) outdeg[edges[i].first]++;
+    for(int iter=0; iter < 100; iter++) {
+        std::fill(acc.begin(), acc.end(), 0.0f);
+        for(size_t i=0; i < edges.size(); i++) {
+            acc[edges[i].second] += rank[edges[i].first] / outdeg[edges[i].first];
+        }
+        for(size_t v=0; v < nvertices; v++) rank[v] = RANDOM_RESET + (1 - RANDOM_RESET) * acc[v];
+    }
+    return rank;
+}
+
+static std::vector<vid_t> reference_minlabels(const std::vector<edge_t> &edges, size_t nvertices) {
+    std::vector<vid_t> label(nvertices);
+    for(vid_t v=0; v < nvertices; v++) label[v] = v;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for(size_t i=0; i < edges.size(); i++) {
+            if (label[edges[i].first] < label[edges[i].second]) {
+                label[edges[i].second] = label[edges[i].first];
+                changed = true;
+            }
+        }
+    }
+    return label;
+}
+
+static void test_pagerank(std::string filename, int nshards, int niters, int window, bool only_adjacency,
+                          const std::vector<float> &reference, metrics &m) {
+    std::stringstream ss;
+    ss << window;
+    set_conf("edgecentric_window", ss.str());
+    graphchi_edgecentric_engine<PagerankProgram> engine(filename, nshards, m);
+    engine.set_only_adjacency(only_adjacency);
+    PagerankProgram program;
+    engine.run(program, niters);
+
+    std::vector<pagerank_value> values = read_vertex_values<pagerank_value>(filename, reference.size());
+    double maxerr = 0;
+    for(size_t v=0; v < reference.size(); v++) {
+        maxerr = std::max(maxerr, (double) fabs(values[v].rank - reference[v]));
+    }
+    logstream(LOG_INFO) << "PageRank, window " << window << (only_adjacency ? ", only adjacency" : "")
+        << ": max difference " << maxerr << std::endl;
+    assert(maxerr < 1e-3);
+}
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+    metrics m("edgecentric-smoketest");
+
+    std::string filename = get_option_string("file");
+    int niters           = get_option_int("niters", 40);
+    vid_t nvertices      = get_option_int("nvertices", 200000);
+
+    if (!file_exists(filename)) write_test_graph(filename, nvertices, 6, true);
+    int nshards          = convert_if_notexists<float>(filename, get_option_string("nshards", "auto"));
+
+    std::vector<edge_t> edges = read_edges(filename);
+    size_t nv = 0;
+    {
+        graphchi_edgecentric_engine<PagerankProgram> engine(filename, nshards, m);
+        nv = engine.num_vertices();
+    }
+    logstream(LOG_INFO) << "Edge-centric smoketest: " << nv << " vertices, " << edges.size()
+        << " edges, " << nshards << " shards." << std::endl;
+
+    std::vector<float> ranks = reference_pagerank(edges, nv);
+    test_pagerank(filename, nshards, niters, 1, false, ranks, m);
+    test_pagerank(filename, nshards, niters, 100, false, ranks, m);
+    test_pagerank(filename, nshards, niters, 65536, false, ranks, m);
+    test_pagerank(filename, nshards, niters, 65536, true, ranks, m);
+
+    /* Stops early, when no label changes */
+    std::vector<vid_t> labels = reference_minlabels(edges, nv);
+    graphchi_edgecentric_engine<MinlabelProgram> engine(filename, nshards, m);
+    MinlabelProgram program(nv);
+    engine.run(program, 10000);
+    std::vector<vid_t> values = read_vertex_values<vid_t>(filename, nv);
+    for(size_t v=0; v < nv; v++) {
+        assert(values[v] == labels[v]);
+    }
+    logstream(LOG_INFO) << "Min-labels converged in " << (engine.get_context().last_iteration + 1)
+        << " iterations." << std::endl;
+
+    metrics_report(m);
+    logstream(LOG_INFO) << "Edge-centric smoketest passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,168 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ 
+ *
+ * @section DESCRIPTION
+ *
+ * Test for the atomic combiners of the functional API. PageRank (sum),
+ * a minimum label and a maximum label are run bulk synchronously with
+ * kernels that take the vertex lock in plus(), and with the same kernels
+ * declaring combiner_type; the vertex values have to agree. Every run
+ * writes its own copy of a generated graph with nvertices vertices,
+ * named after the file option.
+ */
+
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "graphchi_basic_includes.hpp"
+#include "api/functional/functional_api.hpp"
+#include "tests/test_graphs.hpp"
+
+using namespace graphchi;
+
+static const int NOUTEDGES = 5;
+
+struct pagerank_kernel : public functional_kernel<float, float> {
+    float initial_value(graphchi_context &info, vertex_info& myvertex) {
+        return 1.0f;
+    }
+    float reset() {
+        return 0.0f;
+    }
+    float op_neighborval(graphchi_context &info, vertex_info& myvertex, vid_t nbid, float nbval) {
+        return nbval;
+    }
+    float plus(float curval, float toadd) {
+        return curval + toadd;
+    }
+    float compute_vertexvalue(graphchi_context &ginfo, vertex_info& myvertex, float nbvalsum) {
+        return 0.15f + 0.85f * nbvalsum;
+    }
+    float value_to_neighbor(graphchi_context &info, vertex_info& myvertex, vid_t nbid, float myval) {
+        return myval / (float) myvertex.outdegree;
+    }
+};
+
+struct pagerank_kernel_combined : public pagerank_kernel {
+    typedef functional_sum_combiner combiner_type;
+};
+
+/* Smallest id among the vertex and its in-neighbors' labels */
+struct minlabel_kernel : public functional_kernel<vid_t, vid_t> {
+    vid_t initial_value(graphchi_context &info, vertex_info& myvertex) {
+        return myvertex.vertexid;
+    }
+    vid_t reset() {
+        return (vid_t) -1;
+    }
+    vid_t op_neighborval(graphchi_context &info, vertex_info& myvertex, vid_t nbid, vid_t nbval) {
+        return nbval;
+    }
+    vid_t plus(vid_t curval, vid_t toadd) {
+        return std::min(curval, toadd);
+    }
+    vid_t compute_vertexvalue(graphchi_context &ginfo, vertex_info& myvertex, vid_t nbvalsum) {
+        return std::min(myvertex.vertexid, nbvalsum);
+    }
+    vid_t value_to_neighbor(graphchi_context &info, vertex_info& myvertex, vid_t nbid, vid_t myval) {
+        return myval;
+    }
+};
+
+struct minlabel_kernel_combined : public minlabel_kernel {
+    typedef functional_min_combiner combiner_type;
+};
+
+/* Largest id among the vertex and its in-neighbors' labels */
+struct maxlabel_kernel : public functional_kernel<vid_t, vid_t> {
+    vid_t initial_value(graphchi_context &info, vertex_info& myvertex) {
+        return myvertex.vertexid;
+    }
+    vid_t reset() {
+        return 0;
+    }
+    vid_t op_neighborval(graphchi_context &info, vertex_info& myvertex, vid_t nbid, vid_t nbval) {
+        return nbval;
+    }
+    vid_t plus(vid_t curval, vid_t toadd) {
+        return std::max(curval, toadd);
+    }
+    vid_t compute_vertexvalue(graphchi_context &ginfo, vertex_info& myvertex, vid_t nbvalsum) {
+        return std::max(myvertex.vertexid, nbvalsum);
+    }
+    vid_t value_to_neighbor(graphchi_context &info, vertex_info& myvertex, vid_t nbid, vid_t myval) {
+        return myval;
+    }
+};
+
+struct maxlabel_kernel_combined : public maxlabel_kernel {
+    typedef functional_max_combiner combiner_type;
+};
+
+/* Runs the kernel on a fresh copy of the graph and returns the vertex values */
+template <class KERNEL>
+std::vector<typename KERNEL::VertexDataType> run_kernel(std::string filename, vid_t nvertices, int niters, metrics &m) {
+    typedef typename KERNEL::VertexDataType VT;
+    write_random_test_graph(filename, nvertices, NOUTEDGES, 4321);
+    run_functional_unweighted_synchronous<KERNEL>(filename, niters, m);
+    return read_vertex_values<VT>(filename, nvertices);
+}
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+    metrics m("functional-combiner-test");
+    
+    std::string filename = get_option_string("file");
+    vid_t nvertices      = get_option_int("nvertices", 50000);
+    int niters           = get_option_int("niters", 6);
+    
+    assert(!functional_has_combiner<pagerank_kernel>::value);
+    assert(functional_has_combiner<pagerank_kernel_combined>::value);
+    
+    std::vector<float> pr_locked = run_kernel<pagerank_kernel>(filename + ".pr_locked", nvertices, niters, m);
+    std::vector<float> pr_combined = run_kernel<pagerank_kernel_combined>(filename + ".pr_combined", nvertices, niters, m);
+    double maxdiff = 0;
+    for(vid_t v=0; v < nvertices; v++) {
+        maxdiff = std::max(maxdiff, (double) std::fabs(pr_locked[v] - pr_combined[v]) / std::max(1.0f, pr_locked[v]));
+    }
+    logstream(LOG_INFO) << "PageRank, largest relative difference: " << maxdiff << std::endl;
+    assert(maxdiff < 1e-4);
+    
+    std::vector<vid_t> min_locked = run_kernel<minlabel_kernel>(filename + ".min_locked", nvertices, niters, m);
+    std::vector<vid_t> min_combined = run_kernel<minlabel_kernel_combined>(filename + ".min_combined", nvertices, niters, m);
+    std::vector<vid_t> max_locked = run_kernel<maxlabel_kernel>(filename + ".max_locked", nvertices, niters, m);
+    std::vector<vid_t> max_combined = run_kernel<maxlabel_kernel_combined>(filename + ".max_combined", nvertices, niters, m);
+    size_t lowered = 0;
+    for(vid_t v=0; v < nvertices; v++) {
+        assert(min_locked[v] == min_combined[v]);
+        assert(max_locked[v] == max_combined[v]);
+        assert(min_combined[v] <= v && max_combined[v] >= v);
+        lowered += min_combined[v] < v;
+    }
+    /* The labels did propagate */
+    assert(lowered > nvertices / 2);
+    
+    metrics_report(m);
+    logstream(LOG_INFO) << "Functional combiner test passed." << std::endl;
+    return 0;
+}
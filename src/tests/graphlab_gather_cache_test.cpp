@@ -0,0 +1,123 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Test for the gather cache of the GraphLab v2.1 wrapper. Runs a GAS
+ * PageRank, which keeps the caches of its out-neighbors up to date with
+ * post_delta(), without and with use_cache, and checks that the ranks
+ * agree and that the cached run skipped gathers. If the input file does
+ * not exist, a graph with nvertices vertices is written to it.
+ */
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "graphchi_basic_includes.hpp"
+#include "api/graphlab2_1_GAS_api/graphchi_graphlabv2_1.hpp"
+#include "tests/test_graphs.hpp"
+
+using namespace graphchi;
+
+#define RANDOM_RESET 0.15
+
+/* The rank and its share sent along each out-edge */
+struct pagerank_data {
+    double rank;
+    double share;
+    pagerank_data() : rank(1.0), share(0.0) {}
+};
+
+typedef graphlab::distributed_graph<pagerank_data, vid_t> graph_type;
+
+struct GASPagerank : public graphlab::ivertex_program<graph_type, double> {
+    double last_change;
+
+    GASPagerank() : last_change(0) {}
+
+    double gather(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+        return edge.source().data().share;
+    }
+
+    void apply(icontext_type& context, vertex_type& vertex, const double& total) {
+        pagerank_data &d = vertex.data();
+        d.rank = RANDOM_RESET + (1 - RANDOM_RESET) * total;
+        double share = vertex.num_out_edges() > 0 ? d.rank / vertex.num_out_edges() : 0.0;
+        last_change = share - d.share;
+        d.share = share;
+    }
+
+    void scatter(icontext_type& context, const vertex_type& vertex, edge_type& edge) const {
+        context.post_delta(edge.target(), last_change);
+    }
+};
+
+typedef graphlab::GraphLabWrapper<GASPagerank> GLWrapper;
+
+static std::vector<pagerank_data> run_pagerank(std::string filename, int nshards, int niters, bool use_cache,
+                                               int maxwindow, metrics &m, long &cache_hits) {
+    GLWrapper wrapper;
+    wrapper.use_cache = use_cache;
+    graphchi_engine<bool, vid_t> engine(filename, nshards, false, m);
+    engine.set_modifies_inedges(false);
+    engine.set_modifies_outedges(false);
+    /* Several sub-intervals, so neighbors post deltas across them */
+    engine.set_maxwindow(maxwindow);
+    engine.run(wrapper, niters);
+    cache_hits = use_cache ? wrapper.cache_hits.value() : 0;
+    std::vector<pagerank_data> ranks = *wrapper.vertexInmemoryArray;
+    delete wrapper.vertexInmemoryArray;
+    return ranks;
+}
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+    metrics m("graphlab-gather-cache-test");
+
+    std::string filename = get_option_string("file");
+    int niters           = get_option_int("niters", 6);
+    vid_t nvertices      = get_option_int("nvertices", 20000);
+    int maxwindow        = get_option_int("maxwindow", 2000);
+
+    if (!file_exists(filename)) write_test_graph(filename, nvertices, 5, true);
+    int nshards          = convert_if_notexists<vid_t>(filename, get_option_string("nshards", "auto"));
+
+    long hits_uncached, hits_cached;
+    std::vector<pagerank_data> uncached = run_pagerank(filename, nshards, niters, false, maxwindow, m, hits_uncached);
+    std::vector<pagerank_data> cached   = run_pagerank(filename, nshards, niters, true, maxwindow, m, hits_cached);
+
+    assert(uncached.size() == cached.size());
+    double maxerr = 0;
+    for(size_t v=0; v < uncached.size(); v++) {
+        double err = fabs(uncached[v].rank - cached[v].rank) / uncached[v].rank;
+        if (err > maxerr) maxerr = err;
+    }
+    logstream(LOG_INFO) << "Max relative difference of ranks: " << maxerr << ", "
+        << hits_cached << " updates skipped gather in the last iteration." << std::endl;
+    assert(maxerr < 1e-9);
+    assert(hits_cached == (long) uncached.size());
+
+    metrics_report(m);
+    logstream(LOG_INFO) << "GraphLab gather cache test passed." << std::endl;
+    return 0;
+}
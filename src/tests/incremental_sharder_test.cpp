@@ -0,0 +1,133 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Test for add_edges_incremental(). A delta edge list is added twice:
+ * first to existing shards of the base graph, then to a base graph that
+ * has no shards yet, which is converted first. The delta has edges from
+ * hub vertices all over the graph into the last interval, and the shard
+ * size is small, so the other intervals are split because of their new
+ * out-edges alone. After each update the engine checks that every edge
+ * of the base graph and the delta is in the shards with its value. The
+ * base graph, with nvertices vertices, is written to the input file.
+ */
+
+#include <string>
+#include <fstream>
+#include <vector>
+
+#include "graphchi_basic_includes.hpp"
+#include "tests/test_graphs.hpp"
+
+using namespace graphchi;
+
+typedef vid_t VertexDataType;
+typedef vid_t EdgeDataType;
+
+static vid_t edge_value(vid_t src, vid_t dst) {
+    return src * 31 + dst;
+}
+
+struct IncrementalCheckProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
+    counter_aggregator outedges, inedges;
+
+    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+        for(int i=0; i < vertex.num_inedges(); i++) {
+            vid_t src = vertex.inedge(i)->vertex_id();
+            if (vertex.inedge(i)->get_data() != edge_value(src, vertex.id())) {
+                logstream(LOG_ERROR) << "Edge " << src << " -> " << vertex.id() << ": " << vertex.inedge(i)->get_data()
+                    << " != " << edge_value(src, vertex.id()) << std::endl;
+                assert(false);
+            }
+        }
+        outedges.add(vertex.num_outedges());
+        inedges.add(vertex.num_inedges());
+    }
+};
+
+/* Edges from every 100th vertex to the last 1000 vertices, and to a few new vertices */
+static size_t write_delta(std::string filename, vid_t nvertices) {
+    std::ofstream f(filename.c_str());
+    size_t n = 0;
+    for(vid_t v=0; v < nvertices; v += 100) {
+        for(vid_t k=0; k < 60; k++) {
+            vid_t dst = nvertices - 1000 + (v / 100 + k * 7) % 1000;
+            if (dst == v) continue;
+            f << v << "\t" << dst << "\t" << edge_value(v, dst) << std::endl;
+            n++;
+        }
+        vid_t newv = nvertices + v / 100;
+        f << v << "\t" << newv << "\t" << edge_value(v, newv) << std::endl;
+        n++;
+    }
+    return n;
+}
+
+static void check_shards(std::string filename, int nshards, size_t nedges) {
+    metrics m("incremental-sharder-check");
+    graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, false, m);
+    IncrementalCheckProgram program;
+    engine.add_aggregator(&program.outedges);
+    engine.add_aggregator(&program.inedges);
+    engine.run(program, 1);
+    logstream(LOG_INFO) << nshards << " shards, " << program.outedges.value() << " out-edges and "
+        << program.inedges.value() << " in-edges, expected " << nedges << std::endl;
+    assert(program.outedges.value() == (long) nedges);
+    assert(program.inedges.value() == (long) nedges);
+}
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+
+    /* Small shards: with the default 20000 vertices, the base intervals have
+       about 37000 in- and out-edges. The delta adds about 2800 out-edges to
+       each of them, so they are split although only the last shard gets
+       new edges. */
+    set_conf("membudget_mb", "1");
+    set_conf("incremental.maxshardedges", "40000");
+
+    std::string filename = get_option_string("file");
+    vid_t nvertices      = get_option_int("nvertices", 20000);
+    std::string deltafile = filename + ".delta";
+
+    size_t nbase = write_test_graph(filename, nvertices, 4, false, edge_value);
+    size_t ndelta = write_delta(deltafile, nvertices);
+
+    /* Existing shards plus a delta */
+    int nshards = convert<EdgeDataType, EdgeDataType>(filename, "auto");
+    check_shards(filename, nshards, nbase);
+    int newshards = add_edges_incremental<EdgeDataType>(filename, deltafile);
+    assert(newshards > nshards);
+    check_shards(filename, newshards, nbase + ndelta);
+    delete_shards<EdgeDataType>(filename, newshards);
+
+    /* No shards plus a delta */
+    assert(find_shards<EdgeDataType>(filename, "auto") == 0);
+    nshards = add_edges_incremental<EdgeDataType>(filename, deltafile);
+    assert(nshards == newshards);
+    check_shards(filename, nshards, nbase + ndelta);
+    delete_shards<EdgeDataType>(filename, nshards);
+
+    logstream(LOG_INFO) << "Incremental sharder test passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,122 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ 
+ *
+ * @section DESCRIPTION
+ *
+ * Test for the message store when the engine's intervals change between
+ * iterations, as with the dynamic engine: messages are sent with two
+ * intervals, and delivered after the intervals were split and the last
+ * one grew. Messages are sent from many threads, and run with
+ * message_budget_mb=1 to also spill them to disk. Then checks that a new
+ * run does not receive the messages left from the previous one.
+ */
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <omp.h>
+
+#include "graphchi_basic_includes.hpp"
+#include "api/message_store.hpp"
+
+using namespace graphchi;
+
+typedef std::vector<std::pair<vid_t, vid_t> > intervals_t;
+
+static const int NCOPIES = 50;
+
+/* Receives every vertex of st..en and checks the combined message */
+static size_t check_interval(message_store<vid_t, min_reducer<vid_t> > &store, vid_t st, vid_t en, vid_t nvertices) {
+    store.deliver(st, en);
+    size_t n = 0;
+    for(vid_t v=st; v <= en; v++) {
+        vid_t msg;
+        bool got = store.receive(v, msg);
+        assert(got == (v < nvertices));
+        if (got) {
+            assert(msg == 2 * v);
+            n++;
+        }
+    }
+    return n;
+}
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+    
+    std::string prefix = get_option_string("prefix", "/tmp/message_store_test");
+    vid_t nvertices = get_option_int("nvertices", 250000);
+    
+    intervals_t sent;
+    sent.push_back(std::pair<vid_t, vid_t>(0, nvertices / 2 - 1));
+    sent.push_back(std::pair<vid_t, vid_t>(nvertices / 2, nvertices * 3 / 4));  // the rest is added later
+    
+    message_store<vid_t, min_reducer<vid_t> > store(sent, prefix);
+    store.iteration_start(0, NULL, sent);
+    
+    #pragma omp parallel for schedule(dynamic, 1000)
+    for(int i=0; i < (int) nvertices * NCOPIES; i++) {
+        vid_t v = (vid_t) (i % nvertices);
+        store.send(v, 2 * v + (i / nvertices) % 3);
+    }
+    
+    /* Both intervals split, the last one grows past the vertices */
+    intervals_t delivered;
+    delivered.push_back(std::pair<vid_t, vid_t>(0, nvertices / 4 - 1));
+    delivered.push_back(std::pair<vid_t, vid_t>(nvertices / 4, nvertices / 2 + 10));
+    delivered.push_back(std::pair<vid_t, vid_t>(nvertices / 2 + 11, nvertices * 2 / 3));
+    delivered.push_back(std::pair<vid_t, vid_t>(nvertices * 2 / 3 + 1, nvertices + 1000));
+    store.iteration_start(1, NULL, delivered);
+    
+    size_t received = 0;
+    for(size_t p=0; p < delivered.size(); p++) {
+        received += check_interval(store, delivered[p].first, delivered[p].second, nvertices);
+    }
+    assert(received == nvertices);
+    
+    /* All at once, as in the in-memory mode */
+    received = check_interval(store, 0, nvertices + 1000, nvertices);
+    assert(received == nvertices);
+    
+    /* Nothing was sent in iteration 1 */
+    store.iteration_start(2, NULL, delivered);
+    store.deliver(0, nvertices - 1);
+    for(vid_t v=0; v < nvertices; v++) assert(!store.has_message(v));
+    
+    /* Messages sent in the last iteration of a run are dropped by the next run */
+    store.iteration_start(3, NULL, delivered);
+    #pragma omp parallel for schedule(dynamic, 1000)
+    for(int i=0; i < (int) nvertices * NCOPIES; i++) {
+        store.send((vid_t) (i % nvertices), 1);
+    }
+    store.iteration_start(0, NULL, sent);
+    store.deliver(0, nvertices - 1);
+    for(vid_t v=0; v < nvertices; v++) assert(!store.has_message(v));
+    for(int r=0; r < 10000; r++) {
+        std::stringstream ss;
+        ss << prefix << ".msgs." << r;
+        assert(!file_exists(ss.str()));
+    }
+    
+    logstream(LOG_INFO) << "Message store test passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,216 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Test for multipivot_scc() and scc_tarjan. The graph is made of blocks
+ * with self-loops, 2-cycles for Trim-2, 2-cycles that Trim-2 can not
+ * take, longer cycles, duplicate edges and SCCs spanning two blocks.
+ * The components are found three times: with the default tarjan_edges,
+ * so that the residual of trimming goes to the in-memory Tarjan; with a
+ * bound that needs some forward-backward passes first; and with no
+ * Tarjan at all. Each partition is compared with a plain recursive
+ * Tarjan over the edge list. The graph, with nblocks blocks, is written
+ * to the input file.
+ */
+
+#include <string>
+#include <fstream>
+#include <vector>
+#include <map>
+
+#include "graphchi_basic_includes.hpp"
+#include "util/multipivot_scc.hpp"
+
+using namespace graphchi;
+
+typedef vid_t EdgeDataType;
+
+static const vid_t BLOCK = 16;
+
+static void add_edge(std::vector<std::pair<vid_t, vid_t> > &edges, vid_t src, vid_t dst) {
+    edges.push_back(std::pair<vid_t, vid_t>(src, dst));
+}
+
+static std::vector<std::pair<vid_t, vid_t> > make_graph(vid_t nblocks) {
+    std::vector<std::pair<vid_t, vid_t> > edges;
+    for(vid_t k=0; k < nblocks; k++) {
+        vid_t b = k * BLOCK;
+        /* Singleton with a self-loop */
+        add_edge(edges, b, b);
+        add_edge(edges, b, b + 1);
+        /* 2-cycle, each the other's only live in-neighbor once b is
+           trimmed: Trim-2. The self-loop must not count. */
+        add_edge(edges, b + 1, b + 2);
+        add_edge(edges, b + 2, b + 1);
+        add_edge(edges, b + 1, b + 1);
+        add_edge(edges, b + 2, b + 3);
+        /* 5-cycle with a chord */
+        for(vid_t i=0; i < 5; i++) add_edge(edges, b + 3 + i, b + 3 + (i + 1) % 5);
+        add_edge(edges, b + 5, b + 3);
+        add_edge(edges, b + 3, b + 8);
+        /* 2-cycle with an extra in-edge on one side and an extra out-edge
+           on the other, which Trim-2 does not take */
+        add_edge(edges, b + 8, b + 9);
+        add_edge(edges, b + 9, b + 8);
+        add_edge(edges, b + 9, b + 10);
+        /* 3-cycle, linked to the 5-cycle of the next block */
+        add_edge(edges, b + 10, b + 11);
+        add_edge(edges, b + 11, b + 12);
+        add_edge(edges, b + 12, b + 10);
+        if (k + 1 < nblocks) add_edge(edges, b + 12, b + BLOCK + 3);
+        /* 3-cycle with a duplicate edge and a self-loop */
+        add_edge(edges, b + 13, b + 14);
+        add_edge(edges, b + 13, b + 14);
+        add_edge(edges, b + 14, b + 15);
+        add_edge(edges, b + 15, b + 13);
+        add_edge(edges, b + 15, b + 15);
+        add_edge(edges, b + 11, b + 13);
+        /* The 5-cycles of an even block and the next one are one SCC */
+        if (k % 2 == 0 && k + 1 < nblocks) {
+            add_edge(edges, b + 4, b + BLOCK + 5);
+            add_edge(edges, b + BLOCK + 6, b + 4);
+        }
+    }
+    return edges;
+}
+
+/* Plain recursive Tarjan, labels are component numbers */
+struct reference_tarjan {
+    std::vector<std::vector<vid_t> > adj;
+    std::vector<int> index, lowlink, label;
+    std::vector<bool> onstack;
+    std::vector<vid_t> stack;
+    int counter, ncomponents;
+
+    reference_tarjan(vid_t n, const std::vector<std::pair<vid_t, vid_t> > &edges) : adj(n), index(n, -1),
+        lowlink(n, 0), label(n, -1), onstack(n, false), counter(0), ncomponents(0) {
+        for(size_t i=0; i < edges.size(); i++) adj[edges[i].first].push_back(edges[i].second);
+        for(vid_t v=0; v < n; v++) {
+            if (index[v] < 0) visit(v);
+        }
+    }
+
+    void visit(vid_t v) {
+        index[v] = lowlink[v] = counter++;
+        stack.push_back(v);
+        onstack[v] = true;
+        for(size_t i=0; i < adj[v].size(); i++) {
+            vid_t w = adj[v][i];
+            if (index[w] < 0) {
+                visit(w);
+                lowlink[v] = std::min(lowlink[v], lowlink[w]);
+            } else if (onstack[w]) {
+                lowlink[v] = std::min(lowlink[v], index[w]);
+            }
+        }
+        if (lowlink[v] == index[v]) {
+            vid_t w;
+            do {
+                w = stack.back();
+                stack.pop_back();
+                onstack[w] = false;
+                label[w] = ncomponents;
+            } while(w != v);
+            ncomponents++;
+        }
+    }
+};
+
+/* Same partition, up to the names of the components */
+static void check_partition(const std::vector<vid_t> &labels, const std::vector<int> &expected) {
+    assert(labels.size() == expected.size());
+    std::map<vid_t, int> fw;
+    std::map<int, vid_t> bw;
+    for(size_t v=0; v < labels.size(); v++) {
+        if (fw.count(labels[v]) == 0) fw[labels[v]] = expected[v];
+        if (bw.count(expected[v]) == 0) bw[expected[v]] = labels[v];
+        if (fw[labels[v]] != expected[v] || bw[expected[v]] != labels[v]) {
+            logstream(LOG_ERROR) << "Vertex " << v << " has label " << labels[v] << ", expected component "
+                << expected[v] << std::endl;
+            assert(false);
+        }
+    }
+}
+
+static scc_stats run_scc(std::string filename, int nshards, size_t tarjan_edges, std::vector<vid_t> &labels) {
+    metrics m("multipivot-scc-test");
+    graphchi_engine<vid_t, EdgeDataType> engine(filename, nshards, true, m);
+    engine.set_only_adjacency(true);
+    engine.set_modifies_inedges(false);
+    engine.set_modifies_outedges(false);
+    labels.resize(engine.num_vertices());
+    scc_stats stats = multipivot_scc(engine, filename, &labels[0], 1000, 4, tarjan_edges);
+    logstream(LOG_INFO) << "tarjan_edges " << tarjan_edges << ": " << stats.ntrim2 << " vertices in Trim-2, "
+        << stats.npasses << " forward-backward passes, " << stats.ntarjan << " vertices to Tarjan." << std::endl;
+    return stats;
+}
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+
+    std::string filename = get_option_string("file");
+    vid_t nblocks        = get_option_int("nblocks", 50);
+
+    std::vector<std::pair<vid_t, vid_t> > edges = make_graph(nblocks);
+    {
+        std::ofstream f(filename.c_str());
+        for(size_t i=0; i < edges.size(); i++) f << edges[i].first << "\t" << edges[i].second << std::endl;
+    }
+    int nshards = convert<EdgeDataType, EdgeDataType>(filename, "auto");
+
+    vid_t nvertices = nblocks * BLOCK;
+    reference_tarjan reference(nvertices, edges);
+    logstream(LOG_INFO) << reference.ncomponents << " components in " << nvertices << " vertices." << std::endl;
+
+    /* scc_tarjan on the whole edge list */
+    std::vector<vid_t> all(nvertices);
+    for(vid_t v=0; v < nvertices; v++) all[v] = v;
+    scc_tarjan tarjan(all, edges);
+    assert((int) tarjan.num_components() == reference.ncomponents);
+    std::vector<vid_t> labels(nvertices);
+    for(size_t i=0; i < tarjan.num_vertices(); i++) labels[tarjan.vertex(i)] = tarjan.label(i);
+    check_partition(labels, reference.label);
+
+    /* Trimming, then the residual to Tarjan */
+    scc_stats stats = run_scc(filename, nshards, 16 * 1024 * 1024, labels);
+    assert(stats.ntrim2 >= 2 * nblocks);
+    assert(stats.npasses == 0);
+    assert(stats.ntarjan > 0);
+    check_partition(labels, reference.label);
+
+    /* Forward-backward until the residual is small */
+    stats = run_scc(filename, nshards, edges.size() / 2, labels);
+    assert(stats.npasses > 0);
+    assert(stats.ntarjan > 0);
+    check_partition(labels, reference.label);
+
+    /* Forward-backward only */
+    stats = run_scc(filename, nshards, 0, labels);
+    assert(stats.npasses > 0);
+    assert(stats.ntarjan == 0);
+    check_partition(labels, reference.label);
+
+    delete_shards<EdgeDataType>(filename, nshards);
+    logstream(LOG_INFO) << "Multipivot SCC test passed." << std::endl;
+    return 0;
+}
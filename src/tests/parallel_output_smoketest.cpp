@@ -0,0 +1,114 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ 
+ *
+ * @section DESCRIPTION
+ *
+ * Smoke test for parallel_output_writer written from update functions on
+ * the on-disk engine, whose nested teams start new threads on every
+ * sub-interval. Every vertex writes one record per iteration; the test
+ * checks that each record is in the file exactly once and that the
+ * number of thread buffers stays bounded. The records are also written
+ * through a writer with 4-byte buffers, smaller than most records. If
+ * the input file does not exist, a ring with nvertices vertices is
+ * written to it.
+ */
+
+#include <string>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+
+#include "graphchi_basic_includes.hpp"
+#include "output/parallel_output_writer.hpp"
+#include "tests/test_graphs.hpp"
+
+using namespace graphchi;
+
+typedef vid_t VertexDataType;
+typedef vid_t EdgeDataType;
+
+parallel_output_writer * out = NULL;
+parallel_output_writer * out_small = NULL;
+
+struct OutputTestProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
+    int maxbuffers;
+    
+    OutputTestProgram() : maxbuffers(0) {}
+    
+    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+        out->write_edge(vertex.id(), (vid_t) gcontext.iteration);
+        out_small->write_edge(vertex.id(), (vid_t) gcontext.iteration);
+    }
+    
+    void after_iteration(int iteration, graphchi_context &gcontext) {
+        maxbuffers = std::max(maxbuffers, out->num_buffers());
+    }
+};
+
+/* Checks that the file has every (vertex, iteration) exactly once */
+static void check_output(std::string outfile, vid_t nvertices, int niters) {
+    std::vector<int> seen((size_t) nvertices * niters, 0);
+    std::ifstream in(outfile.c_str());
+    vid_t v, iter;
+    size_t n = 0;
+    while(in >> v >> iter) {
+        assert(v < nvertices && (int) iter < niters);
+        seen[(size_t) iter * nvertices + v]++;
+        n++;
+    }
+    assert(n == seen.size());
+    for(size_t i=0; i < seen.size(); i++) assert(seen[i] == 1);
+}
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+    metrics m("parallel-output-smoketest");
+    
+    std::string filename = get_option_string("file");
+    int niters           = get_option_int("niters", 30);
+    vid_t nvertices      = get_option_int("nvertices", 20000);
+    
+    if (!file_exists(filename)) write_ring_graph(filename, nvertices);
+    int nshards          = convert_if_notexists<EdgeDataType>(filename, get_option_string("nshards", "auto"));
+    
+    std::string outfile = filename + ".parallel_output";
+    out = new parallel_output_writer(outfile);
+    out_small = new parallel_output_writer(outfile + "_small", OUTPUT_TEXT, false, 4);
+    
+    graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, false, m);
+    engine.set_maxwindow(get_option_int("maxwindow", 1000));
+    OutputTestProgram program;
+    engine.run(program, niters);
+    nvertices = (vid_t) engine.num_vertices();
+    delete out;
+    delete out_small;
+    
+    check_output(outfile, nvertices, niters);
+    check_output(outfile + "_small", nvertices, niters);
+    
+    logstream(LOG_INFO) << "At most " << program.maxbuffers << " thread buffers in " << niters << " iterations." << std::endl;
+    assert(program.maxbuffers < MAX_THREAD_SLOTS / 16);
+    
+    metrics_report(m);
+    logstream(LOG_INFO) << "Parallel output smoketest passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ 
+ *
+ * @section DESCRIPTION
+ *
+ * Test for the parallel radix sort (piSort) used by the sharder. Random
+ * edges, with their input position as the value, are sorted by source
+ * and then by destination, as the shovels do. The result has to be the
+ * edges in (dst, src, position) order, which only holds if both sorts
+ * keep equal keys in input order. Runs with several thread counts,
+ * including ones that do not divide the number of edges.
+ */
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "graphchi_basic_includes.hpp"
+#include "preprocessing/sharder.hpp"
+
+using namespace graphchi;
+
+typedef edge_with_value<vid_t> test_edge;
+
+static bool dst_src_pos_less(const test_edge &a, const test_edge &b) {
+    if (a.dst != b.dst) return a.dst < b.dst;
+    if (a.src != b.src) return a.src < b.src;
+    return a.value < b.value;
+}
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+    
+    size_t nedges = get_option_int("nedges", 1000000);
+    vid_t max_vertex = get_option_int("max_vertex", 5000);
+    
+    std::vector<test_edge> input(nedges);
+    unsigned int seed = 1;
+    for(size_t i=0; i < nedges; i++) {
+        seed = seed * 1103515245 + 12345;
+        vid_t src = (seed >> 8) % (max_vertex + 1);
+        seed = seed * 1103515245 + 12345;
+        vid_t dst = (seed >> 8) % (max_vertex + 1);
+        input[i] = test_edge(src, dst, (vid_t) i);
+    }
+    std::vector<test_edge> expected = input;
+    std::sort(expected.begin(), expected.end(), dst_src_pos_less);
+    
+    int nthreads[] = {1, 2, 3, 4, 7, 8};
+    for(int t=0; t < (int) (sizeof(nthreads) / sizeof(int)); t++) {
+        /* Also below PARALLEL_RADIX_MIN, where piSort falls back to iSort */
+        size_t sizes[] = {nedges, 1000};
+        for(int s=0; s < 2; s++) {
+            size_t n = std::min(nedges, sizes[s]);
+            std::vector<test_edge> edges(input.begin(), input.begin() + n);
+            piSort(&edges[0], (intT) n, (intT) max_vertex, srcF<vid_t>(), nthreads[t]);
+            piSort(&edges[0], (intT) n, (intT) max_vertex, dstF<vid_t>(), nthreads[t]);
+            
+            std::vector<test_edge> exp = (n == nedges ? expected : std::vector<test_edge>(input.begin(), input.begin() + n));
+            if (n != nedges) std::sort(exp.begin(), exp.end(), dst_src_pos_less);
+            for(size_t i=0; i < n; i++) {
+                assert(edges[i].src == exp[i].src && edges[i].dst == exp[i].dst && edges[i].value == exp[i].value);
+            }
+        }
+        logstream(LOG_INFO) << "piSort with " << nthreads[t] << " threads is stable." << std::endl;
+    }
+    
+    logstream(LOG_INFO) << "Radix sort test passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ 
+ *
+ * @section DESCRIPTION
+ *
+ * Test for the degree counts the sharder takes while flushing the shovels
+ * (shovel_degree_counter). Shovels of random edges are counted from many
+ * threads, in an order where the largest vertex id keeps growing so that
+ * the array is resized between counts, and the counts are compared with
+ * the degrees of the edge list. Then checks permute() and release().
+ */
+
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "graphchi_basic_includes.hpp"
+#include "preprocessing/sharder.hpp"
+
+using namespace graphchi;
+
+typedef edge_with_value<float> test_edge;
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+    
+    vid_t nvertices = get_option_int("nvertices", 100000);
+    int nshovels = get_option_int("nshovels", 64);
+    size_t shovel_edges = get_option_int("shovel_edges", 20000);
+    
+    /* Shovel s has vertex ids below (s + 1) * nvertices / nshovels */
+    std::vector<std::vector<test_edge> > shovels(nshovels);
+    std::vector<degree> expected(nvertices);
+    for(vid_t v=0; v < nvertices; v++) expected[v].indegree = expected[v].outdegree = 0;
+    unsigned int seed = 7;
+    for(int s=0; s < nshovels; s++) {
+        vid_t limit = (vid_t) ((size_t) (s + 1) * nvertices / nshovels);
+        for(size_t i=0; i < shovel_edges; i++) {
+            seed = seed * 1103515245 + 12345;
+            vid_t src = (seed >> 8) % limit;
+            seed = seed * 1103515245 + 12345;
+            vid_t dst = (seed >> 8) % limit;
+            shovels[s].push_back(test_edge(src, dst, 1.0f));
+            expected[src].outdegree++;
+            expected[dst].indegree++;
+        }
+    }
+    
+    shovel_degree_counter counter;
+    #pragma omp parallel for schedule(dynamic, 1)
+    for(int s=0; s < nshovels; s++) {
+        vid_t max_vertex = 0;
+        for(size_t i=0; i < shovels[s].size(); i++) {
+            max_vertex = std::max(max_vertex, std::max(shovels[s][i].src, shovels[s][i].dst));
+        }
+        counter.count(&shovels[s][0], shovels[s].size(), max_vertex);
+    }
+    for(vid_t v=0; v < nvertices; v++) {
+        degree d = counter.get(v);
+        assert(d.indegree == expected[v].indegree && d.outdegree == expected[v].outdegree);
+    }
+    /* Vertices past the largest counted id have no edges */
+    degree past = counter.get(nvertices + 1000);
+    assert(past.indegree == 0 && past.outdegree == 0);
+    
+    /* Reversed ids */
+    std::vector<vid_t> order(nvertices);
+    for(vid_t v=0; v < nvertices; v++) order[v] = nvertices - 1 - v;
+    vertex_permutation perm;
+    perm.from_order(order);
+    counter.permute(perm);
+    for(vid_t v=0; v < nvertices; v++) {
+        degree d = counter.get(nvertices - 1 - v);
+        assert(d.indegree == expected[v].indegree && d.outdegree == expected[v].outdegree);
+    }
+    
+    /* The released array is zeroed for the final count */
+    degree * degs = counter.release(nvertices);
+    for(vid_t v=0; v < nvertices; v++) assert(degs[v].indegree == 0 && degs[v].outdegree == 0);
+    free(degs);
+    past = counter.get(0);
+    assert(past.indegree == 0 && past.outdegree == 0);
+    
+    logstream(LOG_INFO) << "Shovel degree test passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ 
+ *
+ * @section DESCRIPTION
+ *
+ * Round-trip test for the sorted edge stream: writes edges with and
+ * without values, compressed and uncompressed, over several blocks with
+ * a partial last one, and checks that the reader returns them unchanged.
+ * Values are pseudo-random in half of the runs, so that blocks zlib
+ * cannot shrink are stored as-is.
+ */
+
+#include <string>
+
+#include "graphchi_basic_includes.hpp"
+#include "preprocessing/sorted_edgestream.hpp"
+
+using namespace graphchi;
+
+static vid_t test_src(size_t i) {
+    return (vid_t) (i / 7);
+}
+
+static vid_t test_dst(size_t i) {
+    return (vid_t) ((i * 13) % 100003);
+}
+
+static uint64_t test_value(size_t i, bool random) {
+    if (!random) return i % 5;
+    uint64_t x = i * 6364136223846793005ULL + 1442695040888963407ULL;
+    return x ^ (x >> 29);
+}
+
+static void roundtrip(std::string filename, size_t nedges, uint32_t edges_per_block,
+                      bool with_values, bool compressed, bool random) {
+    {
+        sorted_edgestream_writer<uint64_t> writer(filename, with_values, compressed, edges_per_block);
+        for(size_t i=0; i < nedges; i++) {
+            writer.add(test_src(i), test_dst(i), test_value(i, random));
+        }
+        assert(writer.num_edges() == nedges);
+        writer.close();
+    }
+    
+    sorted_edgestream_reader<uint64_t> reader(filename);
+    assert(reader.num_edges() == nedges);
+    assert(reader.has_values() == with_values);
+    vid_t maxv = 0;
+    for(size_t i=0; i < nedges; i++) maxv = std::max(maxv, std::max(test_src(i), test_dst(i)));
+    assert(reader.max_vertex() == maxv);
+    
+    vid_t src, dst;
+    uint64_t value = 0;
+    for(size_t i=0; i < nedges; i++) {
+        bool got = (i % 2 == 0 ? reader.next(src, dst, value) : reader.next(src, dst));
+        assert(got);
+        assert(src == test_src(i) && dst == test_dst(i));
+        if (with_values && i % 2 == 0) assert(value == test_value(i, random));
+    }
+    assert(!reader.next(src, dst, value));
+    assert(!reader.next(src, dst));
+}
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+    
+    std::string filename = get_option_string("file", "/tmp/sorted_edgestream_test");
+    size_t nedges = get_option_int("nedges", 100000);
+    uint32_t edges_per_block = get_option_int("edges_per_block", 4096);
+    
+    for(int with_values=0; with_values < 2; with_values++) {
+        for(int compressed=0; compressed < 2; compressed++) {
+            for(int random=0; random < 2; random++) {
+                roundtrip(filename, nedges, edges_per_block, with_values, compressed, random);
+            }
+        }
+    }
+    /* Empty stream and a stream of exactly one full block */
+    roundtrip(filename, 0, edges_per_block, true, true, false);
+    roundtrip(filename, edges_per_block, edges_per_block, true, true, false);
+    remove(filename.c_str());
+    
+    logstream(LOG_INFO) << "Sorted edge stream test passed." << std::endl;
+    return 0;
+}
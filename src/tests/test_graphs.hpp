@@ -0,0 +1,125 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Input graphs of the tests, written as edge lists, and a reader for the
+ * vertex values a test computed. The tests write their graph to the file
+ * given with "file" if it does not exist yet.
+ */
+
+#ifndef DEF_GRAPHCHI_TEST_GRAPHS
+#define DEF_GRAPHCHI_TEST_GRAPHS
+
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "graphchi_basic_includes.hpp"
+
+namespace graphchi {
+
+    /* Out-edges of vertex v in write_test_graph() */
+    static void test_graph_outedges(vid_t v, vid_t nvertices, int maxdegree, bool skewed, std::vector<vid_t> &dsts) {
+        dsts.clear();
+        if (skewed && v % 10 == 9) return;
+        int degree = (skewed ? 1 + (int) (v % maxdegree) : maxdegree);
+        for(int k=1; k <= degree; k++) {
+            vid_t dst = (vid_t) (((size_t) v * 7 + k * 13) % nvertices);
+            if (dst != v) dsts.push_back(dst);
+        }
+    }
+
+    /**
+     * Writes a graph where vertex v has out-edges to (7v + 13k) mod
+     * nvertices, k = 1..maxdegree; self-loops are dropped. If skewed,
+     * vertex v has only 1 + v % maxdegree of them and every tenth vertex
+     * is a sink. Returns the number of edges written.
+     */
+    static size_t write_test_graph(std::string filename, vid_t nvertices, int maxdegree, bool skewed=false) {
+        std::ofstream f(filename.c_str());
+        std::vector<vid_t> dsts;
+        size_t n = 0;
+        for(vid_t v=0; v < nvertices; v++) {
+            test_graph_outedges(v, nvertices, maxdegree, skewed, dsts);
+            for(size_t i=0; i < dsts.size(); i++) f << v << "\t" << dsts[i] << std::endl;
+            n += dsts.size();
+        }
+        return n;
+    }
+
+    /* As above, with value(src, dst) as the value of every edge */
+    template <typename ET>
+    static size_t write_test_graph(std::string filename, vid_t nvertices, int maxdegree, bool skewed,
+                                   ET (*value)(vid_t src, vid_t dst)) {
+        std::ofstream f(filename.c_str());
+        std::vector<vid_t> dsts;
+        size_t n = 0;
+        for(vid_t v=0; v < nvertices; v++) {
+            test_graph_outedges(v, nvertices, maxdegree, skewed, dsts);
+            for(size_t i=0; i < dsts.size(); i++) f << v << "\t" << dsts[i] << "\t" << value(v, dsts[i]) << std::endl;
+            n += dsts.size();
+        }
+        return n;
+    }
+
+    /* Writes outdegree random out-edges per vertex; self-loops are dropped */
+    static size_t write_random_test_graph(std::string filename, vid_t nvertices, int outdegree, unsigned int seed) {
+        std::ofstream f(filename.c_str());
+        size_t n = 0;
+        for(vid_t v=0; v < nvertices; v++) {
+            for(int k=0; k < outdegree; k++) {
+                seed = seed * 1103515245 + 12345;
+                vid_t dst = (seed >> 8) % nvertices;
+                if (dst == v) continue;
+                f << v << "\t" << dst << std::endl;
+                n++;
+            }
+        }
+        return n;
+    }
+
+    /* Writes a directed ring */
+    static void write_ring_graph(std::string filename, vid_t nvertices) {
+        std::ofstream f(filename.c_str());
+        for(vid_t v=0; v < nvertices; v++) {
+            f << v << "\t" << (v + 1) % nvertices << std::endl;
+        }
+    }
+
+    /* Reads the vertex data file the engine wrote for the graph */
+    template <typename VT>
+    static std::vector<VT> read_vertex_values(std::string filename, size_t nvertices) {
+        std::vector<VT> values(nvertices);
+        int f = open(filename_vertex_data<VT>(filename).c_str(), O_RDONLY);
+        assert(f >= 0);
+        preada(f, &values[0], nvertices * sizeof(VT), 0);
+        close(f);
+        return values;
+    }
+
+}
+
+#endif
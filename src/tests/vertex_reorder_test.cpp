@@ -0,0 +1,190 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Test for the reordering stage of the sharder. The graph is converted
+ * with each of the orderings degree, bfs, rcm and community, and then:
+ * the .vperm file is loaded, saved and loaded again, and has to be a
+ * bijection of the vertex ids; every line of the .reorder.vmap has to
+ * agree with it; and the edges in the shards, mapped back to the
+ * original ids, have to be the edges of the input with their values,
+ * duplicates included and self-edges dropped. The graph, with nvertices
+ * vertices, is written to the input file.
+ */
+
+#include <string>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+
+#include "graphchi_basic_includes.hpp"
+
+using namespace graphchi;
+
+typedef vid_t VertexDataType;
+typedef vid_t EdgeDataType;
+
+/* (src, dst, value) */
+typedef std::pair<std::pair<vid_t, vid_t>, vid_t> value_edge;
+
+static vid_t edge_value(vid_t src, vid_t dst) {
+    return src * 31 + dst;
+}
+
+static value_edge make_edge(vid_t src, vid_t dst, vid_t value) {
+    return value_edge(std::pair<vid_t, vid_t>(src, dst), value);
+}
+
+/* Collects the in-edges of the shards with the original ids */
+struct CollectEdgesProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
+    const vertex_permutation &perm;
+    std::vector<value_edge> edges;
+    mutex lock;
+
+    CollectEdgesProgram(const vertex_permutation &perm) : perm(perm) {}
+
+    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+        std::vector<value_edge> local;
+        for(int i=0; i < vertex.num_inedges(); i++) {
+            local.push_back(make_edge(perm.to_old(vertex.inedge(i)->vertex_id()), perm.to_old(vertex.id()),
+                                      vertex.inedge(i)->get_data()));
+        }
+        lock.lock();
+        edges.insert(edges.end(), local.begin(), local.end());
+        lock.unlock();
+    }
+};
+
+/* Every fifth vertex has a self-edge, which the sharder drops, and every
+   seventh a duplicate edge */
+static std::vector<value_edge> write_graph(std::string filename, vid_t nvertices) {
+    std::ofstream f(filename.c_str());
+    std::vector<value_edge> edges;
+    for(vid_t v=0; v < nvertices; v++) {
+        for(vid_t k=1; k <= 4; k++) {
+            vid_t dst = (vid_t) (((size_t) v * 7 + k * 13 * (1 + v % 3)) % nvertices);
+            if (dst == v) continue;
+            f << v << "\t" << dst << "\t" << edge_value(v, dst) << std::endl;
+            edges.push_back(make_edge(v, dst, edge_value(v, dst)));
+            if (k == 1 && v % 7 == 0) {
+                f << v << "\t" << dst << "\t" << edge_value(v, dst) << std::endl;
+                edges.push_back(make_edge(v, dst, edge_value(v, dst)));
+            }
+        }
+        if (v % 5 == 0) f << v << "\t" << v << "\t" << edge_value(v, v) << std::endl;
+    }
+    std::sort(edges.begin(), edges.end());
+    return edges;
+}
+
+static void check_bijection(const vertex_permutation &perm, vid_t nvertices) {
+    assert(perm.size() == (size_t) nvertices);
+    std::vector<bool> seen(nvertices, false);
+    for(vid_t v=0; v < nvertices; v++) {
+        assert(perm.to_new(perm.to_old(v)) == v);
+        assert(perm.to_old(perm.to_new(v)) == v);
+        assert(perm.to_new(v) < nvertices);
+        assert(!seen[perm.to_new(v)]);
+        seen[perm.to_new(v)] = true;
+    }
+}
+
+static void check_vmap(std::string filename, const vertex_permutation &perm) {
+    FILE * f = fopen(filename.c_str(), "r");
+    assert(f != NULL);
+    char s[1024];
+    size_t nlines = 0;
+    while(fgets(s, 1024, f) != NULL) {
+        if (s[0] == '#') continue;
+        unsigned int oldid, newid;
+        int nread = sscanf(s, "%u\t%u", &oldid, &newid);
+        assert(nread == 2);
+        assert(perm.to_old(newid) == oldid);
+        nlines++;
+    }
+    fclose(f);
+    assert(nlines == perm.size());
+}
+
+static void check_reorder(std::string filename, std::string method, vid_t nvertices,
+                          const std::vector<value_edge> &expected) {
+    set_conf("reorder", method);
+    int nshards = convert<EdgeDataType, EdgeDataType>(filename, "auto");
+
+    /* The binary permutation, and the same after a save and load */
+    vertex_permutation perm;
+    assert(perm.load(filename_vertex_permutation(filename)));
+    check_bijection(perm, nvertices);
+    std::string copyname = filename_vertex_permutation(filename) + ".copy";
+    perm.save(copyname);
+    vertex_permutation copy;
+    assert(copy.load(copyname));
+    assert(copy.size() == perm.size());
+    for(vid_t v=0; v < nvertices; v++) {
+        assert(copy.to_new(v) == perm.to_new(v));
+        assert(copy.to_old(v) == perm.to_old(v));
+    }
+    remove(copyname.c_str());
+
+    check_vmap(filename_vertex_map(filename), perm);
+
+    size_t nmoved = 0;
+    for(vid_t v=0; v < nvertices; v++) {
+        if (perm.to_new(v) != v) nmoved++;
+    }
+
+    metrics m("vertex-reorder-check");
+    graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, false, m);
+    assert(engine.num_vertices() == (size_t) nvertices);
+    CollectEdgesProgram program(perm);
+    engine.run(program, 1);
+    std::sort(program.edges.begin(), program.edges.end());
+    logstream(LOG_INFO) << method << ": " << nshards << " shards, " << nmoved << " vertices moved, "
+        << program.edges.size() << " edges, expected " << expected.size() << std::endl;
+    assert(program.edges == expected);
+
+    delete_shards<EdgeDataType>(filename, nshards);
+    remove(filename_vertex_permutation(filename).c_str());
+    remove(filename_vertex_map(filename).c_str());
+}
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+
+    /* Several shards. The ordering CSR of the default graph still fits,
+       so bfs, rcm and community do not fall back to degree ordering. */
+    set_conf("membudget_mb", "1");
+
+    std::string filename = get_option_string("file");
+    vid_t nvertices      = get_option_int("nvertices", 10000);
+
+    std::vector<value_edge> expected = write_graph(filename, nvertices);
+
+    check_reorder(filename, "degree", nvertices, expected);
+    check_reorder(filename, "bfs", nvertices, expected);
+    check_reorder(filename, "rcm", nvertices, expected);
+    check_reorder(filename, "community", nvertices, expected);
+
+    logstream(LOG_INFO) << "Vertex reorder test passed." << std::endl;
+    return 0;
+}
@@ -45,6 +45,7 @@
 #include "util/qsort.hpp"
 #include "api/chifilenames.hpp"
 #include "engine/auxdata/vertex_data.hpp"
+#include "api/vertex_aggregator.hpp"
 
 #ifndef DEF_GRAPHCHI_ACTIVEANALYSIS 
 #define DEF_GRAPHCHI_ACTIVEANALYSIS
@@ -64,135 +65,28 @@ bool label_count_greater(const labelcount_tt<LabelType> &a, const labelcount_tt<
     return a.count > b.count;
 }
 
+/* Counts the vertices whose value is_active() */
 template <typename LabelType>
-int active_vertices_count(std::string basefilename) {    
-    typedef labelcount_tt<LabelType> labelcount_t;
-
-    metrics m("active-vertices-count");
-    stripedio * iomgr = new stripedio(m);
-    
-    vid_t readwindow = 1024 * 1024;
-    vid_t numvertices = (vid_t) get_num_vertices(basefilename);
-    vertex_data_store<LabelType> * vertexdata =
-    new vertex_data_store<LabelType>(basefilename, numvertices, iomgr);
-    
-    std::vector<labelcount_t> curlabels;
-    bool first = true;
-    vid_t curvid = 0;
-    //LabelType * buffer = (LabelType*) calloc(readwindow, sizeof(LabelType));
-    
-    /* Iterate the vertex values and maintain the top-list */
-    vid_t st = 0;
-    vid_t en = numvertices - 1;
-  	
-	int active_count = 0;	
-  
-    while(st <= numvertices - 1) {
-        en = st + readwindow - 1;
-        if (en >= numvertices - 1) en = numvertices - 1;
-        
-        /* Load the vertex values */
-        vertexdata->load(st, en);
-        
-        int nt = en - st + 1;
-        
-        /* Mark vertices with its own label with 0xffffffff so they will be ignored */
-        for(int i=0; i < nt; i++) { 
-            LabelType l = *vertexdata->vertex_data_ptr(i + st);
-			/*
-            if (l == curvid) buffer[i] = 0xffffffff;
-            else buffer[i] = l;
-			*/	
-            //curvid++;
-			//if(l.is_active() < 0)
-			if(l.is_active())
-				active_count++;
-        }
-        
-		/*
-        quickSort(buffer, nt, std::less<LabelType>());
-        
-        std::vector<labelcount_t> newlabels;
-        newlabels.reserve(nt);
-        LabelType lastlabel = LabelType(0xffffffff);
-        for(int i=0; i < nt; i++) {
-            if (buffer[i] != LabelType(0xffffffff)) {
-                if (buffer[i] != lastlabel) {
-                    newlabels.push_back(labelcount_t(buffer[i], 1));
-                } else {
-                    newlabels[newlabels.size() - 1].count ++;
-                }
-                lastlabel = buffer[i];
-            }
-        }
-		 
-        if (first) {
-            for(int i=0; i < (int)newlabels.size(); i++) {
-                curlabels.push_back(newlabels[i]);
-            }
-            
-        } else {
-            int cl = 0;
-            int nl = 0;
-            std::vector< labelcount_t > merged;
-            merged.reserve(curlabels.size() + newlabels.size());
-            while(cl < (int)curlabels.size() && nl < (int)newlabels.size()) {
-                if (newlabels[nl].label == curlabels[cl].label) {
-                    merged.push_back(labelcount_t(newlabels[nl].label, newlabels[nl].count + curlabels[cl].count));
-                    nl++; cl++;
-                } else {
-                    if (newlabels[nl].label < curlabels[cl].label) {
-                        merged.push_back(newlabels[nl]);
-                        nl++;
-                    } else {
-                        merged.push_back(curlabels[cl]);
-                        cl++;
-                    }
-                }
-            }
-            while(cl < (int)curlabels.size()) merged.push_back(curlabels[cl++]);
-            while(nl < (int)newlabels.size()) merged.push_back(newlabels[nl++]);
-            
-            curlabels = merged;
-        }
-		*/
-        
-        first = false;
-        st += readwindow;
-    }
-   	/* 
-    //std::sort(curlabels.begin(), curlabels.end(), label_count_greater<LabelType>);
- 
-    std::string outname = basefilename + ".components";
-    std::ofstream resf;
-    resf.open(outname.c_str());
-    if (resf == NULL) {
-        logstream(LOG_ERROR) << "Could not write label outputfile : " << outname << std::endl;
+class active_count_reducer : public VReducer<LabelType, int> {
+public:
+    int init() {
         return 0;
     }
-	int valid_count = 0;
-    for(int i=0; i < (int) curlabels.size(); i++) {
-        resf << curlabels[i].label << "," << curlabels[i].count + 1 << std::endl;
-		// only count labels whose size greater than 1
-		if(curlabels[i].count > 1)
-			valid_count++;
-    }
-    resf.close();
     
-    std::cout << "Total number of different labels (components/communities): " << curlabels.size() << std::endl;
-    std::cout << "List of labels was written to file: " << outname << std::endl;
+    void callback(vid_t vertex_id, LabelType &value, int &accum) {
+        if (value.is_active()) accum++;
+    }
     
-    for(int i=0; i < (int)std::min((size_t)printtop, curlabels.size()); i++) {
-        std::cout << (i+1) << ". label: " << curlabels[i].label << ", size: " << curlabels[i].count + 1 << std::endl;
+    void combine(int &accum, const int &other) {
+        accum += other;
     }
-		
-    free(buffer);
-   	*/ 
-    delete vertexdata;
-    delete iomgr;
-	
-	//return curlabels.size();
-	return active_count;
+};
+
+template <typename LabelType>
+int active_vertices_count(std::string basefilename) {    
+    vid_t numvertices = (vid_t) get_num_vertices(basefilename);
+    active_count_reducer<LabelType> reducer;
+    return parallel_foreach_vertices<LabelType, int>(basefilename, 0, numvertices, reducer);
 }
 
 
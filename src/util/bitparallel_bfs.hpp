@@ -0,0 +1,205 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Per-vertex source bitmasks for bit-parallel multi-source BFS
+ * (MS-BFS). Every vertex has a seen mask and a frontier mask with one
+ * bit per source, so one level-synchronous sweep advances all sources:
+ *
+ *   next(v)  = OR of frontier(u) over in-neighbors u, ANDNOT seen(v)
+ *   seen(v) |= next(v)
+ *
+ * and next becomes the frontier of the following level. Masks are a
+ * whole number of 256-bit lanes (64 sources per word), and the masks of
+ * a vertex are contiguous. Each vertex writes only its own masks and
+ * reads the frontier of the previous level, so updates can run in
+ * parallel without locks.
+ *
+ * The three masks are held in memory, 3 * nvertices * width / 8 bytes.
+ * The width is clamped to a memory budget; callers with more sources
+ * than max_sources() have to run several sweeps.
+ */
+
+#ifndef DEF_GRAPHCHI_BITPARALLEL_BFS
+#define DEF_GRAPHCHI_BITPARALLEL_BFS
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "graphchi_types.hpp"
+#include "logger/logger.hpp"
+
+namespace graphchi {
+
+    class bitparallel_bfs {
+        static const size_t LANE_WORDS = 4;     // 256 bits
+
+        vid_t nvertices;
+        size_t nwords;         // words per vertex mask
+        uint64_t * seen;
+        uint64_t * frontier;
+        uint64_t * next;
+
+        /* dst |= a & ~b over n words, n a multiple of LANE_WORDS */
+        static inline void or_andnot(uint64_t * dst, const uint64_t * a, const uint64_t * b, size_t n) {
+#ifdef __AVX2__
+            for(size_t i=0; i < n; i += LANE_WORDS) {
+                __m256i d = _mm256_loadu_si256((const __m256i *) (dst + i));
+                __m256i x = _mm256_andnot_si256(_mm256_loadu_si256((const __m256i *) (b + i)),
+                                                _mm256_loadu_si256((const __m256i *) (a + i)));
+                _mm256_storeu_si256((__m256i *) (dst + i), _mm256_or_si256(d, x));
+            }
+#else
+            for(size_t i=0; i < n; i++) dst[i] |= a[i] & ~b[i];
+#endif
+        }
+
+        static inline bool any(const uint64_t * a, size_t n) {
+            uint64_t x = 0;
+            for(size_t i=0; i < n; i++) x |= a[i];
+            return x != 0;
+        }
+
+        static uint64_t * alloc_masks(size_t nwords_total) {
+            void * p = NULL;
+            int err = posix_memalign(&p, 32, nwords_total * sizeof(uint64_t));
+            if (err != 0) {
+                logstream(LOG_FATAL) << "Could not allocate " << nwords_total * sizeof(uint64_t) / (1024 * 1024)
+                    << " MB for bit-parallel BFS masks." << std::endl;
+                assert(false);
+            }
+            memset(p, 0, nwords_total * sizeof(uint64_t));
+            return (uint64_t *) p;
+        }
+
+        inline uint64_t * mask(uint64_t * arr, vid_t v) const {
+            return arr + (size_t) v * nwords;
+        }
+
+    public:
+        /**
+         * @param nvertices number of vertices
+         * @param maxsources maximum number of sources of one BFS
+         * @param budget_mb memory for the masks; the number of sources per
+         *        sweep is reduced to fit it, see max_sources()
+         */
+        bitparallel_bfs(vid_t nvertices, size_t maxsources, size_t budget_mb) : nvertices(nvertices) {
+            assert(maxsources > 0);
+            size_t lanes = (maxsources + 64 * LANE_WORDS - 1) / (64 * LANE_WORDS);
+            size_t lanebytes = 3 * LANE_WORDS * sizeof(uint64_t) * (size_t) nvertices;
+            size_t fitlanes = budget_mb * 1024 * 1024 / std::max(lanebytes, (size_t) 1);
+            if (fitlanes == 0) {
+                logstream(LOG_FATAL) << "Bit-parallel BFS needs " << lanebytes / (1024 * 1024) + 1 << " MB for "
+                    << 64 * LANE_WORDS << " sources, but the budget is " << budget_mb << " MB." << std::endl;
+                assert(false);
+            }
+            if (fitlanes < lanes) {
+                logstream(LOG_WARNING) << "Bit-parallel BFS masks of " << maxsources << " sources do not fit in "
+                    << budget_mb << " MB, running " << fitlanes * 64 * LANE_WORDS << " sources per sweep." << std::endl;
+                lanes = fitlanes;
+            }
+            nwords = lanes * LANE_WORDS;
+            seen = alloc_masks(nwords * nvertices);
+            frontier = alloc_masks(nwords * nvertices);
+            next = alloc_masks(nwords * nvertices);
+            logstream(LOG_INFO) << "Bit-parallel BFS: " << nwords * 64 << " sources per sweep, "
+                << (3 * nwords * sizeof(uint64_t) * nvertices) / (1024 * 1024) << " MB of masks." << std::endl;
+        }
+
+        ~bitparallel_bfs() {
+            free(seen);
+            free(frontier);
+            free(next);
+        }
+
+        size_t max_sources() const {
+            return nwords * 64;
+        }
+
+        /**
+         * Starts a new BFS from sources. Source i gets bit i and is put
+         * to the frontier of the first level after advance().
+         */
+        void reset(const std::vector<vid_t> &sources) {
+            assert(sources.size() <= max_sources());
+            memset(seen, 0, nwords * nvertices * sizeof(uint64_t));
+            memset(frontier, 0, nwords * nvertices * sizeof(uint64_t));
+            memset(next, 0, nwords * nvertices * sizeof(uint64_t));
+            for(size_t i=0; i < sources.size(); i++) {
+                uint64_t bit = uint64_t(1) << (i % 64);
+                mask(seen, sources[i])[i / 64] |= bit;
+                mask(next, sources[i])[i / 64] |= bit;
+            }
+        }
+
+        /* True if some source has reached v */
+        inline bool reached(vid_t v) const {
+            return any(seen + (size_t) v * nwords, nwords);
+        }
+
+        /* Adds the sources on the frontier of in-neighbor u to v's next level */
+        inline void gather(vid_t v, vid_t u) {
+            or_andnot(mask(next, v), mask(frontier, u), mask(seen, v), nwords);
+        }
+
+        /**
+         * Marks the sources gathered for v as seen. Returns the index of
+         * the first source that reached v if this is the first level
+         * v was reached on, otherwise -1.
+         */
+        inline int settle(vid_t v) {
+            uint64_t * s = mask(seen, v);
+            const uint64_t * n = mask(next, v);
+            bool first = !any(s, nwords);
+            int src = -1;
+            for(size_t i=0; i < nwords; i++) {
+                if (first && src < 0 && n[i] != 0) src = (int) (i * 64 + __builtin_ctzll(n[i]));
+                s[i] |= n[i];
+            }
+            return src;
+        }
+
+        /**
+         * Ends a level: the gathered masks become the frontier. Call
+         * between iterations, when no updates are running.
+         */
+        void advance() {
+            uint64_t * tmp = frontier;
+            frontier = next;
+            next = tmp;
+            memset(next, 0, nwords * nvertices * sizeof(uint64_t));
+        }
+    };
+
+}
+
+#endif
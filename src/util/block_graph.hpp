@@ -0,0 +1,249 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Sparse quotient graph of blocks (e.g. the BFS trees of msBFS), used
+ * when assigning blocks to partitions. The edges between blocks are
+ * counted during an engine pass into per-thread hash maps, which are
+ * merged into an undirected CSR afterwards: weight(i, j) is the number
+ * of graph edges between blocks i and j in either direction.
+ */
+
+#ifndef DEF_GRAPHCHI_BLOCK_GRAPH
+#define DEF_GRAPHCHI_BLOCK_GRAPH
+
+#include <assert.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+#include "logger/logger.hpp"
+#include "util/thread_slots.hpp"
+
+namespace graphchi {
+
+    /**
+     * Open-addressing hash map from a block pair to an edge count.
+     */
+    class block_pair_counter {
+        std::vector<uint64_t> keys;
+        std::vector<int> counts;
+        size_t nentries;
+
+        static const uint64_t EMPTY_KEY = ~uint64_t(0);
+
+        static inline size_t hash(uint64_t key) {
+            key ^= key >> 33;
+            key *= 0xff51afd7ed558ccdULL;
+            key ^= key >> 33;
+            return (size_t) key;
+        }
+
+        void grow() {
+            std::vector<uint64_t> oldkeys;
+            std::vector<int> oldcounts;
+            oldkeys.swap(keys);
+            oldcounts.swap(counts);
+            keys.assign(oldkeys.size() * 2, uint64_t(EMPTY_KEY));
+            counts.assign(oldkeys.size() * 2, 0);
+            nentries = 0;
+            for(size_t i=0; i < oldkeys.size(); i++) {
+                if (oldkeys[i] != EMPTY_KEY) add(oldkeys[i], oldcounts[i]);
+            }
+        }
+
+    public:
+        block_pair_counter() : keys(1024, uint64_t(EMPTY_KEY)), counts(1024, 0), nentries(0) {}
+
+        inline void add(uint64_t key, int c) {
+            size_t mask = keys.size() - 1;
+            size_t pos = hash(key) & mask;
+            while(keys[pos] != EMPTY_KEY && keys[pos] != key) pos = (pos + 1) & mask;
+            if (keys[pos] == EMPTY_KEY) {
+                keys[pos] = key;
+                nentries++;
+            }
+            counts[pos] += c;
+            if (2 * nentries > keys.size()) grow();
+        }
+
+        size_t size() const {
+            return nentries;
+        }
+
+        /* Appends the entries to out as (key, count) pairs */
+        void collect(std::vector<std::pair<uint64_t, int> > &out) const {
+            for(size_t i=0; i < keys.size(); i++) {
+                if (keys[i] != EMPTY_KEY) out.push_back(std::pair<uint64_t, int>(keys[i], counts[i]));
+            }
+        }
+    };
+
+    /**
+     * Undirected, weighted block graph in CSR form. Neighbors of a block
+     * are sorted by block id.
+     */
+    class block_graph {
+        std::vector<size_t> offsets;
+        std::vector<int> nbrs;
+        std::vector<int> weights;
+        std::vector<long> cut;
+
+    public:
+        block_graph() {}
+
+        int num_blocks() const {
+            return offsets.empty() ? 0 : (int) offsets.size() - 1;
+        }
+
+        size_t num_edges() const {
+            return nbrs.size();
+        }
+
+        inline size_t degree(int b) const {
+            return offsets[b + 1] - offsets[b];
+        }
+
+        inline int neighbor(int b, size_t k) const {
+            return nbrs[offsets[b] + k];
+        }
+
+        inline int weight_at(int b, size_t k) const {
+            return weights[offsets[b] + k];
+        }
+
+        /* Number of edges between blocks a and b, zero if not adjacent */
+        inline int weight(int a, int b) const {
+            std::vector<int>::const_iterator st = nbrs.begin() + offsets[a], en = nbrs.begin() + offsets[a + 1];
+            std::vector<int>::const_iterator it = std::lower_bound(st, en, b);
+            return (it != en && *it == b) ? weights[it - nbrs.begin()] : 0;
+        }
+
+        /* Number of edges leaving block b */
+        inline long cut_edges(int b) const {
+            return cut[b];
+        }
+
+        void clear() {
+            std::vector<size_t>().swap(offsets);
+            std::vector<int>().swap(nbrs);
+            std::vector<int>().swap(weights);
+            std::vector<long>().swap(cut);
+        }
+
+        friend class block_graph_builder;
+    };
+
+    /**
+     * Collects edges between blocks from concurrent update functions.
+     * Each thread counts into its own hash map, so add_edge() takes no locks.
+     * The maps are kept by thread slot (util/thread_slots.hpp).
+     */
+    class block_graph_builder {
+        int nblocks;
+        std::vector<block_pair_counter *> local;
+
+    public:
+        block_graph_builder(int nblocks) : nblocks(nblocks), local(MAX_THREAD_SLOTS, (block_pair_counter *) NULL) {}
+
+        ~block_graph_builder() {
+            for(int i=0; i < thread_slots::count(); i++) {
+                if (local[i] != NULL) delete local[i];
+            }
+        }
+
+        /* Counts an edge from block i to block j. Edges inside a block are ignored. */
+        inline void add_edge(int i, int j, int count=1) {
+            assert(i >= 0 && i < nblocks && j >= 0 && j < nblocks);
+            if (i == j) return;
+            int slot = thread_slots::current();
+            if (local[slot] == NULL) local[slot] = new block_pair_counter();
+            // Pairs are stored with the smaller id first, the graph is undirected
+            uint64_t key = (i < j) ? ((uint64_t) i << 32) | (uint32_t) j : ((uint64_t) j << 32) | (uint32_t) i;
+            local[slot]->add(key, count);
+        }
+
+        /**
+         * Merges the per-thread maps into g and releases them.
+         */
+        void build(block_graph &g) {
+            std::vector<std::pair<uint64_t, int> > pairs;
+            size_t total = 0;
+            for(int i=0; i < thread_slots::count(); i++) {
+                if (local[i] != NULL) total += local[i]->size();
+            }
+            pairs.reserve(total);
+            for(int i=0; i < thread_slots::count(); i++) {
+                if (local[i] != NULL) {
+                    local[i]->collect(pairs);
+                    delete local[i];
+                    local[i] = NULL;
+                }
+            }
+
+            /* Combine the counts of the same pair from different threads */
+            std::sort(pairs.begin(), pairs.end());
+            size_t n = 0;
+            for(size_t i=0; i < pairs.size(); i++) {
+                if (n > 0 && pairs[n - 1].first == pairs[i].first) {
+                    pairs[n - 1].second += pairs[i].second;
+                } else {
+                    pairs[n++] = pairs[i];
+                }
+            }
+            pairs.resize(n);
+
+            /* Both directions into the CSR */
+            g.clear();
+            g.offsets.assign(nblocks + 1, 0);
+            g.cut.assign(nblocks, 0);
+            for(size_t i=0; i < n; i++) {
+                int a = (int) (pairs[i].first >> 32), b = (int) (pairs[i].first & 0xffffffffu);
+                g.offsets[a + 1]++;
+                g.offsets[b + 1]++;
+                g.cut[a] += pairs[i].second;
+                g.cut[b] += pairs[i].second;
+            }
+            for(int b=0; b < nblocks; b++) g.offsets[b + 1] += g.offsets[b];
+            g.nbrs.resize(2 * n);
+            g.weights.resize(2 * n);
+            std::vector<size_t> pos(g.offsets.begin(), g.offsets.end() - 1);
+            /* Pairs are sorted by (a, b), so rows come out sorted too */
+            for(size_t i=0; i < n; i++) {
+                int a = (int) (pairs[i].first >> 32), b = (int) (pairs[i].first & 0xffffffffu);
+                g.nbrs[pos[b]] = a;
+                g.weights[pos[b]++] = pairs[i].second;
+            }
+            for(size_t i=0; i < n; i++) {
+                int a = (int) (pairs[i].first >> 32), b = (int) (pairs[i].first & 0xffffffffu);
+                g.nbrs[pos[a]] = b;
+                g.weights[pos[a]++] = pairs[i].second;
+            }
+            logstream(LOG_INFO) << "Block graph: " << nblocks << " blocks, " << n << " adjacent block pairs." << std::endl;
+        }
+    };
+
+}
+
+#endif
@@ -0,0 +1,133 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * In-memory index of active vertices ordered by degree, for picking the
+ * roots of repeated BFS rounds without rescanning the vertex data file
+ * (see get_top_degree_vertices() and active_vertices_count()).
+ *
+ * Vertices are added with their degree (e.g. from an update function),
+ * then build() buckets them by degree, highest first. Deactivating a
+ * vertex only clears its bit; inactive vertices are dropped lazily when
+ * top() walks past them, so picking K roots costs O(K) amortized.
+ * Deactivation is permanent.
+ */
+
+#ifndef DEF_GRAPHCHI_DEGREE_INDEX
+#define DEF_GRAPHCHI_DEGREE_INDEX
+
+#include <assert.h>
+#include <vector>
+#include <set>
+#include <algorithm>
+
+#include "graphchi_types.hpp"
+#include "logger/logger.hpp"
+#include "util/dense_bitset.hpp"
+
+namespace graphchi {
+
+    class degree_index {
+        std::vector<int> degree;
+        dense_bitset active;
+        std::vector<vid_t> order;     // vertices by descending degree, ascending id
+        size_t cursor;                // order[0..cursor) has been dropped
+        size_t nactive;
+        bool built;
+
+    public:
+        degree_index(vid_t nvertices) : degree(nvertices, 0), active(nvertices), cursor(0), nactive(0), built(false) {
+            active.clear();
+        }
+
+        /* Adds an active vertex. Can be called concurrently before build(). */
+        inline void add(vid_t v, int deg) {
+            assert(!built && deg >= 0);
+            degree[v] = deg;
+            active.set_bit(v);
+        }
+
+        /**
+         * Buckets the added vertices by degree.
+         */
+        void build() {
+            int maxdeg = 0;
+            for(vid_t v=0; v < (vid_t) degree.size(); v++) {
+                if (active.get(v) && degree[v] > maxdeg) maxdeg = degree[v];
+            }
+            /* Counting sort, bucket of degree d starts at pos[maxdeg - d] */
+            std::vector<size_t> pos(maxdeg + 2, 0);
+            for(vid_t v=0; v < (vid_t) degree.size(); v++) {
+                if (active.get(v)) pos[maxdeg - degree[v] + 1]++;
+            }
+            for(int d=0; d <= maxdeg; d++) pos[d + 1] += pos[d];
+            order.resize(pos[maxdeg + 1]);
+            for(vid_t v=0; v < (vid_t) degree.size(); v++) {
+                if (active.get(v)) order[pos[maxdeg - degree[v]]++] = v;
+            }
+            nactive = order.size();
+            cursor = 0;
+            built = true;
+            logstream(LOG_INFO) << "Degree index: " << nactive << " active vertices, max degree " << maxdeg << std::endl;
+        }
+
+        /* Deactivates vertex, returns false if it was not active. Thread-safe. */
+        inline bool deactivate(vid_t v) {
+            if (!active.clear_bit(v)) return false;
+            __sync_fetch_and_sub(&nactive, 1);
+            return true;
+        }
+
+        inline bool is_active(vid_t v) const {
+            return active.get(v);
+        }
+
+        size_t num_active() const {
+            return nactive;
+        }
+
+        /**
+         * Returns up to ntop active vertices with the highest degrees. The
+         * vertices stay active until deactivated.
+         * @param maxdeg if not NULL, set to the highest active degree (or 0)
+         */
+        std::set<vid_t> top(int ntop, int * maxdeg = NULL) {
+            assert(built);
+            std::vector<vid_t> found;
+            size_t i = cursor;
+            for(; i < order.size() && (int) found.size() < ntop; i++) {
+                if (active.get(order[i])) found.push_back(order[i]);
+            }
+            /* Drop the inactive vertices we walked past: the found ones are
+               moved to the end of the scanned range, keeping their order. */
+            cursor = i - found.size();
+            std::copy(found.begin(), found.end(), order.begin() + cursor);
+            if (maxdeg != NULL) *maxdeg = found.empty() ? 0 : degree[found[0]];
+            return std::set<vid_t>(found.begin(), found.end());
+        }
+    };
+
+}
+
+#endif
@@ -1,141 +1,342 @@
 
 // NOTE, copied from GraphLab v 0.5
+// Extended with a two-level summary for skipping empty ranges:
+//   l1 has one bit per word of the bitset, set if the word may be non-zero,
+//   l2 has one bit per cache line (8 words), set if any of its l1 bits is.
+// Summaries are exact after clear()/setall()/clear_bits() and are kept
+// up to date by set_bit()/clear_bit(), which touch them only when a word
+// changes between zero and non-zero.
 
 #ifndef DENSE_BITSET_HPP
 #define DENSE_BITSET_HPP
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <stdint.h>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 namespace graphchi {
     class dense_bitset {
     public:
-        dense_bitset() : array(NULL), len(0) {
-            generate_bit_masks();
+        dense_bitset() : array(NULL), len(0), arrlen(0), l1(NULL), l1len(0), l2(NULL), l2len(0) {
         }
-        
-        dense_bitset(size_t size) : array(NULL), len(size) {
+
+        dense_bitset(size_t size) : array(NULL), len(0), arrlen(0), l1(NULL), l1len(0), l2(NULL), l2len(0) {
             resize(size);
             clear();
-            generate_bit_masks();
         }
-        
-        
-        virtual ~dense_bitset() {free(array);}
-        
+
+
+        virtual ~dense_bitset() {
+            free(array);
+            free(l1);
+            free(l2);
+        }
+
+        /* New bits are cleared */
         void resize(size_t n) {
+            size_t oldarrlen = arrlen;
+            size_t oldlen = len;
             len = n;
             //need len bits
-            arrlen =  n / (8*sizeof(size_t)) + 1;
+            arrlen =  n / BITS_PER_WORD + 1;
             array = (size_t*)realloc(array, sizeof(size_t) * arrlen);
+            if (arrlen > oldarrlen) fill_words(array + oldarrlen, arrlen - oldarrlen, 0);
+            // setall() may have set the bits past the old length
+            if (n > oldlen && oldarrlen > 0) array[oldlen / BITS_PER_WORD] &= bits_below(oldlen % BITS_PER_WORD);
+
+            l1len = arrlen / BITS_PER_WORD + 1;
+            l1 = (size_t*)realloc(l1, sizeof(size_t) * l1len);
+            l2len = (arrlen / WORDS_PER_LINE + 1) / BITS_PER_WORD + 1;
+            l2 = (size_t*)realloc(l2, sizeof(size_t) * l2len);
+            rebuild_summary();
         }
-        
+
         void clear() {
-            for (size_t i = 0;i < arrlen; ++i) array[i] = 0;
+            fill_words(array, arrlen, 0);
+            fill_words(l1, l1len, 0);
+            fill_words(l2, l2len, 0);
         }
-        
+
         void setall() {
-            memset(array, 0xff,  arrlen * sizeof(size_t));
+            fill_words(array, arrlen, ~size_t(0));
+            fill_words(l1, l1len, ~size_t(0));
+            fill_words(l2, l2len, ~size_t(0));
         }
-        
+
         inline bool get(uint32_t b) const{
             uint32_t arrpos, bitpos;
             bit_to_pos(b, arrpos, bitpos);
             return array[arrpos] & (size_t(1) << size_t(bitpos));
         }
-        
+
         //! Set the bit returning the old value
         inline bool set_bit(uint32_t b) {
             // use CAS to set the bit
             uint32_t arrpos, bitpos;
             bit_to_pos(b, arrpos, bitpos);
-            const size_t mask(size_t(1) << size_t(bitpos)); 
-            return __sync_fetch_and_or(array + arrpos, mask) & mask;
+            const size_t mask(size_t(1) << size_t(bitpos));
+            size_t old = __sync_fetch_and_or(array + arrpos, mask);
+            if (old == 0) mark_word(arrpos);
+            return old & mask;
         }
-        
+
         //! Set the state of the bit returning the old value
         inline bool set(uint32_t b, bool value) {
             if (value) return set_bit(b);
             else return clear_bit(b);
         }
-        
+
         //! Clear the bit returning the old value
         inline bool clear_bit(uint32_t b) {
             // use CAS to set the bit
             uint32_t arrpos, bitpos;
             bit_to_pos(b, arrpos, bitpos);
-            const size_t test_mask(size_t(1) << size_t(bitpos)); 
-            const size_t clear_mask(~test_mask); 
-            return __sync_fetch_and_and(array + arrpos, clear_mask) & test_mask;
-        }
-        
-        inline void clear_bits(uint32_t fromb, uint32_t tob) { // tob is inclusive
-            // Careful with alignment
-            const size_t bitsperword = sizeof(size_t)*8;
-            while((fromb%bitsperword != 0)) {
-                clear_bit(fromb);
-                if (fromb>=tob) return;
-                fromb++;
+            const size_t test_mask(size_t(1) << size_t(bitpos));
+            const size_t clear_mask(~test_mask);
+            size_t old = __sync_fetch_and_and(array + arrpos, clear_mask);
+            if (old == test_mask) unmark_word(arrpos);
+            return old & test_mask;
+        }
+
+        /**
+         * Clears bits fromb..tob (inclusive). Safe with concurrent
+         * set_bit() calls outside the range only.
+         */
+        inline void clear_bits(uint32_t fromb, uint32_t tob) {
+            if (len == 0) return;
+            if (tob >= len) tob = (uint32_t)(len - 1);
+            if (fromb > tob) return;
+            uint32_t wf, bf, wt, bt;
+            bit_to_pos(fromb, wf, bf);
+            bit_to_pos(tob, wt, bt);
+            if (wf == wt) {
+                __sync_fetch_and_and(array + wf, ~(bits_upto(bt) & ~bits_below(bf)));
+                refresh_word(wf);
+            } else {
+                __sync_fetch_and_and(array + wf, bits_below(bf));
+                __sync_fetch_and_and(array + wt, ~bits_upto(bt));
+                if (wt > wf + 1) {
+                    fill_words(array + wf + 1, wt - wf - 1, 0);
+                    clear_summary_bits(l1, wf + 1, wt - 1);
+                }
+                refresh_word(wf);
+                refresh_word(wt);
             }
-            
-            while((tob%bitsperword != 0)) {
-                clear_bit(tob);
-                if(tob<=fromb) return;
-                tob--;
+            /* Lines entirely inside the range are empty now */
+            size_t linef = wf / WORDS_PER_LINE, linet = wt / WORDS_PER_LINE;
+            if (linet > linef + 1) clear_summary_bits(l2, linef + 1, linet - 1);
+            refresh_line(linef);
+            refresh_line(linet);
+        }
+
+        //! Number of set bits, counted word by word
+        size_t popcount() const {
+            if (len == 0) return 0;
+            return count_in_range(0, (uint32_t)(len - 1));
+        }
+
+        //! Number of set bits in fromb..tob (inclusive)
+        size_t count_in_range(uint32_t fromb, uint32_t tob) const {
+            if (tob >= len) tob = (uint32_t)(len - 1);
+            if (fromb > tob || len == 0) return 0;
+            uint32_t wf, bf, wt, bt;
+            bit_to_pos(fromb, wf, bf);
+            bit_to_pos(tob, wt, bt);
+            if (wf == wt) return __builtin_popcountl(array[wf] & bits_upto(bt) & ~bits_below(bf));
+            size_t n = __builtin_popcountl(array[wf] & ~bits_below(bf)) + __builtin_popcountl(array[wt] & bits_upto(bt));
+            size_t w = wf + 1;
+            while((w = next_nonzero_word(w, wt - 1)) != NO_WORD) {
+                n += __builtin_popcountl(array[w]);
+                w++;
             }
-            clear_bit(tob);
+            return n;
+        }
 
-            uint32_t from_arrpos = fromb / (8 * (int) sizeof(size_t));
-            uint32_t to_arrpos = tob / (8 * (int)  sizeof(size_t)); 
-            memset(&array[from_arrpos], 0, (to_arrpos-from_arrpos) * (int)  sizeof(size_t));
+        //! Whether any bit in fromb..tob (inclusive) is set
+        inline bool any_in_range(uint32_t fromb, uint32_t tob) const {
+            uint32_t b = fromb;
+            return next_set_bit(b) && b <= tob;
         }
-        
-                
+
+        /**
+         * Moves b to the first set bit at or after b.
+         * Returns false if there is none.
+         */
+        inline bool next_set_bit(uint32_t &b) const {
+            if (b >= len) return false;
+            uint32_t arrpos, bitpos;
+            bit_to_pos(b, arrpos, bitpos);
+            size_t word = array[arrpos] & ~bits_below(bitpos);
+            if (word == 0) {
+                size_t w = next_nonzero_word(arrpos + 1, arrlen - 1);
+                if (w == NO_WORD) return false;
+                arrpos = (uint32_t)w;
+                word = array[w];
+            }
+            b = arrpos * BITS_PER_WORD + __builtin_ctzl(word);
+            // setall() also sets the bits past len in the last word
+            return b < len;
+        }
+
+        //! Finds the first set bit. Returns false if there is none.
+        inline bool first_bit(uint32_t &b) const {
+            b = 0;
+            return next_set_bit(b);
+        }
+
+        //! Moves b to the next set bit after b. Returns false if there is none.
+        inline bool next_bit(uint32_t &b) const {
+            uint32_t nb = b + 1;
+            if (nb == 0 || !next_set_bit(nb)) return false;
+            b = nb;
+            return true;
+        }
+
         inline size_t size() const {
             return len;
         }
-        
+
     private:
-                
-        
+        static const size_t BITS_PER_WORD = 8 * sizeof(size_t);
+        static const size_t WORDS_PER_LINE = 64 / sizeof(size_t);
+        static const size_t NO_WORD = ~size_t(0);
+
+
         inline static void bit_to_pos(uint32_t b, uint32_t &arrpos, uint32_t &bitpos) {
             // the compiler better optimize this...
             arrpos = b / (8 * (int)sizeof(size_t));
             bitpos = b & (8 * (int)sizeof(size_t) - 1);
         }
-        
-        void generate_bit_masks() {
-            below_selectedbit[0] = size_t(-2);
-            for (size_t i = 0;i < 8 * sizeof(size_t) ; ++i) {
-                selectbit[i] = size_t(1) << i;
-                notselectbit[i] = ~selectbit[i];
-                if (i > 0)  below_selectedbit[i] = below_selectedbit[i-1] - selectbit[i];
+
+        /* Mask of bits below bitpos, and of bits up to and including bitpos */
+        inline static size_t bits_below(size_t bitpos) {
+            return (size_t(1) << bitpos) - 1;
+        }
+
+        inline static size_t bits_upto(size_t bitpos) {
+            return bitpos == BITS_PER_WORD - 1 ? ~size_t(0) : (size_t(1) << (bitpos + 1)) - 1;
+        }
+
+        static void fill_words(size_t * p, size_t n, size_t value) {
+#ifdef __AVX2__
+            const __m256i v = _mm256_set1_epi64x((long long)value);
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) _mm256_storeu_si256((__m256i *)(p + i), v);
+            for (; i < n; ++i) p[i] = value;
+#else
+            if (value == 0) memset(p, 0, n * sizeof(size_t));
+            else for (size_t i = 0; i < n; ++i) p[i] = value;
+#endif
+        }
+
+        /* The l1 bits of a line share one l1 word */
+        inline size_t line_bits(size_t line) const {
+            size_t w = line * WORDS_PER_LINE;
+            return (l1[w / BITS_PER_WORD] >> (w % BITS_PER_WORD)) & bits_below(WORDS_PER_LINE);
+        }
+
+        inline void mark_word(size_t w) {
+            const size_t m1 = size_t(1) << (w % BITS_PER_WORD);
+            if (!(l1[w / BITS_PER_WORD] & m1)) __sync_fetch_and_or(l1 + w / BITS_PER_WORD, m1);
+            size_t line = w / WORDS_PER_LINE;
+            const size_t m2 = size_t(1) << (line % BITS_PER_WORD);
+            if (!(l2[line / BITS_PER_WORD] & m2)) __sync_fetch_and_or(l2 + line / BITS_PER_WORD, m2);
+        }
+
+        /* Called when a word may have become zero. A concurrent set_bit()
+           may re-mark the word, so the bit is re-checked after clearing. */
+        inline void unmark_word(size_t w) {
+            refresh_word(w);
+            refresh_line(w / WORDS_PER_LINE);
+        }
+
+        inline void refresh_word(size_t w) {
+            const size_t m1 = size_t(1) << (w % BITS_PER_WORD);
+            if (array[w] != 0) {
+                mark_word(w);
+                return;
             }
+            __sync_fetch_and_and(l1 + w / BITS_PER_WORD, ~m1);
+            if (((volatile size_t *)array)[w] != 0) __sync_fetch_and_or(l1 + w / BITS_PER_WORD, m1);
         }
-        
-        // returns 0 on failure
-        inline size_t next_bit_in_block(const uint32_t &b, const size_t &block) {
-            // use CAS to set the bit
-            size_t x = block & below_selectedbit[b] ;
-            if (x == 0) return 0;
-            else return __builtin_ctzl(x);
+
+        inline void refresh_line(size_t line) {
+            const size_t m2 = size_t(1) << (line % BITS_PER_WORD);
+            if (line_bits(line) != 0) {
+                if (!(l2[line / BITS_PER_WORD] & m2)) __sync_fetch_and_or(l2 + line / BITS_PER_WORD, m2);
+                return;
+            }
+            __sync_fetch_and_and(l2 + line / BITS_PER_WORD, ~m2);
+            if (line_bits(line) != 0) __sync_fetch_and_or(l2 + line / BITS_PER_WORD, m2);
         }
-        
-        // returns 0 on failure
-        inline size_t first_bit_in_block(const size_t &block) {
-            // use CAS to set the bit
-            if (block == 0) return 0;
-            else return __builtin_ctzl(block);
+
+        /* Clears summary bits from..to (inclusive) */
+        static void clear_summary_bits(size_t * s, size_t from, size_t to) {
+            size_t sf = from / BITS_PER_WORD, st = to / BITS_PER_WORD;
+            if (sf == st) {
+                __sync_fetch_and_and(s + sf, ~(bits_upto(to % BITS_PER_WORD) & ~bits_below(from % BITS_PER_WORD)));
+                return;
+            }
+            __sync_fetch_and_and(s + sf, bits_below(from % BITS_PER_WORD));
+            __sync_fetch_and_and(s + st, ~bits_upto(to % BITS_PER_WORD));
+            if (st > sf + 1) fill_words(s + sf + 1, st - sf - 1, 0);
         }
-        
+
+        void rebuild_summary() {
+            fill_words(l1, l1len, 0);
+            fill_words(l2, l2len, 0);
+            for (size_t w = 0; w < arrlen; ++w) {
+                if (array[w] != 0) {
+                    l1[w / BITS_PER_WORD] |= size_t(1) << (w % BITS_PER_WORD);
+                    size_t line = w / WORDS_PER_LINE;
+                    l2[line / BITS_PER_WORD] |= size_t(1) << (line % BITS_PER_WORD);
+                }
+            }
+        }
+
+        /**
+         * First non-zero word in w..wend (inclusive), or NO_WORD.
+         * Skips 512 words per empty l2 word and a line per l2 bit.
+         */
+        inline size_t next_nonzero_word(size_t w, size_t wend) const {
+            while (w <= wend && w < arrlen) {
+                size_t line = w / WORDS_PER_LINE;
+                size_t l2bits = l2[line / BITS_PER_WORD] & ~bits_below(line % BITS_PER_WORD);
+                if (l2bits == 0) {
+                    w = (line / BITS_PER_WORD + 1) * BITS_PER_WORD * WORDS_PER_LINE;
+                    continue;
+                }
+                size_t nextline = (line / BITS_PER_WORD) * BITS_PER_WORD + __builtin_ctzl(l2bits);
+                if (nextline != line) {
+                    line = nextline;
+                    w = line * WORDS_PER_LINE;
+                    if (w > wend) break;
+                }
+                size_t lineend = (line + 1) * WORDS_PER_LINE;
+                size_t l1bits = (l1[w / BITS_PER_WORD] >> (w % BITS_PER_WORD)) & bits_below(lineend - w);
+                while (l1bits != 0) {
+                    size_t cand = w + __builtin_ctzl(l1bits);
+                    if (cand > wend || cand >= arrlen) return NO_WORD;
+                    if (array[cand] != 0) return cand;
+                    l1bits &= l1bits - 1;
+                }
+                w = lineend;
+            }
+            return NO_WORD;
+        }
+
         size_t* array;
         size_t len;
         size_t arrlen;
-        // selectbit[i] has a bit in the i'th position
-        size_t selectbit[8 * sizeof(size_t)];
-        size_t notselectbit[8 * sizeof(size_t)];
-        size_t below_selectedbit[8 * sizeof(size_t)];
+        size_t* l1;
+        size_t l1len;
+        size_t* l2;
+        size_t l2len;
     };
-    
+
 }
 #endif
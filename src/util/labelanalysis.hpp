@@ -169,7 +169,7 @@ int analyze_labels(std::string basefilename, int printtop = 20) {
     std::string outname = basefilename + ".components";
     std::ofstream resf;
     resf.open(outname.c_str());
-    if (resf == NULL) {
+    if (!resf.is_open()) {
         logstream(LOG_ERROR) << "Could not write label outputfile : " << outname << std::endl;
         return 0;
     }
@@ -388,7 +388,7 @@ int count_labels(std::string basefilename, int ntop =20, int NP=0) {
     std::string outname = basefilename + ".components";
     std::ofstream resf;
     resf.open(outname.c_str());
-    if (resf == NULL) {
+    if (!resf.is_open()) {
         logstream(LOG_ERROR) << "Could not write label outputfile : " << outname << std::endl;
         return;
     }
@@ -0,0 +1,377 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Strongly Connected Components with trimming and multi-pivot
+ * forward-backward passes (in the spirit of the Multistep method of
+ * Slota, Rajamanickam and Madduri, 2014):
+ *
+ *  1. Trim: vertices with no live in- or out-neighbors are singleton
+ *     SCCs (Trim-1), and two vertices that are each other's only live
+ *     in- or out-neighbor form an SCC of size two (Trim-2). Vertices with
+ *     zero degree in the degree file are trimmed before the first pass;
+ *     the rest is repeated with the scheduler until nothing changes.
+ *  2. Forward-backward: the npivots live vertices of highest degree
+ *     propagate their id forward, every vertex keeping the smallest pivot
+ *     that reaches it. A pivot p that kept its own id then propagates
+ *     backward among the vertices labeled p, and the vertices reached
+ *     form the SCC of p. At least the smallest pivot succeeds every pass.
+ *     Each pass is followed by trimming.
+ *  3. Once the edges of the live vertices fit in tarjan_edges, they are
+ *     collected to memory and the remaining SCCs are found with Tarjan.
+ *
+ * Every SCC is labeled with a vertex id. The state of a run is kept in
+ * memory by a multipivot_scc_state, so the engine should run with only
+ * adjacency and the selective scheduler.
+ */
+
+#ifndef DEF_GRAPHCHI_MULTIPIVOT_SCC
+#define DEF_GRAPHCHI_MULTIPIVOT_SCC
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+
+#include "graphchi_basic_includes.hpp"
+#include "util/degree_index.hpp"
+#include "util/scc_tarjan.hpp"
+#include "util/thread_slots.hpp"
+
+namespace graphchi {
+
+    static const vid_t SCC_UNASSIGNED = 0xffffffffu;
+
+    /**
+     * Counts of the multipivot_scc() phases.
+     */
+    struct scc_stats {
+        size_t ntrim2;      // vertices in Trim-2 pairs
+        size_t ntarjan;     // live vertices left to Tarjan
+        int npasses;        // forward-backward passes
+
+        scc_stats() : ntrim2(0), ntarjan(0), npasses(0) {}
+    };
+
+    /**
+     * State of one multipivot_scc() run, shared by its update programs.
+     */
+    class multipivot_scc_state {
+        multipivot_scc_state(const multipivot_scc_state &);
+        multipivot_scc_state & operator= (const multipivot_scc_state &);
+
+    public:
+        vid_t nvertices;
+        vid_t * sccid;          // SCC label, SCC_UNASSIGNED while live
+        vid_t * fwlabel;        // smallest pivot reaching the vertex in the current pass
+        vid_t * sole_in;        // only live in-neighbor when last trimmed, or SCC_UNASSIGNED
+        vid_t * sole_out;
+        degree * degs;          // degrees from the degree file
+        degree_index * degindex;
+        size_t nassigned;
+        size_t ntrim2;          // vertices assigned by Trim-2
+        std::vector<std::vector<std::pair<vid_t, vid_t> > > residual_edges;   // by thread slot
+
+        /* labels has nvertices entries and receives the SCC labels */
+        multipivot_scc_state(std::string filename, vid_t nvertices, vid_t * labels) : nvertices(nvertices), sccid(labels),
+                nassigned(0), ntrim2(0) {
+            fwlabel = (vid_t *) malloc(sizeof(vid_t) * nvertices);
+            sole_in = (vid_t *) malloc(sizeof(vid_t) * nvertices);
+            sole_out = (vid_t *) malloc(sizeof(vid_t) * nvertices);
+            for(vid_t v=0; v < nvertices; v++) {
+                sccid[v] = sole_in[v] = sole_out[v] = SCC_UNASSIGNED;
+            }
+            load_degrees(filename);
+            degindex = new degree_index(nvertices);
+        }
+
+        ~multipivot_scc_state() {
+            delete degindex;
+            free(degs);
+            free(fwlabel);
+            free(sole_in);
+            free(sole_out);
+        }
+
+        inline bool is_live(vid_t v) const {
+            return sccid[v] == SCC_UNASSIGNED;
+        }
+
+        /* Labels a live vertex, returns false if it was labeled already */
+        inline bool assign_scc(vid_t v, vid_t label) {
+            if (!__sync_bool_compare_and_swap(&sccid[v], SCC_UNASSIGNED, label)) return false;
+            degindex->deactivate(v);
+            __sync_fetch_and_add(&nassigned, 1);
+            return true;
+        }
+
+        void schedule_live_neighbors(graphchi_vertex<vid_t, vid_t> &vertex, graphchi_context &gcontext) {
+            for(int i=0; i < vertex.num_edges(); i++) {
+                vid_t nb = vertex.edge(i)->vertex_id();
+                if (is_live(nb)) gcontext.scheduler->add_task(nb);
+            }
+        }
+
+        /* Upper bound of the edges between live vertices */
+        size_t residual_edge_bound() const {
+            size_t nedges = 0;
+            for(vid_t v=0; v < nvertices; v++) {
+                if (is_live(v)) nedges += degs[v].outdegree;
+            }
+            return nedges;
+        }
+
+    private:
+        void load_degrees(std::string filename) {
+            degs = (degree *) calloc(nvertices, sizeof(degree));
+            std::string degfname = filename_degree_data(filename);
+            FILE * f = fopen(degfname.c_str(), "rb");
+            if (f == NULL) {
+                logstream(LOG_FATAL) << "Could not open degree file " << degfname << std::endl;
+                assert(false);
+            }
+            size_t nread = fread(degs, sizeof(degree), nvertices, f);
+            fclose(f);
+            logstream(LOG_INFO) << "Read degrees of " << nread << " vertices." << std::endl;
+        }
+    };
+
+    /**
+     * Trim-1 and Trim-2. All vertices run on the first iteration, later only
+     * the neighbors of trimmed vertices.
+     */
+    struct SCCTrim : public GraphChiProgram<vid_t, vid_t> {
+        multipivot_scc_state &scc;
+
+        SCCTrim(multipivot_scc_state &scc) : scc(scc) {}
+
+        void update(graphchi_vertex<vid_t, vid_t> &vertex, graphchi_context &gcontext) {
+            vid_t v = vertex.id();
+            if (!scc.is_live(v)) {
+                /* Trimmed as the partner of a Trim-2 pair */
+                if (gcontext.iteration > 0) scc.schedule_live_neighbors(vertex, gcontext);
+                return;
+            }
+            /* Count live neighbors; a count of one means all live
+               neighbors are the same vertex (duplicate edges) */
+            int nin = 0, nout = 0;
+            vid_t in1 = SCC_UNASSIGNED, out1 = SCC_UNASSIGNED;
+            for(int i=0; i < vertex.num_inedges(); i++) {
+                vid_t nb = vertex.inedge(i)->vertex_id();
+                if (nb == v || !scc.is_live(nb)) continue;
+                if (nin == 0) in1 = nb;
+                if (nin == 0 || nb != in1) nin++;
+            }
+            for(int i=0; i < vertex.num_outedges(); i++) {
+                vid_t nb = vertex.outedge(i)->vertex_id();
+                if (nb == v || !scc.is_live(nb)) continue;
+                if (nout == 0) out1 = nb;
+                if (nout == 0 || nb != out1) nout++;
+            }
+
+            if (nin == 0 || nout == 0) {
+                if (scc.assign_scc(v, v)) scc.schedule_live_neighbors(vertex, gcontext);
+                return;
+            }
+            scc.sole_in[v] = (nin == 1 ? in1 : SCC_UNASSIGNED);
+            scc.sole_out[v] = (nout == 1 ? out1 : SCC_UNASSIGNED);
+
+            /* Neighbors only lose live neighbors, so a partner that once had
+               v as its only live in- (out-) neighbor and is live still does. */
+            vid_t partner = SCC_UNASSIGNED;
+            if (nin == 1 && scc.sole_in[in1] == v && scc.is_live(in1)) partner = in1;
+            else if (nout == 1 && scc.sole_out[out1] == v && scc.is_live(out1)) partner = out1;
+            if (partner != SCC_UNASSIGNED) {
+                vid_t label = std::min(v, partner);
+                if (scc.assign_scc(v, label)) __sync_fetch_and_add(&scc.ntrim2, 1);
+                if (scc.assign_scc(partner, label)) {
+                    __sync_fetch_and_add(&scc.ntrim2, 1);
+                    gcontext.scheduler->add_task(partner);
+                }
+                scc.schedule_live_neighbors(vertex, gcontext);
+            }
+        }
+    };
+
+    /**
+     * Forward phase: smallest reaching pivot. fwlabel is reset and the pivots
+     * set before the run.
+     */
+    struct SCCForward : public GraphChiProgram<vid_t, vid_t> {
+        multipivot_scc_state &scc;
+
+        SCCForward(multipivot_scc_state &scc) : scc(scc) {}
+
+        void update(graphchi_vertex<vid_t, vid_t> &vertex, graphchi_context &gcontext) {
+            vid_t v = vertex.id();
+            if (!scc.is_live(v)) return;
+            vid_t label = scc.fwlabel[v];
+            for(int i=0; i < vertex.num_inedges(); i++) {
+                vid_t nb = vertex.inedge(i)->vertex_id();
+                if (scc.is_live(nb) && scc.fwlabel[nb] < label) label = scc.fwlabel[nb];
+            }
+            bool propagate = (label < scc.fwlabel[v]) || (gcontext.iteration == 0 && label != SCC_UNASSIGNED);
+            scc.fwlabel[v] = label;
+            if (propagate) {
+                for(int i=0; i < vertex.num_outedges(); i++) {
+                    vid_t nb = vertex.outedge(i)->vertex_id();
+                    if (scc.is_live(nb) && scc.fwlabel[nb] > label) gcontext.scheduler->add_task(nb);
+                }
+            }
+        }
+    };
+
+    /**
+     * Backward phase: a live vertex with an out-neighbor already in the SCC
+     * of its forward label joins it. The successful pivots are assigned
+     * before the run.
+     */
+    struct SCCBackward : public GraphChiProgram<vid_t, vid_t> {
+        multipivot_scc_state &scc;
+
+        SCCBackward(multipivot_scc_state &scc) : scc(scc) {}
+
+        void update(graphchi_vertex<vid_t, vid_t> &vertex, graphchi_context &gcontext) {
+            vid_t v = vertex.id();
+            vid_t label = scc.fwlabel[v];
+            if (!scc.is_live(v) || label == SCC_UNASSIGNED) return;
+            bool reached = false;
+            for(int i=0; i < vertex.num_outedges(); i++) {
+                if (scc.sccid[vertex.outedge(i)->vertex_id()] == label) {
+                    reached = true;
+                    break;
+                }
+            }
+            if (!reached || !scc.assign_scc(v, label)) return;
+            for(int i=0; i < vertex.num_inedges(); i++) {
+                vid_t nb = vertex.inedge(i)->vertex_id();
+                if (scc.is_live(nb) && scc.fwlabel[nb] == label) gcontext.scheduler->add_task(nb);
+            }
+        }
+    };
+
+    /**
+     * Collects the edges between live vertices for Tarjan.
+     */
+    struct CollectResidual : public GraphChiProgram<vid_t, vid_t> {
+        multipivot_scc_state &scc;
+
+        CollectResidual(multipivot_scc_state &scc) : scc(scc) {}
+
+        void update(graphchi_vertex<vid_t, vid_t> &vertex, graphchi_context &gcontext) {
+            vid_t v = vertex.id();
+            if (!scc.is_live(v)) return;
+            std::vector<std::pair<vid_t, vid_t> > &out = scc.residual_edges[thread_slots::current()];
+            for(int i=0; i < vertex.num_outedges(); i++) {
+                vid_t nb = vertex.outedge(i)->vertex_id();
+                if (scc.is_live(nb)) out.push_back(std::pair<vid_t, vid_t>(v, nb));
+            }
+        }
+    };
+
+    /**
+     * Labels the SCCs of the graph of the engine to labels, which has
+     * engine.num_vertices() entries.
+     */
+    static scc_stats multipivot_scc(graphchi_engine<vid_t, vid_t> &engine, std::string filename, vid_t * labels,
+                                    int niters, int npivots, size_t tarjan_edges) {
+        vid_t nvertices = (vid_t) engine.num_vertices();
+        scc_stats stats;
+        multipivot_scc_state scc(filename, nvertices, labels);
+
+        /* Trim the vertices with zero in- or out-degree without a pass,
+           index the others by degree for picking pivots */
+        for(vid_t v=0; v < nvertices; v++) {
+            if (scc.degs[v].indegree == 0 || scc.degs[v].outdegree == 0) {
+                scc.sccid[v] = v;
+                scc.nassigned++;
+            } else {
+                scc.degindex->add(v, std::min(scc.degs[v].indegree, scc.degs[v].outdegree));
+            }
+        }
+        scc.degindex->build();
+        logstream(LOG_INFO) << "Trimmed " << scc.nassigned << " vertices using the degree file." << std::endl;
+
+        SCCTrim trim(scc);
+        engine.run(trim, niters);
+        logstream(LOG_INFO) << "Trimming: " << scc.nassigned << " vertices assigned, " << scc.degindex->num_active() << " live." << std::endl;
+
+        while(scc.degindex->num_active() > 0 && scc.residual_edge_bound() > tarjan_edges) {
+            std::set<vid_t> pivots = scc.degindex->top(npivots);
+            for(vid_t v=0; v < nvertices; v++) scc.fwlabel[v] = SCC_UNASSIGNED;
+            for(std::set<vid_t>::iterator it=pivots.begin(); it != pivots.end(); ++it) scc.fwlabel[*it] = *it;
+
+            SCCForward forward(scc);
+            engine.run(forward, niters);
+
+            /* A pivot reached by a smaller pivot is in another pivot's
+               forward set and is retried on a later pass */
+            int nfound = 0;
+            for(std::set<vid_t>::iterator it=pivots.begin(); it != pivots.end(); ++it) {
+                if (scc.fwlabel[*it] == *it && scc.assign_scc(*it, *it)) nfound++;
+            }
+            size_t before = scc.nassigned;
+            SCCBackward backward(scc);
+            engine.run(backward, niters);
+            logstream(LOG_INFO) << "Forward-backward pass " << stats.npasses << ": " << nfound << "/" << pivots.size()
+                << " pivots, " << (scc.nassigned - before + nfound) << " vertices in their SCCs." << std::endl;
+
+            engine.run(trim, niters);
+            logstream(LOG_INFO) << "Trimming: " << scc.nassigned << " vertices assigned, " << scc.degindex->num_active() << " live." << std::endl;
+            stats.npasses++;
+        }
+
+        if (scc.degindex->num_active() > 0) {
+            scc.residual_edges.resize(MAX_THREAD_SLOTS);
+            CollectResidual collect(scc);
+            engine.run(collect, 1);
+
+            std::vector<vid_t> live;
+            for(vid_t v=0; v < nvertices; v++) {
+                if (scc.is_live(v)) live.push_back(v);
+            }
+            std::vector<std::pair<vid_t, vid_t> > edges;
+            for(int i=0; i < thread_slots::count(); i++) {
+                edges.insert(edges.end(), scc.residual_edges[i].begin(), scc.residual_edges[i].end());
+            }
+            std::vector<std::vector<std::pair<vid_t, vid_t> > >().swap(scc.residual_edges);
+
+            scc_tarjan tarjan(live, edges);
+            for(size_t i=0; i < tarjan.num_vertices(); i++) {
+                scc.assign_scc(tarjan.vertex(i), tarjan.label(i));
+            }
+            stats.ntarjan = live.size();
+            logstream(LOG_INFO) << "Tarjan: " << live.size() << " vertices, " << edges.size() << " edges, "
+                << tarjan.num_components() << " components." << std::endl;
+        }
+        assert(scc.nassigned == nvertices);
+        stats.ntrim2 = scc.ntrim2;
+        return stats;
+    }
+
+}
+
+#endif
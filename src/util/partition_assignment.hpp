@@ -0,0 +1,207 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Greedy assignment of blocks (BFS trees, Voronoi cells...) to partitions.
+ *
+ * assign_least_loaded(): every block, in order, goes to the least loaded
+ * partition (used by GVD and blogel).
+ *
+ * assign_greedy(): the partitions are seeded with the first nparts blocks;
+ * then the least loaded partition repeatedly takes its best scored
+ * unassigned neighbor block, score(p, b) = edges(p, b) / cutedges(b), or
+ * the largest unassigned block if it has no neighbors left (used by msBFS).
+ * Scores are kept in a lazy max-heap per partition and updated only for
+ * the neighbors of the block that was just merged; the partition loads
+ * are kept in a min-heap. Ties go to the lower block/partition index.
+ */
+
+#ifndef DEF_GRAPHCHI_PARTITION_ASSIGNMENT
+#define DEF_GRAPHCHI_PARTITION_ASSIGNMENT
+
+#include <assert.h>
+#include <vector>
+#include <map>
+#include <queue>
+#include <algorithm>
+#include <functional>
+
+#include "logger/logger.hpp"
+#include "util/block_graph.hpp"
+
+namespace graphchi {
+
+    class partition_assignment {
+
+        /* Candidate block of a partition. Stale if the block was assigned
+           or the partition's edge count to it has grown since. */
+        struct candidate {
+            double score;
+            long edges;
+            int block;
+            candidate(double score, long edges, int block) : score(score), edges(edges), block(block) {}
+            bool operator< (const candidate &o) const {
+                if (score != o.score) return score < o.score;
+                return block > o.block;
+            }
+        };
+
+        typedef std::pair<long, int> load_t;   // (load, partition), lazily deleted
+
+        int nparts;
+        std::vector<long> block_sizes;
+        const block_graph * graph;
+
+        std::vector<int> block_part;
+        std::vector<std::vector<int> > parts;
+        std::vector<long> loads;
+        size_t nassigned;
+
+        std::vector<std::priority_queue<candidate> > candidates;
+        std::vector<std::map<int, long> > partedges;     // edges from the partition to unassigned blocks
+        std::priority_queue<load_t, std::vector<load_t>, std::greater<load_t> > loadheap;
+        std::vector<int> by_size;     // blocks by descending size
+        size_t size_cursor;
+
+        void add_neighbors(int part, int block) {
+            if (graph == NULL) return;
+            for(size_t k=0; k < graph->degree(block); k++) {
+                int nb = graph->neighbor(block, k);
+                if (block_part[nb] >= 0) continue;
+                long e = (partedges[part][nb] += graph->weight_at(block, k));
+                candidates[part].push(candidate((double) e / (double) graph->cut_edges(nb), e, nb));
+            }
+        }
+
+        /* Best scored unassigned neighbor, or -1 */
+        int best_neighbor(int part) {
+            std::priority_queue<candidate> &heap = candidates[part];
+            while(!heap.empty()) {
+                candidate c = heap.top();
+                if (block_part[c.block] < 0) {
+                    if (partedges[part][c.block] == c.edges) return c.block;
+                } else {
+                    partedges[part].erase(c.block);
+                }
+                heap.pop();
+            }
+            return -1;
+        }
+
+        /* Largest unassigned block, or -1 */
+        int largest_block() {
+            while(size_cursor < by_size.size() && block_part[by_size[size_cursor]] >= 0) size_cursor++;
+            return size_cursor < by_size.size() ? by_size[size_cursor] : -1;
+        }
+
+        struct by_size_desc {
+            const std::vector<long> * sizes;
+            by_size_desc(const std::vector<long> * sizes) : sizes(sizes) {}
+            bool operator() (int a, int b) const {
+                if ((*sizes)[a] != (*sizes)[b]) return (*sizes)[a] > (*sizes)[b];
+                return a < b;
+            }
+        };
+
+    public:
+        /**
+         * @param nparts number of partitions
+         * @param block_sizes size (e.g. number of vertices) of each block
+         * @param graph edges between blocks, needed only by assign_greedy()
+         */
+        partition_assignment(int nparts, const std::vector<long> &block_sizes, const block_graph * graph=NULL) :
+                nparts(nparts), block_sizes(block_sizes), graph(graph), block_part(block_sizes.size(), -1),
+                parts(nparts), loads(nparts, 0), nassigned(0), candidates(nparts), partedges(nparts), size_cursor(0) {
+            assert(nparts > 0);
+            for(int p=0; p < nparts; p++) loadheap.push(load_t(0, p));
+        }
+
+        /* Puts an unassigned block to partition part */
+        void assign(int block, int part) {
+            assert(block_part[block] < 0);
+            block_part[block] = part;
+            parts[part].push_back(block);
+            loads[part] += block_sizes[block];
+            loadheap.push(load_t(loads[part], part));
+            nassigned++;
+            partedges[part].erase(block);
+            add_neighbors(part, block);
+        }
+
+        int least_loaded() {
+            /* Entries whose load has changed since are stale */
+            while(loadheap.top().first != loads[loadheap.top().second]) loadheap.pop();
+            return loadheap.top().second;
+        }
+
+        /* Blocks in order, each to the least loaded partition */
+        void assign_least_loaded() {
+            for(int b=0; b < (int) block_sizes.size(); b++) {
+                if (block_part[b] < 0) assign(b, least_loaded());
+            }
+        }
+
+        /**
+         * Neighborhood-greedy assignment. Blocks 0..nparts-1 seed the
+         * partitions, so blocks should be given by descending size.
+         */
+        void assign_greedy() {
+            assert(graph != NULL && graph->num_blocks() == (int) block_sizes.size());
+            by_size.resize(block_sizes.size());
+            for(size_t b=0; b < by_size.size(); b++) by_size[b] = (int) b;
+            std::sort(by_size.begin(), by_size.end(), by_size_desc(&block_sizes));
+
+            for(int p=0; p < nparts && p < (int) block_sizes.size(); p++) {
+                assign(p, p);
+            }
+            while(nassigned < block_sizes.size()) {
+                int part = least_loaded();
+                int block = best_neighbor(part);
+                if (block < 0) block = largest_block();
+                assert(block >= 0);
+                assign(block, part);
+            }
+            logstream(LOG_INFO) << "Assigned " << nassigned << " blocks to " << nparts << " partitions." << std::endl;
+        }
+
+        int partition_of(int block) const {
+            return block_part[block];
+        }
+
+        const std::vector<int> & blocks(int part) const {
+            return parts[part];
+        }
+
+        long load(int part) const {
+            return loads[part];
+        }
+
+        int num_partitions() const {
+            return nparts;
+        }
+    };
+
+}
+
+#endif
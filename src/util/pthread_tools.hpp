@@ -233,6 +233,18 @@ namespace graphchi {
             l.s.read++;
         }
         
+        /* Takes the read lock only if no writer holds or waits for it */
+        inline bool try_readlock() const {
+            unsigned t = l.u;
+            unsigned write = t & 0xff;
+            unsigned read = (t >> 8) & 0xff;
+            unsigned users = (t >> 16) & 0xff;
+            if (read != users) return false;
+            unsigned char next = (unsigned char) (users + 1);
+            unsigned cmpnew = (t & 0xff000000) | ((unsigned) next << 16) | ((unsigned) next << 8) | write;
+            return cmpxchg(&l.u, t, cmpnew) == t;
+        }
+
         inline void rdunlock() const {
             atomic_inc(&l.s.write);
         }
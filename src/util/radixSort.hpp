@@ -26,6 +26,7 @@
 #include <iostream>
 #include <algorithm>
 #include <math.h>
+#include <omp.h>
 #include "graphchi_types.hpp"
 
 
@@ -114,6 +115,82 @@ namespace graphchi {
         
         free(B); free(Tmp); free(counts);
     }
+    
+    // Below this many elements the parallel sort is not worth the thread startup
+#define PARALLEL_RADIX_MIN (1 << 16)
+    
+    // Parallel radix sort with low order bits first. Each thread owns a
+    // contiguous slice of the input and keeps its own bucket counts; the counts
+    // are prefix-summed in (bucket, thread) order so that the scatter
+    // stays stable, exactly like iSort.
+    template <class E, class F>
+    void piSort(E *A, intT n, intT m, F f, int nthreads) {
+        if (nthreads <= 1 || n < PARALLEL_RADIX_MIN) {
+            iSort(A, n, m, f);
+            return;
+        }
+        intT bits = log2Up(m);
+        
+        // temporary space
+        E* B = (E*) malloc(sizeof(E)*n);
+        bIndexT* Tmp = (bIndexT*) malloc(sizeof(bIndexT)*n);
+        intT* counts = (intT*) malloc(sizeof(intT)*BUCKETS*nthreads);
+        
+        intT rounds = 1+(bits-1)/MAX_RADIX;
+        intT rbits = 1+(bits-1)/rounds;
+        intT bitOffset = 0;
+        bool flipped = 0;
+        
+        while (bitOffset < bits) {
+            if (bitOffset+rbits > bits) rbits = bits-bitOffset;
+            E * from = (flipped ? B : A);
+            E * to = (flipped ? A : B);
+            intT nbuckets = 1L << rbits;
+            eBits<E,F> extract(rbits, bitOffset, f);
+            
+#pragma omp parallel num_threads(nthreads)
+            {
+                // May get fewer threads than asked for (e.g. nested regions)
+                int nt = omp_get_num_threads();
+                int t = omp_get_thread_num();
+                intT chunk = (n + nt - 1) / nt;
+                intT st = std::min(n, chunk * t);
+                intT en = std::min(n, st + chunk);
+                intT * mycounts = counts + t * BUCKETS;
+                
+                for (intT i = 0; i < nbuckets; i++) mycounts[i] = 0;
+                for (intT j = st; j < en; j++) {
+                    intT k = Tmp[j] = extract(from[j]);
+                    mycounts[k]++;
+                }
+#pragma omp barrier
+#pragma omp single
+                {
+                    intT s = 0;
+                    for (intT i = 0; i < nbuckets; i++) {
+                        for (int tt = 0; tt < nt; tt++) {
+                            intT c = counts[tt * BUCKETS + i];
+                            counts[tt * BUCKETS + i] = s;
+                            s += c;
+                        }
+                    }
+                }
+                for (intT j = st; j < en; j++) {
+                    to[mycounts[Tmp[j]]++] = from[j];
+                }
+            }
+            bitOffset += rbits;
+            flipped = !flipped;
+        }
+        
+        if (flipped) {
+#pragma omp parallel for num_threads(nthreads)
+            for (intT i=0; i < n; i++)
+                A[i] = B[i];
+        }
+        
+        free(B); free(Tmp); free(counts);
+    }
 }
 
 
@@ -0,0 +1,158 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * In-memory strongly connected components (Tarjan) for the residual
+ * graph that is left after trimming and forward-backward passes. The
+ * graph is given as an edge list over arbitrary vertex ids and turned
+ * into CSR; the DFS is iterative so long paths do not overflow the stack.
+ * Every component is labeled with its smallest vertex id.
+ */
+
+#ifndef DEF_GRAPHCHI_SCC_TARJAN
+#define DEF_GRAPHCHI_SCC_TARJAN
+
+#include <assert.h>
+#include <vector>
+#include <algorithm>
+
+#include "graphchi_types.hpp"
+
+namespace graphchi {
+
+    class scc_tarjan {
+        std::vector<vid_t> ids;       // local index -> vertex id, sorted
+        std::vector<size_t> offsets;  // CSR over local indices
+        std::vector<int> adj;
+        std::vector<vid_t> labels;    // component label of each local index
+        int ncomponents;
+
+        int local(vid_t v) const {
+            return (int) (std::lower_bound(ids.begin(), ids.end(), v) - ids.begin());
+        }
+
+        void run() {
+            int n = (int) ids.size();
+            std::vector<int> index(n, -1), lowlink(n, 0);
+            std::vector<char> onstack(n, 0);
+            std::vector<int> stack;
+            std::vector<std::pair<int, size_t> > dfs;   // (vertex, next edge)
+            int counter = 0;
+            for(int s=0; s < n; s++) {
+                if (index[s] >= 0) continue;
+                dfs.push_back(std::pair<int, size_t>(s, offsets[s]));
+                index[s] = lowlink[s] = counter++;
+                stack.push_back(s);
+                onstack[s] = 1;
+                while(!dfs.empty()) {
+                    int v = dfs.back().first;
+                    size_t &e = dfs.back().second;
+                    if (e < offsets[v + 1]) {
+                        int u = adj[e++];
+                        if (index[u] < 0) {
+                            index[u] = lowlink[u] = counter++;
+                            stack.push_back(u);
+                            onstack[u] = 1;
+                            dfs.push_back(std::pair<int, size_t>(u, offsets[u]));
+                        } else if (onstack[u]) {
+                            lowlink[v] = std::min(lowlink[v], index[u]);
+                        }
+                        continue;
+                    }
+                    dfs.pop_back();
+                    if (!dfs.empty()) {
+                        int parent = dfs.back().first;
+                        lowlink[parent] = std::min(lowlink[parent], lowlink[v]);
+                    }
+                    if (lowlink[v] == index[v]) {
+                        /* v is the root of a component; local indices follow
+                           vertex id order, so the smallest id is the minimum */
+                        size_t top = stack.size();
+                        int minlocal = v;
+                        do {
+                            top--;
+                            minlocal = std::min(minlocal, stack[top]);
+                        } while(stack[top] != v);
+                        for(size_t i=top; i < stack.size(); i++) {
+                            labels[stack[i]] = ids[minlocal];
+                            onstack[stack[i]] = 0;
+                        }
+                        stack.resize(top);
+                        ncomponents++;
+                    }
+                }
+            }
+        }
+
+    public:
+        /**
+         * @param vertices vertices of the residual graph
+         * @param edges edges between them; edges to other vertices must
+         *        not be included
+         */
+        scc_tarjan(const std::vector<vid_t> &vertices, const std::vector<std::pair<vid_t, vid_t> > &edges) :
+                ids(vertices), ncomponents(0) {
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+            int n = (int) ids.size();
+            offsets.assign(n + 1, 0);
+            std::vector<int> src(edges.size());
+            for(size_t i=0; i < edges.size(); i++) {
+                src[i] = local(edges[i].first);
+                assert(src[i] < n && ids[src[i]] == edges[i].first);
+                offsets[src[i] + 1]++;
+            }
+            for(int v=0; v < n; v++) offsets[v + 1] += offsets[v];
+            adj.resize(edges.size());
+            std::vector<size_t> pos(offsets.begin(), offsets.end() - 1);
+            for(size_t i=0; i < edges.size(); i++) {
+                int dst = local(edges[i].second);
+                assert(dst < n && ids[dst] == edges[i].second);
+                adj[pos[src[i]]++] = dst;
+            }
+            labels.assign(n, 0);
+            run();
+        }
+
+        size_t num_vertices() const {
+            return ids.size();
+        }
+
+        vid_t vertex(size_t i) const {
+            return ids[i];
+        }
+
+        /* Component label (smallest vertex id in it) of the i-th vertex */
+        vid_t label(size_t i) const {
+            return labels[i];
+        }
+
+        int num_components() const {
+            return ncomponents;
+        }
+    };
+
+}
+
+#endif
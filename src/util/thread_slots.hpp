@@ -0,0 +1,121 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Per-thread slots for lock-free accumulation inside update functions.
+ * OpenMP thread numbers are not unique with nested parallelism (the
+ * engine runs updates in nested teams), so every OS thread that asks
+ * gets its own slot index instead.
+ *
+ * libgomp starts new OS threads for nested teams on every parallel
+ * region, so slots are returned to a free list when their thread exits
+ * and handed to later threads. The number of slots is thus bounded by
+ * the number of threads alive at the same time. Data kept in a slot
+ * outlives its thread: a recycled slot keeps accumulating on top of it.
+ */
+
+#ifndef DEF_GRAPHCHI_THREAD_SLOTS
+#define DEF_GRAPHCHI_THREAD_SLOTS
+
+#include <assert.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <vector>
+
+#include "logger/logger.hpp"
+
+namespace graphchi {
+
+    static const int MAX_THREAD_SLOTS = 4096;
+
+    struct thread_slots {
+        static int & next() {
+            static int nextslot = 0;
+            return nextslot;
+        }
+
+        static pthread_mutex_t * free_lock() {
+            static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+            return &lock;
+        }
+
+        static std::vector<int> & free_slots() {
+            static std::vector<int> slots;
+            return slots;
+        }
+
+        /* Thread exit: the key holds slot + 1 */
+        static void release(void * value) {
+            int slot = (int) (intptr_t) value - 1;
+            pthread_mutex_lock(free_lock());
+            free_slots().push_back(slot);
+            pthread_mutex_unlock(free_lock());
+        }
+
+        static void create_key() {
+            pthread_key_create(&key(), release);
+        }
+
+        static pthread_key_t & key() {
+            static pthread_key_t k;
+            return k;
+        }
+
+        static int acquire() {
+            static pthread_once_t once = PTHREAD_ONCE_INIT;
+            pthread_once(&once, create_key);
+            int slot = -1;
+            pthread_mutex_lock(free_lock());
+            if (!free_slots().empty()) {
+                slot = free_slots().back();
+                free_slots().pop_back();
+            } else {
+                slot = next();
+                *(volatile int *) &next() = slot + 1;
+            }
+            pthread_mutex_unlock(free_lock());
+            if (slot >= MAX_THREAD_SLOTS) {
+                logstream(LOG_FATAL) << "More than " << MAX_THREAD_SLOTS << " threads alive asked for a thread slot" << std::endl;
+                assert(false);
+            }
+            pthread_setspecific(key(), (void *) (intptr_t) (slot + 1));
+            return slot;
+        }
+
+        /* Slot of the calling thread, assigned on first call */
+        static inline int current() {
+            static __thread int slot = -1;
+            if (slot < 0) slot = acquire();
+            return slot;
+        }
+
+        /* Number of slots handed out so far; all slots in use are below it */
+        static inline int count() {
+            return *(volatile int *) &next();
+        }
+    };
+
+}
+
+#endif
@@ -43,6 +43,7 @@
 #include "util/qsort.hpp"
 #include "api/chifilenames.hpp"
 #include "engine/auxdata/vertex_data.hpp"
+#include "api/vertex_aggregator.hpp"
 
 namespace graphchi {
   
@@ -74,15 +75,10 @@ namespace graphchi {
     std::vector<vertex_value<VertexDataType> > get_top_vertices(std::string basefilename, int ntop, vid_t from=0, vid_t to=0) {
         typedef vertex_value<VertexDataType> vv_t;
         
-        /* Initialize striped IO manager */
-        metrics m("toplist");
-        stripedio * iomgr = new stripedio(m);
-        
-        /* Initialize the vertex-data reader */
+        /* Initialize the vertex-data reader, it reads the next chunk ahead */
         vid_t readwindow = 1024 * 1024;
         size_t numvertices = get_num_vertices(basefilename);
-        vertex_data_store<VertexDataType> * vertexdata =
-        new vertex_data_store<VertexDataType>(basefilename, numvertices, iomgr);
+        vertex_chunk_reader<VertexDataType> reader(basefilename, 0, (vid_t) numvertices, readwindow);
            
         if ((size_t)ntop > numvertices) {
             ntop = (int)numvertices;
@@ -99,12 +95,9 @@ namespace graphchi {
         vid_t en = numvertices - 1;
 
         int count = 0;
-        while(st <= numvertices - 1) {
-            en = st + readwindow - 1;
-            if (en >= numvertices - 1) en = numvertices - 1;
-            
-            /* Load the vertex values */
-            vertexdata->load(st, en);
+        while(reader.next()) {
+            st = reader.first();
+            en = reader.last();
             
             int nt = en - st + 1;
             int k = 0;
@@ -113,7 +106,7 @@ namespace graphchi {
                 minima = topbuf[ntop - 1].value; // Minimum value that should be even considered
             }
             for(int j=0; j < nt; j++) {
-                VertexDataType& val = *vertexdata->vertex_data_ptr(j + st);
+                VertexDataType& val = *reader.vertex_data_ptr(j + st);
                 if (count == 0 || (val > minima)) {
                     buffer_idxs[k] = vv_t((vid_t)idx + from, val);
                     k++;
@@ -136,7 +129,6 @@ namespace graphchi {
             }
             
             count++;
-            st += readwindow;
         }
                    
         /* Return */
@@ -148,9 +140,6 @@ namespace graphchi {
         free(mergearr);
         free(topbuf);
 
-        delete vertexdata;
-        delete iomgr;
-
         return ret;
     }
 ////////////////////////////////////////////////////////////////////////////////////
@@ -165,15 +154,10 @@ namespace graphchi {
 			std::set<vid_t> get_top_degree_vertices(std::string basefilename, int ntop, int* maxdeg = NULL, vid_t from=0, vid_t to=0) {
 				typedef vertex_value<VertexDataType> vv_t;
 
-				/* Initialize striped IO manager */
-				metrics m("toplist");
-				stripedio * iomgr = new stripedio(m);
-
-				/* Initialize the vertex-data reader */
+				/* Initialize the vertex-data reader, it reads the next chunk ahead */
 				vid_t readwindow = 1024 * 1024;
 				size_t numvertices = get_num_vertices(basefilename);
-				vertex_data_store<VertexDataType> * vertexdata =
-					new vertex_data_store<VertexDataType>(basefilename, numvertices, iomgr);
+				vertex_chunk_reader<VertexDataType> reader(basefilename, 0, (vid_t) numvertices, readwindow);
 
 				if ((size_t)ntop > numvertices) {
 					ntop = (int)numvertices;
@@ -190,12 +174,9 @@ namespace graphchi {
 				vid_t en = numvertices - 1;
 
 				int count = 0;
-				while(st <= numvertices - 1) {
-					en = st + readwindow - 1;
-					if (en >= numvertices - 1) en = numvertices - 1;
-
-					/* Load the vertex values */
-					vertexdata->load(st, en);
+				while(reader.next()) {
+					st = reader.first();
+					en = reader.last();
 
 					int nt = en - st + 1;
 					int k = 0;
@@ -204,7 +185,7 @@ namespace graphchi {
 						minima = topbuf[ntop - 1].value; // Minimum value that should be even considered
 					}
 					for(int j=0; j < nt; j++) {
-						VertexDataType& val = *vertexdata->vertex_data_ptr(j + st);
+						VertexDataType& val = *reader.vertex_data_ptr(j + st);
 						if(val.is_active()){
 							if (count == 0 || (val.get_degree() > minima.get_degree())) {
 								buffer_idxs[k] = vv_t((vid_t)idx + from, val);
@@ -228,7 +209,6 @@ namespace graphchi {
 					}
 
 					count++;
-					st += readwindow;
 				}
 
 				/* Return */
@@ -246,9 +226,6 @@ namespace graphchi {
 				free(buffer_idxs);
 				free(mergearr);
 				free(topbuf);
-
-				delete vertexdata;
-				delete iomgr;
 				
 				return ret;
 			}
@@ -277,14 +254,10 @@ namespace graphchi {
     int get_top_deg_vertices(std::string basefilename, int* Rt, int ntop, vid_t from=0, vid_t to=0) {
         typedef deg_vertex<VertexDataType> vv_t;
        	assert(Rt != NULL); 
-        /* Initialize striped IO manager */
-        metrics m("Root init");
-        stripedio * iomgr = new stripedio(m);
-        /* Initialize the vertex-data reader */
+        /* Initialize the vertex-data reader, it reads the next chunk ahead */
         vid_t readwindow = 1024 * 1024;
         size_t numvertices = get_num_vertices(basefilename);
-        vertex_data_store<VertexDataType> * vertexdata =
-        new vertex_data_store<VertexDataType>(basefilename, numvertices, iomgr);
+        vertex_chunk_reader<VertexDataType> reader(basefilename, 0, (vid_t) numvertices, readwindow);
            
         if ((size_t)ntop > numvertices) {
             ntop = (int)numvertices;
@@ -303,12 +276,9 @@ namespace graphchi {
 		//int max_id =0; 
 
         int count = 0;
-        while(st <= numvertices - 1) {
-            en = st + readwindow - 1;
-            if (en >= numvertices - 1) en = numvertices - 1;
-            
-            /* Load the vertex values */
-            vertexdata->load(st, en);
+        while(reader.next()) {
+            st = reader.first();
+            en = reader.last();
             
             int nt = en - st + 1;
             int k = 0;
@@ -318,7 +288,7 @@ namespace graphchi {
                 mini_deg = topbuf[ntop - 1].value; // Minimum value that should be even considered
             }
             for(int j=0; j < nt; j++) {
-                VertexDataType& val = *vertexdata->vertex_data_ptr(j + st);
+                VertexDataType& val = *reader.vertex_data_ptr(j + st);
 				if(!val.is_confirm())
 				{// only  unvisited vertices can be roots
 				/*
@@ -350,7 +320,6 @@ namespace graphchi {
             }
             
             count++;
-            st += readwindow;
         }
                    
         /* Return */
@@ -383,9 +352,6 @@ namespace graphchi {
         free(buffer_idxs);
         free(mergearr);
         free(topbuf);
-
-        delete vertexdata;
-        delete iomgr;
 		
         return ntop;
     }
@@ -396,14 +362,10 @@ namespace graphchi {
     int get_top_deg_vertex(std::string basefilename, bool max = true, vid_t from=0, vid_t to=0) {
         //typedef deg_vertex<VertexDataType> vv_t;
        	//assert(Rt != NULL); 
-        /* Initialize striped IO manager */
-        metrics m("top degree vertex");
-        stripedio * iomgr = new stripedio(m);
-        /* Initialize the vertex-data reader */
+        /* Initialize the vertex-data reader, it reads the next chunk ahead */
         vid_t readwindow = 1024 * 1024;
         size_t numvertices = get_num_vertices(basefilename);
-        vertex_data_store<VertexDataType> * vertexdata =
-        new vertex_data_store<VertexDataType>(basefilename, numvertices, iomgr);
+        vertex_chunk_reader<VertexDataType> reader(basefilename, 0, (vid_t) numvertices, readwindow);
         /* 
         if ((size_t)ntop > numvertices) {
             ntop = (int)numvertices;
@@ -427,12 +389,9 @@ namespace graphchi {
 		int extreme_id = 0;
 		// get max or min degree vertex
 		int extreme_deg = max ? 0 : 2100000000;
-        while(st <= numvertices - 1) {
-            en = st + readwindow - 1;
-            if (en >= numvertices - 1) en = numvertices - 1;
-            
-            /* Load the vertex values */
-            vertexdata->load(st, en);
+        while(reader.next()) {
+            st = reader.first();
+            en = reader.last();
             
             int nt = en - st + 1;
             int k = 0;
@@ -444,7 +403,7 @@ namespace graphchi {
             }
 			*/
 			for(int j=0; j < nt; j++) {
-				VertexDataType& val = *vertexdata->vertex_data_ptr(j + st);
+				VertexDataType& val = *reader.vertex_data_ptr(j + st);
 				if(max){
 					if(val.get_degree() > extreme_deg){
 						extreme_id = j+st; 
@@ -472,7 +431,6 @@ namespace graphchi {
             }
            	*/ 
             count++;
-            st += readwindow;
         }
 		std::cout<<"extreme_id="<<extreme_id<<" extreme_degree="<<extreme_deg<<std::endl;
         return extreme_id;